@@ -17,7 +17,7 @@
 
 #include "../pngpriv.h"
 
-#ifdef PNG_READ_SUPPORTED
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_SUPPORTED)
 
 #if PNG_ARM_NEON_OPT > 0
 #ifdef PNG_ARM_NEON_CHECK_SUPPORTED /* Do run-time checks */
@@ -54,8 +54,8 @@ static int png_have_neon(png_structp png_ptr);
 #  error "ALIGNED_MEMORY is required; set: -DPNG_ALIGNED_MEMORY_SUPPORTED"
 #endif
 
-void
-png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
+static int
+png_use_neon(png_structp pp)
 {
    /* The switch statement is compiled in for ARM_NEON_API, the call to
     * png_have_neon is compiled in for ARM_NEON_CHECK.  If both are defined
@@ -67,7 +67,6 @@ png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
     * wrong order of the 'ON' and 'default' cases.  UNSET now defaults to OFF,
     * as documented in png.h
     */
-   png_debug(1, "in png_init_filter_functions_neon");
 #ifdef PNG_ARM_NEON_API_SUPPORTED
    switch ((pp->options >> PNG_ARM_NEON) & 3)
    {
@@ -86,7 +85,7 @@ png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
                no_neon = !png_have_neon(pp);
 
             if (no_neon)
-               return;
+               return 0;
          }
 #ifdef PNG_ARM_NEON_API_SUPPORTED
          break;
@@ -95,7 +94,7 @@ png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
 
 #ifdef PNG_ARM_NEON_API_SUPPORTED
       default: /* OFF or INVALID */
-         return;
+         return 0;
 
       case PNG_OPTION_ON:
          /* Option turned on */
@@ -103,6 +102,19 @@ png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
    }
 #endif
 
+   PNG_UNUSED(pp)
+   return 1;
+}
+
+#ifdef PNG_READ_SUPPORTED
+void
+png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
+{
+   png_debug(1, "in png_init_filter_functions_neon");
+
+   if (png_use_neon(pp) == 0)
+      return;
+
    /* IMPORTANT: any new external functions used here must be declared using
     * PNG_INTERNAL_FUNCTION in ../pngpriv.h.  This is required so that the
     * 'prefix' option to configure works:
@@ -131,6 +143,120 @@ png_init_filter_functions_neon(png_structp pp, unsigned int bpp)
       pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
           png_read_filter_row_paeth4_neon;
    }
+
+#if PNG_ARM_NEON_IMPLEMENTATION == 1
+   /* There are no assembler versions of the filters for 1 and 2 byte pixels or
+    * for 16-bit RGB and RGBA.  Avg and Paeth for 1 byte pixels are left as the
+    * generic C code.
+    */
+   else if (bpp == 1)
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub1_neon;
+
+   else if (bpp == 2)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub2_neon;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg2_neon;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_read_filter_row_paeth2_neon;
+   }
+
+   else if (bpp == 6)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub6_neon;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg6_neon;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_read_filter_row_paeth6_neon;
+   }
+
+   else if (bpp == 8)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub8_neon;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg8_neon;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_read_filter_row_paeth8_neon;
+   }
+#endif
 }
-#endif /* PNG_ARM_NEON_OPT > 0 */
 #endif /* READ */
+
+#if defined(PNG_WRITE_FILTER_SUPPORTED) && PNG_ARM_NEON_IMPLEMENTATION == 1
+void
+png_init_write_filter_functions_neon(png_structp pp, unsigned int bpp)
+{
+   png_debug(1, "in png_init_write_filter_functions_neon");
+
+   if (png_use_neon(pp) == 0)
+      return;
+
+   /* The write filters handle every pixel size. */
+   pp->write_filter[PNG_FILTER_VALUE_SUB-1] = png_write_filter_row_sub_neon;
+   pp->write_filter[PNG_FILTER_VALUE_UP-1] = png_write_filter_row_up_neon;
+   pp->write_filter[PNG_FILTER_VALUE_AVG-1] = png_write_filter_row_avg_neon;
+   pp->write_filter[PNG_FILTER_VALUE_PAETH-1] =
+       png_write_filter_row_paeth_neon;
+   pp->write_filter_sums = png_write_filter_sums_neon;
+
+   PNG_UNUSED(bpp)
+}
+#endif /* WRITE_FILTER && intrinsics */
+
+#if PNG_ARM_PMULL_OPT > 0
+void
+png_init_crc_functions_neon(png_structp pp)
+{
+   png_debug(1, "in png_init_crc_functions_neon");
+
+   if (png_use_neon(pp) == 0)
+      return;
+
+   pp->crc_fn = png_crc32_pmull;
+}
+#endif /* PNG_ARM_PMULL_OPT > 0 */
+
+#if defined(PNG_ARM_NEON_GAMMA) && defined(PNG_READ_GAMMA_SUPPORTED)
+void
+png_init_gamma_functions_neon(png_structp pp)
+{
+   png_debug(1, "in png_init_gamma_functions_neon");
+
+   if (png_use_neon(pp) == 0)
+      return;
+
+   pp->do_gamma = png_do_gamma_neon;
+
+#if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+   defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+   pp->do_compose = png_do_compose_neon;
+#endif
+
+#ifdef PNG_READ_RGB_TO_GRAY_SUPPORTED
+   pp->do_rgb_to_gray = png_do_rgb_to_gray_neon;
+#endif
+}
+#endif /* ARM_NEON_GAMMA && READ_GAMMA */
+
+#if PNG_ARM_NEON_IMPLEMENTATION == 1
+void
+png_init_shuffle_functions_neon(png_structp pp)
+{
+   png_debug(1, "in png_init_shuffle_functions_neon");
+
+   if (png_use_neon(pp) == 0)
+      return;
+
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+   defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+   /* Not if the 8-bit gamma lookup is fused too. */
+   if (pp->do_fused != NULL && pp->fused_gamma == NULL)
+      pp->do_fused = png_do_fused_neon;
+#endif
+
+#if defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+   defined(PNG_WRITE_PACKSWAP_SUPPORTED)
+   if ((pp->transformations & PNG_PACKSWAP) != 0)
+      pp->do_packswap = png_do_packswap_neon;
+#endif
+}
+#endif /* intrinsics */
+#endif /* PNG_ARM_NEON_OPT > 0 */
+#endif /* READ || WRITE */
@@ -0,0 +1,164 @@
+/* crc32_neon_intrinsics.c - CRC-32 using the ARMv8 PMULL instruction
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_SUPPORTED)
+
+#if PNG_ARM_PMULL_OPT > 0
+
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_ARM64)
+#  include <arm64_neon.h>
+#else
+#  include <arm_neon.h>
+#endif
+
+/* This is the method of intel/crc32_pclmul_intrinsics.c, with the same
+ * constants; see there for the details.  PMULL multiplies one 64-bit half of
+ * each operand, so these helpers stand in for the PCLMULQDQ selectors 0x00
+ * (low halves), 0x11 (high halves) and 0x10 (low of a, high of b.)
+ */
+static const uint64_t png_crc32_k1k2[2] = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t png_crc32_k3k4[2] = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t png_crc32_k5[2] = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t png_crc32_poly[2] = { 0x01db710641, 0x01f7011641 };
+
+static uint64x2_t
+png_clmul_00(uint64x2_t a, uint64x2_t b)
+{
+   return vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(a, 0),
+       (poly64_t)vgetq_lane_u64(b, 0)));
+}
+
+static uint64x2_t
+png_clmul_11(uint64x2_t a, uint64x2_t b)
+{
+   return vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(a, 1),
+       (poly64_t)vgetq_lane_u64(b, 1)));
+}
+
+static uint64x2_t
+png_clmul_10(uint64x2_t a, uint64x2_t b)
+{
+   return vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(a, 0),
+       (poly64_t)vgetq_lane_u64(b, 1)));
+}
+
+/* Load 16 bytes, and shift a vector right by n bytes shifting in zeros. */
+#define png_load(p) vreinterpretq_u64_u8(vld1q_u8(p))
+#define png_shift_right(x, n) vreinterpretq_u64_u8(\
+   vextq_u8(vreinterpretq_u8_u64(x), vdupq_n_u8(0), n))
+
+/* Fold 'length' bytes, which must be at least 64 and a multiple of 16, into
+ * the (uninverted) CRC register 'crc' and return the new register value.
+ */
+static png_uint_32
+png_crc32_fold(png_uint_32 crc, png_const_bytep ptr, size_t length)
+{
+   uint64x2_t x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+   x1 = png_load(ptr);
+   x2 = png_load(ptr + 16);
+   x3 = png_load(ptr + 32);
+   x4 = png_load(ptr + 48);
+   x1 = veorq_u64(x1,
+       vreinterpretq_u64_u32(vsetq_lane_u32(crc, vdupq_n_u32(0), 0)));
+
+   ptr += 64;
+   length -= 64;
+
+   /* Fold four 128-bit lanes at a time. */
+   x0 = vld1q_u64(png_crc32_k1k2);
+
+   while (length >= 64)
+   {
+      x5 = png_clmul_00(x1, x0);
+      x6 = png_clmul_00(x2, x0);
+      x7 = png_clmul_00(x3, x0);
+      x8 = png_clmul_00(x4, x0);
+
+      x1 = png_clmul_11(x1, x0);
+      x2 = png_clmul_11(x2, x0);
+      x3 = png_clmul_11(x3, x0);
+      x4 = png_clmul_11(x4, x0);
+
+      x1 = veorq_u64(veorq_u64(x1, x5), png_load(ptr));
+      x2 = veorq_u64(veorq_u64(x2, x6), png_load(ptr + 16));
+      x3 = veorq_u64(veorq_u64(x3, x7), png_load(ptr + 32));
+      x4 = veorq_u64(veorq_u64(x4, x8), png_load(ptr + 48));
+
+      ptr += 64;
+      length -= 64;
+   }
+
+   /* Fold the four lanes into one. */
+   x0 = vld1q_u64(png_crc32_k3k4);
+
+   x5 = png_clmul_00(x1, x0);
+   x1 = png_clmul_11(x1, x0);
+   x1 = veorq_u64(veorq_u64(x1, x5), x2);
+
+   x5 = png_clmul_00(x1, x0);
+   x1 = png_clmul_11(x1, x0);
+   x1 = veorq_u64(veorq_u64(x1, x5), x3);
+
+   x5 = png_clmul_00(x1, x0);
+   x1 = png_clmul_11(x1, x0);
+   x1 = veorq_u64(veorq_u64(x1, x5), x4);
+
+   /* Then any remaining 16 byte blocks. */
+   while (length >= 16)
+   {
+      x5 = png_clmul_00(x1, x0);
+      x1 = png_clmul_11(x1, x0);
+      x1 = veorq_u64(veorq_u64(x1, x5), png_load(ptr));
+
+      ptr += 16;
+      length -= 16;
+   }
+
+   /* Reduce 128 bits to 64. */
+   x3 = vdupq_n_u64(0xffffffff);
+   x2 = png_clmul_10(x1, x0);
+   x1 = veorq_u64(png_shift_right(x1, 8), x2);
+
+   x0 = vld1q_u64(png_crc32_k5);
+   x2 = png_shift_right(x1, 4);
+   x1 = png_clmul_00(vandq_u64(x1, x3), x0);
+   x1 = veorq_u64(x1, x2);
+
+   /* Barrett reduction to 32 bits. */
+   x0 = vld1q_u64(png_crc32_poly);
+   x2 = png_clmul_10(vandq_u64(x1, x3), x0);
+   x2 = png_clmul_00(vandq_u64(x2, x3), x0);
+   x1 = veorq_u64(x1, x2);
+
+   return vgetq_lane_u32(vreinterpretq_u32_u64(x1), 1);
+}
+
+png_uint_32
+png_crc32_pmull(png_uint_32 crc, png_const_bytep ptr, size_t length)
+{
+   /* Short buffers, such as chunk headers, and the tail of longer ones are
+    * left to the table code.
+    */
+   if (length >= 64)
+   {
+      size_t fold = length & ~(size_t)15;
+
+      crc = ~png_crc32_fold(~crc, ptr, fold);
+      ptr += fold;
+      length -= fold;
+   }
+
+   return png_crc32_slice8(crc, ptr, length);
+}
+
+#endif /* PNG_ARM_PMULL_OPT > 0 */
+#endif /* READ || WRITE */
@@ -13,7 +13,7 @@
 
 #include "../pngpriv.h"
 
-#ifdef PNG_READ_SUPPORTED
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_FILTER_SUPPORTED)
 
 /* This code requires -mfpu=neon on the command line: */
 #if PNG_ARM_NEON_IMPLEMENTATION == 1 /* intrinsics code from pngpriv.h */
@@ -47,6 +47,34 @@
 
 #if PNG_ARM_NEON_OPT > 0
 
+static uint8x8_t
+paeth(uint8x8_t a, uint8x8_t b, uint8x8_t c)
+{
+   uint8x8_t d, e;
+   uint16x8_t p1, pa, pb, pc;
+
+   p1 = vaddl_u8(a, b); /* a + b */
+   pc = vaddl_u8(c, c); /* c * 2 */
+   pa = vabdl_u8(b, c); /* pa */
+   pb = vabdl_u8(a, c); /* pb */
+   pc = vabdq_u16(p1, pc); /* pc */
+
+   p1 = vcleq_u16(pa, pb); /* pa <= pb */
+   pa = vcleq_u16(pa, pc); /* pa <= pc */
+   pb = vcleq_u16(pb, pc); /* pb <= pc */
+
+   p1 = vandq_u16(p1, pa); /* pa <= pb && pa <= pc */
+
+   d = vmovn_u16(pb);
+   e = vmovn_u16(p1);
+
+   d = vbsl_u8(d, b, c);
+   e = vbsl_u8(e, a, d);
+
+   return e;
+}
+
+#ifdef PNG_READ_SUPPORTED
 void
 png_read_filter_row_up_neon(png_row_infop row_info, png_bytep row,
    png_const_bytep prev_row)
@@ -68,6 +96,69 @@ png_read_filter_row_up_neon(png_row_infop row_info, png_bytep row,
    }
 }
 
+void
+png_read_filter_row_sub1_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* For 1 and 2 byte pixels Sub is reversed 16 bytes at a time by a prefix
+    * sum: adding the vector shifted by 1 (or 2), 4 and 8 bytes leaves each
+    * byte holding the sum of all the bytes before it, then the last value
+    * reconstructed in the previous block is added to all of them.
+    */
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+
+   uint8x16_t vzero = vdupq_n_u8(0);
+   uint8x16_t vlast = vzero;
+
+   png_debug(1, "in png_read_filter_row_sub1_neon");
+
+   for (; rp < rp_stop; rp += 16)
+   {
+      uint8x16_t qrp = vld1q_u8(rp);
+
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 15));
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 14));
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 12));
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 8));
+      qrp = vaddq_u8(qrp, vlast);
+      vlast = vdupq_n_u8(vgetq_lane_u8(qrp, 15));
+
+      vst1q_u8(rp, qrp);
+   }
+
+   PNG_UNUSED(prev_row)
+}
+
+void
+png_read_filter_row_sub2_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+
+   uint8x16_t vzero = vdupq_n_u8(0);
+   uint8x16_t vlast = vzero;
+
+   png_debug(1, "in png_read_filter_row_sub2_neon");
+
+   for (; rp < rp_stop; rp += 16)
+   {
+      uint8x16_t qrp = vld1q_u8(rp);
+
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 14));
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 12));
+      qrp = vaddq_u8(qrp, vextq_u8(vzero, qrp, 8));
+      qrp = vaddq_u8(qrp, vlast);
+      vlast = vreinterpretq_u8_u16(vdupq_n_u16(
+          vgetq_lane_u16(vreinterpretq_u16_u8(qrp), 7)));
+
+      vst1q_u8(rp, qrp);
+   }
+
+   PNG_UNUSED(prev_row)
+}
+
 void
 png_read_filter_row_sub3_neon(png_row_infop row_info, png_bytep row,
    png_const_bytep prev_row)
@@ -257,33 +348,6 @@ png_read_filter_row_avg4_neon(png_row_infop row_info, png_bytep row,
    }
 }
 
-static uint8x8_t
-paeth(uint8x8_t a, uint8x8_t b, uint8x8_t c)
-{
-   uint8x8_t d, e;
-   uint16x8_t p1, pa, pb, pc;
-
-   p1 = vaddl_u8(a, b); /* a + b */
-   pc = vaddl_u8(c, c); /* c * 2 */
-   pa = vabdl_u8(b, c); /* pa */
-   pb = vabdl_u8(a, c); /* pb */
-   pc = vabdq_u16(p1, pc); /* pc */
-
-   p1 = vcleq_u16(pa, pb); /* pa <= pb */
-   pa = vcleq_u16(pa, pc); /* pa <= pc */
-   pb = vcleq_u16(pb, pc); /* pb <= pc */
-
-   p1 = vandq_u16(p1, pa); /* pa <= pb && pa <= pc */
-
-   d = vmovn_u16(pb);
-   e = vmovn_u16(p1);
-
-   d = vbsl_u8(d, b, c);
-   e = vbsl_u8(e, a, d);
-
-   return e;
-}
-
 void
 png_read_filter_row_paeth3_neon(png_row_infop row_info, png_bytep row,
    png_const_bytep prev_row)
@@ -397,6 +461,468 @@ png_read_filter_row_paeth4_neon(png_row_infop row_info, png_bytep row,
    }
 }
 
+/* Avg and Paeth for 2 byte pixels (8-bit gray-alpha, 16-bit gray) work a pixel
+ * at a time; each pixel depends on the previous reconstructed one.
+ */
+void
+png_read_filter_row_avg2_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+   png_const_bytep pp = prev_row;
+
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_avg2_neon");
+
+   for (; rp < rp_stop; rp += 2, pp += 2)
+   {
+      vdest = vhadd_u8(vdest, vld1_u8(pp));
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      vst1_lane_u16(png_ptr(uint16_t,rp), vreinterpret_u16_u8(vdest), 0);
+   }
+}
+
+void
+png_read_filter_row_paeth2_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+   png_const_bytep pp = prev_row;
+
+   uint8x8_t vlast = vdup_n_u8(0);
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_paeth2_neon");
+
+   for (; rp < rp_stop; rp += 2, pp += 2)
+   {
+      uint8x8_t vpp = vld1_u8(pp);
+
+      vdest = paeth(vdest, vpp, vlast);
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      vlast = vpp;
+
+      vst1_lane_u16(png_ptr(uint16_t,rp), vreinterpret_u16_u8(vdest), 0);
+   }
+}
+
+/* 6 and 8 byte pixels (16-bit RGB and RGBA) are handled one pixel per 64-bit
+ * register.  A 6 byte pixel is loaded with the following two bytes, which are
+ * ignored, and stored as a 32-bit and a 16-bit lane so that the raw bytes of
+ * the next pixel are not overwritten before they have been read.
+ */
+static void
+png_st6(png_bytep rp, uint8x8_t v)
+{
+   vst1_lane_u32(png_ptr(uint32_t,rp), vreinterpret_u32_u8(v), 0);
+   vst1_lane_u16(png_ptr(uint16_t,rp+4), vreinterpret_u16_u8(v), 2);
+}
+
+void
+png_read_filter_row_sub6_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_sub6_neon");
+
+   for (; rp < rp_stop; rp += 6)
+   {
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      png_st6(rp, vdest);
+   }
+
+   PNG_UNUSED(prev_row)
+}
+
+void
+png_read_filter_row_sub8_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_sub8_neon");
+
+   for (; rp < rp_stop; rp += 8)
+   {
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      vst1_u8(rp, vdest);
+   }
+
+   PNG_UNUSED(prev_row)
+}
+
+void
+png_read_filter_row_avg6_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+   png_const_bytep pp = prev_row;
+
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_avg6_neon");
+
+   for (; rp < rp_stop; rp += 6, pp += 6)
+   {
+      vdest = vhadd_u8(vdest, vld1_u8(pp));
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      png_st6(rp, vdest);
+   }
+}
+
+void
+png_read_filter_row_avg8_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+   png_const_bytep pp = prev_row;
+
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_avg8_neon");
+
+   for (; rp < rp_stop; rp += 8, pp += 8)
+   {
+      vdest = vhadd_u8(vdest, vld1_u8(pp));
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      vst1_u8(rp, vdest);
+   }
+}
+
+void
+png_read_filter_row_paeth6_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+   png_const_bytep pp = prev_row;
+
+   uint8x8_t vlast = vdup_n_u8(0);
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_paeth6_neon");
+
+   for (; rp < rp_stop; rp += 6, pp += 6)
+   {
+      uint8x8_t vpp = vld1_u8(pp);
+
+      vdest = paeth(vdest, vpp, vlast);
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      vlast = vpp;
+
+      png_st6(rp, vdest);
+   }
+}
+
+void
+png_read_filter_row_paeth8_neon(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   png_bytep rp = row;
+   png_bytep rp_stop = row + row_info->rowbytes;
+   png_const_bytep pp = prev_row;
+
+   uint8x8_t vlast = vdup_n_u8(0);
+   uint8x8_t vdest = vdup_n_u8(0);
+
+   png_debug(1, "in png_read_filter_row_paeth8_neon");
+
+   for (; rp < rp_stop; rp += 8, pp += 8)
+   {
+      uint8x8_t vpp = vld1_u8(pp);
+
+      vdest = paeth(vdest, vpp, vlast);
+      vdest = vadd_u8(vdest, vld1_u8(rp));
+      vlast = vpp;
+
+      vst1_u8(rp, vdest);
+   }
+}
+
+#endif /* READ */
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* The write side filters work on the unfiltered rows so there is no serial
+ * dependency and all four handle any pixel size 16 bytes at a time.  Each
+ * stores the filtered bytes and returns the sum of their absolute values, as
+ * signed bytes, stopping early when this exceeds lmins as the C code does.
+ * Unlike the read functions these do not read or write beyond row_bytes.
+ */
+#define PNG_FILTER_SUM(v) ((v) < 128 ? (v) : 256 - (v))
+
+static size_t
+png_sum_abs_neon(uint8x16_t d)
+{
+   uint64x2_t s;
+
+   /* vabsq_s8 maps -128 to itself, which is 128 when taken as unsigned. */
+   s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vreinterpretq_u8_s8(
+       vabsq_s8(vreinterpretq_s8_u8(d))))));
+
+   return (size_t)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+}
+
+size_t
+png_write_filter_row_sub_neon(png_const_bytep row, png_const_bytep prev,
+   png_bytep dp, size_t row_bytes, unsigned int bpp, size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_sub_neon");
+
+   for (i = 0; i < bpp; i++)
+   {
+      unsigned int v = dp[i] = row[i];
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   for (; i + 16 <= row_bytes; i += 16)
+   {
+      uint8x16_t d = vsubq_u8(vld1q_u8(row + i), vld1q_u8(row + i - bpp));
+
+      vst1q_u8(dp + i, d);
+      sum += png_sum_abs_neon(d);
+
+      if (sum > lmins)  /* We are already worse, don't continue. */
+         return sum;
+   }
+
+   for (; i < row_bytes; i++)
+   {
+      unsigned int v = dp[i] = (png_byte)(row[i] - row[i - bpp]);
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   PNG_UNUSED(prev)
+   return sum;
+}
+
+size_t
+png_write_filter_row_up_neon(png_const_bytep row, png_const_bytep prev,
+   png_bytep dp, size_t row_bytes, unsigned int bpp, size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_up_neon");
+
+   for (i = 0; i + 16 <= row_bytes; i += 16)
+   {
+      uint8x16_t d = vsubq_u8(vld1q_u8(row + i), vld1q_u8(prev + i));
+
+      vst1q_u8(dp + i, d);
+      sum += png_sum_abs_neon(d);
+
+      if (sum > lmins)
+         return sum;
+   }
+
+   for (; i < row_bytes; i++)
+   {
+      unsigned int v = dp[i] = (png_byte)(row[i] - prev[i]);
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   PNG_UNUSED(bpp)
+   return sum;
+}
+
+size_t
+png_write_filter_row_avg_neon(png_const_bytep row, png_const_bytep prev,
+   png_bytep dp, size_t row_bytes, unsigned int bpp, size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_avg_neon");
+
+   for (i = 0; i < bpp; i++)
+   {
+      unsigned int v = dp[i] = (png_byte)(row[i] - (prev[i] >> 1));
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   for (; i + 16 <= row_bytes; i += 16)
+   {
+      /* vhaddq_u8 is the truncating average PNG requires. */
+      uint8x16_t d = vsubq_u8(vld1q_u8(row + i),
+          vhaddq_u8(vld1q_u8(row + i - bpp), vld1q_u8(prev + i)));
+
+      vst1q_u8(dp + i, d);
+      sum += png_sum_abs_neon(d);
+
+      if (sum > lmins)
+         return sum;
+   }
+
+   for (; i < row_bytes; i++)
+   {
+      unsigned int v = dp[i] =
+          (png_byte)(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   return sum;
+}
+
+size_t
+png_write_filter_row_paeth_neon(png_const_bytep row, png_const_bytep prev,
+   png_bytep dp, size_t row_bytes, unsigned int bpp, size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_paeth_neon");
+
+   for (i = 0; i < bpp; i++)
+   {
+      unsigned int v = dp[i] = (png_byte)(row[i] - prev[i]);
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   for (; i + 16 <= row_bytes; i += 16)
+   {
+      uint8x16_t a = vld1q_u8(row + i - bpp);
+      uint8x16_t b = vld1q_u8(prev + i);
+      uint8x16_t c = vld1q_u8(prev + i - bpp);
+      uint8x16_t d;
+
+      d = vsubq_u8(vld1q_u8(row + i), vcombine_u8(
+          paeth(vget_low_u8(a), vget_low_u8(b), vget_low_u8(c)),
+          paeth(vget_high_u8(a), vget_high_u8(b), vget_high_u8(c))));
+
+      vst1q_u8(dp + i, d);
+      sum += png_sum_abs_neon(d);
+
+      if (sum > lmins)
+         return sum;
+   }
+
+   for (; i < row_bytes; i++)
+   {
+      int a = row[i - bpp], b = prev[i], c = prev[i - bpp];
+      int pa = b - c, pb = a - c, pc = pa + pb;
+      unsigned int v;
+
+      pa = pa < 0 ? -pa : pa;
+      pb = pb < 0 ? -pb : pb;
+      pc = pc < 0 ? -pc : pc;
+
+      v = dp[i] = (png_byte)(row[i] -
+          ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c));
+      sum += PNG_FILTER_SUM(v);
+   }
+
+   return sum;
+}
+
+/* Add the contribution of one byte, r, to each of the five filter sums given
+ * its neighbours a (left), b (above) and c (above left).
+ */
+static void
+png_filter_sums_byte(size_t *sums, int r, int a, int b, int c)
+{
+   int pa = b - c, pb = a - c, pc = pa + pb;
+   unsigned int v;
+
+   pa = pa < 0 ? -pa : pa;
+   pb = pb < 0 ? -pb : pb;
+   pc = pc < 0 ? -pc : pc;
+
+   v = r & 0xff;
+   sums[PNG_FILTER_VALUE_NONE] += PNG_FILTER_SUM(v);
+   v = (r - a) & 0xff;
+   sums[PNG_FILTER_VALUE_SUB] += PNG_FILTER_SUM(v);
+   v = (r - b) & 0xff;
+   sums[PNG_FILTER_VALUE_UP] += PNG_FILTER_SUM(v);
+   v = (r - ((a + b) >> 1)) & 0xff;
+   sums[PNG_FILTER_VALUE_AVG] += PNG_FILTER_SUM(v);
+   v = (r - ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c)) & 0xff;
+   sums[PNG_FILTER_VALUE_PAETH] += PNG_FILTER_SUM(v);
+}
+
+/* Accumulate |d| (as signed bytes) into the 32-bit lanes of s. */
+static uint32x4_t
+png_acc_abs_neon(uint32x4_t s, uint8x16_t d)
+{
+   return vpadalq_u16(s, vpaddlq_u8(vreinterpretq_u8_s8(
+       vabsq_s8(vreinterpretq_s8_u8(d)))));
+}
+
+static size_t
+png_sum_lanes_neon(uint32x4_t s)
+{
+   uint64x2_t t = vpaddlq_u32(s);
+
+   return (size_t)(vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1));
+}
+
+/* Compute the sums for all five filters in one pass over the row, without
+ * storing any filtered bytes.
+ */
+void
+png_write_filter_sums_neon(png_const_bytep row, png_const_bytep prev,
+   size_t row_bytes, unsigned int bpp, size_t *sums)
+{
+   size_t i;
+   int f;
+
+   png_debug(1, "in png_write_filter_sums_neon");
+
+   for (f = 0; f < PNG_FILTER_VALUE_LAST; f++)
+      sums[f] = 0;
+
+   for (i = 0; i < bpp; i++)
+      png_filter_sums_byte(sums, row[i], 0, prev[i], 0);
+
+   /* Each 32-bit lane gains at most 512 per vector, so the row is done in
+    * blocks of 1MB to avoid overflow.
+    */
+   while (i + 16 <= row_bytes)
+   {
+      size_t end = row_bytes - i > 0x100000 ? i + 0x100000 : row_bytes;
+      uint32x4_t s0, s1, s2, s3, s4;
+
+      s0 = s1 = s2 = s3 = s4 = vdupq_n_u32(0);
+
+      for (; i + 16 <= end; i += 16)
+      {
+         uint8x16_t r = vld1q_u8(row + i);
+         uint8x16_t a = vld1q_u8(row + i - bpp);
+         uint8x16_t b = vld1q_u8(prev + i);
+         uint8x16_t c = vld1q_u8(prev + i - bpp);
+         uint8x16_t p = vcombine_u8(
+             paeth(vget_low_u8(a), vget_low_u8(b), vget_low_u8(c)),
+             paeth(vget_high_u8(a), vget_high_u8(b), vget_high_u8(c)));
+
+         s0 = png_acc_abs_neon(s0, r);
+         s1 = png_acc_abs_neon(s1, vsubq_u8(r, a));
+         s2 = png_acc_abs_neon(s2, vsubq_u8(r, b));
+         s3 = png_acc_abs_neon(s3, vsubq_u8(r, vhaddq_u8(a, b)));
+         s4 = png_acc_abs_neon(s4, vsubq_u8(r, p));
+      }
+
+      sums[PNG_FILTER_VALUE_NONE] += png_sum_lanes_neon(s0);
+      sums[PNG_FILTER_VALUE_SUB] += png_sum_lanes_neon(s1);
+      sums[PNG_FILTER_VALUE_UP] += png_sum_lanes_neon(s2);
+      sums[PNG_FILTER_VALUE_AVG] += png_sum_lanes_neon(s3);
+      sums[PNG_FILTER_VALUE_PAETH] += png_sum_lanes_neon(s4);
+   }
+
+   for (; i < row_bytes; i++)
+      png_filter_sums_byte(sums, row[i], row[i - bpp], prev[i], prev[i - bpp]);
+}
+#endif /* WRITE_FILTER */
+
 #endif /* PNG_ARM_NEON_OPT > 0 */
 #endif /* PNG_ARM_NEON_IMPLEMENTATION == 1 (intrinsics) */
-#endif /* READ */
+#endif /* READ || WRITE_FILTER */
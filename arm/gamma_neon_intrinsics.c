@@ -0,0 +1,671 @@
+/* gamma_neon_intrinsics.c - NEON gamma correction, compositing and conversion
+ *                           to gray
+ *
+ * Copyright (c) 2026 agent
+ * Derived from intel/gamma_sse2_intrinsics.c
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_GAMMA_SUPPORTED
+
+#ifdef PNG_ARM_NEON_GAMMA
+
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_ARM64)
+#  include <arm64_neon.h>
+#else
+#  include <arm_neon.h>
+#endif
+
+/* As in the SSE2 code the whole row is corrected then the alpha channel is put
+ * back.  Return the number of bytes in each pixel that are not alpha, with the
+ * size of the pixel in *pixel_bytes, or 0 for the formats that are left to
+ * png_do_gamma.
+ */
+static unsigned int
+png_gamma_layout(png_row_infop row_info, unsigned int *pixel_bytes)
+{
+   unsigned int sample_bytes = row_info->bit_depth >> 3;
+
+   *pixel_bytes = sample_bytes * row_info->channels;
+
+   switch (row_info->color_type)
+   {
+      case PNG_COLOR_TYPE_GRAY:
+      case PNG_COLOR_TYPE_RGB:
+         return *pixel_bytes;
+
+      case PNG_COLOR_TYPE_GRAY_ALPHA:
+      case PNG_COLOR_TYPE_RGB_ALPHA:
+         return *pixel_bytes - sample_bytes;
+
+      default:
+         return 0;
+   }
+}
+
+/* A vector with 0xff in the alpha bytes; the pixel sizes with alpha, 2, 4 and
+ * 8 bytes, all divide 16.
+ */
+static uint8x16_t
+png_gamma_alpha_mask(unsigned int pixel_bytes, unsigned int color_bytes)
+{
+   png_byte mask[16];
+   unsigned int i;
+
+   for (i = 0; i < 16; ++i)
+      mask[i] = (png_byte)(i % pixel_bytes < color_bytes ? 0 : 0xff);
+
+   return vld1q_u8(mask);
+}
+
+/* 8-bit samples: TBL looks up 64 byte tables and TBX leaves the lanes with an
+ * index out of range unchanged, so four lookups, with the index reduced by 64
+ * each time, cover the whole 256 entry table.
+ */
+static void
+png_lookup_init_neon(uint8x16x4_t table[4], png_const_bytep bytes)
+{
+   int i, j;
+
+   for (i = 0; i < 4; ++i)
+      for (j = 0; j < 4; ++j)
+         table[i].val[j] = vld1q_u8(bytes + 64*i + 16*j);
+}
+
+static uint8x16_t
+png_lookup_neon(const uint8x16x4_t table[4], uint8x16_t x)
+{
+   uint8x16_t step = vdupq_n_u8(64);
+   uint8x16_t index = vsubq_u8(x, step);
+   uint8x16_t g = vqtbl4q_u8(table[0], x);
+
+   g = vqtbx4q_u8(g, table[1], index);
+   index = vsubq_u8(index, step);
+   g = vqtbx4q_u8(g, table[2], index);
+   index = vsubq_u8(index, step);
+   return vqtbx4q_u8(g, table[3], index);
+}
+
+static void
+png_do_gamma_8_neon(png_const_bytep gamma_table, png_bytep row,
+    size_t rowbytes, unsigned int pixel_bytes, unsigned int color_bytes)
+{
+   uint8x16x4_t table[4];
+   uint8x16_t alpha = png_gamma_alpha_mask(pixel_bytes, color_bytes);
+   size_t n;
+
+   png_lookup_init_neon(table, gamma_table);
+
+   for (n = 0; n + 16 <= rowbytes; n += 16)
+   {
+      uint8x16_t x = vld1q_u8(row + n);
+
+      vst1q_u8(row + n, vbslq_u8(alpha, x, png_lookup_neon(table, x)));
+   }
+
+   for (; n < rowbytes; ++n)
+      if (n % pixel_bytes < color_bytes)
+         row[n] = gamma_table[row[n]];
+}
+
+#ifdef PNG_READ_16BIT_SUPPORTED
+/* 16-bit samples, approximately, with PNG_APPROXIMATE_GAMMA_16: the same
+ * calculation as png_do_gamma_16_sse2, see there for the details.
+ */
+static float32x4_t
+png_log2_f32(float32x4_t x)
+{
+   uint32x4_t bits = vreinterpretq_u32_f32(x);
+   int32x4_t e = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)),
+       vdupq_n_s32(127));
+   float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(
+       vandq_u32(bits, vdupq_n_u32(0x7fffff)), vdupq_n_u32(0x3f800000)));
+   uint32x4_t big = vcgtq_f32(m, vdupq_n_f32(1.41421356f));
+   float32x4_t s, s2, p;
+
+   m = vbslq_f32(big, vmulq_n_f32(m, .5f), m);
+   e = vsubq_s32(e, vreinterpretq_s32_u32(big));
+
+   s = vdivq_f32(vsubq_f32(m, vdupq_n_f32(1.f)),
+       vaddq_f32(m, vdupq_n_f32(1.f)));
+   s2 = vmulq_f32(s, s);
+
+   p = vaddq_f32(vdupq_n_f32(.41219858f), vmulq_n_f32(s2, .32059889f));
+   p = vaddq_f32(vdupq_n_f32(.57707802f), vmulq_f32(s2, p));
+   p = vaddq_f32(vdupq_n_f32(.96179669f), vmulq_f32(s2, p));
+   p = vaddq_f32(vdupq_n_f32(2.88539008f), vmulq_f32(s2, p));
+
+   return vaddq_f32(vcvtq_f32_s32(e), vmulq_f32(s, p));
+}
+
+static float32x4_t
+png_exp2_f32(float32x4_t y)
+{
+   int32x4_t n;
+   float32x4_t f, p;
+
+   y = vmaxq_f32(y, vdupq_n_f32(-126.f));
+   n = vcvtnq_s32_f32(y);
+   f = vsubq_f32(y, vcvtq_f32_s32(n));
+
+   p = vaddq_f32(vdupq_n_f32(1.3333558e-3f), vmulq_n_f32(f, 1.5403530e-4f));
+   p = vaddq_f32(vdupq_n_f32(9.6181291e-3f), vmulq_f32(f, p));
+   p = vaddq_f32(vdupq_n_f32(5.5504109e-2f), vmulq_f32(f, p));
+   p = vaddq_f32(vdupq_n_f32(.24022651f), vmulq_f32(f, p));
+   p = vaddq_f32(vdupq_n_f32(.69314718f), vmulq_f32(f, p));
+   p = vaddq_f32(vdupq_n_f32(1.f), vmulq_f32(f, p));
+
+   return vmulq_f32(p, vreinterpretq_f32_s32(vshlq_n_s32(
+       vaddq_s32(n, vdupq_n_s32(127)), 23)));
+}
+
+static uint32x4_t
+png_gamma_16_f32(uint32x4_t q, float32x4_t scale, float32x4_t exponent)
+{
+   float32x4_t x = vmulq_f32(vcvtq_f32_u32(q), scale);
+   float32x4_t r = png_exp2_f32(vmulq_f32(exponent, png_log2_f32(x)));
+   uint32x4_t out = vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(r, 65535.f),
+       vdupq_n_f32(.5f)));
+
+   return vbicq_u32(out, vceqq_u32(q, vdupq_n_u32(0)));
+}
+
+static uint8x16_t
+png_gamma_16_neon(uint8x16_t v, int16x8_t shift, float32x4_t scale,
+    float32x4_t exponent)
+{
+   uint16x8_t q = vshlq_u16(vreinterpretq_u16_u8(vrev16q_u8(v)), shift);
+   uint32x4_t lo = png_gamma_16_f32(vmovl_u16(vget_low_u16(q)), scale,
+       exponent);
+   uint32x4_t hi = png_gamma_16_f32(vmovl_u16(vget_high_u16(q)), scale,
+       exponent);
+
+   return vrev16q_u8(vreinterpretq_u8_u16(vcombine_u16(vqmovn_u32(lo),
+       vqmovn_u32(hi))));
+}
+
+static void
+png_do_gamma_16_neon(png_structrp png_ptr, png_bytep row, size_t rowbytes,
+    unsigned int pixel_bytes, unsigned int color_bytes)
+{
+   unsigned int gamma_shift = (unsigned int)png_ptr->gamma_shift;
+   uint8x16_t alpha = png_gamma_alpha_mask(pixel_bytes, color_bytes);
+   int16x8_t shift = vdupq_n_s16((int16_t)-(int)gamma_shift);
+   float32x4_t scale = vdupq_n_f32(1.f /
+       (float)((1U << (16U - gamma_shift)) - 1U));
+   float32x4_t exponent = vdupq_n_f32(
+       (float)png_ptr->gamma_16_exponent * 1E-5f);
+   size_t n;
+
+   for (n = 0; n < rowbytes; n += 16)
+   {
+      if (n + 16 <= rowbytes)
+      {
+         uint8x16_t v = vld1q_u8(row + n);
+
+         vst1q_u8(row + n, vbslq_u8(alpha, v,
+             png_gamma_16_neon(v, shift, scale, exponent)));
+      }
+
+      else
+      {
+         png_byte buffer[16];
+         uint8x16_t v;
+
+         memset(buffer, 0, sizeof buffer);
+         memcpy(buffer, row + n, rowbytes - n);
+         v = vld1q_u8(buffer);
+         vst1q_u8(buffer, vbslq_u8(alpha, v,
+             png_gamma_16_neon(v, shift, scale, exponent)));
+         memcpy(row + n, buffer, rowbytes - n);
+      }
+   }
+}
+#endif /* READ_16BIT */
+
+int
+png_do_gamma_neon(png_structrp png_ptr, png_row_infop row_info, png_bytep row)
+{
+   unsigned int pixel_bytes, color_bytes;
+
+   color_bytes = png_gamma_layout(row_info, &pixel_bytes);
+   if (color_bytes == 0)
+      return 0;
+
+   if (row_info->bit_depth == 8 && png_ptr->gamma_table != NULL)
+   {
+      png_do_gamma_8_neon(png_ptr->gamma_table, row, row_info->rowbytes,
+          pixel_bytes, color_bytes);
+      return 1;
+   }
+
+#ifdef PNG_READ_16BIT_SUPPORTED
+   if (row_info->bit_depth == 16 && png_ptr->gamma_16_exponent != 0)
+   {
+      png_do_gamma_16_neon(png_ptr, row, row_info->rowbytes, pixel_bytes,
+          color_bytes);
+      return 1;
+   }
+#endif
+
+   return 0;
+}
+
+#if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+   defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+/* Alpha compositing of 8-bit gray-alpha and RGBA rows, as png_do_compose does
+ * it; see png_do_compose_avx2 for the method.
+ */
+static int
+png_compose_color(png_bytep bytes, png_const_color_16p color,
+    unsigned int pixel_bytes)
+{
+   unsigned int i;
+
+   for (i = 0; i < 16; ++i)
+   {
+      unsigned int channel = i % pixel_bytes;
+      png_uint_16 value;
+
+      if (pixel_bytes == 2)
+         value = channel == 0 ? color->gray : 0;
+
+      else
+         value = channel == 0 ? color->red : channel == 1 ? color->green :
+             channel == 2 ? color->blue : 0;
+
+      if (value > 255)
+         return 0;
+
+      bytes[i] = (png_byte)value;
+   }
+
+   return 1;
+}
+
+/* png_composite, in the form used with PNG_READ_COMPOSITE_NODIV_SUPPORTED; the
+ * alpha of each pixel is in all its bytes of 'a'.  VADDHN gives the top byte of
+ * temp + (temp >> 8).
+ */
+static uint8x16_t
+png_composite_neon(uint8x16_t fg, uint8x16_t a, uint8x16_t bg)
+{
+   uint8x16_t inverse = vmvnq_u8(a);
+   uint16x8_t round = vdupq_n_u16(128);
+   uint16x8_t lo = vaddq_u16(vmlal_u8(vmull_u8(vget_low_u8(fg),
+       vget_low_u8(a)), vget_low_u8(bg), vget_low_u8(inverse)), round);
+   uint16x8_t hi = vaddq_u16(vmlal_u8(vmull_u8(vget_high_u8(fg),
+       vget_high_u8(a)), vget_high_u8(bg), vget_high_u8(inverse)), round);
+
+   return vcombine_u8(vaddhn_u16(lo, vshrq_n_u16(lo, 8)),
+       vaddhn_u16(hi, vshrq_n_u16(hi, 8)));
+}
+
+int
+png_do_compose_neon(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   static const png_byte spread_4[16] =
+      { 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15 };
+   static const png_byte spread_2[16] =
+      { 1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15 };
+   unsigned int pixel_bytes;
+   size_t rowbytes = row_info->rowbytes;
+   size_t n;
+   int gamma, optimize = (png_ptr->flags & PNG_FLAG_OPTIMIZE_ALPHA) != 0;
+   png_byte color[16], color_1[16];
+   uint8x16x4_t gamma_table[4], to_1[4], from_1[4];
+   uint8x16_t alpha, spread, bg, bg_1;
+
+   if (row_info->bit_depth != 8)
+      return 0;
+
+   if (row_info->color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+      pixel_bytes = 2;
+
+   else if (row_info->color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+      pixel_bytes = 4;
+
+   else
+      return 0;
+
+   if (png_compose_color(color, &png_ptr->background, pixel_bytes) == 0)
+      return 0;
+
+   bg = vld1q_u8(color);
+   bg_1 = bg;
+
+   gamma = png_ptr->gamma_to_1 != NULL && png_ptr->gamma_from_1 != NULL &&
+       png_ptr->gamma_table != NULL;
+
+   if (gamma != 0)
+   {
+      if (png_compose_color(color_1, &png_ptr->background_1, pixel_bytes) ==
+          0)
+         return 0;
+
+      bg_1 = vld1q_u8(color_1);
+      png_lookup_init_neon(gamma_table, png_ptr->gamma_table);
+      png_lookup_init_neon(to_1, png_ptr->gamma_to_1);
+
+      if (optimize == 0)
+         png_lookup_init_neon(from_1, png_ptr->gamma_from_1);
+   }
+
+   alpha = png_gamma_alpha_mask(pixel_bytes, pixel_bytes - 1);
+   spread = vld1q_u8(pixel_bytes == 4 ? spread_4 : spread_2);
+
+   for (n = 0; n < rowbytes; n += 16)
+   {
+      png_byte buffer[16];
+      png_bytep p = row + n;
+      uint8x16_t x, a, c;
+
+      if (n + 16 > rowbytes)
+      {
+         memset(buffer, 0, sizeof buffer);
+         memcpy(buffer, p, rowbytes - n);
+         p = buffer;
+      }
+
+      x = vld1q_u8(p);
+      a = vqtbl1q_u8(x, spread);
+
+      if (gamma == 0)
+         c = png_composite_neon(x, a, bg);
+
+      else
+      {
+         c = png_lookup_neon(gamma_table, x);
+
+         if (vminvq_u8(a) != 255)
+         {
+            uint8x16_t w = png_composite_neon(png_lookup_neon(to_1, x), a,
+                bg_1);
+
+            if (optimize == 0)
+               w = png_lookup_neon(from_1, w);
+
+            c = vbslq_u8(vceqq_u8(a, vdupq_n_u8(255)), c, w);
+            c = vbslq_u8(vceqq_u8(a, vdupq_n_u8(0)), bg, c);
+         }
+      }
+
+      vst1q_u8(p, vbslq_u8(alpha, x, c));
+
+      if (p == buffer)
+         memcpy(row + n, buffer, rowbytes - n);
+   }
+
+   return 1;
+}
+#endif /* READ_BACKGROUND || READ_ALPHA_MODE */
+
+#ifdef PNG_READ_RGB_TO_GRAY_SUPPORTED
+/* Conversion to gray, as png_do_rgb_to_gray does it.  VLD3 and VLD4 separate
+ * the channels of 16 8-bit or 8 16-bit pixels and the weighted sums are made
+ * with 16 by 16 bit multiplies into 32 bits; VRSHRN adds the 16384 that
+ * rounds the 16-bit and gamma corrected values.
+ */
+static uint16x8_t
+png_gray_sum_neon(uint16x8_t r, uint16x8_t g, uint16x8_t b, png_uint_16 rc,
+    png_uint_16 gc, png_uint_16 bc, int round)
+{
+   uint32x4_t lo = vmlal_n_u16(vmlal_n_u16(vmull_n_u16(vget_low_u16(r), rc),
+       vget_low_u16(g), gc), vget_low_u16(b), bc);
+   uint32x4_t hi = vmlal_n_u16(vmlal_n_u16(vmull_n_u16(vget_high_u16(r), rc),
+       vget_high_u16(g), gc), vget_high_u16(b), bc);
+
+   if (round != 0)
+      return vcombine_u16(vrshrn_n_u32(lo, 15), vrshrn_n_u32(hi, 15));
+
+   return vcombine_u16(vshrn_n_u32(lo, 15), vshrn_n_u32(hi, 15));
+}
+
+static uint8x16_t
+png_gray_sum_8_neon(uint8x16_t r, uint8x16_t g, uint8x16_t b, png_uint_16 rc,
+    png_uint_16 gc, png_uint_16 bc, int round)
+{
+   return vcombine_u8(vmovn_u16(png_gray_sum_neon(vmovl_u8(vget_low_u8(r)),
+       vmovl_u8(vget_low_u8(g)), vmovl_u8(vget_low_u8(b)), rc, gc, bc,
+       round)), vmovn_u16(png_gray_sum_neon(vmovl_u8(vget_high_u8(r)),
+       vmovl_u8(vget_high_u8(g)), vmovl_u8(vget_high_u8(b)), rc, gc, bc,
+       round)));
+}
+
+/* 16-bit samples are loaded as little-endian, so their bytes are swapped. */
+static uint16x8_t
+png_swap_16_neon(uint16x8_t x)
+{
+   return vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(x)));
+}
+
+int
+png_do_rgb_to_gray_neon(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row, int *rgb_error)
+{
+   png_uint_32 rc = png_ptr->rgb_to_gray_red_coeff;
+   png_uint_32 gc = png_ptr->rgb_to_gray_green_coeff;
+   png_uint_32 bc = 32768 - rc - gc;
+   png_uint_32 row_width = row_info->width;
+   png_uint_32 i = 0;
+   unsigned int bit_depth = row_info->bit_depth;
+   int have_alpha, gamma;
+   png_bytep sp = row, dp = row;
+   uint8x16x4_t to_1[4], from_1[4], gamma_table[4];
+   uint8x16_t all_gray = vdupq_n_u8(0xff);
+
+   if ((row_info->color_type != PNG_COLOR_TYPE_RGB &&
+       row_info->color_type != PNG_COLOR_TYPE_RGB_ALPHA) ||
+       (bit_depth != 8 && bit_depth != 16) || rc + gc > 32768)
+      return 0;
+
+   /* The 16-bit tables are left to png_do_rgb_to_gray. */
+   gamma = png_ptr->gamma_to_1 != NULL && png_ptr->gamma_from_1 != NULL;
+   if (bit_depth == 16 && png_ptr->gamma_16_to_1 != NULL &&
+       png_ptr->gamma_16_from_1 != NULL)
+      return 0;
+
+   have_alpha = (row_info->color_type & PNG_COLOR_MASK_ALPHA) != 0;
+
+   if (bit_depth == 8)
+   {
+      if (gamma != 0)
+      {
+         png_lookup_init_neon(to_1, png_ptr->gamma_to_1);
+         png_lookup_init_neon(from_1, png_ptr->gamma_from_1);
+
+         if (png_ptr->gamma_table != NULL)
+            png_lookup_init_neon(gamma_table, png_ptr->gamma_table);
+      }
+
+      for (; i + 16 <= row_width; i += 16)
+      {
+         uint8x16x4_t x;
+         uint8x16_t gray, y;
+
+         if (have_alpha != 0)
+         {
+            x = vld4q_u8(sp);
+            sp += 64;
+         }
+
+         else
+         {
+            uint8x16x3_t rgb = vld3q_u8(sp);
+
+            x.val[0] = rgb.val[0];
+            x.val[1] = rgb.val[1];
+            x.val[2] = rgb.val[2];
+            x.val[3] = rgb.val[2];
+            sp += 48;
+         }
+
+         gray = vandq_u8(vceqq_u8(x.val[0], x.val[1]),
+             vceqq_u8(x.val[0], x.val[2]));
+         all_gray = vandq_u8(all_gray, gray);
+
+         if (gamma != 0)
+         {
+            y = png_lookup_neon(from_1, png_gray_sum_8_neon(
+                png_lookup_neon(to_1, x.val[0]),
+                png_lookup_neon(to_1, x.val[1]),
+                png_lookup_neon(to_1, x.val[2]), (png_uint_16)rc,
+                (png_uint_16)gc, (png_uint_16)bc, 1));
+
+            y = vbslq_u8(gray, png_ptr->gamma_table != NULL ?
+                png_lookup_neon(gamma_table, x.val[0]) : x.val[0], y);
+         }
+
+         else
+            y = png_gray_sum_8_neon(x.val[0], x.val[1], x.val[2],
+                (png_uint_16)rc, (png_uint_16)gc, (png_uint_16)bc, 0);
+
+         if (have_alpha != 0)
+         {
+            uint8x16x2_t ga;
+
+            ga.val[0] = y;
+            ga.val[1] = x.val[3];
+            vst2q_u8(dp, ga);
+            dp += 32;
+         }
+
+         else
+         {
+            vst1q_u8(dp, y);
+            dp += 16;
+         }
+      }
+   }
+
+   else
+   {
+      for (; i + 8 <= row_width; i += 8)
+      {
+         uint16x8x4_t x;
+         uint16x8_t r, g, b, y;
+
+         if (have_alpha != 0)
+         {
+            x = vld4q_u16((const png_uint_16*)sp);
+            sp += 64;
+         }
+
+         else
+         {
+            uint16x8x3_t rgb = vld3q_u16((const png_uint_16*)sp);
+
+            x.val[0] = rgb.val[0];
+            x.val[1] = rgb.val[1];
+            x.val[2] = rgb.val[2];
+            x.val[3] = rgb.val[2];
+            sp += 48;
+         }
+
+         r = png_swap_16_neon(x.val[0]);
+         g = png_swap_16_neon(x.val[1]);
+         b = png_swap_16_neon(x.val[2]);
+         all_gray = vandq_u8(all_gray, vreinterpretq_u8_u16(vandq_u16(
+             vceqq_u16(r, g), vceqq_u16(r, b))));
+         y = png_swap_16_neon(png_gray_sum_neon(r, g, b, (png_uint_16)rc,
+             (png_uint_16)gc, (png_uint_16)bc, 1));
+
+         if (have_alpha != 0)
+         {
+            uint16x8x2_t ga;
+
+            ga.val[0] = y;
+            ga.val[1] = x.val[3];
+            vst2q_u16((png_uint_16*)dp, ga);
+            dp += 32;
+         }
+
+         else
+         {
+            vst1q_u16((png_uint_16*)dp, y);
+            dp += 16;
+         }
+      }
+   }
+
+   *rgb_error = vminvq_u8(all_gray) == 0;
+
+   for (; i < row_width; ++i)
+   {
+      png_uint_32 r, g, b, y;
+
+      if (bit_depth == 8)
+      {
+         r = sp[0];
+         g = sp[1];
+         b = sp[2];
+      }
+
+      else
+      {
+         r = png_get_uint_16(sp);
+         g = png_get_uint_16(sp + 2);
+         b = png_get_uint_16(sp + 4);
+      }
+
+      if (r != g || r != b)
+      {
+         *rgb_error = 1;
+
+         if (bit_depth == 8 && gamma != 0)
+            y = png_ptr->gamma_from_1[(rc*png_ptr->gamma_to_1[r] +
+                gc*png_ptr->gamma_to_1[g] + bc*png_ptr->gamma_to_1[b] +
+                16384) >> 15];
+
+         else if (bit_depth == 8)
+            y = (rc*r + gc*g + bc*b) >> 15;
+
+         else
+            y = (rc*r + gc*g + bc*b + 16384) >> 15;
+      }
+
+      else if (bit_depth == 8 && gamma != 0 && png_ptr->gamma_table != NULL)
+         y = png_ptr->gamma_table[r];
+
+      else
+         y = r;
+
+      if (bit_depth == 8)
+         *(dp++) = (png_byte)y;
+
+      else
+      {
+         *(dp++) = (png_byte)(y >> 8);
+         *(dp++) = (png_byte)y;
+      }
+
+      sp += 3 * (bit_depth >> 3);
+
+      if (have_alpha != 0)
+      {
+         *(dp++) = *(sp++);
+
+         if (bit_depth == 16)
+            *(dp++) = *(sp++);
+      }
+   }
+
+   row_info->channels = (png_byte)(row_info->channels - 2);
+   row_info->color_type = (png_byte)(row_info->color_type &
+       ~PNG_COLOR_MASK_COLOR);
+   row_info->pixel_depth = (png_byte)(row_info->channels *
+       row_info->bit_depth);
+   row_info->rowbytes = PNG_ROWBYTES(row_info->pixel_depth, row_width);
+
+   return 1;
+}
+#endif /* READ_RGB_TO_GRAY */
+
+#endif /* PNG_ARM_NEON_GAMMA */
+#endif /* READ_GAMMA */
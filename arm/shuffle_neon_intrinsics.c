@@ -0,0 +1,174 @@
+/* shuffle_neon_intrinsics.c - NEON byte shuffles for the transformations that
+ *                             only move bytes
+ *
+ * Copyright (c) 2026 agent
+ * Derived from intel/shuffle_ssse3_intrinsics.c
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_SUPPORTED)
+
+#if PNG_ARM_NEON_IMPLEMENTATION == 1
+
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_ARM64)
+#  include <arm64_neon.h>
+#else
+#  include <arm_neon.h>
+#endif
+
+/* TBL on 16 bytes; indices of 16 or more, such as the 0x80 png_init_fused
+ * uses for zero, select zero as they do for PSHUFB.  32-bit ARM only has the
+ * 8 byte form.
+ */
+static uint8x16_t
+png_shuffle_neon(uint8x16_t v, uint8x16_t index)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+   return vqtbl1q_u8(v, index);
+#else
+   uint8x8x2_t table;
+
+   table.val[0] = vget_low_u8(v);
+   table.val[1] = vget_high_u8(v);
+   return vcombine_u8(vtbl2_u8(table, vget_low_u8(index)),
+       vtbl2_u8(table, vget_high_u8(index)));
+#endif
+}
+
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+    defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+/* This is png_do_fused_ssse3; see there for how the row is done in place. */
+void
+png_do_fused_neon(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   unsigned int in = png_ptr->fused_in_bytes;
+   unsigned int out = png_ptr->fused_out_bytes;
+   size_t in_step = png_ptr->fused_block * in;
+   size_t out_step = png_ptr->fused_block * out;
+   size_t row_in = (size_t)width * in;
+   const uint8x16_t shuffle = vld1q_u8(png_ptr->fused_shuffle);
+   const uint8x16_t invert = vld1q_u8(png_ptr->fused_xor);
+   png_byte save[16];
+   png_uint_32 rest;
+   size_t blocks;
+   uint8x16_t v, next;
+
+   if (row_in < 16)
+   {
+      png_do_fused(png_ptr, row, width);
+      return;
+   }
+
+   blocks = (row_in - 16) / in_step + 1;
+   rest = width - (png_uint_32)(blocks * png_ptr->fused_block);
+
+   if (out > in)
+   {
+      png_const_bytep sp = row + row_in;
+      png_bytep dp = row + (size_t)width * out;
+
+      memcpy(save, row, rest * in);
+      v = vld1q_u8(sp - 16);
+
+      while (--blocks > 0)
+      {
+         sp -= in_step;
+         next = vld1q_u8(sp - 16);
+         vst1q_u8(dp - 16, veorq_u8(png_shuffle_neon(v, shuffle), invert));
+         dp -= out_step;
+         v = next;
+      }
+
+      vst1q_u8(dp - 16, veorq_u8(png_shuffle_neon(v, shuffle), invert));
+
+      memcpy(row, save, rest * in);
+      png_do_fused(png_ptr, row, rest);
+   }
+
+   else
+   {
+      png_const_bytep sp = row;
+      png_bytep dp = row;
+
+      memcpy(save, row + blocks * in_step, rest * in);
+      v = vld1q_u8(sp);
+
+      while (--blocks > 0)
+      {
+         sp += in_step;
+         next = vld1q_u8(sp);
+         vst1q_u8(dp, veorq_u8(png_shuffle_neon(v, shuffle), invert));
+         dp += out_step;
+         v = next;
+      }
+
+      vst1q_u8(dp, veorq_u8(png_shuffle_neon(v, shuffle), invert));
+      dp += out_step;
+
+      memcpy(dp, save, rest * in);
+      png_do_fused(png_ptr, dp, rest);
+   }
+}
+#endif /* READ_TRANSFORMS || WRITE_TRANSFORMS */
+
+#if defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+    defined(PNG_WRITE_PACKSWAP_SUPPORTED)
+/* The lookups for the high half of each byte, as in the SSSE3 code. */
+static const png_byte png_packswap_half[3][16] =
+{
+   { /* 1 bit */
+      0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+      0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+   },
+   { /* 2 bits */
+      0x0, 0x4, 0x8, 0xC, 0x1, 0x5, 0x9, 0xD,
+      0x2, 0x6, 0xA, 0xE, 0x3, 0x7, 0xB, 0xF
+   },
+   { /* 4 bits */
+      0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7,
+      0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF
+   }
+};
+
+int
+png_do_packswap_neon(png_row_infop row_info, png_bytep row)
+{
+   const uint8x16_t low_bits = vdupq_n_u8(0x0f);
+   png_const_bytep half;
+   png_bytep end = row + row_info->rowbytes;
+   uint8x16_t high, low;
+
+   switch (row_info->bit_depth)
+   {
+      case 1: half = png_packswap_half[0]; break;
+      case 2: half = png_packswap_half[1]; break;
+      case 4: half = png_packswap_half[2]; break;
+      default: return 0;
+   }
+
+   high = vld1q_u8(half);
+   low = vshlq_n_u8(high, 4);
+
+   for (; end - row >= 16; row += 16)
+   {
+      uint8x16_t v = vld1q_u8(row);
+
+      vst1q_u8(row, vorrq_u8(png_shuffle_neon(low, vandq_u8(v, low_bits)),
+          png_shuffle_neon(high, vshrq_n_u8(v, 4))));
+   }
+
+   for (; row < end; ++row)
+      *row = (png_byte)((half[*row & 0xf] << 4) | half[*row >> 4]);
+
+   return 1;
+}
+#endif /* READ_PACKSWAP || WRITE_PACKSWAP */
+
+#endif /* PNG_ARM_NEON_IMPLEMENTATION == 1 */
+#endif /* READ || WRITE */
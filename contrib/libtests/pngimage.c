@@ -10,7 +10,8 @@
  *
  * Test the png_read_png and png_write_png interfaces.  Given a PNG file load it
  * using png_read_png and then write with png_write_png.  Test all possible
- * transforms.
+ * transforms.  Also test stopping the read of the image data part way through
+ * with png_set_read_stop_row and png_set_read_last_pass.
  */
 #include <stdarg.h>
 #include <stdlib.h>
@@ -57,6 +58,45 @@
 #  endif /* INFO_IMAGE */
 #endif /* pre 1.7.0 */
 
+/* 1.6.38 added png_set_read_stop_row and png_set_read_last_pass; the read
+ * past the stopping point is caught with png_jmpbuf:
+ */
+#if PNG_LIBPNG_VER >= 10638 && defined(PNG_SEQUENTIAL_READ_SUPPORTED) &&\
+   defined(PNG_SETJMP_SUPPORTED)
+#  define STOP_READ_TESTS
+#endif
+
+/* 1.6.38 also added png_set_restart_points; the IDAT data is then checked by
+ * decompressing it with zlib from each restart point:
+ */
+/* ... and PNG_SKIP_CHECKSUMS, which is tested on a damaged copy of the file:
+ */
+#if PNG_LIBPNG_VER >= 10638 && defined(PNG_SET_OPTION_SUPPORTED) &&\
+   defined(PNG_SKIP_CHECKSUMS) && defined(PNG_SETJMP_SUPPORTED) &&\
+   defined(PNG_WRITE_PNG_SUPPORTED)
+#  define CHECKSUM_TESTS
+#endif
+
+#if PNG_LIBPNG_VER >= 10638 && defined(PNG_WRITE_RESTART_POINTS_SUPPORTED)
+#  define RESTART_POINTS_TESTS
+#endif
+
+/* ... and png_set_zlib_backend, which is tested with a backend that counts the
+ * calls and passes them on to zlib:
+ */
+#if PNG_LIBPNG_VER >= 10638 && defined(PNG_ZLIB_BACKEND_SUPPORTED) &&\
+   defined(PNG_READ_PNG_SUPPORTED) && defined(PNG_WRITE_PNG_SUPPORTED)
+#  define ZLIB_BACKEND_TESTS
+#endif
+
+#if defined(RESTART_POINTS_TESTS) || defined(ZLIB_BACKEND_TESTS)
+#  ifdef PNG_ZLIB_HEADER
+#     include PNG_ZLIB_HEADER
+#  else
+#     include <zlib.h>
+#  endif
+#endif
+
 #ifdef PNG_READ_PNG_SUPPORTED
 /* If a transform is valid on both read and write this implies that if the
  * transform is applied to read it must also be applied on write to produce
@@ -575,11 +615,15 @@ struct display
     */
    png_structp    read_pp;
    png_infop      read_ip;
+   png_bytep      read_row;          /* for reads of one row at a time */
+   int            skip_checksums;    /* read_png sets PNG_SKIP_CHECKSUMS */
+   int            zlib_backend;      /* use the counting zlib backend */
 
 #  ifdef PNG_WRITE_PNG_SUPPORTED
       /* Used to write a new image (the original info_ptr is used) */
       png_structp   write_pp;
       struct buffer written_file;   /* where the file gets written */
+      int           threads;        /* png_set_compression_threads value */
 #  endif
 
    struct buffer  original_file;     /* Data read from the original file */
@@ -601,11 +645,15 @@ display_init(struct display *dp)
    dp->original_rows = NULL;
    dp->read_pp = NULL;
    dp->read_ip = NULL;
+   dp->read_row = NULL;
+   dp->skip_checksums = 0;
+   dp->zlib_backend = 0;
    buffer_init(&dp->original_file);
 
 #  ifdef PNG_WRITE_PNG_SUPPORTED
       dp->write_pp = NULL;
       buffer_init(&dp->written_file);
+      dp->threads = 0;
 #  endif
 }
 
@@ -614,6 +662,12 @@ display_clean_read(struct display *dp)
 {
    if (dp->read_pp != NULL)
       png_destroy_read_struct(&dp->read_pp, &dp->read_ip, NULL);
+
+   if (dp->read_row != NULL)
+   {
+      free(dp->read_row);
+      dp->read_row = NULL;
+   }
 }
 
 #ifdef PNG_WRITE_PNG_SUPPORTED
@@ -636,6 +690,7 @@ display_clean(struct display *dp)
    dp->original_rowbytes = 0;
    dp->original_rows = NULL;
    dp->chunks = 0;
+   dp->skip_checksums = 0;
 
    png_destroy_read_struct(&dp->original_pp, &dp->original_ip, NULL);
    /* leave the filename for error detection */
@@ -860,6 +915,67 @@ read_function(png_structp pp, png_bytep data, size_t size)
    buffer_read(get_dp(pp), get_buffer(pp), data, size);
 }
 
+#ifdef ZLIB_BACKEND_TESTS
+/* A zlib backend that counts the calls to deflate, inflate and the whole-buffer
+ * functions.  The counts are not thread safe, so it must not be used with
+ * png_set_compression_threads.
+ */
+static unsigned int deflate_calls, inflate_calls;
+static unsigned int deflate_buffer_calls, inflate_buffer_calls;
+static png_zlib_backend count_backend;
+
+static int PNGCBAPI
+count_deflate(png_voidp zstream, int flush)
+{
+   ++deflate_calls;
+   return deflate((z_streamp)zstream, flush);
+}
+
+static int PNGCBAPI
+count_inflate(png_voidp zstream, int flush)
+{
+   ++inflate_calls;
+   return inflate((z_streamp)zstream, flush);
+}
+
+static int PNGCBAPI
+count_deflate_buffer(png_bytep dst, size_t *dst_len, png_const_bytep src,
+   size_t src_len, int level)
+{
+   uLongf len = (uLongf)*dst_len;
+   int ret = compress2(dst, &len, src, (uLong)src_len, level);
+
+   ++deflate_buffer_calls;
+   *dst_len = len;
+   return ret;
+}
+
+static int PNGCBAPI
+count_inflate_buffer(png_bytep dst, size_t *dst_len, png_const_bytep src,
+   size_t src_len)
+{
+   uLongf len = (uLongf)*dst_len;
+   int ret = uncompress(dst, &len, src, (uLong)src_len);
+
+   ++inflate_buffer_calls;
+   *dst_len = len;
+   return ret;
+}
+
+static void
+count_reset(void)
+{
+   memset(&count_backend, 0, sizeof count_backend);
+   count_backend.deflate_data = count_deflate;
+   count_backend.inflate_data = count_inflate;
+   count_backend.deflate_buffer = count_deflate_buffer;
+   count_backend.inflate_buffer = count_inflate_buffer;
+
+   deflate_calls = inflate_calls = 0;
+   deflate_buffer_calls = inflate_buffer_calls = 0;
+}
+#endif /* ZLIB_BACKEND_TESTS */
+
 static void
 read_png(struct display *dp, struct buffer *bp, const char *operation,
    int transforms)
@@ -895,6 +1011,16 @@ read_png(struct display *dp, struct buffer *bp, const char *operation,
       png_set_user_limits(pp, 0x7fffffff, 0x7fffffff);
 #  endif
 
+#  ifdef CHECKSUM_TESTS
+      if (dp->skip_checksums)
+         png_set_option(pp, PNG_SKIP_CHECKSUMS, PNG_OPTION_ON);
+#  endif
+
+#  ifdef ZLIB_BACKEND_TESTS
+      if (dp->zlib_backend)
+         png_set_zlib_backend(pp, &count_backend);
+#  endif
+
    /* Set the IO handling */
    buffer_start_read(bp);
    png_set_read_fn(pp, bp, read_function);
@@ -1316,8 +1442,163 @@ write_function(png_structp pp, png_bytep data, size_t size)
    buffer_write(get_dp(pp), get_buffer(pp), data, size);
 }
 
+#ifdef RESTART_POINTS_TESTS
+static png_bytep
+written_idat(struct display *dp, size_t *length)
+   /* Return the concatenated IDAT chunk data of the written file, that is the
+    * zlib stream, in memory allocated with malloc.
+    */
+{
+   struct buffer *bp = &dp->written_file;
+   png_bytep idat = NULL;
+   size_t idat_len = 0;
+   png_byte header[8];
+
+   buffer_start_read(bp);
+   buffer_read(dp, bp, header, 8); /* signature */
+
+   do
+   {
+      png_uint_32 chunk_len;
+
+      buffer_read(dp, bp, header, 8);
+      chunk_len = png_get_uint_32(header);
+
+      if (memcmp(header+4, "IDAT", 4) == 0)
+      {
+         png_bytep more = (png_bytep)realloc(idat, idat_len + chunk_len);
+
+         if (more == NULL)
+         {
+            free(idat);
+            display_log(dp, APP_ERROR, "out of memory for IDAT");
+         }
+
+         idat = more;
+         buffer_read(dp, bp, idat + idat_len, chunk_len);
+         idat_len += chunk_len;
+      }
+
+      else while (chunk_len > 0)
+      {
+         png_byte skip[64];
+         size_t avail = chunk_len < sizeof skip ? chunk_len : sizeof skip;
+
+         buffer_read(dp, bp, skip, avail);
+         chunk_len -= (png_uint_32)avail;
+      }
+
+      buffer_read(dp, bp, header, 4); /* CRC */
+   }
+   while (memcmp(header+4, "IEND", 4) != 0);
+
+   *length = idat_len;
+   return idat;
+}
+
+static const char *
+restart_row(struct display *dp, png_const_bytep idat, size_t idat_len,
+   png_uint_32 y, png_uint_32 offset, png_bytep row)
+   /* Decompress the row 'y' that starts at 'offset' in the zlib stream into
+    * row[] with a new raw inflate stream, so without any of the preceding data,
+    * and check it against the original.  Returns NULL or an error message.
+    */
+{
+   size_t rowbytes = dp->original_rowbytes;
+   z_stream zs;
+   int ret;
+
+   if (y >= dp->height || offset >= idat_len)
+      return "outside the image";
+
+   memset(&zs, 0, sizeof zs);
+   if (inflateInit2(&zs, -15) != Z_OK)
+      return "inflateInit2 failed";
+
+   zs.next_in = (Bytef*)(idat + offset); /* zlib is not const correct */
+   zs.avail_in = (uInt)(idat_len - offset);
+   zs.next_out = row;
+   zs.avail_out = (uInt)(rowbytes + 1);
+   ret = inflate(&zs, Z_SYNC_FLUSH);
+   inflateEnd(&zs);
+
+   if (zs.avail_out != 0 || (ret != Z_OK && ret != Z_STREAM_END))
+      return "inflate failed";
+
+   if (row[0] == PNG_FILTER_VALUE_SUB)
+   {
+      size_t bpp = (dp->bit_depth *
+         png_get_channels(dp->original_pp, dp->original_ip) + 7) >> 3;
+      size_t i;
+
+      for (i=bpp+1; i<=rowbytes; ++i)
+         row[i] = (png_byte)(row[i] + row[i-bpp]);
+   }
+
+   else if (row[0] != PNG_FILTER_VALUE_NONE)
+      return "filter uses the previous row";
+
+   if (memcmp(row+1, dp->original_rows[y], rowbytes) != 0)
+      return "row changed";
+
+   return NULL;
+}
+
+static void
+check_restart_points(struct display *dp, png_uint_32 nrows)
+   /* Called with the png_struct of a write with a restart point every nrows
+    * rows (so only the original rows may have been written.)
+    */
+{
+   png_const_uint_32p points;
+   png_uint_32 npoints = png_get_restart_points(dp->write_pp, &points);
+   png_uint_32 expected = 0;
+
+   if (dp->interlace_method == PNG_INTERLACE_NONE)
+      expected = (dp->height-1) / nrows;
+
+   if (npoints != expected)
+      display_log(dp, LIBPNG_BUG, "%lu restart points, expected %lu",
+         (unsigned long)npoints, (unsigned long)expected);
+
+   if (npoints > 0)
+   {
+      size_t idat_len;
+      png_bytep idat = written_idat(dp, &idat_len);
+      png_bytep row = (png_bytep)malloc(dp->original_rowbytes + 1);
+      const char *error = NULL;
+      png_uint_32 i;
+
+      for (i=0; row != NULL && error == NULL && i<npoints; ++i)
+      {
+         if (points[2*i] != (i+1) * nrows)
+            error = "wrong row";
+
+         else
+            error = restart_row(dp, idat, idat_len, points[2*i],
+               points[2*i+1], row);
+      }
+
+      free(row);
+      free(idat);
+
+      if (error != NULL)
+         display_log(dp, LIBPNG_BUG, "restart point %lu (row %lu): %s",
+            (unsigned long)(i-1), (unsigned long)points[2*i-2], error);
+
+      else if (i < npoints)
+         display_log(dp, APP_ERROR, "out of memory for a row");
+   }
+}
+#endif /* RESTART_POINTS_TESTS */
+
 static void
-write_png(struct display *dp, png_infop ip, int transforms)
+write_png(struct display *dp, png_infop ip, int transforms, size_t idat_size,
+   png_uint_32 restart_rows)
+   /* idat_size, if not 0, sets the compression buffer size and so the size of
+    * each IDAT chunk.  restart_rows, if not 0, makes every restart_rows'th row
+    * a restart point.
+    */
 {
    display_clean_write(dp); /* safety */
 
@@ -1339,6 +1620,27 @@ write_png(struct display *dp, png_infop ip, int transforms)
       png_set_user_limits(dp->write_pp, 0x7fffffff, 0x7fffffff);
 #  endif
 
+   if (idat_size > 0)
+      png_set_compression_buffer_size(dp->write_pp, idat_size);
+
+#  ifdef PNG_WRITE_PARALLEL_SUPPORTED
+      if (dp->threads > 1)
+         png_set_compression_threads(dp->write_pp, dp->threads);
+#  endif
+
+#  ifdef ZLIB_BACKEND_TESTS
+      if (dp->zlib_backend)
+         png_set_zlib_backend(dp->write_pp, &count_backend);
+#  endif
+
+#  ifdef RESTART_POINTS_TESTS
+      if (restart_rows > 0)
+         png_set_restart_points(dp->write_pp, restart_rows);
+#  else
+      if (restart_rows > 0)
+         display_log(dp, INTERNAL_ERROR, "restart points not supported");
+#  endif
+
    /* Certain transforms require the png_info to be zapped to allow the
     * transform to work correctly.
     */
@@ -1358,6 +1660,11 @@ write_png(struct display *dp, png_infop ip, int transforms)
 
    png_write_png(dp->write_pp, ip, transforms, NULL/*params*/);
 
+#  ifdef RESTART_POINTS_TESTS
+      if (restart_rows > 0)
+         check_restart_points(dp, restart_rows);
+#  endif
+
    /* Clean it on the way out - if control returns to the caller then the
     * written_file contains the required data.
     */
@@ -1365,6 +1672,570 @@ write_png(struct display *dp, png_infop ip, int transforms)
 }
 #endif /* WRITE_PNG */
 
+#ifdef STOP_READ_TESTS
+static void PNGCBAPI
+past_end_error(png_structp pp, png_const_charp error)
+{
+   if (strcmp(error, "Read past the last requested row") == 0)
+      png_longjmp(pp, 1);
+
+   display_error(pp, error);
+}
+
+static int
+read_past_end(struct display *dp)
+   /* Read one more row of an image that has been stopped; returns 1 if libpng
+    * reports the expected error.
+    */
+{
+   png_structp pp = dp->read_pp;
+
+   png_set_error_fn(pp, dp, past_end_error, display_warning);
+
+   if (setjmp(png_jmpbuf(pp)) != 0)
+   {
+      png_set_error_fn(pp, dp, display_error, display_warning);
+      return 1;
+   }
+
+   png_read_row(pp, dp->read_row, NULL);
+   png_set_error_fn(pp, dp, display_error, display_warning);
+   return 0;
+}
+
+static void
+start_row_read(struct display *dp, struct buffer *bp, const char *operation,
+   png_uint_32 nrows)
+   /* Create a png_struct for a read of 'bp' a row at a time into a buffer of
+    * nrows rows and read the info up to the IDAT.
+    */
+{
+   png_structp pp;
+
+   display_clean_read(dp);
+   dp->operation = operation;
+   dp->transforms = 0;
+
+   dp->read_pp = pp = png_create_read_struct(PNG_LIBPNG_VER_STRING, dp,
+      display_error, display_warning);
+   if (pp == NULL)
+      display_log(dp, LIBPNG_ERROR, "failed to create read struct");
+
+   dp->read_ip = png_create_info_struct(pp);
+   if (dp->read_ip == NULL)
+      display_log(dp, LIBPNG_ERROR, "failed to create info struct");
+
+   dp->read_row = (png_bytep)malloc(nrows * dp->original_rowbytes);
+   if (dp->read_row == NULL)
+      display_log(dp, APP_ERROR, "out of memory for %lu rows",
+         (unsigned long)nrows);
+
+#  ifdef PNG_SET_USER_LIMITS_SUPPORTED
+      png_set_user_limits(pp, 0x7fffffff, 0x7fffffff);
+#  endif
+
+   buffer_start_read(bp);
+   png_set_read_fn(pp, bp, read_function);
+   png_read_info(pp, dp->read_ip);
+}
+
+static void
+end_row_read(struct display *dp)
+   /* Check that the IDAT data has been abandoned, then read the chunks after
+    * it, which should all be there.
+    */
+{
+   png_uint_32 chunks;
+
+   if (!read_past_end(dp))
+      display_log(dp, LIBPNG_BUG, "read past the stopping point not detected");
+
+   png_read_end(dp->read_pp, dp->read_ip);
+
+   chunks = png_get_valid(dp->read_pp, dp->read_ip, 0xffffffff);
+   if (chunks != (dp->chunks & ~PNG_INFO_IDAT))
+      display_log(dp, APP_FAIL, "PNG chunks changed from 0x%lx to 0x%lx",
+         (unsigned long)(dp->chunks & ~PNG_INFO_IDAT), (unsigned long)chunks);
+}
+
+static void
+test_stop_row(struct display *dp, struct buffer *bp, png_uint_32 nrows,
+   int late)
+   /* Read the first nrows rows of a non-interlaced image with
+    * png_set_read_stop_row, called before the first row or, if 'late', after
+    * the last one.
+    */
+{
+   png_uint_32 y;
+
+   start_row_read(dp, bp, late ? "stop row (late)" : "stop row", 1);
+
+   if (!late)
+      png_set_read_stop_row(dp->read_pp, nrows);
+
+   for (y=0; y<nrows; ++y)
+   {
+      png_read_row(dp->read_pp, dp->read_row, NULL);
+
+      if (memcmp(dp->read_row, dp->original_rows[y], dp->original_rowbytes))
+      {
+         display_log(dp, APP_FAIL, "row %lu changed (stopping after %lu)",
+            (unsigned long)y, (unsigned long)nrows);
+         return;
+      }
+   }
+
+   if (late)
+      png_set_read_stop_row(dp->read_pp, nrows);
+
+   end_row_read(dp);
+}
+
+static int
+same_pixel(struct display *dp, png_const_bytep row, png_uint_32 x,
+   png_uint_32 orig_x, png_uint_32 orig_y)
+   /* Compare pixel x of 'row' with pixel (orig_x,orig_y) of the original */
+{
+   png_const_bytep orig = dp->original_rows[orig_y];
+   unsigned int bits = dp->bit_depth *
+      png_get_channels(dp->original_pp, dp->original_ip);
+
+   if (bits < 8)
+   {
+      unsigned int mask = (1U << bits) - 1;
+      size_t s = (size_t)x * bits, o = (size_t)orig_x * bits;
+
+      return ((row[s >> 3] >> (8 - bits - (s & 7))) & mask) ==
+         ((orig[o >> 3] >> (8 - bits - (o & 7))) & mask);
+   }
+
+   bits >>= 3;
+   return memcmp(row + (size_t)x * bits, orig + (size_t)orig_x * bits,
+      bits) == 0;
+}
+
+static void
+test_last_pass(struct display *dp, struct buffer *bp, int last)
+   /* Read the passes of an interlaced image up to 'last' with
+    * png_set_read_last_pass, first as they are stored, then with libpng
+    * deinterlacing them.  The pixels read should be those of the original
+    * image at the positions of the passes.
+    */
+{
+   size_t rowbytes = dp->original_rowbytes;
+   png_uint_32 x, y;
+   int pass, passes;
+
+   start_row_read(dp, bp, "last pass", 1);
+   png_set_read_last_pass(dp->read_pp, last);
+
+   for (pass=0; pass<=last; ++pass)
+   {
+      png_uint_32 cols = PNG_PASS_COLS(dp->width, pass);
+      png_uint_32 rows = PNG_PASS_ROWS(dp->height, pass);
+
+      if (cols == 0) /* libpng skips the pass */
+         continue;
+
+      for (y=0; y<rows; ++y)
+      {
+         png_read_row(dp->read_pp, dp->read_row, NULL);
+
+         for (x=0; x<cols; ++x)
+            if (!same_pixel(dp, dp->read_row, x,
+               PNG_COL_FROM_PASS_COL(x, pass), PNG_ROW_FROM_PASS_ROW(y, pass)))
+         {
+            display_log(dp, APP_FAIL, "pass %d pixel (%lu,%lu) changed",
+               pass, (unsigned long)x, (unsigned long)y);
+            return;
+         }
+      }
+   }
+
+   end_row_read(dp);
+
+   start_row_read(dp, bp, "last pass (deinterlaced)", dp->height);
+   png_set_read_last_pass(dp->read_pp, last);
+
+   passes = png_set_interlace_handling(dp->read_pp);
+   if (passes != last+1)
+      display_log(dp, LIBPNG_BUG,
+         "png_set_interlace_handling returned %d passes for last pass %d",
+         passes, last);
+
+   for (pass=0; pass<passes; ++pass)
+      for (y=0; y<dp->height; ++y)
+         png_read_row(dp->read_pp, dp->read_row + y * rowbytes, NULL);
+
+   for (pass=0; pass<=last; ++pass)
+   {
+      png_uint_32 cols = PNG_PASS_COLS(dp->width, pass);
+      png_uint_32 rows = PNG_PASS_ROWS(dp->height, pass);
+
+      for (y=0; y<rows; ++y)
+      {
+         png_uint_32 image_y = PNG_ROW_FROM_PASS_ROW(y, pass);
+
+         for (x=0; x<cols; ++x)
+         {
+            png_uint_32 image_x = PNG_COL_FROM_PASS_COL(x, pass);
+
+            if (!same_pixel(dp, dp->read_row + image_y * rowbytes, image_x,
+               image_x, image_y))
+            {
+               display_log(dp, APP_FAIL,
+                  "deinterlaced pass %d pixel (%lu,%lu) changed", pass,
+                  (unsigned long)image_x, (unsigned long)image_y);
+               return;
+            }
+         }
+      }
+   }
+
+   end_row_read(dp);
+}
+#endif /* STOP_READ_TESTS */
+
+#if defined(CHECKSUM_TESTS) || defined(ZLIB_BACKEND_TESTS)
+static png_bytep
+buffer_contents(struct display *dp, struct buffer *bp, size_t *size)
+   /* Return a copy of the whole of 'bp' in memory allocated with malloc. */
+{
+   struct buffer_list *list = &bp->first;
+   png_bytep data = NULL;
+   size_t length = 0;
+
+   for (;;)
+   {
+      size_t avail = list == bp->last ? bp->end_count : sizeof list->buffer;
+      png_bytep more = (png_bytep)realloc(data, length + avail);
+
+      if (more == NULL)
+      {
+         free(data);
+         display_log(dp, APP_ERROR, "out of memory copying file");
+      }
+
+      data = more;
+      memcpy(data + length, list->buffer, avail);
+      length += avail;
+
+      if (list == bp->last)
+         break;
+
+      list = list->next;
+   }
+
+   *size = length;
+   return data;
+}
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+static png_bytep
+simplified_read(png_const_bytep file, size_t size, png_uint_32 flags,
+   int zlib_backend, size_t *image_size)
+   /* Read the PNG in memory as 16-bit linear RGBA, with the given extra
+    * png_image flags and, if zlib_backend is set, the counting zlib backend;
+    * returns NULL on error, else the image from malloc.
+    */
+{
+   png_image image;
+   png_bytep buffer = NULL;
+
+   memset(&image, 0, sizeof image);
+   image.version = PNG_IMAGE_VERSION;
+
+   if (png_image_begin_read_from_memory(&image, file, size))
+   {
+#     ifdef ZLIB_BACKEND_TESTS
+         if (zlib_backend &&
+             !png_image_set_zlib_backend(&image, &count_backend))
+            return NULL;
+#     else
+         (void)zlib_backend;
+#     endif
+
+      image.format = PNG_FORMAT_LINEAR_RGB_ALPHA;
+      image.flags |= flags;
+      *image_size = PNG_IMAGE_SIZE(image);
+      buffer = (png_bytep)malloc(*image_size);
+
+      if (buffer == NULL)
+         png_image_free(&image);
+
+      else if (!png_image_finish_read(&image, NULL/*background*/, buffer,
+         0/*row_stride*/, NULL/*colormap*/))
+      {
+         free(buffer);
+         buffer = NULL;
+      }
+   }
+
+   return buffer;
+}
+#endif /* SIMPLIFIED_READ */
+#endif /* CHECKSUM_TESTS || ZLIB_BACKEND_TESTS */
+
+#ifdef CHECKSUM_TESTS
+static int
+damage_checksum(png_bytep file, size_t size, int adler)
+   /* Flip a bit in the CRC of the first IDAT chunk or, if 'adler' is set, in
+    * the last byte of the zlib stream, which is part of its ADLER32.  Returns
+    * 0 if there is no IDAT.
+    */
+{
+   size_t pos = 8, end = 0;
+
+   while (pos + 12 <= size)
+   {
+      png_uint_32 length = png_get_uint_32(file + pos);
+
+      if (length > size - pos - 12)
+         break;
+
+      if (memcmp(file + pos + 4, "IDAT", 4) == 0 && length > 0)
+      {
+         end = pos + 8 + length;
+
+         if (!adler)
+            break;
+      }
+
+      pos += 12 + length;
+   }
+
+   if (end == 0)
+      return 0;
+
+   if (adler)
+      file[end-1] ^= 1;
+
+   else
+      file[end] ^= 1;
+
+   return 1;
+}
+
+static void PNGCBAPI
+expected_error(png_structp pp, png_const_charp error)
+{
+   (void)error;
+   png_longjmp(pp, 1);
+}
+
+static int
+read_fails(struct display *dp, struct buffer *bp)
+   /* Read 'bp' with the default settings; returns 1 if libpng reports an
+    * error.
+    */
+{
+   png_structp pp;
+
+   display_clean_read(dp);
+
+   dp->read_pp = pp = png_create_read_struct(PNG_LIBPNG_VER_STRING, dp,
+      expected_error, display_warning);
+   if (pp == NULL)
+      display_log(dp, LIBPNG_ERROR, "failed to create read struct");
+
+   dp->read_ip = png_create_info_struct(pp);
+   if (dp->read_ip == NULL)
+      display_log(dp, LIBPNG_ERROR, "failed to create info struct");
+
+   if (setjmp(png_jmpbuf(pp)) != 0)
+      return 1;
+
+#  ifdef PNG_SET_USER_LIMITS_SUPPORTED
+      png_set_user_limits(pp, 0x7fffffff, 0x7fffffff);
+#  endif
+
+   buffer_start_read(bp);
+   png_set_read_fn(pp, bp, read_function);
+   png_read_png(pp, dp->read_ip, 0/*transforms*/, NULL/*params*/);
+
+   return 0;
+}
+
+static void
+test_checksums(struct display *dp)
+   /* Damage a copy of the original file, first the CRC of an IDAT chunk then
+    * the ADLER32 of the image data.  libpng must report an error unless it is
+    * told not to check them, with PNG_SKIP_CHECKSUMS or, for the simplified
+    * API, PNG_IMAGE_FLAG_TRUSTED_INPUT, in which case the image must be
+    * unchanged.
+    */
+{
+   size_t size;
+   png_bytep original = buffer_contents(dp, &dp->original_file, &size);
+   png_bytep damaged = (png_bytep)malloc(size);
+   int adler;
+
+   if (damaged == NULL)
+   {
+      free(original);
+      display_log(dp, APP_ERROR, "out of memory copying file");
+   }
+
+   for (adler=0; adler<2; ++adler)
+   {
+      const char *error = NULL;
+
+      dp->operation = "damaged checksums";
+      dp->transforms = 0;
+      memcpy(damaged, original, size);
+      if (!damage_checksum(damaged, size, adler))
+         break;
+
+      buffer_start_write(&dp->written_file);
+      buffer_write(dp, &dp->written_file, damaged, size);
+
+      if (!read_fails(dp, &dp->written_file))
+         error = "not detected";
+
+#     ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+         else
+         {
+            size_t image_size = 0;
+            png_bytep expect = simplified_read(original, size, 0, 0,
+               &image_size);
+            png_bytep checked = simplified_read(damaged, size, 0, 0,
+               &image_size);
+            png_bytep trusted = simplified_read(damaged, size,
+               PNG_IMAGE_FLAG_TRUSTED_INPUT, 0, &image_size);
+
+            if (expect == NULL)
+               error = "simplified read of the original failed";
+
+            else if (checked != NULL)
+               error = "not detected by png_image_finish_read";
+
+            else if (trusted == NULL)
+               error = "PNG_IMAGE_FLAG_TRUSTED_INPUT read failed";
+
+            else if (memcmp(expect, trusted, image_size) != 0)
+               error = "PNG_IMAGE_FLAG_TRUSTED_INPUT changed the image";
+
+            free(trusted);
+            free(checked);
+            free(expect);
+         }
+#     endif
+
+      if (error != NULL)
+      {
+         free(damaged);
+         free(original);
+         display_log(dp, LIBPNG_BUG, "damaged %s: %s",
+            adler ? "ADLER32" : "IDAT CRC", error);
+      }
+
+      dp->skip_checksums = 1;
+      read_png(dp, &dp->written_file, adler ?
+         "skip ADLER32" : "skip IDAT CRC", 0/*transforms*/);
+      dp->skip_checksums = 0;
+
+      if (!compare_read(dp, 0/*transforms applied*/))
+         break;
+   }
+
+   free(damaged);
+   free(original);
+}
+#endif /* CHECKSUM_TESTS */
+
+#ifdef ZLIB_BACKEND_TESTS
+static void
+test_zlib_backend(struct display *dp)
+   /* Read the file, then write it with a zTXt chunk added, with the counting
+    * zlib backend and check that libpng called it.  The written file must read
+    * back unchanged and the simplified API, which has all of the IDAT data in
+    * memory, must decompress it with a single call to inflate_buffer.
+    */
+{
+   const char *error = NULL;
+   int threads = dp->threads;
+
+   count_reset();
+   dp->threads = 0;
+   dp->zlib_backend = 1;
+   read_png(dp, &dp->original_file, "zlib backend", 0/*transforms*/);
+
+   if (inflate_calls == 0)
+      error = "inflate not called on read";
+
+   else
+   {
+#     ifdef PNG_WRITE_COMPRESSED_TEXT_SUPPORTED
+         static char key[] = "Comment";
+         static char text[] = "Compressed with the zlib backend";
+         png_text chunk;
+
+         memset(&chunk, 0, sizeof chunk);
+         chunk.compression = PNG_TEXT_COMPRESSION_zTXt;
+         chunk.key = key;
+         chunk.text = text;
+         chunk.text_length = (sizeof text)-1;
+         png_set_text(dp->read_pp, dp->read_ip, &chunk, 1);
+#     endif
+
+      write_png(dp, dp->read_ip, 0/*transforms*/, 0/*idat_size*/,
+         0/*restart_rows*/);
+
+      if (deflate_calls == 0)
+         error = "deflate not called on write";
+
+#     ifdef PNG_WRITE_COMPRESSED_TEXT_SUPPORTED
+         else if (deflate_buffer_calls == 0)
+            error = "deflate_buffer not used for zTXt";
+#     endif
+   }
+
+   dp->zlib_backend = 0;
+   dp->threads = threads;
+
+   if (error != NULL)
+   {
+      display_log(dp, LIBPNG_BUG, "zlib backend: %s", error);
+      return;
+   }
+
+   read_png(dp, &dp->written_file, NULL, 0/*transforms*/);
+   if (!compare_read(dp, 0/*transforms applied*/))
+      return;
+
+#  ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   {
+      size_t size, image_size = 0;
+      png_bytep file = buffer_contents(dp, &dp->written_file, &size);
+      png_bytep expect = simplified_read(file, size, 0, 0, &image_size);
+      png_bytep actual;
+
+      inflate_buffer_calls = 0;
+      actual = simplified_read(file, size, 0, 1, &image_size);
+
+      if (expect == NULL)
+         error = "simplified read failed";
+
+      else if (actual == NULL)
+         error = "simplified read with the backend failed";
+
+      else if (inflate_buffer_calls != 1)
+         error = "inflate_buffer not used for IDAT";
+
+      else if (memcmp(expect, actual, image_size) != 0)
+         error = "inflate_buffer changed the image";
+
+      free(actual);
+      free(expect);
+      free(file);
+
+      if (error != NULL)
+         display_log(dp, LIBPNG_BUG, "zlib backend: %s", error);
+   }
+#  endif
+}
+#endif /* ZLIB_BACKEND_TESTS */
+
 static int
 skip_transform(struct display *dp, int tr)
    /* Helper to test for a bad combo and log it if it is skipped */
@@ -1431,12 +2302,102 @@ test_one_file(struct display *dp, const char *filename)
     * changed.
     */
    dp->operation = "write";
-   write_png(dp, dp->original_ip, 0/*transforms*/);
+   write_png(dp, dp->original_ip, 0/*transforms*/, 0/*idat_size*/,
+      0/*restart_rows*/);
    read_png(dp, &dp->written_file, NULL, 0/*transforms*/);
    if (!compare_read(dp, 0/*transforms applied*/))
       return;
 #endif
 
+#if defined(PNG_WRITE_PNG_SUPPORTED) && defined(RESTART_POINTS_TESTS)
+   /* Write the image with restart points, in the default size of IDAT chunk
+    * and in small ones.  write_png checks that the IDAT data decompresses from
+    * each point on its own, then the file, with its riDX chunk, must read back
+    * unchanged.
+    */
+   if (dp->height > 1)
+   {
+      png_uint_32 nrows = dp->height > 3 ? dp->height/3 : 1;
+
+      write_png(dp, dp->original_ip, 0/*transforms*/, 0/*idat_size*/, nrows);
+      read_png(dp, &dp->written_file, NULL, 0/*transforms*/);
+      if (!compare_read(dp, 0/*transforms applied*/))
+         return;
+
+      write_png(dp, dp->original_ip, 0/*transforms*/, 16/*idat_size*/, nrows);
+      read_png(dp, &dp->written_file, NULL, 0/*transforms*/);
+      if (!compare_read(dp, 0/*transforms applied*/))
+         return;
+   }
+#endif
+
+#ifdef CHECKSUM_TESTS
+   test_checksums(dp);
+#endif
+
+#ifdef ZLIB_BACKEND_TESTS
+   test_zlib_backend(dp);
+#endif
+
+#ifdef STOP_READ_TESTS
+   /* Stop reading the image data part way through; the rows, or passes, before
+    * the stopping point should be unchanged and the chunks after the IDAT
+    * should still be read.  This is done with the original file then, to stop
+    * in the middle of a run of IDAT chunks, with a copy written in small ones.
+    */
+   {
+      struct buffer *files[2];
+      unsigned int nfiles = 0;
+
+      files[nfiles++] = &dp->original_file;
+#     ifdef PNG_WRITE_PNG_SUPPORTED
+         write_png(dp, dp->original_ip, 0/*transforms*/, 16/*idat_size*/,
+            0/*restart_rows*/);
+         files[nfiles++] = &dp->written_file;
+#     endif
+
+      while (nfiles > 0)
+      {
+         struct buffer *bp = files[--nfiles];
+
+         if (dp->interlace_method == PNG_INTERLACE_NONE)
+         {
+            png_uint_32 stops[3];
+            unsigned int i;
+
+            stops[0] = 1;
+            stops[1] = dp->height/2;
+            stops[2] = dp->height-1;
+
+            for (i=0; i<ARRAY_SIZE(stops); ++i)
+               if (stops[i] > 0 && stops[i] < dp->height &&
+                  (i == 0 || stops[i] > stops[i-1]))
+            {
+               test_stop_row(dp, bp, stops[i], 0/*late*/);
+               test_stop_row(dp, bp, stops[i], 1/*late*/);
+            }
+         }
+
+         else
+         {
+            int last, pass;
+
+            /* Only the passes with a later pass that libpng reads without
+             * deinterlacing are stopped early.
+             */
+            for (last=0; last<6; ++last)
+               for (pass=last+1; pass<7; ++pass)
+                  if (PNG_PASS_COLS(dp->width, pass) > 0 &&
+                     PNG_PASS_ROWS(dp->height, pass) > 0)
+            {
+               test_last_pass(dp, bp, last);
+               break;
+            }
+         }
+      }
+   }
+#endif
+
    /* Third test: the active options.  Test each in turn, or, with the
     * EXHAUSTIVE option, test all possible combinations.
     */
@@ -1475,7 +2436,8 @@ test_one_file(struct display *dp, const char *filename)
              * low order bits because of the SHIFT/sBIT transform.
              */
             dp->operation = "reversible transforms";
-            write_png(dp, dp->read_ip, current);
+            write_png(dp, dp->read_ip, current, 0/*idat_size*/,
+               0/*restart_rows*/);
 
             /* And if this is read back in, because all the transformations were
              * reversible, the result should be the same.
@@ -1648,6 +2610,17 @@ main(int argc, char **argv)
       else if (strcmp(name, "--nolist-combos") == 0)
          d.options &= ~LIST_COMBOS;
 
+      else if (strcmp(name, "--threads") == 0 && option_end+1 < argc)
+      {
+#        if defined(PNG_WRITE_PNG_SUPPORTED) &&\
+            defined(PNG_WRITE_PARALLEL_SUPPORTED)
+            d.threads = atoi(argv[++option_end]);
+#        else
+            fprintf(stderr, "pngimage: %s: not supported\n", name);
+            return SKIP;
+#        endif
+      }
+
       else if (name[0] == '-' && name[1] == '-')
       {
          fprintf(stderr, "pngimage: %s: unknown option\n", name);
@@ -335,6 +335,10 @@ compare_16bit(int v1, int v2, int error_limit, int multiple_algorithms)
 #define NO_RESEED  512   /* do not reseed on each new file */
 #define GBG_ERROR 1024   /* do not ignore the gamma+background_rgb_to_gray
                           * libpng warning. */
+#define RESTART_POINTS 2048 /* write restart points (riDX) */
+#define CROP 4096        /* also read a window of each image */
+#define REDUCE 24576     /* also read each image reduced by 2, 4 or 8: */
+#define REDUCE_LOG2(opts) (((opts) & REDUCE) / 8192) /* log2 of the factor */
 
 static void
 print_opts(png_uint_32 opts)
@@ -363,6 +367,12 @@ print_opts(png_uint_32 opts)
    if (opts & GBG_ERROR)
       printf(" --fault-gbg-warning");
 #endif
+   if (opts & RESTART_POINTS)
+      printf(" --restart");
+   if (opts & CROP)
+      printf(" --crop");
+   if (opts & REDUCE)
+      printf(" --reduce %u", 1U << REDUCE_LOG2(opts));
 }
 
 #define FORMAT_NO_CHANGE 0x80000000 /* additional flag */
@@ -585,6 +595,11 @@ typedef struct
    size_t      allocsize;
    char        tmpfile_name[32];
    png_uint_16 colormap[256*4];
+   png_uint_32 crop_x;      /* png_image_set_crop window for read_file, */
+   png_uint_32 crop_y;      /* none if crop_width is 0 */
+   png_uint_32 crop_width;
+   png_uint_32 crop_height;
+   unsigned int reduce;     /* png_image_set_reduction factor, 0 for none */
 }
 Image;
 
@@ -2983,6 +2998,14 @@ read_file(Image *image, png_uint_32 format, png_const_colorp background)
    if (image->opts & sRGB_16BIT)
       image->image.flags |= PNG_IMAGE_FLAG_16BIT_sRGB;
 
+   if (image->crop_width > 0 && !png_image_set_crop(&image->image,
+      image->crop_x, image->crop_y, image->crop_width, image->crop_height))
+      return logerror(image, "set crop: ", image->file_name, "");
+
+   if (image->reduce > 0 &&
+      !png_image_set_reduction(&image->image, image->reduce))
+      return logerror(image, "set reduction: ", image->file_name, "");
+
    /* Have an initialized image with all the data we need plus, maybe, an
     * allocated file (myfile) or buffer (mybuffer) that need to be freed.
     */
@@ -3136,6 +3159,9 @@ write_one_file(Image *output, Image *image, int convert_to_8bit)
    if (image->opts & FAST_WRITE)
       image->image.flags |= PNG_IMAGE_FLAG_FAST;
 
+   if (image->opts & RESTART_POINTS)
+      image->image.flags |= PNG_IMAGE_FLAG_RESTART_POINTS;
+
    if (image->opts & USE_STDIO)
    {
 #ifdef PNG_SIMPLIFIED_WRITE_STDIO_SUPPORTED
@@ -3303,6 +3329,258 @@ write_one_file(Image *output, Image *image, int convert_to_8bit)
 }
 #endif
 
+/* Read the middle of the image again through png_image_set_crop and check that
+ * it matches the same window of 'image', which has just been read with the
+ * same format and background.  Interlaced images take a different path
+ * through libpng for this.
+ */
+static int
+check_crop(Image *image, png_uint_32 format, png_const_colorp background)
+{
+   Image window;
+   int result;
+
+   /* Share the input of 'image'; only the buffer is freed at the end. */
+   window = *image;
+   window.buffer = NULL;
+   window.bufsize = 0;
+   window.allocsize = 0;
+   window.crop_x = image->image.width / 4;
+   window.crop_y = image->image.height / 4;
+   window.crop_width = (image->image.width + 1) / 2;
+   window.crop_height = (image->image.height + 1) / 2;
+
+   resetimage(&window);
+   result = read_file(&window, format, background);
+
+   if (result)
+   {
+      png_uint_32 read_format = image->image.format;
+      size_t pixel_size = PNG_IMAGE_PIXEL_SIZE(read_format);
+      size_t row_size = window.crop_width * pixel_size;
+      size_t component_size = PNG_IMAGE_PIXEL_COMPONENT_SIZE(read_format);
+      png_const_bytep a = image->buffer+16 +
+         window.crop_y * image->stride * component_size +
+         window.crop_x * pixel_size;
+      png_const_bytep b = window.buffer+16;
+      png_uint_32 y;
+
+      for (y = 0; y < window.crop_height; ++y)
+      {
+         if (memcmp(a, b, row_size) != 0)
+         {
+            char row[32];
+
+            sprintf(row, ": crop row %lu differs", (unsigned long)y);
+            result = logerror(image, image->file_name, row, "");
+            break;
+         }
+
+         a += image->stride * component_size;
+         b += window.stride * component_size;
+      }
+
+      if (result && (read_format & PNG_FORMAT_FLAG_COLORMAP) != 0 &&
+         (window.image.colormap_entries != image->image.colormap_entries ||
+         memcmp(window.colormap, image->colormap,
+            PNG_IMAGE_COLORMAP_SIZE(image->image)) != 0))
+         result = logerror(image, image->file_name, ": crop color-map differs",
+            "");
+   }
+
+   freebuffer(&window);
+   return result;
+}
+
+/* png_image_set_reduction point samples or averages each block of pixels
+ * depending on the PNG data, so this reads the IHDR and looks for tRNS and the
+ * color space chunks in the file.  Returns 0 if the file cannot be read.
+ */
+static int
+reduce_info(Image *image, png_bytep ihdr, int *trns, int *colorspace)
+{
+   FILE *f = fopen(image->file_name, "rb");
+   png_byte header[8];
+   int ok = 0;
+
+   *trns = *colorspace = 0;
+
+   if (f == NULL)
+      return 0;
+
+   if (fread(header, 8, 1, f) == 1) while (fread(header, 8, 1, f) == 1)
+   {
+      png_uint_32 length = png_get_uint_32(header);
+
+      if (memcmp(header+4, "IHDR", 4) == 0)
+         ok = length == 13 && fread(ihdr, 13, 1, f) == 1 &&
+            fseek(f, 4, SEEK_CUR) == 0;
+
+      else if (memcmp(header+4, "IDAT", 4) == 0)
+         break;
+
+      else
+      {
+         if (memcmp(header+4, "tRNS", 4) == 0)
+            *trns = 1;
+
+         else if (memcmp(header+4, "gAMA", 4) == 0 ||
+            memcmp(header+4, "cHRM", 4) == 0 ||
+            memcmp(header+4, "sRGB", 4) == 0 ||
+            memcmp(header+4, "iCCP", 4) == 0)
+            *colorspace = 1;
+
+         if (fseek(f, (long)length + 4, SEEK_CUR) != 0)
+            break;
+      }
+
+      if (!ok)
+         break;
+   }
+
+   fclose(f);
+   return ok;
+}
+
+/* Read the image again reduced with png_image_set_reduction and check it
+ * against 'image', which has just been read with the same format and
+ * background.  Point sampled images must match the top-left pixel of each
+ * block.  The other images are averaged before the conversion to the output
+ * format, unless they are interlaced, so the average of each block of 'image'
+ * is only the right answer if that conversion does not change the values;
+ * otherwise just the size of the reduced image is checked.
+ */
+static int
+check_reduce(Image *image, png_uint_32 format, png_const_colorp background)
+{
+   Image reduced;
+   unsigned int shift = REDUCE_LOG2(image->opts);
+   png_uint_32 read_format = image->image.format;
+   png_byte ihdr[13];
+   int trns, colorspace, point_sample, average;
+   int result;
+
+   if (!reduce_info(image, ihdr, &trns, &colorspace))
+      return logerror(image, image->file_name, ": cannot read IHDR", "");
+
+   point_sample = ihdr[8] < 8 || ihdr[9] == PNG_COLOR_TYPE_PALETTE || trns ||
+      (ihdr[12] != 0 && (read_format & PNG_FORMAT_FLAG_COLORMAP) != 0);
+
+   if (point_sample || (read_format & PNG_FORMAT_FLAG_COLORMAP) != 0)
+      average = 0;
+
+   else if (ihdr[12] != 0)
+      average = 1;
+
+   else /* no gamma correction, RGB to gray, composition or premultiplication */
+      average = !colorspace &&
+         (ihdr[8] == 16) == ((read_format & PNG_FORMAT_FLAG_LINEAR) != 0) &&
+         ((ihdr[9] & PNG_COLOR_MASK_COLOR) == 0 ||
+            (read_format & PNG_FORMAT_FLAG_COLOR) != 0) &&
+         ((ihdr[9] & PNG_COLOR_MASK_ALPHA) == 0 ||
+            ((read_format & PNG_FORMAT_FLAG_ALPHA) != 0 &&
+            (read_format & PNG_FORMAT_FLAG_LINEAR) == 0));
+
+   /* Share the input of 'image'; only the buffer is freed at the end. */
+   reduced = *image;
+   reduced.buffer = NULL;
+   reduced.bufsize = 0;
+   reduced.allocsize = 0;
+   reduced.crop_width = 0;
+   reduced.reduce = 1U << shift;
+
+   resetimage(&reduced);
+   result = read_file(&reduced, format, background);
+
+   if (result && (reduced.image.width !=
+         (image->image.width + (1U << shift) - 1) >> shift ||
+      reduced.image.height !=
+         (image->image.height + (1U << shift) - 1) >> shift))
+      result = logerror(image, image->file_name, ": reduced size wrong", "");
+
+   if (result && (point_sample || average))
+   {
+      size_t pixel_size = PNG_IMAGE_PIXEL_SIZE(read_format);
+      size_t component_size = PNG_IMAGE_PIXEL_COMPONENT_SIZE(read_format);
+      unsigned int channels = (unsigned int)(pixel_size / component_size);
+      png_uint_32 x, y;
+
+      for (y = 0; result && y < reduced.image.height; ++y)
+         for (x = 0; result && x < reduced.image.width; ++x)
+      {
+         png_uint_32 rows = image->image.height - (y << shift);
+         png_uint_32 cols = image->image.width - (x << shift);
+         png_const_bytep a = image->buffer+16 +
+            (y << shift) * image->stride * component_size +
+            (x << shift) * pixel_size;
+         png_const_bytep b = reduced.buffer+16 +
+            y * reduced.stride * component_size + x * pixel_size;
+         unsigned int c;
+
+         if (point_sample || rows > (1U << shift))
+            rows = point_sample ? 1 : 1U << shift;
+
+         if (point_sample || cols > (1U << shift))
+            cols = point_sample ? 1 : 1U << shift;
+
+         for (c = 0; c < channels; ++c)
+         {
+            png_uint_32 sum = 0, expect, got, i, j;
+
+            for (j = 0; j < rows; ++j) for (i = 0; i < cols; ++i)
+            {
+               png_const_bytep sp = a + j * image->stride * component_size +
+                  i * pixel_size + c * component_size;
+
+               if (component_size == 2)
+               {
+                  png_const_voidp pv = sp;
+                  png_const_uint_16p pp = voidcast(png_const_uint_16p, pv);
+
+                  sum += *pp;
+               }
+
+               else
+                  sum += *sp;
+            }
+
+            expect = (sum + (rows * cols >> 1)) / (rows * cols);
+
+            if (component_size == 2)
+            {
+               png_const_voidp pv = b + c * component_size;
+               png_const_uint_16p pp = voidcast(png_const_uint_16p, pv);
+
+               got = *pp;
+            }
+
+            else
+               got = b[c];
+
+            if (got != expect)
+            {
+               char pixel[64];
+
+               sprintf(pixel, ": reduced pixel (%lu,%lu)[%u] %lu, expected %lu",
+                  (unsigned long)x, (unsigned long)y, c, (unsigned long)got,
+                  (unsigned long)expect);
+               result = logerror(image, image->file_name, pixel, "");
+            }
+         }
+      }
+
+      if (result && (read_format & PNG_FORMAT_FLAG_COLORMAP) != 0 &&
+         (reduced.image.colormap_entries != image->image.colormap_entries ||
+         memcmp(reduced.colormap, image->colormap,
+            PNG_IMAGE_COLORMAP_SIZE(image->image)) != 0))
+         result = logerror(image, image->file_name,
+            ": reduced color-map differs", "");
+   }
+
+   freebuffer(&reduced);
+   return result;
+}
+
 static int
 testimage(Image *image, png_uint_32 opts, format_list *pf)
 {
@@ -3389,6 +3667,20 @@ testimage(Image *image, png_uint_32 opts, format_list *pf)
          if (!result)
             break;
 
+         if (opts & CROP)
+         {
+            result = check_crop(&copy, format, background);
+            if (!result)
+               break;
+         }
+
+         if (opts & REDUCE)
+         {
+            result = check_reduce(&copy, format, background);
+            if (!result)
+               break;
+         }
+
 #        ifdef PNG_SIMPLIFIED_WRITE_SUPPORTED
             /* Write the *copy* just made to a new file to make sure the write
              * side works ok.  Check the conversion to sRGB if the copy is
@@ -3567,6 +3859,30 @@ main(int argc, char **argv)
          opts |= NO_RESEED;
       else if (strcmp(arg, "--fault-gbg-warning") == 0)
          opts |= GBG_ERROR;
+      else if (strcmp(arg, "--restart") == 0)
+         opts |= RESTART_POINTS;
+      else if (strcmp(arg, "--crop") == 0)
+         opts |= CROP;
+      else if (strcmp(arg, "--reduce") == 0)
+      {
+         const char *factor = c+1 < argc ? argv[++c] : "";
+
+         opts &= ~REDUCE;
+
+         if (strcmp(factor, "2") == 0)
+            opts |= 8192;
+         else if (strcmp(factor, "4") == 0)
+            opts |= 16384;
+         else if (strcmp(factor, "8") == 0)
+            opts |= 24576;
+         else
+         {
+            fflush(stdout);
+            fprintf(stderr, "%s: %s requires a factor of 2, 4 or 8\n",
+               argv[0], arg);
+            exit(99);
+         }
+      }
       else if (strcmp(arg, "--tmpfile") == 0)
       {
          if (c+1 < argc)
@@ -2471,6 +2471,7 @@ typedef struct png_modifier
    unsigned int             test_gamma_scale16 :1;
    unsigned int             test_gamma_background :1;
    unsigned int             test_gamma_alpha_mode :1;
+   unsigned int             test_gamma_approximate_16 :1;
    unsigned int             test_gamma_expand16 :1;
    unsigned int             test_exhaustive :1;
 
@@ -2552,6 +2553,7 @@ modifier_init(png_modifier *pm)
    pm->test_gamma_scale16 = 0;
    pm->test_gamma_background = 0;
    pm->test_gamma_alpha_mode = 0;
+   pm->test_gamma_approximate_16 = 0;
    pm->test_gamma_expand16 = 0;
    pm->test_lbg = 1;
    pm->test_lbg_gamma_threshold = 1;
@@ -11005,6 +11007,201 @@ summarize_gamma_errors(png_modifier *pm, png_const_charp who, int low_bit_depth,
    fflush(stdout);
 }
 
+#if defined(PNG_APPROXIMATE_GAMMA_16) && defined(PNG_SET_OPTION_SUPPORTED) &&\
+   defined(DO_16BIT)
+/* With PNG_APPROXIMATE_GAMMA_16 the 16-bit gamma corrected values are
+ * calculated rather than looked up in gamma_16_table, the result must be
+ * within 1 of the table value.  The 16-bit gray transform image has all 65536
+ * values and the red channel of the RGB and RGBA images has them too, so each
+ * image is read twice, with the option off to get the table values then with
+ * it on, and every sample compared.  The alpha channel must not change.
+ *
+ * The reads are sequential and do not use the pngvalid row checking; the
+ * comparison is against libpng, not the ideal values.
+ */
+static int
+gamma_approximate_16_read(png_modifier *pmIn, png_uint_32 id,
+    double file_gamma, double screen_gamma, png_byte sbit, int approximate,
+    const char *name, png_bytep image, size_t *size)
+{
+   context(&pmIn->this, fault);
+
+   Try
+   {
+      png_modifier *pm = pmIn;
+      png_structp pp;
+      png_infop pi;
+      gama_modification gama_mod;
+      srgb_modification srgb_mod;
+      sbit_modification sbit_mod;
+      png_uint_32 height, y;
+      size_t rowbytes;
+
+      pm->encoding_counter = 0;
+      modifier_set_encoding(pm); /* Just resets everything */
+      pm->current_gamma = file_gamma;
+
+      pm->modifications = NULL;
+      gama_modification_init(&gama_mod, pm, file_gamma);
+      srgb_modification_init(&srgb_mod, pm, 127 /*delete*/);
+      if (sbit > 0)
+         sbit_modification_init(&sbit_mod, pm, sbit);
+
+      modification_reset(pm->modifications);
+
+      pp = set_modifier_for_read(pm, &pi, id, name);
+      png_set_read_fn(pp, pm, modifier_read);
+      png_read_info(pp, pi);
+
+      png_set_option(pp, PNG_APPROXIMATE_GAMMA_16, approximate);
+      png_set_gamma(pp, screen_gamma, file_gamma);
+      png_read_update_info(pp, pi);
+
+      height = png_get_image_height(pp, pi);
+      rowbytes = png_get_rowbytes(pp, pi);
+
+      if (png_get_bit_depth(pp, pi) != 16 ||
+          height * rowbytes > TRANSFORM_HEIGHTMAX * TRANSFORM_ROWMAX)
+         png_error(pp, "approximate gamma 16: unexpected image format");
+
+      for (y=0; y<height; ++y)
+         png_read_row(pp, image + y * rowbytes, NULL);
+
+      png_read_end(pp, pi);
+      *size = height * rowbytes;
+
+      pm->this.validated = 1;
+      modifier_reset(pm);
+   }
+
+   Catch(fault)
+   {
+      modifier_reset(voidcast(png_modifier*,(void*)fault));
+      return 0;
+   }
+
+   return 1;
+}
+
+static void
+gamma_approximate_16_test(png_modifier *pm, png_byte colour_type,
+    double file_gamma, double screen_gamma, png_byte sbit, png_bytep table,
+    png_bytep calculated)
+{
+   png_uint_32 id = FILEID(colour_type, 16, 0/*no tRNS*/, PNG_INTERLACE_NONE,
+      0, 0, 0);
+   unsigned int channels = colour_type == 0 ? 1U : colour_type == 2 ? 3U : 4U;
+   unsigned int maxerr = 0;
+   size_t table_size = 0, calculated_size = 0, i;
+   size_t pos = 0;
+   char name[64];
+
+   if (sbit > 0)
+   {
+      pos = safecat(name, sizeof name, pos, "sbit(");
+      pos = safecatn(name, sizeof name, pos, sbit);
+      pos = safecat(name, sizeof name, pos, ") ");
+   }
+
+   pos = safecat(name, sizeof name, pos, "approximate ");
+   pos = safecatd(name, sizeof name, pos, file_gamma, 3);
+   pos = safecat(name, sizeof name, pos, "->");
+   pos = safecatd(name, sizeof name, pos, screen_gamma, 3);
+
+   if (!gamma_approximate_16_read(pm, id, file_gamma, screen_gamma, sbit,
+          0/*table*/, name, table, &table_size) ||
+       !gamma_approximate_16_read(pm, id, file_gamma, screen_gamma, sbit,
+          1/*approximate*/, name, calculated, &calculated_size))
+      return;
+
+   if (table_size != calculated_size)
+   {
+      store_log(&pm->this, NULL, "approximate gamma 16: image size changed",
+         1/*error*/);
+      return;
+   }
+
+   for (i=0; i<table_size; i += 2)
+   {
+      unsigned int t = (table[i] << 8) + table[i+1];
+      unsigned int c = (calculated[i] << 8) + calculated[i+1];
+      unsigned int err = t > c ? t - c : c - t;
+      int alpha = channels == 4 && (i/2) % 4 == 3;
+
+      if (err > (alpha ? 0U : 1U))
+      {
+         char msg[128];
+
+         pos = safecat(msg, sizeof msg, 0, alpha ? "alpha " : "sample ");
+         pos = safecatn(msg, sizeof msg, pos, (int)(i/2));
+         pos = safecat(msg, sizeof msg, pos, ": table ");
+         pos = safecatn(msg, sizeof msg, pos, (int)t);
+         pos = safecat(msg, sizeof msg, pos, " calculated ");
+         pos = safecatn(msg, sizeof msg, pos, (int)c);
+         store_log(&pm->this, NULL, msg, 1/*error*/);
+         return;
+      }
+
+      if (err > maxerr)
+         maxerr = err;
+   }
+
+   if (pm->log)
+      fprintf(stderr, "16 bit %s %s: max error %u\n", colour_types[colour_type],
+         name, maxerr);
+}
+
+static void
+perform_gamma_approximate_16_tests(png_modifier *pm)
+{
+   /* Gray, RGB and RGBA with and without an sBIT chunk; an sBIT of 8 or less
+    * gives the maximum gamma_shift of 8.  The screen gammas go from .5 to 3 for
+    * a file encoded with the sRGB gamma and a linear one.
+    */
+   static const png_byte colour_types_16[] = { 0, 2, 6 };
+   static const png_byte sbits[] = { 0, 8, 11, 13, 15 };
+   static const double file_gammas[] = { .45455, 1 };
+   png_bytep table, calculated;
+   unsigned int c;
+
+   table = voidcast(png_bytep,
+      malloc(TRANSFORM_HEIGHTMAX * TRANSFORM_ROWMAX));
+   calculated = voidcast(png_bytep,
+      malloc(TRANSFORM_HEIGHTMAX * TRANSFORM_ROWMAX));
+
+   if (table == NULL || calculated == NULL)
+      store_log(&pm->this, NULL, "approximate gamma 16: OOM", 1/*error*/);
+
+   else for (c=0; c<(sizeof colour_types_16)/(sizeof colour_types_16[0]); ++c)
+   {
+      unsigned int s;
+
+      for (s=0; s<(sizeof sbits)/(sizeof sbits[0]); ++s)
+      {
+         unsigned int f;
+
+         for (f=0; f<(sizeof file_gammas)/(sizeof file_gammas[0]); ++f)
+         {
+            int sg;
+
+            for (sg=2; sg<=12; ++sg)
+            {
+               gamma_approximate_16_test(pm, colour_types_16[c],
+                  file_gammas[f], sg/4., sbits[s], table, calculated);
+
+               if (fail(pm))
+                  goto done;
+            }
+         }
+      }
+   }
+
+done:
+   free(table);
+   free(calculated);
+}
+#endif /* APPROXIMATE_GAMMA_16 && SET_OPTION && DO_16BIT */
+
 static void
 perform_gamma_test(png_modifier *pm, int summary)
 {
@@ -11124,6 +11321,17 @@ perform_gamma_test(png_modifier *pm, int summary)
    }
 #endif
 
+#if defined(PNG_APPROXIMATE_GAMMA_16) && defined(PNG_SET_OPTION_SUPPORTED) &&\
+   defined(DO_16BIT)
+   if (pm->test_gamma_approximate_16)
+   {
+      perform_gamma_approximate_16_tests(pm);
+
+      if (fail(pm))
+         return;
+   }
+#endif
+
 #ifdef PNG_READ_ALPHA_MODE_SUPPORTED
    if (pm->test_gamma_alpha_mode)
    {
@@ -11834,6 +12042,7 @@ int main(int argc, char **argv)
          pm.test_gamma_scale16 = 1;
          pm.test_gamma_background = 1; /* composition */
          pm.test_gamma_alpha_mode = 1;
+         pm.test_gamma_approximate_16 = 1;
          }
 
       else if (strcmp(*argv, "--nogamma") == 0)
@@ -11875,6 +12084,12 @@ int main(int argc, char **argv)
       else if (strcmp(*argv, "--nogamma-alpha-mode") == 0)
          pm.test_gamma_alpha_mode = 0;
 
+      else if (strcmp(*argv, "--gamma-approximate-16") == 0)
+         pm.ngamma_tests = 2U, pm.test_gamma_approximate_16 = 1;
+
+      else if (strcmp(*argv, "--nogamma-approximate-16") == 0)
+         pm.test_gamma_approximate_16 = 0;
+
       else if (strcmp(*argv, "--expand16") == 0)
          pm.test_gamma_expand16 = 1;
 
@@ -12071,7 +12286,8 @@ int main(int argc, char **argv)
    if (pm.ngamma_tests > 0 &&
       pm.test_gamma_threshold == 0 && pm.test_gamma_transform == 0 &&
       pm.test_gamma_sbit == 0 && pm.test_gamma_scale16 == 0 &&
-      pm.test_gamma_background == 0 && pm.test_gamma_alpha_mode == 0)
+      pm.test_gamma_background == 0 && pm.test_gamma_alpha_mode == 0 &&
+      pm.test_gamma_approximate_16 == 0)
    {
       pm.test_gamma_threshold = 1;
       pm.test_gamma_transform = 1;
@@ -12079,6 +12295,7 @@ int main(int argc, char **argv)
       pm.test_gamma_scale16 = 1;
       pm.test_gamma_background = 1;
       pm.test_gamma_alpha_mode = 1;
+      pm.test_gamma_approximate_16 = 1;
    }
 
    else if (pm.ngamma_tests == 0)
@@ -12090,6 +12307,7 @@ int main(int argc, char **argv)
       pm.test_gamma_scale16 = 0;
       pm.test_gamma_background = 0;
       pm.test_gamma_alpha_mode = 0;
+      pm.test_gamma_approximate_16 = 0;
    }
 
    Try
@@ -144,7 +144,8 @@ static PNG_CALLBACK(void, no_warnings, (png_structp png_ptr,
    (void)warning;
 }
 
-static int read_png(FILE *fp, png_int_32 transforms, FILE *write_file)
+static int read_png(FILE *fp, png_int_32 transforms, FILE *write_file,
+      int skip_checksums)
 {
    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,0,0,
          no_warnings);
@@ -161,6 +162,12 @@ static int read_png(FILE *fp, png_int_32 transforms, FILE *write_file)
 
 #  ifdef PNG_BENIGN_ERRORS_SUPPORTED
       png_set_benign_errors(png_ptr, 1/*allowed*/);
+#  endif
+#  if defined(PNG_SET_OPTION_SUPPORTED) && defined(PNG_SKIP_CHECKSUMS)
+      if (skip_checksums)
+         png_set_option(png_ptr, PNG_SKIP_CHECKSUMS, PNG_OPTION_ON);
+#  else
+      (void)skip_checksums;
 #  endif
    png_init_io(png_ptr, fp);
 
@@ -190,7 +197,8 @@ static int mytime(struct timespec *t)
    return 0;
 }
 
-static int perform_one_test(FILE *fp, int nfiles, png_int_32 transforms)
+static int perform_one_test(FILE *fp, int nfiles, png_int_32 transforms,
+      int skip_checksums)
 {
    int i;
    struct timespec before, after;
@@ -202,7 +210,7 @@ static int perform_one_test(FILE *fp, int nfiles, png_int_32 transforms)
    {
       for (i=0; i<nfiles; ++i)
       {
-         if (read_png(fp, transforms, NULL/*write*/))
+         if (read_png(fp, transforms, NULL/*write*/, skip_checksums))
          {
             if (ferror(fp))
             {
@@ -280,7 +288,8 @@ static int add_one_file(FILE *fp, char *name)
          exit(1);
       }
 
-      if (read_png(ip, -1/*by row*/, fp/*output*/))
+      /* Always check the files that are added: */
+      if (read_png(ip, -1/*by row*/, fp/*output*/, 0/*checksums*/))
       {
          if (ferror(ip))
          {
@@ -348,6 +357,11 @@ usage(FILE *fp)
 "  --<transform>: implies by-image, use PNG_TRANSFORM_<transform>\n"
 "  Otherwise: read by row using png_read_row (to a single row buffer)\n"
    /* ISO C90 string length max 509 */);fprintf(stderr,
+"Checksums:\n"
+"  --skip-checksums: time the decode with the PNG_SKIP_CHECKSUMS option, so\n"
+"  that neither the chunk CRCs nor the ADLER32 are calculated; compare the\n"
+"  result with a run without the option to see the cost of the checksums\n"
+   );fprintf(stderr,
 "{files}:\n"
 "  PNG files to copy into the assembly and time.  Invalid files are skipped\n"
 "  with appropriate error messages.  If no files are given the list of files\n"
@@ -366,6 +380,7 @@ int main(int argc, char **argv)
    int err = 0;
    int nfiles = 0;
    int transforms = -1; /* by row */
+   int skip_checksums = 0;
    const char *assembly = NULL;
    FILE *fp;
 
@@ -468,6 +483,13 @@ int main(int argc, char **argv)
 
       --argc;
 
+      /* This is not a transform; it does not change the read method: */
+      if (strcmp(opt, "skip-checksums") == 0)
+      {
+         skip_checksums = 1;
+         continue;
+      }
+
       /* Transforms turn on the by-image processing and maybe set some
        * transforms:
        */
@@ -588,7 +610,7 @@ int main(int argc, char **argv)
 
          else
          {
-            ok = perform_one_test(fp, nfiles, transforms);
+            ok = perform_one_test(fp, nfiles, transforms, skip_checksums);
             (void)fclose(fp);
          }
       }
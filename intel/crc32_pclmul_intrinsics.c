@@ -0,0 +1,158 @@
+/* crc32_pclmul_intrinsics.c - CRC-32 using the PCLMULQDQ instruction
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_SUPPORTED)
+
+#if PNG_INTEL_PCLMUL_OPT > 0
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+/* This file is compiled for PCLMULQDQ regardless of the flags used for the rest
+ * of libpng.  png_crc32_pclmul may not be called until
+ * png_init_crc_functions_sse2 has confirmed, at run time, that the CPU
+ * supports the instruction.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#  define PNG_PCLMUL_TARGET __attribute__((target("sse2,pclmul")))
+#else
+#  define PNG_PCLMUL_TARGET
+#endif
+
+/* The folding method is described in "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).  The constants are
+ * the powers of x modulo the bit reflected PNG polynomial given there:
+ *
+ *    k1, k2   fold 512 bits: x^(4*128+32) mod P, x^(4*128-32) mod P
+ *    k3, k4   fold 128 bits: x^(128+32) mod P, x^(128-32) mod P
+ *    k5       fold 96 bits to 64: x^64 mod P
+ *    P', u    the polynomial and its Barrett constant, floor(x^64 / P)
+ */
+static const png_uint_32 png_crc32_k1k2[4] =
+   { 0x54442bd4, 0x1, 0xc6e41596, 0x1 };
+static const png_uint_32 png_crc32_k3k4[4] =
+   { 0x751997d0, 0x1, 0xccaa009e, 0x0 };
+static const png_uint_32 png_crc32_k5[4] =
+   { 0x63cd6124, 0x1, 0x0, 0x0 };
+static const png_uint_32 png_crc32_poly[4] =
+   { 0xdb710641, 0x1, 0xf7011641, 0x1 };
+
+/* Fold 'length' bytes, which must be at least 64 and a multiple of 16, into
+ * the (uninverted) CRC register 'crc' and return the new register value.
+ */
+static PNG_PCLMUL_TARGET png_uint_32
+png_crc32_fold(png_uint_32 crc, png_const_bytep ptr, size_t length)
+{
+   __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+   x1 = _mm_loadu_si128((const __m128i*)(ptr));
+   x2 = _mm_loadu_si128((const __m128i*)(ptr + 16));
+   x3 = _mm_loadu_si128((const __m128i*)(ptr + 32));
+   x4 = _mm_loadu_si128((const __m128i*)(ptr + 48));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+
+   ptr += 64;
+   length -= 64;
+
+   /* Fold four 128-bit lanes at a time. */
+   x0 = _mm_loadu_si128((const __m128i*)png_crc32_k1k2);
+
+   while (length >= 64)
+   {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+          _mm_loadu_si128((const __m128i*)(ptr)));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+          _mm_loadu_si128((const __m128i*)(ptr + 16)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+          _mm_loadu_si128((const __m128i*)(ptr + 32)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+          _mm_loadu_si128((const __m128i*)(ptr + 48)));
+
+      ptr += 64;
+      length -= 64;
+   }
+
+   /* Fold the four lanes into one. */
+   x0 = _mm_loadu_si128((const __m128i*)png_crc32_k3k4);
+
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), x2);
+
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), x3);
+
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), x4);
+
+   /* Then any remaining 16 byte blocks. */
+   while (length >= 16)
+   {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+          _mm_loadu_si128((const __m128i*)ptr));
+
+      ptr += 16;
+      length -= 16;
+   }
+
+   /* Reduce 128 bits to 64. */
+   x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+   x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+   x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+   x0 = _mm_loadu_si128((const __m128i*)png_crc32_k5);
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   /* Barrett reduction to 32 bits. */
+   x0 = _mm_loadu_si128((const __m128i*)png_crc32_poly);
+   x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x10);
+   x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, x3), x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   return (png_uint_32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+png_uint_32
+png_crc32_pclmul(png_uint_32 crc, png_const_bytep ptr, size_t length)
+{
+   /* Short buffers, such as chunk headers, and the tail of longer ones are
+    * left to the table code.
+    */
+   if (length >= 64)
+   {
+      size_t fold = length & ~(size_t)15;
+
+      crc = ~png_crc32_fold(~crc, ptr, fold);
+      ptr += fold;
+      length -= fold;
+   }
+
+   return png_crc32_slice8(crc, ptr, length);
+}
+
+#endif /* PNG_INTEL_PCLMUL_OPT > 0 */
+#endif /* READ || WRITE */
@@ -0,0 +1,707 @@
+/* filter_avx2_intrinsics.c - AVX2 optimized filter functions
+ *
+ * Copyright (c) 2026 agent
+ * Copyright (c) 2016-2017 Glenn Randers-Pehrson
+ * Derived from intel/filter_sse2_intrinsics.c
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_FILTER_SUPPORTED)
+
+#if PNG_INTEL_AVX2_OPT > 0
+
+#include <immintrin.h>
+
+/* Everything in this file is compiled for AVX2 (which implies SSSE3 and
+ * SSE4.1) regardless of the flags used for the rest of libpng.  None of these
+ * functions may be called until png_init_filter_functions_sse2 has confirmed,
+ * at run time, that the CPU and the OS support AVX2.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#  define PNG_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#  define PNG_AVX2_TARGET
+#endif
+
+#ifdef PNG_READ_SUPPORTED
+/* The Sub, Avg and Paeth filters look at most 3 pixels (a,b,c) to predict the
+ * 4th (d), positioned like this:
+ *    prev:  c b
+ *    row:   a d
+ * Sub and Up are the only filters that can be computed for several pixels at
+ * once; Sub by a prefix sum within the vector.  Avg and Paeth depend on the
+ * reconstructed value of a so they still run one pixel at a time, but here
+ * they can use the SSSE3 and SSE4.1 instructions the SSE2 versions emulate.
+ */
+
+static PNG_AVX2_TARGET __m128i load4_avx2(const void* p) {
+   int tmp;
+   memcpy(&tmp, p, sizeof(tmp));
+   return _mm_cvtsi32_si128(tmp);
+}
+
+static PNG_AVX2_TARGET void store4_avx2(void* p, __m128i v) {
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, sizeof(int));
+}
+
+static PNG_AVX2_TARGET __m128i load3_avx2(const void* p) {
+   png_uint_32 tmp = 0;
+   memcpy(&tmp, p, 3);
+   return _mm_cvtsi32_si128(tmp);
+}
+
+static PNG_AVX2_TARGET void store3_avx2(void* p, __m128i v) {
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, 3);
+}
+
+static PNG_AVX2_TARGET __m128i load6_avx2(const void* p) {
+   png_byte tmp[8] = {0};
+   memcpy(tmp, p, 6);
+   return _mm_loadl_epi64((const __m128i*)tmp);
+}
+
+static PNG_AVX2_TARGET void store6_avx2(void* p, __m128i v) {
+   png_byte tmp[8];
+   _mm_storel_epi64((__m128i*)tmp, v);
+   memcpy(p, tmp, 6);
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_up_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* Up is a plain bytewise add of the previous row, 32 bytes at a time. */
+   size_t rb;
+
+   png_debug(1, "in png_read_filter_row_up_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 32) {
+      __m256i d = _mm256_loadu_si256((const __m256i*)row);
+      __m256i b = _mm256_loadu_si256((const __m256i*)prev);
+      _mm256_storeu_si256((__m256i*)row, _mm256_add_epi8(d, b));
+
+      prev += 32;
+      row  += 32;
+      rb   -= 32;
+   }
+   if (rb >= 16) {
+      __m128i d = _mm_loadu_si128((const __m128i*)row);
+      __m128i b = _mm_loadu_si128((const __m128i*)prev);
+      _mm_storeu_si128((__m128i*)row, _mm_add_epi8(d, b));
+
+      prev += 16;
+      row  += 16;
+      rb   -= 16;
+   }
+   while (rb > 0) {
+      *row = (png_byte)(*row + *prev++);
+      row++;
+      rb--;
+   }
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_sub1_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* As png_read_filter_row_sub1_sse2, but with 32 pixels per vector; the
+    * prefix sum is computed in each 128-bit lane then the last byte of the low
+    * lane is carried into the high lane.
+    */
+   const __m256i last = _mm256_set1_epi8(15);
+   size_t rb;
+   png_byte carry;
+   __m256i a = _mm256_setzero_si256();
+
+   png_debug(1, "in png_read_filter_row_sub1_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 32) {
+      __m256i d = _mm256_loadu_si256((const __m256i*)row);
+
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 1));
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 2));
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 4));
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 8));
+      d = _mm256_add_epi8(d, _mm256_shuffle_epi8(
+          _mm256_permute2x128_si256(d, d, 0x08), last));
+      d = _mm256_add_epi8(d, a);
+      a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(d, last), 0xff);
+
+      _mm256_storeu_si256((__m256i*)row, d);
+
+      row += 32;
+      rb  -= 32;
+   }
+
+   carry = (png_byte)_mm_cvtsi128_si32(_mm256_castsi256_si128(a));
+   while (rb > 0) {
+      carry = (png_byte)(*row + carry);
+      *row++ = carry;
+      rb--;
+   }
+   PNG_UNUSED(prev)
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_sub2_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   const __m256i last = _mm256_set1_epi16(0x0f0e);
+   size_t rb;
+   png_byte carry0, carry1;
+   __m256i a = _mm256_setzero_si256();
+
+   png_debug(1, "in png_read_filter_row_sub2_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 32) {
+      __m256i d = _mm256_loadu_si256((const __m256i*)row);
+
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 2));
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 4));
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 8));
+      d = _mm256_add_epi8(d, _mm256_shuffle_epi8(
+          _mm256_permute2x128_si256(d, d, 0x08), last));
+      d = _mm256_add_epi8(d, a);
+      a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(d, last), 0xff);
+
+      _mm256_storeu_si256((__m256i*)row, d);
+
+      row += 32;
+      rb  -= 32;
+   }
+
+   carry0 = (png_byte)_mm_cvtsi128_si32(_mm256_castsi256_si128(a));
+   carry1 = (png_byte)(_mm_cvtsi128_si32(_mm256_castsi256_si128(a)) >> 8);
+   while (rb >= 2) {
+      carry0 = (png_byte)(row[0] + carry0);
+      carry1 = (png_byte)(row[1] + carry1);
+      *row++ = carry0;
+      *row++ = carry1;
+      rb -= 2;
+   }
+   PNG_UNUSED(prev)
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_sub3_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* Five 3-byte pixels fit in the low 15 bytes of a 128-bit vector.  Shifting
+    * by one, two and four pixels and adding gives the running sum of the five
+    * pixels, to which the last reconstructed pixel of the previous block is
+    * added.  The 16th byte belongs to the next block and is stored unchanged.
+    */
+   const __m128i last = _mm_setr_epi8(12,13,14, 12,13,14, 12,13,14,
+                                      12,13,14, 12,13,14, -1);
+   const __m128i keep = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,
+                                      -1,-1,-1,-1,-1,-1,-1, 0);
+   size_t rb;
+   __m128i a = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub3_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 16) {
+      __m128i raw = _mm_loadu_si128((const __m128i*)row);
+      __m128i d = raw;
+
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 3));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 6));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 12));
+      d = _mm_add_epi8(d, a);
+      a = _mm_shuffle_epi8(d, last);
+
+      _mm_storeu_si128((__m128i*)row, _mm_blendv_epi8(raw, d, keep));
+
+      row += 15;
+      rb  -= 15;
+   }
+   while (rb >= 4) {
+      a = _mm_add_epi8(load4_avx2(row), a);
+      store3_avx2(row, a);
+
+      row += 3;
+      rb  -= 3;
+   }
+   if (rb > 0) {
+      a = _mm_add_epi8(load3_avx2(row), a);
+      store3_avx2(row, a);
+   }
+   PNG_UNUSED(prev)
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_sub4_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* Eight 4-byte pixels per 256-bit vector.  The prefix sum is computed in
+    * each 128-bit lane, then the last pixel of the low lane is carried into the
+    * high lane and the last pixel of the previous block into both.
+    */
+   size_t rb;
+   __m256i a = _mm256_setzero_si256();
+
+   png_debug(1, "in png_read_filter_row_sub4_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 32) {
+      __m256i d = _mm256_loadu_si256((const __m256i*)row);
+
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 4));
+      d = _mm256_add_epi8(d, _mm256_slli_si256(d, 8));
+      d = _mm256_add_epi8(d, _mm256_shuffle_epi32(
+          _mm256_permute2x128_si256(d, d, 0x08), 0xff));
+      d = _mm256_add_epi8(d, a);
+      a = _mm256_permute4x64_epi64(_mm256_shuffle_epi32(d, 0xff), 0xff);
+
+      _mm256_storeu_si256((__m256i*)row, d);
+
+      row += 32;
+      rb  -= 32;
+   }
+   {
+      __m128i a4 = _mm256_castsi256_si128(a);
+
+      while (rb >= 4) {
+         a4 = _mm_add_epi8(load4_avx2(row), a4);
+         store4_avx2(row, a4);
+
+         row += 4;
+         rb  -= 4;
+      }
+   }
+   PNG_UNUSED(prev)
+}
+
+/* Paeth for one pixel held in the low 16-bit lanes of a, b, c and d (the raw
+ * value); returns the reconstructed pixel, also as 16-bit lanes.
+ */
+static PNG_AVX2_TARGET __m128i
+paeth_avx2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+   __m128i pa,pb,pc,smallest,nearest;
+
+   /* (p-a) == (a+b-c - a) == (b-c) */
+   pa = _mm_sub_epi16(b,c);
+
+   /* (p-b) == (a+b-c - b) == (a-c) */
+   pb = _mm_sub_epi16(a,c);
+
+   /* (p-c) == (a+b-c - c) == (a+b-c-c) == (b-c)+(a-c) */
+   pc = _mm_add_epi16(pa,pb);
+
+   pa = _mm_abs_epi16(pa);  /* |p-a| */
+   pb = _mm_abs_epi16(pb);  /* |p-b| */
+   pc = _mm_abs_epi16(pc);  /* |p-c| */
+
+   smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+   /* Paeth breaks ties favoring a over b over c. */
+   nearest  = _mm_blendv_epi8(
+                 _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(smallest, pb)),
+                 a, _mm_cmpeq_epi16(smallest, pa));
+
+   /* Note `_epi8`: we need addition to wrap modulo 255. */
+   return _mm_add_epi8(d, nearest);
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_paeth3_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* The first pixel has no left context, and so uses an Up filter, p = b.
+    * This works naturally with our main loop's p = a+b-c if we force a and c
+    * to zero.
+    */
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth3_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 4) {
+      c = b; b = _mm_cvtepu8_epi16(load4_avx2(prev));
+      a = paeth_avx2(a, b, c, _mm_cvtepu8_epi16(load4_avx2(row)));
+      store3_avx2(row, _mm_packus_epi16(a,a));
+
+      prev += 3;
+      row  += 3;
+      rb   -= 3;
+   }
+   if (rb > 0) {
+      c = b; b = _mm_cvtepu8_epi16(load3_avx2(prev));
+      a = paeth_avx2(a, b, c, _mm_cvtepu8_epi16(load3_avx2(row)));
+      store3_avx2(row, _mm_packus_epi16(a,a));
+   }
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_paeth4_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth4_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 4) {
+      c = b; b = _mm_cvtepu8_epi16(load4_avx2(prev));
+      a = paeth_avx2(a, b, c, _mm_cvtepu8_epi16(load4_avx2(row)));
+      store4_avx2(row, _mm_packus_epi16(a,a));
+
+      prev += 4;
+      row  += 4;
+      rb   -= 4;
+   }
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_paeth6_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth6_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 8) {
+      c = b; b = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)prev));
+      a = paeth_avx2(a, b, c,
+             _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)row)));
+      store6_avx2(row, _mm_packus_epi16(a,a));
+
+      prev += 6;
+      row  += 6;
+      rb   -= 6;
+   }
+   if (rb > 0) {
+      c = b; b = _mm_cvtepu8_epi16(load6_avx2(prev));
+      a = paeth_avx2(a, b, c, _mm_cvtepu8_epi16(load6_avx2(row)));
+      store6_avx2(row, _mm_packus_epi16(a,a));
+   }
+}
+
+PNG_AVX2_TARGET
+void png_read_filter_row_paeth8_avx2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth8_avx2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 8) {
+      c = b; b = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)prev));
+      a = paeth_avx2(a, b, c,
+             _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)row)));
+      _mm_storel_epi64((__m128i*)row, _mm_packus_epi16(a,a));
+
+      prev += 8;
+      row  += 8;
+      rb   -= 8;
+   }
+}
+
+#endif /* READ */
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* Write side filters, as the SSE2 ones in filter_sse2_intrinsics.c but 32
+ * bytes at a time.
+ */
+#define PNG_FILTER_SUM(v) ((v) < 128 ? (v) : 256 - (v))
+
+static PNG_AVX2_TARGET size_t
+sum_abs_i8_avx2(__m256i d)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   __m128i s;
+
+   d = _mm256_sad_epu8(_mm256_abs_epi8(d), zero);
+   s = _mm_add_epi64(_mm256_castsi256_si128(d),
+                     _mm256_extracti128_si256(d, 1));
+   return (size_t)_mm_cvtsi128_si32(s) +
+          (size_t)_mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+}
+
+PNG_AVX2_TARGET
+size_t png_write_filter_row_sub_avx2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_sub_avx2");
+
+   for (i = 0; i < bpp; i++) {
+      unsigned int v = dp[i] = row[i];
+      sum += PNG_FILTER_SUM(v);
+   }
+   for (; i + 32 <= row_bytes; i += 32) {
+      __m256i d = _mm256_sub_epi8(
+         _mm256_loadu_si256((const __m256i*)(row+i)),
+         _mm256_loadu_si256((const __m256i*)(row+i-bpp)));
+      _mm256_storeu_si256((__m256i*)(dp+i), d);
+
+      sum += sum_abs_i8_avx2(d);
+      if (sum > lmins)  /* We are already worse, don't continue. */
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - row[i-bpp]);
+      sum += PNG_FILTER_SUM(v);
+   }
+   PNG_UNUSED(prev)
+   return sum;
+}
+
+PNG_AVX2_TARGET
+size_t png_write_filter_row_up_avx2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_up_avx2");
+
+   for (i = 0; i + 32 <= row_bytes; i += 32) {
+      __m256i d = _mm256_sub_epi8(
+         _mm256_loadu_si256((const __m256i*)(row+i)),
+         _mm256_loadu_si256((const __m256i*)(prev+i)));
+      _mm256_storeu_si256((__m256i*)(dp+i), d);
+
+      sum += sum_abs_i8_avx2(d);
+      if (sum > lmins)
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - prev[i]);
+      sum += PNG_FILTER_SUM(v);
+   }
+   PNG_UNUSED(bpp)
+   return sum;
+}
+
+PNG_AVX2_TARGET
+size_t png_write_filter_row_avg_avx2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_avg_avx2");
+
+   for (i = 0; i < bpp; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - (prev[i] >> 1));
+      sum += PNG_FILTER_SUM(v);
+   }
+   for (; i + 32 <= row_bytes; i += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(row+i-bpp));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(prev+i));
+      __m256i avg, d;
+
+      /* Truncating average, as in the SSE2 code. */
+      avg = _mm256_sub_epi8(_mm256_avg_epu8(a,b),
+         _mm256_and_si256(_mm256_xor_si256(a,b), _mm256_set1_epi8(1)));
+
+      d = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(row+i)), avg);
+      _mm256_storeu_si256((__m256i*)(dp+i), d);
+
+      sum += sum_abs_i8_avx2(d);
+      if (sum > lmins)
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      unsigned int v = dp[i] =
+         (png_byte)(row[i] - ((row[i-bpp] + prev[i]) >> 1));
+      sum += PNG_FILTER_SUM(v);
+   }
+   return sum;
+}
+
+/* The Paeth predictor computed on bytes; see paeth_bytes in
+ * filter_sse2_intrinsics.c.
+ */
+static PNG_AVX2_TARGET __m256i
+paeth_bytes_avx2(__m256i a, __m256i b, __m256i c)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   __m256i pa, pb, pc, same_sign, a_ok, b_ok;
+
+   pa = _mm256_or_si256(_mm256_subs_epu8(b, c), _mm256_subs_epu8(c, b));
+   pb = _mm256_or_si256(_mm256_subs_epu8(a, c), _mm256_subs_epu8(c, a));
+
+   same_sign = _mm256_cmpeq_epi8(
+      _mm256_cmpeq_epi8(_mm256_subs_epu8(c, b), zero),
+      _mm256_cmpeq_epi8(_mm256_subs_epu8(c, a), zero));
+
+   pc = _mm256_blendv_epi8(
+      _mm256_or_si256(_mm256_subs_epu8(pa, pb), _mm256_subs_epu8(pb, pa)),
+      _mm256_adds_epu8(pa, pb), same_sign);
+
+   a_ok = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(pa, pb), pa),
+                           _mm256_cmpeq_epi8(_mm256_min_epu8(pa, pc), pa));
+   b_ok = _mm256_cmpeq_epi8(_mm256_min_epu8(pb, pc), pb);
+
+   return _mm256_blendv_epi8(_mm256_blendv_epi8(c, b, b_ok), a, a_ok);
+}
+
+PNG_AVX2_TARGET
+size_t png_write_filter_row_paeth_avx2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_paeth_avx2");
+
+   for (i = 0; i < bpp; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - prev[i]);
+      sum += PNG_FILTER_SUM(v);
+   }
+   for (; i + 32 <= row_bytes; i += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(row+i-bpp));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(prev+i));
+      __m256i c = _mm256_loadu_si256((const __m256i*)(prev+i-bpp));
+      __m256i p, d;
+
+      p = paeth_bytes_avx2(a, b, c);
+
+      d = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(row+i)), p);
+      _mm256_storeu_si256((__m256i*)(dp+i), d);
+
+      sum += sum_abs_i8_avx2(d);
+      if (sum > lmins)
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      int a = row[i-bpp], b = prev[i], c = prev[i-bpp];
+      int pa = b - c, pb = a - c, pc = pa + pb;
+      unsigned int v;
+
+      pa = pa < 0 ? -pa : pa;
+      pb = pb < 0 ? -pb : pb;
+      pc = pc < 0 ? -pc : pc;
+
+      v = dp[i] = (png_byte)(row[i] -
+         ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c));
+      sum += PNG_FILTER_SUM(v);
+   }
+   return sum;
+}
+
+/* As filter_sums_byte in filter_sse2_intrinsics.c */
+static void
+filter_sums_byte_avx2(size_t *sums, int r, int a, int b, int c)
+{
+   int pa = b - c, pb = a - c, pc = pa + pb;
+   unsigned int v;
+
+   pa = pa < 0 ? -pa : pa;
+   pb = pb < 0 ? -pb : pb;
+   pc = pc < 0 ? -pc : pc;
+
+   v = r & 0xff;
+   sums[PNG_FILTER_VALUE_NONE] += PNG_FILTER_SUM(v);
+   v = (r - a) & 0xff;
+   sums[PNG_FILTER_VALUE_SUB] += PNG_FILTER_SUM(v);
+   v = (r - b) & 0xff;
+   sums[PNG_FILTER_VALUE_UP] += PNG_FILTER_SUM(v);
+   v = (r - ((a + b) >> 1)) & 0xff;
+   sums[PNG_FILTER_VALUE_AVG] += PNG_FILTER_SUM(v);
+   v = (r - ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c)) & 0xff;
+   sums[PNG_FILTER_VALUE_PAETH] += PNG_FILTER_SUM(v);
+}
+
+static PNG_AVX2_TARGET __m256i
+sad_i8_avx2(__m256i d)
+{
+   return _mm256_sad_epu8(_mm256_abs_epi8(d), _mm256_setzero_si256());
+}
+
+static PNG_AVX2_TARGET void
+add_sad_avx2(size_t *sum, __m256i s)
+{
+   __m128i t = _mm_add_epi64(_mm256_castsi256_si128(s),
+                             _mm256_extracti128_si256(s, 1));
+
+   *sum += (size_t)(png_uint_32)_mm_cvtsi128_si32(t) +
+           (size_t)(png_uint_32)_mm_cvtsi128_si32(_mm_srli_si128(t, 8));
+}
+
+PNG_AVX2_TARGET
+void png_write_filter_sums_avx2(png_const_bytep row, png_const_bytep prev,
+   size_t row_bytes, unsigned int bpp, size_t *sums)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   size_t i;
+   int f;
+
+   png_debug(1, "in png_write_filter_sums_avx2");
+
+   for (f = 0; f < PNG_FILTER_VALUE_LAST; f++)
+      sums[f] = 0;
+
+   for (i = 0; i < bpp; i++)
+      filter_sums_byte_avx2(sums, row[i], 0, prev[i], 0);
+
+   /* Blocks of 1MB keep the accumulators within 32 bits. */
+   while (i + 32 <= row_bytes)
+   {
+      size_t end = row_bytes - i > 0x100000 ? i + 0x100000 : row_bytes;
+      __m256i s0 = zero, s1 = zero, s2 = zero, s3 = zero, s4 = zero;
+
+      for (; i + 32 <= end; i += 32)
+      {
+         __m256i r = _mm256_loadu_si256((const __m256i*)(row+i));
+         __m256i a = _mm256_loadu_si256((const __m256i*)(row+i-bpp));
+         __m256i b = _mm256_loadu_si256((const __m256i*)(prev+i));
+         __m256i c = _mm256_loadu_si256((const __m256i*)(prev+i-bpp));
+         __m256i avg, p;
+
+         avg = _mm256_sub_epi8(_mm256_avg_epu8(a,b),
+            _mm256_and_si256(_mm256_xor_si256(a,b), _mm256_set1_epi8(1)));
+
+         p = paeth_bytes_avx2(a, b, c);
+
+         s0 = _mm256_add_epi64(s0, sad_i8_avx2(r));
+         s1 = _mm256_add_epi64(s1, sad_i8_avx2(_mm256_sub_epi8(r, a)));
+         s2 = _mm256_add_epi64(s2, sad_i8_avx2(_mm256_sub_epi8(r, b)));
+         s3 = _mm256_add_epi64(s3, sad_i8_avx2(_mm256_sub_epi8(r, avg)));
+         s4 = _mm256_add_epi64(s4, sad_i8_avx2(_mm256_sub_epi8(r, p)));
+      }
+
+      add_sad_avx2(sums + PNG_FILTER_VALUE_NONE, s0);
+      add_sad_avx2(sums + PNG_FILTER_VALUE_SUB, s1);
+      add_sad_avx2(sums + PNG_FILTER_VALUE_UP, s2);
+      add_sad_avx2(sums + PNG_FILTER_VALUE_AVG, s3);
+      add_sad_avx2(sums + PNG_FILTER_VALUE_PAETH, s4);
+   }
+
+   for (; i < row_bytes; i++)
+      filter_sums_byte_avx2(sums, row[i], row[i-bpp], prev[i], prev[i-bpp]);
+}
+#endif /* WRITE_FILTER */
+
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+#endif /* READ || WRITE_FILTER */
@@ -13,7 +13,7 @@
 
 #include "../pngpriv.h"
 
-#ifdef PNG_READ_SUPPORTED
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_FILTER_SUPPORTED)
 
 #if PNG_INTEL_SSE_IMPLEMENTATION > 0
 
@@ -27,6 +27,35 @@
  * whichever of a, b, or c is closest to p=a+b-c.
  */
 
+/* Returns |x| for 16-bit lanes. */
+static __m128i abs_i16(__m128i x) {
+#if PNG_INTEL_SSE_IMPLEMENTATION >= 2
+   return _mm_abs_epi16(x);
+#else
+   /* Read this all as, return x<0 ? -x : x.
+   * To negate two's complement, you flip all the bits then add 1.
+    */
+   __m128i is_negative = _mm_cmplt_epi16(x, _mm_setzero_si128());
+
+   /* Flip negative lanes. */
+   x = _mm_xor_si128(x, is_negative);
+
+   /* +1 to negative lanes, else +0. */
+   x = _mm_sub_epi16(x, is_negative);
+   return x;
+#endif
+}
+
+/* Bytewise c ? t : e. */
+static __m128i if_then_else(__m128i c, __m128i t, __m128i e) {
+#if PNG_INTEL_SSE_IMPLEMENTATION >= 3
+   return _mm_blendv_epi8(e,t,c);
+#else
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+#endif
+}
+
+#ifdef PNG_READ_SUPPORTED
 static __m128i load4(const void* p) {
    int tmp;
    memcpy(&tmp, p, sizeof(tmp));
@@ -49,6 +78,117 @@ static void store3(void* p, __m128i v) {
    memcpy(p, &tmp, 3);
 }
 
+static __m128i load2(const void* p) {
+   png_uint_16 tmp;
+   memcpy(&tmp, p, sizeof(tmp));
+   return _mm_cvtsi32_si128(tmp);
+}
+
+static void store2(void* p, __m128i v) {
+   png_uint_16 tmp = (png_uint_16)_mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, sizeof(tmp));
+}
+
+static __m128i load8(const void* p) {
+   return _mm_loadl_epi64((const __m128i*)p);
+}
+
+static void store8(void* p, __m128i v) {
+   _mm_storel_epi64((__m128i*)p, v);
+}
+
+static __m128i load6(const void* p) {
+   png_byte tmp[8] = {0};
+   memcpy(tmp, p, 6);
+   return _mm_loadl_epi64((const __m128i*)tmp);
+}
+
+static void store6(void* p, __m128i v) {
+   png_byte tmp[8];
+   _mm_storel_epi64((__m128i*)tmp, v);
+   memcpy(p, tmp, 6);
+}
+
+void png_read_filter_row_sub1_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* With 1 and 2 byte pixels a vector holds 16 or 8 pixels.  Rather than work
+    * a pixel at a time the Sub filter is reversed with a prefix sum: shifting
+    * by 1, 2, 4 and 8 pixels and adding leaves each byte holding the sum of
+    * itself and all the bytes before it in the vector, then the last value
+    * reconstructed in the previous block is added in.
+    */
+   size_t rb;
+
+   __m128i d, a = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub1_sse2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 16) {
+      d = _mm_loadu_si128((const __m128i*)row);
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+      d = _mm_add_epi8(d, a);
+
+      /* Broadcast byte 15 to all the bytes. */
+      a = _mm_unpackhi_epi8(d, d);
+      a = _mm_shuffle_epi32(_mm_shufflehi_epi16(a, 0xff), 0xff);
+
+      _mm_storeu_si128((__m128i*)row, d);
+
+      row += 16;
+      rb  -= 16;
+   }
+   if (rb > 0) {
+      png_byte last = (png_byte)_mm_cvtsi128_si32(a);
+
+      while (rb > 0) {
+         last = (png_byte)(*row + last);
+         *row++ = last;
+         rb--;
+      }
+   }
+   PNG_UNUSED(prev)
+}
+
+void png_read_filter_row_sub2_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+
+   __m128i d, a = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub2_sse2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 16) {
+      d = _mm_loadu_si128((const __m128i*)row);
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+      d = _mm_add_epi8(d, a);
+
+      /* Broadcast the last pixel (16-bit lane 7) to all the pixels. */
+      a = _mm_shuffle_epi32(_mm_shufflehi_epi16(d, 0xff), 0xff);
+
+      _mm_storeu_si128((__m128i*)row, d);
+
+      row += 16;
+      rb  -= 16;
+   }
+   while (rb >= 2) {
+      a = _mm_add_epi8(load2(row), a);
+      store2(row, a);
+
+      row += 2;
+      rb  -= 2;
+   }
+   PNG_UNUSED(prev)
+}
+
 void png_read_filter_row_sub3_sse2(png_row_infop row_info, png_bytep row,
    png_const_bytep prev)
 {
@@ -107,6 +247,107 @@ void png_read_filter_row_sub4_sse2(png_row_infop row_info, png_bytep row,
    PNG_UNUSED(prev)
 }
 
+void png_read_filter_row_sub6_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* 6 and 8 byte pixels are 16-bit RGB and RGBA; the byte-wise arithmetic is
+    * exactly the same as for the 8-bit formats, the vectors are just wider.
+    */
+   size_t rb;
+
+   __m128i a, d = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub6_sse2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 8) {
+      a = d; d = load8(row);
+      d = _mm_add_epi8(d, a);
+      store6(row, d);
+
+      row += 6;
+      rb  -= 6;
+   }
+   if (rb > 0) {
+      a = d; d = load6(row);
+      d = _mm_add_epi8(d, a);
+      store6(row, d);
+
+      row += 6;
+      rb  -= 6;
+   }
+   PNG_UNUSED(prev)
+}
+
+void png_read_filter_row_sub8_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* Two pixels fit in a vector, so the second pixel can be reconstructed at
+    * the same time as the first by adding in the (raw) first pixel.
+    */
+   size_t rb;
+
+   __m128i d, a = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub8_sse2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 16) {
+      d = _mm_loadu_si128((const __m128i*)row);
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+      d = _mm_add_epi8(d, a);
+      a = _mm_unpackhi_epi64(d, d);
+      _mm_storeu_si128((__m128i*)row, d);
+
+      row += 16;
+      rb  -= 16;
+   }
+   if (rb > 0) {
+      d = _mm_add_epi8(load8(row), a);
+      store8(row, d);
+
+      row += 8;
+      rb  -= 8;
+   }
+   PNG_UNUSED(prev)
+}
+
+void png_read_filter_row_avg2_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* Avg and Paeth cannot be reversed with a prefix sum because each pixel
+    * depends on the (truncated) value reconstructed for the one before, so the
+    * 2 byte versions work a pixel at a time like the 3 and 4 byte ones.  There
+    * would be no benefit in doing this for 1 byte pixels.
+    */
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i    b;
+   __m128i a, d = zero;
+
+   png_debug(1, "in png_read_filter_row_avg2_sse2");
+
+   rb = row_info->rowbytes+2;
+   while (rb > 2) {
+      __m128i avg;
+             b = load2(prev);
+      a = d; d = load2(row );
+
+      /* PNG requires a truncating average, so we can't just use _mm_avg_epu8 */
+      avg = _mm_avg_epu8(a,b);
+      /* ...but we can fix it up by subtracting off 1 if it rounded up. */
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a,b),
+                                            _mm_set1_epi8(1)));
+
+      d = _mm_add_epi8(d, avg);
+      store2(row, d);
+
+      prev += 2;
+      row  += 2;
+      rb   -= 2;
+   }
+}
+
 void png_read_filter_row_avg3_sse2(png_row_infop row_info, png_bytep row,
    png_const_bytep prev)
 {
@@ -198,32 +439,81 @@ void png_read_filter_row_avg4_sse2(png_row_infop row_info, png_bytep row,
    }
 }
 
-/* Returns |x| for 16-bit lanes. */
-static __m128i abs_i16(__m128i x) {
-#if PNG_INTEL_SSE_IMPLEMENTATION >= 2
-   return _mm_abs_epi16(x);
-#else
-   /* Read this all as, return x<0 ? -x : x.
-   * To negate two's complement, you flip all the bits then add 1.
-    */
-   __m128i is_negative = _mm_cmplt_epi16(x, _mm_setzero_si128());
+void png_read_filter_row_avg6_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i    b;
+   __m128i a, d = zero;
 
-   /* Flip negative lanes. */
-   x = _mm_xor_si128(x, is_negative);
+   png_debug(1, "in png_read_filter_row_avg6_sse2");
 
-   /* +1 to negative lanes, else +0. */
-   x = _mm_sub_epi16(x, is_negative);
-   return x;
-#endif
+   rb = row_info->rowbytes;
+   while (rb >= 8) {
+      __m128i avg;
+             b = load8(prev);
+      a = d; d = load8(row );
+
+      /* PNG requires a truncating average, so we can't just use _mm_avg_epu8 */
+      avg = _mm_avg_epu8(a,b);
+      /* ...but we can fix it up by subtracting off 1 if it rounded up. */
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a,b),
+                                            _mm_set1_epi8(1)));
+      d = _mm_add_epi8(d, avg);
+      store6(row, d);
+
+      prev += 6;
+      row  += 6;
+      rb   -= 6;
+   }
+   if (rb > 0) {
+      __m128i avg;
+             b = load6(prev);
+      a = d; d = load6(row );
+
+      /* PNG requires a truncating average, so we can't just use _mm_avg_epu8 */
+      avg = _mm_avg_epu8(a,b);
+      /* ...but we can fix it up by subtracting off 1 if it rounded up. */
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a,b),
+                                            _mm_set1_epi8(1)));
+      d = _mm_add_epi8(d, avg);
+      store6(row, d);
+
+      prev += 6;
+      row  += 6;
+      rb   -= 6;
+   }
 }
 
-/* Bytewise c ? t : e. */
-static __m128i if_then_else(__m128i c, __m128i t, __m128i e) {
-#if PNG_INTEL_SSE_IMPLEMENTATION >= 3
-   return _mm_blendv_epi8(e,t,c);
-#else
-   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
-#endif
+void png_read_filter_row_avg8_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i    b;
+   __m128i a, d = zero;
+
+   png_debug(1, "in png_read_filter_row_avg8_sse2");
+
+   rb = row_info->rowbytes+8;
+   while (rb > 8) {
+      __m128i avg;
+             b = load8(prev);
+      a = d; d = load8(row );
+
+      /* PNG requires a truncating average, so we can't just use _mm_avg_epu8 */
+      avg = _mm_avg_epu8(a,b);
+      /* ...but we can fix it up by subtracting off 1 if it rounded up. */
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a,b),
+                                            _mm_set1_epi8(1)));
+      d = _mm_add_epi8(d, avg);
+      store8(row, d);
+
+      prev += 8;
+      row  += 8;
+      rb   -= 8;
+   }
 }
 
 void png_read_filter_row_paeth3_sse2(png_row_infop row_info, png_bytep row,
@@ -387,5 +677,391 @@ void png_read_filter_row_paeth4_sse2(png_row_infop row_info, png_bytep row,
    }
 }
 
-#endif /* PNG_INTEL_SSE_IMPLEMENTATION > 0 */
+/* The Paeth predictor for one pixel of up to 8 bytes, unpacked to 16-bit lanes
+ * in a, b, c and d (the filtered value); returns the reconstructed pixel, still
+ * unpacked, ready to be the next 'a'.
+ */
+static __m128i paeth_predict(__m128i a, __m128i b, __m128i c, __m128i d) {
+   __m128i pa,pb,pc,smallest,nearest;
+
+   /* (p-a) == (a+b-c - a) == (b-c) */
+   pa = _mm_sub_epi16(b,c);
+
+   /* (p-b) == (a+b-c - b) == (a-c) */
+   pb = _mm_sub_epi16(a,c);
+
+   /* (p-c) == (a+b-c - c) == (a+b-c-c) == (b-c)+(a-c) */
+   pc = _mm_add_epi16(pa,pb);
+
+   pa = abs_i16(pa);  /* |p-a| */
+   pb = abs_i16(pb);  /* |p-b| */
+   pc = abs_i16(pc);  /* |p-c| */
+
+   smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+   /* Paeth breaks ties favoring a over b over c. */
+   nearest  = if_then_else(_mm_cmpeq_epi16(smallest, pa), a,
+                      if_then_else(_mm_cmpeq_epi16(smallest, pb), b,
+                                                                  c));
+
+   /* Note `_epi8`: we need addition to wrap modulo 255. */
+   return _mm_add_epi8(d, nearest);
+}
+
+void png_read_filter_row_paeth2_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth2_sse2");
+
+   rb = row_info->rowbytes+2;
+   while (rb > 2) {
+      c = b; b = _mm_unpacklo_epi8(load2(prev), zero);
+      a = paeth_predict(a, b, c, _mm_unpacklo_epi8(load2(row), zero));
+      store2(row, _mm_packus_epi16(a,a));
+
+      prev += 2;
+      row  += 2;
+      rb   -= 2;
+   }
+}
+
+void png_read_filter_row_paeth6_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* As paeth3 and paeth4 above; a 6 or 8 byte pixel unpacked to 16 bits still
+    * fits in a single vector.
+    */
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth6_sse2");
+
+   rb = row_info->rowbytes;
+   while (rb >= 8) {
+      c = b; b = _mm_unpacklo_epi8(load8(prev), zero);
+      a = paeth_predict(a, b, c, _mm_unpacklo_epi8(load8(row), zero));
+      store6(row, _mm_packus_epi16(a,a));
+
+      prev += 6;
+      row  += 6;
+      rb   -= 6;
+   }
+   if (rb > 0) {
+      c = b; b = _mm_unpacklo_epi8(load6(prev), zero);
+      a = paeth_predict(a, b, c, _mm_unpacklo_epi8(load6(row), zero));
+      store6(row, _mm_packus_epi16(a,a));
+   }
+}
+
+void png_read_filter_row_paeth8_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   size_t rb;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth8_sse2");
+
+   rb = row_info->rowbytes+8;
+   while (rb > 8) {
+      c = b; b = _mm_unpacklo_epi8(load8(prev), zero);
+      a = paeth_predict(a, b, c, _mm_unpacklo_epi8(load8(row), zero));
+      store8(row, _mm_packus_epi16(a,a));
+
+      prev += 8;
+      row  += 8;
+      rb   -= 8;
+   }
+}
+
 #endif /* READ */
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* The write side filters are computed from the original, unfiltered, rows so
+ * unlike reading there is no dependency between pixels and all four filters
+ * can be computed 16 bytes at a time for any pixel size.  Each function writes
+ * the filtered row to 'dp' and returns the sum of the absolute values of the
+ * filtered bytes (taken as signed), the "minimum sum of absolute differences"
+ * heuristic used by png_write_find_filter.  Like the C code the functions stop
+ * early once the sum exceeds lmins, since the filter will not be chosen.
+ */
+#define PNG_FILTER_SUM(v) ((v) < 128 ? (v) : 256 - (v))
+
+/* The sum, as above, of the 16 bytes of d. */
+static size_t sum_abs_i8(__m128i d) {
+   const __m128i zero = _mm_setzero_si128();
+
+   /* |d| for signed bytes is min(d, -d) for unsigned ones; the two halves of
+    * the result of _mm_sad_epu8 are 16-bit sums.
+    */
+   d = _mm_sad_epu8(_mm_min_epu8(d, _mm_sub_epi8(zero, d)), zero);
+   return (size_t)_mm_cvtsi128_si32(d) +
+          (size_t)_mm_cvtsi128_si32(_mm_srli_si128(d, 8));
+}
+
+size_t png_write_filter_row_sub_sse2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_sub_sse2");
+
+   for (i = 0; i < bpp; i++) {
+      unsigned int v = dp[i] = row[i];
+      sum += PNG_FILTER_SUM(v);
+   }
+   for (; i + 16 <= row_bytes; i += 16) {
+      __m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(row+i)),
+                               _mm_loadu_si128((const __m128i*)(row+i-bpp)));
+      _mm_storeu_si128((__m128i*)(dp+i), d);
+
+      sum += sum_abs_i8(d);
+      if (sum > lmins)  /* We are already worse, don't continue. */
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - row[i-bpp]);
+      sum += PNG_FILTER_SUM(v);
+   }
+   PNG_UNUSED(prev)
+   return sum;
+}
+
+size_t png_write_filter_row_up_sse2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_up_sse2");
+
+   for (i = 0; i + 16 <= row_bytes; i += 16) {
+      __m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(row+i)),
+                               _mm_loadu_si128((const __m128i*)(prev+i)));
+      _mm_storeu_si128((__m128i*)(dp+i), d);
+
+      sum += sum_abs_i8(d);
+      if (sum > lmins)
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - prev[i]);
+      sum += PNG_FILTER_SUM(v);
+   }
+   PNG_UNUSED(bpp)
+   return sum;
+}
+
+size_t png_write_filter_row_avg_sse2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_avg_sse2");
+
+   for (i = 0; i < bpp; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - (prev[i] >> 1));
+      sum += PNG_FILTER_SUM(v);
+   }
+   for (; i + 16 <= row_bytes; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(row+i-bpp));
+      __m128i b = _mm_loadu_si128((const __m128i*)(prev+i));
+      __m128i avg, d;
+
+      /* PNG requires a truncating average, so we can't just use _mm_avg_epu8 */
+      avg = _mm_avg_epu8(a,b);
+      /* ...but we can fix it up by subtracting off 1 if it rounded up. */
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a,b),
+                                            _mm_set1_epi8(1)));
+
+      d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(row+i)), avg);
+      _mm_storeu_si128((__m128i*)(dp+i), d);
+
+      sum += sum_abs_i8(d);
+      if (sum > lmins)
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      unsigned int v = dp[i] =
+         (png_byte)(row[i] - ((row[i-bpp] + prev[i]) >> 1));
+      sum += PNG_FILTER_SUM(v);
+   }
+   return sum;
+}
+
+/* The Paeth predictor computed on bytes.  pa = |b-c| and pb = |a-c| fit in a
+ * byte and pc = |(b-c) + (a-c)| is pa+pb when the two differences have the
+ * same sign, otherwise |pa-pb|.  When pa+pb overflows it saturates to 255,
+ * which still leaves pc >= pa and pc >= pb, so the choice is unchanged.
+ */
+static __m128i paeth_bytes(__m128i a, __m128i b, __m128i c) {
+   const __m128i zero = _mm_setzero_si128();
+   __m128i pa, pb, pc, same_sign, a_ok, b_ok;
+
+   pa = _mm_or_si128(_mm_subs_epu8(b, c), _mm_subs_epu8(c, b));
+   pb = _mm_or_si128(_mm_subs_epu8(a, c), _mm_subs_epu8(c, a));
+
+   /* b >= c and a >= c, bytewise */
+   same_sign = _mm_cmpeq_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(c, b), zero),
+                              _mm_cmpeq_epi8(_mm_subs_epu8(c, a), zero));
+
+   pc = if_then_else(same_sign, _mm_adds_epu8(pa, pb),
+      _mm_or_si128(_mm_subs_epu8(pa, pb), _mm_subs_epu8(pb, pa)));
+
+   /* x <= y is min(x,y) == x.  Paeth breaks ties favoring a over b over c. */
+   a_ok = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(pa, pb), pa),
+                        _mm_cmpeq_epi8(_mm_min_epu8(pa, pc), pa));
+   b_ok = _mm_cmpeq_epi8(_mm_min_epu8(pb, pc), pb);
+
+   return if_then_else(a_ok, a, if_then_else(b_ok, b, c));
+}
+
+size_t png_write_filter_row_paeth_sse2(png_const_bytep row,
+   png_const_bytep prev, png_bytep dp, size_t row_bytes, unsigned int bpp,
+   size_t lmins)
+{
+   size_t i, sum = 0;
+
+   png_debug(1, "in png_write_filter_row_paeth_sse2");
+
+   for (i = 0; i < bpp; i++) {
+      unsigned int v = dp[i] = (png_byte)(row[i] - prev[i]);
+      sum += PNG_FILTER_SUM(v);
+   }
+   for (; i + 16 <= row_bytes; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(row+i-bpp));
+      __m128i b = _mm_loadu_si128((const __m128i*)(prev+i));
+      __m128i c = _mm_loadu_si128((const __m128i*)(prev+i-bpp));
+      __m128i p, d;
+
+      p = paeth_bytes(a, b, c);
+
+      d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(row+i)), p);
+      _mm_storeu_si128((__m128i*)(dp+i), d);
+
+      sum += sum_abs_i8(d);
+      if (sum > lmins)
+         return sum;
+   }
+   for (; i < row_bytes; i++) {
+      int a = row[i-bpp], b = prev[i], c = prev[i-bpp];
+      int pa = b - c, pb = a - c, pc = pa + pb;
+      unsigned int v;
+
+      pa = pa < 0 ? -pa : pa;
+      pb = pb < 0 ? -pb : pb;
+      pc = pc < 0 ? -pc : pc;
+
+      v = dp[i] = (png_byte)(row[i] -
+         ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c));
+      sum += PNG_FILTER_SUM(v);
+   }
+   return sum;
+}
+
+/* Add the contribution of one byte, r, to each of the five filter sums given
+ * its neighbours a (left), b (above) and c (above left).
+ */
+static void filter_sums_byte(size_t *sums, int r, int a, int b, int c) {
+   int pa = b - c, pb = a - c, pc = pa + pb;
+   unsigned int v;
+
+   pa = pa < 0 ? -pa : pa;
+   pb = pb < 0 ? -pb : pb;
+   pc = pc < 0 ? -pc : pc;
+
+   v = r & 0xff;
+   sums[PNG_FILTER_VALUE_NONE] += PNG_FILTER_SUM(v);
+   v = (r - a) & 0xff;
+   sums[PNG_FILTER_VALUE_SUB] += PNG_FILTER_SUM(v);
+   v = (r - b) & 0xff;
+   sums[PNG_FILTER_VALUE_UP] += PNG_FILTER_SUM(v);
+   v = (r - ((a + b) >> 1)) & 0xff;
+   sums[PNG_FILTER_VALUE_AVG] += PNG_FILTER_SUM(v);
+   v = (r - ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c)) & 0xff;
+   sums[PNG_FILTER_VALUE_PAETH] += PNG_FILTER_SUM(v);
+}
+
+/* The sum of the absolute values of the signed bytes of d, as two 64-bit
+ * lanes.
+ */
+static __m128i sad_i8(__m128i d) {
+   const __m128i zero = _mm_setzero_si128();
+   return _mm_sad_epu8(_mm_min_epu8(d, _mm_sub_epi8(zero, d)), zero);
+}
+
+static void add_sad(size_t *sum, __m128i s) {
+   *sum += (size_t)(png_uint_32)_mm_cvtsi128_si32(s) +
+           (size_t)(png_uint_32)_mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+}
+
+/* Compute the sums for all five filters in one pass over the row, without
+ * storing any filtered bytes; the caller then only needs to filter the row
+ * with the filter it chooses.
+ */
+void png_write_filter_sums_sse2(png_const_bytep row, png_const_bytep prev,
+   size_t row_bytes, unsigned int bpp, size_t *sums)
+{
+   const __m128i zero = _mm_setzero_si128();
+   size_t i;
+   int f;
+
+   png_debug(1, "in png_write_filter_sums_sse2");
+
+   for (f = 0; f < PNG_FILTER_VALUE_LAST; f++)
+      sums[f] = 0;
+
+   for (i = 0; i < bpp; i++)
+      filter_sums_byte(sums, row[i], 0, prev[i], 0);
+
+   /* The 64-bit lanes of the accumulators are read as 32-bit values, which
+    * can't overflow in 64K vectors, so the row is done in blocks of 1MB.
+    */
+   while (i + 16 <= row_bytes) {
+      size_t end = row_bytes - i > 0x100000 ? i + 0x100000 : row_bytes;
+      __m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero, s4 = zero;
+
+      for (; i + 16 <= end; i += 16) {
+         __m128i r = _mm_loadu_si128((const __m128i*)(row+i));
+         __m128i a = _mm_loadu_si128((const __m128i*)(row+i-bpp));
+         __m128i b = _mm_loadu_si128((const __m128i*)(prev+i));
+         __m128i c = _mm_loadu_si128((const __m128i*)(prev+i-bpp));
+         __m128i avg, p;
+
+         /* Truncating average, as in png_write_filter_row_avg_sse2. */
+         avg = _mm_sub_epi8(_mm_avg_epu8(a,b),
+            _mm_and_si128(_mm_xor_si128(a,b), _mm_set1_epi8(1)));
+
+         p = paeth_bytes(a, b, c);
+
+         s0 = _mm_add_epi64(s0, sad_i8(r));
+         s1 = _mm_add_epi64(s1, sad_i8(_mm_sub_epi8(r, a)));
+         s2 = _mm_add_epi64(s2, sad_i8(_mm_sub_epi8(r, b)));
+         s3 = _mm_add_epi64(s3, sad_i8(_mm_sub_epi8(r, avg)));
+         s4 = _mm_add_epi64(s4, sad_i8(_mm_sub_epi8(r, p)));
+      }
+
+      add_sad(sums + PNG_FILTER_VALUE_NONE, s0);
+      add_sad(sums + PNG_FILTER_VALUE_SUB, s1);
+      add_sad(sums + PNG_FILTER_VALUE_UP, s2);
+      add_sad(sums + PNG_FILTER_VALUE_AVG, s3);
+      add_sad(sums + PNG_FILTER_VALUE_PAETH, s4);
+   }
+
+   for (; i < row_bytes; i++)
+      filter_sums_byte(sums, row[i], row[i-bpp], prev[i], prev[i-bpp]);
+}
+#endif /* WRITE_FILTER */
+
+#endif /* PNG_INTEL_SSE_IMPLEMENTATION > 0 */
+#endif /* READ || WRITE_FILTER */
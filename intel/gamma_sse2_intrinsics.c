@@ -0,0 +1,1070 @@
+/* gamma_sse2_intrinsics.c - SSE2 and AVX2 gamma correction, compositing and
+ *                           conversion to gray
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_GAMMA_SUPPORTED
+
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0
+
+#include <immintrin.h>
+
+/* The AVX2 functions are compiled for AVX2 regardless of the flags used for
+ * the rest of libpng; png_init_gamma_functions_sse2 only installs them after
+ * checking the CPU.
+ */
+#if PNG_INTEL_AVX2_OPT > 0
+#  if defined(__GNUC__) || defined(__clang__)
+#     define PNG_AVX2_TARGET __attribute__((target("avx2")))
+#  else
+#     define PNG_AVX2_TARGET
+#  endif
+#endif
+
+/* The gamma functions correct every byte or sample of the row then put the
+ * alpha channel back.  Return the number of bytes in each pixel that are not
+ * alpha, with the size of the pixel in *pixel_bytes, or 0 for the formats that
+ * are left to png_do_gamma.
+ */
+static unsigned int
+png_gamma_layout(png_row_infop row_info, unsigned int *pixel_bytes)
+{
+   unsigned int sample_bytes = row_info->bit_depth >> 3;
+
+   *pixel_bytes = sample_bytes * row_info->channels;
+
+   switch (row_info->color_type)
+   {
+      case PNG_COLOR_TYPE_GRAY:
+      case PNG_COLOR_TYPE_RGB:
+         return *pixel_bytes;
+
+      case PNG_COLOR_TYPE_GRAY_ALPHA:
+      case PNG_COLOR_TYPE_RGB_ALPHA:
+         return *pixel_bytes - sample_bytes;
+
+      default:
+         return 0;
+   }
+}
+
+/* A vector with 0xff in the alpha bytes, which repeats for the pixel sizes with
+ * alpha: 2, 4 and 8 bytes.
+ */
+static __m128i
+png_gamma_alpha_mask(unsigned int pixel_bytes, unsigned int color_bytes)
+{
+   png_byte mask[16];
+   unsigned int i;
+
+   for (i = 0; i < 16; ++i)
+      mask[i] = (png_byte)(i % pixel_bytes < color_bytes ? 0 : 0xff);
+
+   return _mm_loadu_si128((const __m128i*)mask);
+}
+
+#if PNG_INTEL_AVX2_OPT > 0
+/* 8-bit samples: the table is widened to 32 bits so that the lookups can be
+ * done with gathers, eight at a time.  The results are packed back to bytes,
+ * which puts them in the order of the 64-bit parts 0, 2, 4, 6, 1, 3, 5, 7,
+ * undone by the final permute.
+ */
+static void
+png_lookup_init_avx2(int wide[256], png_const_bytep table)
+{
+   int i;
+
+   for (i = 0; i < 256; ++i)
+      wide[i] = table[i];
+}
+
+static __m256i PNG_AVX2_TARGET
+png_lookup_avx2(const int wide[256], __m256i x)
+{
+   __m128i lo = _mm256_castsi256_si128(x);
+   __m128i hi = _mm256_extracti128_si256(x, 1);
+
+   return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(
+       _mm256_packus_epi32(
+       _mm256_i32gather_epi32(wide, _mm256_cvtepu8_epi32(lo), 4),
+       _mm256_i32gather_epi32(wide, _mm256_cvtepu8_epi32(
+       _mm_srli_si128(lo, 8)), 4)),
+       _mm256_packus_epi32(
+       _mm256_i32gather_epi32(wide, _mm256_cvtepu8_epi32(hi), 4),
+       _mm256_i32gather_epi32(wide, _mm256_cvtepu8_epi32(
+       _mm_srli_si128(hi, 8)), 4))),
+       _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+int PNG_AVX2_TARGET
+png_do_gamma_avx2(png_structrp png_ptr, png_row_infop row_info, png_bytep row)
+{
+   png_const_bytep gamma_table = png_ptr->gamma_table;
+   unsigned int pixel_bytes, color_bytes;
+   size_t rowbytes = row_info->rowbytes;
+   size_t n;
+   int wide[256];
+   __m256i alpha;
+
+   if (row_info->bit_depth != 8 || gamma_table == NULL)
+      return 0;
+
+   color_bytes = png_gamma_layout(row_info, &pixel_bytes);
+   if (color_bytes == 0)
+      return 0;
+
+   png_lookup_init_avx2(wide, gamma_table);
+   alpha = _mm256_broadcastsi128_si256(png_gamma_alpha_mask(pixel_bytes,
+       color_bytes));
+
+   for (n = 0; n + 32 <= rowbytes; n += 32)
+   {
+      __m256i x = _mm256_loadu_si256((const __m256i*)(row + n));
+
+      _mm256_storeu_si256((__m256i*)(row + n), _mm256_blendv_epi8(
+          png_lookup_avx2(wide, x), x, alpha));
+   }
+
+   for (; n < rowbytes; ++n)
+      if (n % pixel_bytes < color_bytes)
+         row[n] = gamma_table[row[n]];
+
+   return 1;
+}
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+
+#ifdef PNG_READ_16BIT_SUPPORTED
+/* 16-bit samples, approximately: this calculates the value that
+ * png_build_16bit_table puts in gamma_16_table in single precision instead of
+ * looking it up,
+ *
+ *    65535 * pow((v >> gamma_shift) / max, exponent)
+ *
+ * as exp2(exponent * log2(x)).  log2 of the mantissa, reduced to
+ * [sqrt(.5), sqrt(2)), uses the series for 2*atanh((m-1)/(m+1)) and exp2 of
+ * the fraction, reduced to [-.5, .5], the series for exp.  The error from the
+ * series is below 1E-7 and the result is within 1 of the value in the table.
+ */
+static __m128
+png_log2_ps(__m128 x)
+{
+   __m128i bits = _mm_castps_si128(x);
+   __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+   __m128 m = _mm_castsi128_ps(_mm_or_si128(
+       _mm_and_si128(bits, _mm_set1_epi32(0x7fffff)),
+       _mm_set1_epi32(0x3f800000)));
+   __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+   __m128 s, s2, p;
+
+   /* Halve the mantissas above sqrt(2) and add one to the exponent, the
+    * comparison result is -1 for these.
+    */
+   m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(.5f))));
+   e = _mm_sub_epi32(e, _mm_castps_si128(big));
+
+   s = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.f)),
+       _mm_add_ps(m, _mm_set1_ps(1.f)));
+   s2 = _mm_mul_ps(s, s);
+
+   /* 2/ln(2) * (s + s^3/3 + s^5/5 + s^7/7 + s^9/9) */
+   p = _mm_add_ps(_mm_set1_ps(.41219858f), _mm_mul_ps(s2,
+       _mm_set1_ps(.32059889f)));
+   p = _mm_add_ps(_mm_set1_ps(.57707802f), _mm_mul_ps(s2, p));
+   p = _mm_add_ps(_mm_set1_ps(.96179669f), _mm_mul_ps(s2, p));
+   p = _mm_add_ps(_mm_set1_ps(2.88539008f), _mm_mul_ps(s2, p));
+
+   return _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(s, p));
+}
+
+static __m128
+png_exp2_ps(__m128 y)
+{
+   __m128i n;
+   __m128 f, p;
+
+   /* Results below 2^-126 are zero after scaling and rounding. */
+   y = _mm_max_ps(y, _mm_set1_ps(-126.f));
+   n = _mm_cvtps_epi32(y);
+   f = _mm_sub_ps(y, _mm_cvtepi32_ps(n));
+
+   /* exp(f*ln(2)) to the sixth power of f */
+   p = _mm_add_ps(_mm_set1_ps(1.3333558e-3f), _mm_mul_ps(f,
+       _mm_set1_ps(1.5403530e-4f)));
+   p = _mm_add_ps(_mm_set1_ps(9.6181291e-3f), _mm_mul_ps(f, p));
+   p = _mm_add_ps(_mm_set1_ps(5.5504109e-2f), _mm_mul_ps(f, p));
+   p = _mm_add_ps(_mm_set1_ps(.24022651f), _mm_mul_ps(f, p));
+   p = _mm_add_ps(_mm_set1_ps(.69314718f), _mm_mul_ps(f, p));
+   p = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(f, p));
+
+   return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(
+       _mm_add_epi32(n, _mm_set1_epi32(127)), 23)));
+}
+
+/* Correct four samples, 'q' is the sample shifted right by gamma_shift. */
+static __m128i
+png_gamma_16_ps(__m128i q, __m128 scale, __m128 exponent)
+{
+   __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(q), scale);
+   __m128 r = png_exp2_ps(_mm_mul_ps(exponent, png_log2_ps(x)));
+   __m128i out = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r,
+       _mm_set1_ps(65535.f)), _mm_set1_ps(.5f)));
+
+   /* log2(0) is not defined; zero stays zero. */
+   return _mm_andnot_si128(_mm_cmpeq_epi32(q, _mm_setzero_si128()), out);
+}
+
+static __m128i
+png_gamma_16_sse2(__m128i v, __m128i shift, __m128 scale, __m128 exponent)
+{
+   /* The samples are big-endian. */
+   __m128i s = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+   __m128i q = _mm_srl_epi16(s, shift);
+   __m128i lo = png_gamma_16_ps(_mm_unpacklo_epi16(q, _mm_setzero_si128()),
+       scale, exponent);
+   __m128i hi = png_gamma_16_ps(_mm_unpackhi_epi16(q, _mm_setzero_si128()),
+       scale, exponent);
+   __m128i bias = _mm_set1_epi32(32768);
+
+   /* There is no unsigned 32 to 16-bit pack in SSE2, so the values are made
+    * signed for the pack then restored.
+    */
+   s = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lo, bias),
+       _mm_sub_epi32(hi, bias)), _mm_set1_epi16(-32768));
+
+   return _mm_or_si128(_mm_slli_epi16(s, 8), _mm_srli_epi16(s, 8));
+}
+
+int
+png_do_gamma_16_sse2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   unsigned int pixel_bytes, color_bytes;
+   unsigned int gamma_shift = (unsigned int)png_ptr->gamma_shift;
+   size_t rowbytes = row_info->rowbytes;
+   size_t n;
+   __m128i alpha, shift;
+   __m128 scale, exponent;
+
+   if (row_info->bit_depth != 16)
+      return 0;
+
+   color_bytes = png_gamma_layout(row_info, &pixel_bytes);
+   if (color_bytes == 0)
+      return 0;
+
+   alpha = png_gamma_alpha_mask(pixel_bytes, color_bytes);
+   shift = _mm_cvtsi32_si128((int)gamma_shift);
+   scale = _mm_set1_ps(1.f / (float)((1U << (16U - gamma_shift)) - 1U));
+   exponent = _mm_set1_ps((float)png_ptr->gamma_16_exponent * 1E-5f);
+
+   for (n = 0; n < rowbytes; n += 16)
+   {
+      __m128i v, g;
+
+      if (n + 16 <= rowbytes)
+      {
+         v = _mm_loadu_si128((const __m128i*)(row + n));
+         g = png_gamma_16_sse2(v, shift, scale, exponent);
+         _mm_storeu_si128((__m128i*)(row + n), _mm_or_si128(
+             _mm_and_si128(alpha, v), _mm_andnot_si128(alpha, g)));
+      }
+
+      else
+      {
+         /* The end of the row goes through a buffer so that it gets exactly
+          * the same calculation as the rest.
+          */
+         png_byte buffer[16];
+
+         memset(buffer, 0, sizeof buffer);
+         memcpy(buffer, row + n, rowbytes - n);
+         v = _mm_loadu_si128((const __m128i*)buffer);
+         g = png_gamma_16_sse2(v, shift, scale, exponent);
+         _mm_storeu_si128((__m128i*)buffer, _mm_or_si128(
+             _mm_and_si128(alpha, v), _mm_andnot_si128(alpha, g)));
+         memcpy(row + n, buffer, rowbytes - n);
+      }
+   }
+
+   return 1;
+}
+
+#if PNG_INTEL_AVX2_OPT > 0
+/* The same calculation on eight samples at a time.  FMA is not used, so the
+ * results are the same as those of png_do_gamma_16_sse2.
+ */
+static __m256 PNG_AVX2_TARGET
+png_log2_avx2(__m256 x)
+{
+   __m256i bits = _mm256_castps_si256(x);
+   __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+       _mm256_set1_epi32(127));
+   __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+       _mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)),
+       _mm256_set1_epi32(0x3f800000)));
+   __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+   __m256 s, s2, p;
+
+   m = _mm256_sub_ps(m, _mm256_and_ps(big, _mm256_mul_ps(m,
+       _mm256_set1_ps(.5f))));
+   e = _mm256_sub_epi32(e, _mm256_castps_si256(big));
+
+   s = _mm256_div_ps(_mm256_sub_ps(m, _mm256_set1_ps(1.f)),
+       _mm256_add_ps(m, _mm256_set1_ps(1.f)));
+   s2 = _mm256_mul_ps(s, s);
+
+   p = _mm256_add_ps(_mm256_set1_ps(.41219858f), _mm256_mul_ps(s2,
+       _mm256_set1_ps(.32059889f)));
+   p = _mm256_add_ps(_mm256_set1_ps(.57707802f), _mm256_mul_ps(s2, p));
+   p = _mm256_add_ps(_mm256_set1_ps(.96179669f), _mm256_mul_ps(s2, p));
+   p = _mm256_add_ps(_mm256_set1_ps(2.88539008f), _mm256_mul_ps(s2, p));
+
+   return _mm256_add_ps(_mm256_cvtepi32_ps(e), _mm256_mul_ps(s, p));
+}
+
+static __m256 PNG_AVX2_TARGET
+png_exp2_avx2(__m256 y)
+{
+   __m256i n;
+   __m256 f, p;
+
+   y = _mm256_max_ps(y, _mm256_set1_ps(-126.f));
+   n = _mm256_cvtps_epi32(y);
+   f = _mm256_sub_ps(y, _mm256_cvtepi32_ps(n));
+
+   p = _mm256_add_ps(_mm256_set1_ps(1.3333558e-3f), _mm256_mul_ps(f,
+       _mm256_set1_ps(1.5403530e-4f)));
+   p = _mm256_add_ps(_mm256_set1_ps(9.6181291e-3f), _mm256_mul_ps(f, p));
+   p = _mm256_add_ps(_mm256_set1_ps(5.5504109e-2f), _mm256_mul_ps(f, p));
+   p = _mm256_add_ps(_mm256_set1_ps(.24022651f), _mm256_mul_ps(f, p));
+   p = _mm256_add_ps(_mm256_set1_ps(.69314718f), _mm256_mul_ps(f, p));
+   p = _mm256_add_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(f, p));
+
+   return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(
+       _mm256_add_epi32(n, _mm256_set1_epi32(127)), 23)));
+}
+
+static __m256i PNG_AVX2_TARGET
+png_gamma_16_ps_avx2(__m256i q, __m256 scale, __m256 exponent)
+{
+   __m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(q), scale);
+   __m256 r = png_exp2_avx2(_mm256_mul_ps(exponent, png_log2_avx2(x)));
+   __m256i out = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(r,
+       _mm256_set1_ps(65535.f)), _mm256_set1_ps(.5f)));
+
+   return _mm256_andnot_si256(_mm256_cmpeq_epi32(q, _mm256_setzero_si256()),
+       out);
+}
+
+static __m256i PNG_AVX2_TARGET
+png_gamma_16_avx2(__m256i v, __m128i shift, __m256 scale, __m256 exponent)
+{
+   __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13,
+       12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+   __m256i q = _mm256_srl_epi16(_mm256_shuffle_epi8(v, swap), shift);
+   __m256i lo = png_gamma_16_ps_avx2(_mm256_unpacklo_epi16(q,
+       _mm256_setzero_si256()), scale, exponent);
+   __m256i hi = png_gamma_16_ps_avx2(_mm256_unpackhi_epi16(q,
+       _mm256_setzero_si256()), scale, exponent);
+
+   /* The unpacks and the pack both work within each 128-bit lane, so the
+    * samples come back in order.
+    */
+   return _mm256_shuffle_epi8(_mm256_packus_epi32(lo, hi), swap);
+}
+
+int PNG_AVX2_TARGET
+png_do_gamma_16_avx2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   unsigned int pixel_bytes, color_bytes;
+   unsigned int gamma_shift = (unsigned int)png_ptr->gamma_shift;
+   size_t rowbytes = row_info->rowbytes;
+   size_t n;
+   __m256i alpha;
+   __m128i shift;
+   __m256 scale, exponent;
+
+   if (row_info->bit_depth != 16)
+      return 0;
+
+   color_bytes = png_gamma_layout(row_info, &pixel_bytes);
+   if (color_bytes == 0)
+      return 0;
+
+   alpha = _mm256_broadcastsi128_si256(png_gamma_alpha_mask(pixel_bytes,
+       color_bytes));
+   shift = _mm_cvtsi32_si128((int)gamma_shift);
+   scale = _mm256_set1_ps(1.f / (float)((1U << (16U - gamma_shift)) - 1U));
+   exponent = _mm256_set1_ps((float)png_ptr->gamma_16_exponent * 1E-5f);
+
+   for (n = 0; n < rowbytes; n += 32)
+   {
+      png_byte buffer[32];
+      png_bytep p = row + n;
+      __m256i v;
+
+      if (n + 32 > rowbytes)
+      {
+         memset(buffer, 0, sizeof buffer);
+         memcpy(buffer, p, rowbytes - n);
+         p = buffer;
+      }
+
+      v = _mm256_loadu_si256((const __m256i*)p);
+      _mm256_storeu_si256((__m256i*)p, _mm256_blendv_epi8(
+          png_gamma_16_avx2(v, shift, scale, exponent), v, alpha));
+
+      if (p == buffer)
+         memcpy(row + n, buffer, rowbytes - n);
+   }
+
+   return 1;
+}
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+#endif /* READ_16BIT */
+
+#if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+   defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+/* Alpha compositing of 8-bit gray-alpha and RGBA rows, as png_do_compose does
+ * it.  Return the size of the pixels, or 0 for the formats left to the C code.
+ */
+static unsigned int
+png_compose_layout(png_row_infop row_info)
+{
+   if (row_info->bit_depth == 8)
+   {
+      if (row_info->color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+         return 2;
+
+      if (row_info->color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+         return 4;
+   }
+
+   return 0;
+}
+
+/* Whether png_do_compose converts to linear light to composite. */
+static int
+png_compose_gamma(png_const_structrp png_ptr)
+{
+   return png_ptr->gamma_to_1 != NULL && png_ptr->gamma_from_1 != NULL &&
+       png_ptr->gamma_table != NULL;
+}
+
+/* Put the background color in 16 bytes of pixels (the alpha bytes are 0).
+ * png_do_compose truncates a component that does not fit in a byte, which
+ * gives a different result from compositing with it, so return 0 for that.
+ */
+static int
+png_compose_color(png_bytep bytes, png_const_color_16p color,
+    unsigned int pixel_bytes)
+{
+   unsigned int i;
+
+   for (i = 0; i < 16; ++i)
+   {
+      unsigned int channel = i % pixel_bytes;
+      png_uint_16 value;
+
+      if (pixel_bytes == 2)
+         value = channel == 0 ? color->gray : 0;
+
+      else
+         value = channel == 0 ? color->red : channel == 1 ? color->green :
+             channel == 2 ? color->blue : 0;
+
+      if (value > 255)
+         return 0;
+
+      bytes[i] = (png_byte)value;
+   }
+
+   return 1;
+}
+
+/* png_composite on 16-bit lanes.  This is the form used with
+ * PNG_READ_COMPOSITE_NODIV_SUPPORTED; for 8-bit values it gives the same
+ * result as the division by 255 in the other form.
+ */
+static __m128i
+png_composite_sse2(__m128i fg, __m128i alpha, __m128i bg)
+{
+   __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(fg, alpha),
+       _mm_mullo_epi16(bg, _mm_xor_si128(alpha, _mm_set1_epi16(255)))),
+       _mm_set1_epi16(128));
+
+   return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/* Composite the bytes of 'fg' on 'bg', the background in 16-bit lanes, using
+ * the alpha of the pixels in 'x'.
+ */
+static __m128i
+png_compose_sse2(__m128i fg, __m128i x, __m128i bg, unsigned int pixel_bytes)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i lo = _mm_unpacklo_epi8(x, zero);
+   __m128i hi = _mm_unpackhi_epi8(x, zero);
+
+   if (pixel_bytes == 4)
+   {
+      lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3,3,3,3)),
+          _MM_SHUFFLE(3,3,3,3));
+      hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3,3,3,3)),
+          _MM_SHUFFLE(3,3,3,3));
+   }
+
+   else
+   {
+      lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3,3,1,1)),
+          _MM_SHUFFLE(3,3,1,1));
+      hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3,3,1,1)),
+          _MM_SHUFFLE(3,3,1,1));
+   }
+
+   return _mm_packus_epi16(
+       png_composite_sse2(_mm_unpacklo_epi8(fg, zero), lo, bg),
+       png_composite_sse2(_mm_unpackhi_epi8(fg, zero), hi, bg));
+}
+
+/* Without gamma correction png_composite gives the pixel itself when alpha is
+ * 255 and the background when it is 0, so every pixel is composited.  The
+ * composition in linear light needs table lookups and is left to the AVX2
+ * version.
+ */
+int
+png_do_compose_sse2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   unsigned int pixel_bytes = png_compose_layout(row_info);
+   size_t rowbytes = row_info->rowbytes;
+   size_t n;
+   png_byte color[16];
+   __m128i alpha, bg;
+
+   if (pixel_bytes == 0 || png_compose_gamma(png_ptr) != 0 ||
+       png_compose_color(color, &png_ptr->background, pixel_bytes) == 0)
+      return 0;
+
+   alpha = png_gamma_alpha_mask(pixel_bytes, pixel_bytes - 1);
+   bg = _mm_unpacklo_epi8(_mm_loadu_si128((const __m128i*)color),
+       _mm_setzero_si128());
+
+   for (n = 0; n < rowbytes; n += 16)
+   {
+      png_byte buffer[16];
+      png_bytep p = row + n;
+      __m128i x;
+
+      if (n + 16 > rowbytes)
+      {
+         memset(buffer, 0, sizeof buffer);
+         memcpy(buffer, p, rowbytes - n);
+         p = buffer;
+      }
+
+      x = _mm_loadu_si128((const __m128i*)p);
+      _mm_storeu_si128((__m128i*)p, _mm_or_si128(_mm_and_si128(alpha, x),
+          _mm_andnot_si128(alpha, png_compose_sse2(x, x, bg, pixel_bytes))));
+
+      if (p == buffer)
+         memcpy(row + n, buffer, rowbytes - n);
+   }
+
+   return 1;
+}
+
+#if PNG_INTEL_AVX2_OPT > 0
+static __m256i PNG_AVX2_TARGET
+png_composite_avx2(__m256i fg, __m256i alpha, __m256i bg)
+{
+   __m256i t = _mm256_add_epi16(_mm256_add_epi16(
+       _mm256_mullo_epi16(fg, alpha), _mm256_mullo_epi16(bg,
+       _mm256_xor_si256(alpha, _mm256_set1_epi16(255)))),
+       _mm256_set1_epi16(128));
+
+   return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static __m256i PNG_AVX2_TARGET
+png_compose_avx2(__m256i fg, __m256i x, __m256i bg, unsigned int pixel_bytes)
+{
+   __m256i zero = _mm256_setzero_si256();
+   __m256i lo = _mm256_unpacklo_epi8(x, zero);
+   __m256i hi = _mm256_unpackhi_epi8(x, zero);
+
+   if (pixel_bytes == 4)
+   {
+      lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo,
+          _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+      hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi,
+          _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+   }
+
+   else
+   {
+      lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo,
+          _MM_SHUFFLE(3,3,1,1)), _MM_SHUFFLE(3,3,1,1));
+      hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi,
+          _MM_SHUFFLE(3,3,1,1)), _MM_SHUFFLE(3,3,1,1));
+   }
+
+   return _mm256_packus_epi16(
+       png_composite_avx2(_mm256_unpacklo_epi8(fg, zero), lo, bg),
+       png_composite_avx2(_mm256_unpackhi_epi8(fg, zero), hi, bg));
+}
+
+/* With gamma correction the pixels are composited in linear light, using the
+ * gamma_to_1 and gamma_from_1 tables, except that opaque pixels only go
+ * through gamma_table and transparent ones become the background, which is
+ * already in the screen gamma.  Three table lookups for each byte cost more in
+ * vectors than they do in scalar code, so 32 bytes are done at a time only when
+ * they are all opaque or transparent; otherwise they are done here, one pixel
+ * at a time as png_do_compose does.
+ */
+#define PNG_COMPOSE_PIXEL(channels)\
+   for (sp = row; sp < row + 32; sp += (channels) + 1)\
+   {\
+      png_byte a = sp[channels];\
+      unsigned int i;\
+\
+      if (a == 0xff)\
+         for (i = 0; i < (channels); ++i)\
+            sp[i] = gamma_table[sp[i]];\
+\
+      else if (a == 0)\
+         for (i = 0; i < (channels); ++i)\
+            sp[i] = color[i];\
+\
+      else\
+         for (i = 0; i < (channels); ++i)\
+         {\
+            png_byte w;\
+\
+            png_composite(w, gamma_to_1[sp[i]], a, color_1[i]);\
+            if (optimize == 0) w = gamma_from_1[w];\
+            sp[i] = w;\
+         }\
+   }
+
+static void
+png_compose_block(png_const_structrp png_ptr, png_bytep row,
+    unsigned int pixel_bytes, png_const_bytep color, png_const_bytep color_1,
+    int optimize)
+{
+   png_const_bytep gamma_table = png_ptr->gamma_table;
+   png_const_bytep gamma_to_1 = png_ptr->gamma_to_1;
+   png_const_bytep gamma_from_1 = png_ptr->gamma_from_1;
+   png_bytep sp;
+
+   if (pixel_bytes == 4)
+      PNG_COMPOSE_PIXEL(3)
+
+   else
+      PNG_COMPOSE_PIXEL(1)
+}
+
+#undef PNG_COMPOSE_PIXEL
+
+int PNG_AVX2_TARGET
+png_do_compose_avx2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   unsigned int pixel_bytes = png_compose_layout(row_info);
+   size_t rowbytes = row_info->rowbytes;
+   size_t n;
+   int gamma, optimize = (png_ptr->flags & PNG_FLAG_OPTIMIZE_ALPHA) != 0;
+   png_byte color[16], color_1[16];
+   int gamma_wide[256];
+   __m256i alpha, spread, background, bg;
+
+   if (pixel_bytes == 0 ||
+       png_compose_color(color, &png_ptr->background, pixel_bytes) == 0)
+      return 0;
+
+   background = _mm256_broadcastsi128_si256(
+       _mm_loadu_si128((const __m128i*)color));
+   bg = _mm256_unpacklo_epi8(background, _mm256_setzero_si256());
+
+   gamma = png_compose_gamma(png_ptr);
+   if (gamma != 0)
+   {
+      if (png_compose_color(color_1, &png_ptr->background_1, pixel_bytes) ==
+          0)
+         return 0;
+
+      png_lookup_init_avx2(gamma_wide, png_ptr->gamma_table);
+   }
+
+   alpha = _mm256_broadcastsi128_si256(png_gamma_alpha_mask(pixel_bytes,
+       pixel_bytes - 1));
+
+   /* Copies the alpha of each pixel to all its bytes. */
+   if (pixel_bytes == 4)
+      spread = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15,
+          15, 15, 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+
+   else
+      spread = _mm256_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13,
+          15, 15, 1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+
+   for (n = 0; n < rowbytes; n += 32)
+   {
+      png_byte buffer[32];
+      png_bytep p = row + n;
+      __m256i x;
+
+      if (n + 32 > rowbytes)
+      {
+         memset(buffer, 0, sizeof buffer);
+         memcpy(buffer, p, rowbytes - n);
+         p = buffer;
+      }
+
+      x = _mm256_loadu_si256((const __m256i*)p);
+
+      if (gamma == 0)
+      {
+         _mm256_storeu_si256((__m256i*)p, _mm256_blendv_epi8(
+             png_compose_avx2(x, x, bg, pixel_bytes), x, alpha));
+      }
+
+      else
+      {
+         __m256i a = _mm256_shuffle_epi8(x, spread);
+         __m256i opaque = _mm256_cmpeq_epi8(a, _mm256_set1_epi8(-1));
+         __m256i clear = _mm256_cmpeq_epi8(a, _mm256_setzero_si256());
+         int mask = _mm256_movemask_epi8(opaque);
+
+         if ((mask | _mm256_movemask_epi8(clear)) != -1)
+            png_compose_block(png_ptr, p, pixel_bytes, color, color_1,
+                optimize);
+
+         else
+         {
+            __m256i c = background;
+
+            if (mask != 0)
+               c = _mm256_blendv_epi8(c, png_lookup_avx2(gamma_wide, x),
+                   opaque);
+
+            _mm256_storeu_si256((__m256i*)p, _mm256_blendv_epi8(c, x, alpha));
+         }
+      }
+
+      if (p == buffer)
+         memcpy(row + n, buffer, rowbytes - n);
+   }
+
+   return 1;
+}
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+#endif /* READ_BACKGROUND || READ_ALPHA_MODE */
+
+#if defined(PNG_READ_RGB_TO_GRAY_SUPPORTED) && PNG_INTEL_AVX2_OPT > 0
+/* Conversion of 8-bit and 16-bit RGB and RGBA rows to gray, as
+ * png_do_rgb_to_gray does it, eight pixels at a time.  Each pixel is put in a
+ * 32-bit lane of red, green and blue, in the order 0, 1, 4, 5, 2, 3, 6, 7 for
+ * 16-bit rows, so that the weighted sums can be made with 32-bit multiplies.
+ * The coefficients add up to 32768, so without gamma correction the sum for a
+ * gray pixel gives the value itself; the comparison is only needed for the
+ * result the function returns, which is kept as an AND of the lanes that were
+ * gray.
+ */
+static void PNG_AVX2_TARGET
+png_gray_load_avx2(png_const_bytep sp, unsigned int pixel_bytes, __m256i *r,
+    __m256i *g, __m256i *b, __m256i *a)
+{
+   __m256i x0, x1, y0, y1, z0, z1;
+
+   if (pixel_bytes == 3 || pixel_bytes == 4)
+   {
+      __m256i mask = _mm256_set1_epi32(0xff);
+
+      if (pixel_bytes == 3)
+         x0 = _mm256_shuffle_epi8(_mm256_inserti128_si256(
+             _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)sp)),
+             _mm_loadu_si128((const __m128i*)(sp + 12)), 1),
+             _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10,
+             11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+
+      else
+         x0 = _mm256_loadu_si256((const __m256i*)sp);
+
+      *r = _mm256_and_si256(x0, mask);
+      *g = _mm256_and_si256(_mm256_srli_epi32(x0, 8), mask);
+      *b = _mm256_and_si256(_mm256_srli_epi32(x0, 16), mask);
+      *a = _mm256_srli_epi32(x0, 24);
+      return;
+   }
+
+   /* 16-bit samples are byte swapped into the low half of the lanes, except
+    * that the alpha is left where it will be in the gray-alpha pixel.
+    */
+   if (pixel_bytes == 6)
+   {
+      __m256i rg = _mm256_setr_epi8(1, 0, -1, -1, 7, 6, -1, -1, 3, 2, -1, -1,
+          9, 8, -1, -1, 1, 0, -1, -1, 7, 6, -1, -1, 3, 2, -1, -1, 9, 8, -1,
+          -1);
+      __m256i ba = _mm256_setr_epi8(5, 4, -1, -1, 11, 10, -1, -1, -1, -1, -1,
+          -1, -1, -1, -1, -1, 5, 4, -1, -1, 11, 10, -1, -1, -1, -1, -1, -1,
+          -1, -1, -1, -1);
+
+      x0 = _mm256_inserti128_si256(_mm256_castsi128_si256(
+          _mm_loadu_si128((const __m128i*)sp)),
+          _mm_loadu_si128((const __m128i*)(sp + 12)), 1);
+      x1 = _mm256_inserti128_si256(_mm256_castsi128_si256(
+          _mm_loadu_si128((const __m128i*)(sp + 24))),
+          _mm_loadu_si128((const __m128i*)(sp + 36)), 1);
+      y0 = _mm256_shuffle_epi8(x0, rg);
+      y1 = _mm256_shuffle_epi8(x1, rg);
+      z0 = _mm256_shuffle_epi8(x0, ba);
+      z1 = _mm256_shuffle_epi8(x1, ba);
+   }
+
+   else
+   {
+      __m256i rg = _mm256_setr_epi8(1, 0, -1, -1, 9, 8, -1, -1, 3, 2, -1, -1,
+          11, 10, -1, -1, 1, 0, -1, -1, 9, 8, -1, -1, 3, 2, -1, -1, 11, 10,
+          -1, -1);
+      __m256i ba = _mm256_setr_epi8(5, 4, -1, -1, 13, 12, -1, -1, -1, -1, 6,
+          7, -1, -1, 14, 15, 5, 4, -1, -1, 13, 12, -1, -1, -1, -1, 6, 7, -1,
+          -1, 14, 15);
+
+      x0 = _mm256_loadu_si256((const __m256i*)sp);
+      x1 = _mm256_loadu_si256((const __m256i*)(sp + 32));
+      y0 = _mm256_shuffle_epi8(x0, rg);
+      y1 = _mm256_shuffle_epi8(x1, rg);
+      z0 = _mm256_shuffle_epi8(x0, ba);
+      z1 = _mm256_shuffle_epi8(x1, ba);
+   }
+
+   *r = _mm256_unpacklo_epi64(y0, y1);
+   *g = _mm256_unpackhi_epi64(y0, y1);
+   *b = _mm256_unpacklo_epi64(z0, z1);
+   *a = _mm256_unpackhi_epi64(z0, z1);
+}
+
+static void PNG_AVX2_TARGET
+png_gray_store_avx2(png_bytep dp, unsigned int pixel_bytes, __m256i y,
+    __m256i a)
+{
+   if (pixel_bytes == 3 || pixel_bytes == 4)
+   {
+      if (pixel_bytes == 4)
+      {
+         y = _mm256_or_si256(y, _mm256_slli_epi32(a, 8));
+         y = _mm256_packus_epi32(y, y);
+         _mm_storeu_si128((__m128i*)dp, _mm256_castsi256_si128(
+             _mm256_permute4x64_epi64(y, 0x08)));
+      }
+
+      else
+      {
+         y = _mm256_packus_epi32(y, y);
+         y = _mm256_packus_epi16(y, y);
+         _mm_storel_epi64((__m128i*)dp, _mm256_castsi256_si128(
+             _mm256_permutevar8x32_epi32(y, _mm256_setr_epi32(0, 4, 0, 0, 0,
+             0, 0, 0))));
+      }
+
+      return;
+   }
+
+   /* Swap the bytes and put the pixels back in order. */
+   y = _mm256_permutevar8x32_epi32(_mm256_or_si256(_mm256_srli_epi32(y, 8),
+       _mm256_and_si256(_mm256_slli_epi32(y, 8), _mm256_set1_epi32(0xff00))),
+       _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+
+   if (pixel_bytes == 8)
+      _mm256_storeu_si256((__m256i*)dp, _mm256_or_si256(y,
+          _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0, 1, 4, 5, 2, 3,
+          6, 7))));
+
+   else
+   {
+      y = _mm256_packus_epi32(y, y);
+      _mm_storeu_si128((__m128i*)dp, _mm256_castsi256_si128(
+          _mm256_permute4x64_epi64(y, 0x08)));
+   }
+}
+
+int PNG_AVX2_TARGET
+png_do_rgb_to_gray_avx2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row, int *rgb_error)
+{
+   png_uint_32 rc = png_ptr->rgb_to_gray_red_coeff;
+   png_uint_32 gc = png_ptr->rgb_to_gray_green_coeff;
+   png_uint_32 bc = 32768 - rc - gc;
+   png_uint_32 row_width = row_info->width;
+   png_uint_32 i, vector_width;
+   unsigned int bit_depth = row_info->bit_depth;
+   unsigned int pixel_bytes, gray_bytes;
+   int have_alpha, gamma;
+   png_bytep sp = row, dp = row;
+   int to_1_wide[256], from_1_wide[256], gamma_wide[256];
+   __m256i red, green, blue, half, all_gray;
+
+   if ((row_info->color_type != PNG_COLOR_TYPE_RGB &&
+       row_info->color_type != PNG_COLOR_TYPE_RGB_ALPHA) ||
+       (bit_depth != 8 && bit_depth != 16) || rc + gc > 32768)
+      return 0;
+
+   /* The 16-bit tables are left to png_do_rgb_to_gray. */
+   gamma = png_ptr->gamma_to_1 != NULL && png_ptr->gamma_from_1 != NULL;
+   if (bit_depth == 16 && png_ptr->gamma_16_to_1 != NULL &&
+       png_ptr->gamma_16_from_1 != NULL)
+      return 0;
+
+   have_alpha = (row_info->color_type & PNG_COLOR_MASK_ALPHA) != 0;
+   pixel_bytes = (bit_depth >> 3) * (have_alpha != 0 ? 4 : 3);
+   gray_bytes = (bit_depth >> 3) * (have_alpha != 0 ? 2 : 1);
+
+   if (bit_depth == 8 && gamma != 0)
+   {
+      png_lookup_init_avx2(to_1_wide, png_ptr->gamma_to_1);
+      png_lookup_init_avx2(from_1_wide, png_ptr->gamma_from_1);
+
+      if (png_ptr->gamma_table != NULL)
+         png_lookup_init_avx2(gamma_wide, png_ptr->gamma_table);
+   }
+
+   /* The RGB loads read 4 bytes beyond the eight pixels. */
+   vector_width = row_width;
+   if (have_alpha == 0)
+      vector_width = vector_width > 2 ? vector_width - 2 : 0;
+
+   red = _mm256_set1_epi32((int)rc);
+   green = _mm256_set1_epi32((int)gc);
+   blue = _mm256_set1_epi32((int)bc);
+   half = _mm256_set1_epi32(bit_depth == 16 || gamma != 0 ? 16384 : 0);
+   all_gray = _mm256_set1_epi32(-1);
+
+   for (i = 0; i + 8 <= vector_width; i += 8)
+   {
+      __m256i r, g, b, a, y, gray;
+
+      png_gray_load_avx2(sp, pixel_bytes, &r, &g, &b, &a);
+      gray = _mm256_and_si256(_mm256_cmpeq_epi32(r, g),
+          _mm256_cmpeq_epi32(r, b));
+      all_gray = _mm256_and_si256(all_gray, gray);
+
+      if (bit_depth == 8 && gamma != 0)
+      {
+         int mask = _mm256_movemask_epi8(gray);
+
+         y = r;
+
+         if (mask != -1)
+         {
+            __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(
+                _mm256_i32gather_epi32(to_1_wide, r, 4), red),
+                _mm256_mullo_epi32(_mm256_i32gather_epi32(to_1_wide, g, 4),
+                green)), _mm256_add_epi32(_mm256_mullo_epi32(
+                _mm256_i32gather_epi32(to_1_wide, b, 4), blue), half));
+
+            y = _mm256_i32gather_epi32(from_1_wide, _mm256_srli_epi32(sum, 15),
+                4);
+         }
+
+         if (mask != 0 && png_ptr->gamma_table != NULL)
+            y = _mm256_blendv_epi8(y, _mm256_i32gather_epi32(gamma_wide, r, 4),
+                gray);
+
+         else if (mask != 0)
+            y = _mm256_blendv_epi8(y, r, gray);
+      }
+
+      else
+         y = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(
+             _mm256_mullo_epi32(r, red), _mm256_mullo_epi32(g, green)),
+             _mm256_add_epi32(_mm256_mullo_epi32(b, blue), half)), 15);
+
+      png_gray_store_avx2(dp, pixel_bytes, y, a);
+      sp += 8 * pixel_bytes;
+      dp += 8 * gray_bytes;
+   }
+
+   *rgb_error = _mm256_movemask_epi8(all_gray) != -1;
+
+   for (; i < row_width; ++i)
+   {
+      png_uint_32 r, g, b, y;
+
+      if (bit_depth == 8)
+      {
+         r = sp[0];
+         g = sp[1];
+         b = sp[2];
+      }
+
+      else
+      {
+         r = png_get_uint_16(sp);
+         g = png_get_uint_16(sp + 2);
+         b = png_get_uint_16(sp + 4);
+      }
+
+      if (r != g || r != b)
+      {
+         *rgb_error = 1;
+
+         if (bit_depth == 8 && gamma != 0)
+            y = png_ptr->gamma_from_1[(rc*png_ptr->gamma_to_1[r] +
+                gc*png_ptr->gamma_to_1[g] + bc*png_ptr->gamma_to_1[b] +
+                16384) >> 15];
+
+         else if (bit_depth == 8)
+            y = (rc*r + gc*g + bc*b) >> 15;
+
+         else
+            y = (rc*r + gc*g + bc*b + 16384) >> 15;
+      }
+
+      else if (bit_depth == 8 && gamma != 0 && png_ptr->gamma_table != NULL)
+         y = png_ptr->gamma_table[r];
+
+      else
+         y = r;
+
+      if (bit_depth == 8)
+         *(dp++) = (png_byte)y;
+
+      else
+      {
+         *(dp++) = (png_byte)(y >> 8);
+         *(dp++) = (png_byte)y;
+      }
+
+      sp += 3 * (bit_depth >> 3);
+
+      if (have_alpha != 0)
+      {
+         *(dp++) = *(sp++);
+
+         if (bit_depth == 16)
+            *(dp++) = *(sp++);
+      }
+   }
+
+   row_info->channels = (png_byte)(row_info->channels - 2);
+   row_info->color_type = (png_byte)(row_info->color_type &
+       ~PNG_COLOR_MASK_COLOR);
+   row_info->pixel_depth = (png_byte)(row_info->channels *
+       row_info->bit_depth);
+   row_info->rowbytes = PNG_ROWBYTES(row_info->pixel_depth, row_width);
+
+   return 1;
+}
+#endif /* READ_RGB_TO_GRAY && PNG_INTEL_AVX2_OPT > 0 */
+
+#endif /* PNG_INTEL_SSE_IMPLEMENTATION > 0 */
+#endif /* READ_GAMMA */
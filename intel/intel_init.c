@@ -1,5 +1,5 @@
 
-/* intel_init.c - SSE2 optimized filter functions
+/* intel_init.c - SSE2, SSSE3 and AVX2 optimized functions
  *
  * Copyright (c) 2018 Cosmin Truta
  * Copyright (c) 2016-2017 Glenn Randers-Pehrson
@@ -13,22 +13,135 @@
 
 #include "../pngpriv.h"
 
-#ifdef PNG_READ_SUPPORTED
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_SUPPORTED)
 #if PNG_INTEL_SSE_IMPLEMENTATION > 0
 
+#if PNG_INTEL_AVX2_OPT > 0 || PNG_INTEL_PCLMUL_OPT > 0 ||\
+    PNG_INTEL_SSSE3_OPT > 0
+#ifdef _MSC_VER
+#  include <intrin.h>
+#else
+#  include <cpuid.h>
+#endif
+#endif
+
+#if PNG_INTEL_AVX2_OPT > 0
+/* AVX2 support is detected at run time with CPUID.  The instructions are only
+ * usable if the OS also saves the YMM registers on a context switch; this is
+ * what the OSXSAVE and XGETBV checks establish.
+ */
+
+static int
+png_check_avx2(void)
+{
+#ifdef _MSC_VER
+   int info[4];
+
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return 0;
+
+   /* OSXSAVE (bit 27) and AVX (bit 28) */
+   __cpuid(info, 1);
+   if ((info[2] & 0x18000000) != 0x18000000)
+      return 0;
+
+   /* XMM (bit 1) and YMM (bit 2) state enabled by the OS */
+   if ((_xgetbv(0) & 6) != 6)
+      return 0;
+
+   /* AVX2 (bit 5) */
+   __cpuidex(info, 7, 0);
+   return (info[1] & 0x20) != 0;
+#else
+   unsigned int eax, ebx, ecx, edx;
+
+   if (__get_cpuid_max(0, NULL) < 7)
+      return 0;
+
+   __cpuid(1, eax, ebx, ecx, edx);
+   if ((ecx & 0x18000000U) != 0x18000000U)
+      return 0;
+
+   __asm__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+   if ((eax & 6U) != 6U)
+      return 0;
+
+   __cpuid_count(7, 0, eax, ebx, ecx, edx);
+   return (ebx & 0x20U) != 0;
+#endif
+}
+
+static int
+png_have_avx2(void)
+{
+   static volatile int have_avx2 = -1; /* not checked */
+
+   if (have_avx2 < 0)
+      have_avx2 = png_check_avx2();
+
+   return have_avx2;
+}
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+
+#if PNG_INTEL_SSSE3_OPT > 0
+static int
+png_check_ssse3(void)
+{
+#ifdef _MSC_VER
+   int info[4];
+
+   /* SSSE3 (bit 9) */
+   __cpuid(info, 1);
+   return (info[2] & 0x200) != 0;
+#else
+   unsigned int eax, ebx, ecx, edx;
+
+   if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+      return 0;
+
+   return (ecx & 0x200U) != 0;
+#endif
+}
+
+static int
+png_have_ssse3(void)
+{
+   static volatile int have_ssse3 = -1; /* not checked */
+
+   if (have_ssse3 < 0)
+      have_ssse3 = png_check_ssse3();
+
+   return have_ssse3;
+}
+#endif /* PNG_INTEL_SSSE3_OPT > 0 */
+
+#ifdef PNG_READ_SUPPORTED
 void
 png_init_filter_functions_sse2(png_structp pp, unsigned int bpp)
 {
-   /* The techniques used to implement each of these filters in SSE operate on
+   /* The techniques used to implement most of these filters in SSE operate on
     * one pixel at a time.
-    * So they generally speed up 3bpp images about 3x, 4bpp images about 4x.
-    * They can scale up to 6 and 8 bpp images and down to 2 bpp images,
-    * but they'd not likely have any benefit for 1bpp images.
+    * So they generally speed up 3bpp images about 3x, 4bpp images about 4x,
+    * and the 6 and 8 bpp (16-bit RGB and RGBA) versions rather more.
+    * For 1 and 2 bpp images Sub works on a whole vector of pixels at once;
+    * Avg and Paeth for 1bpp images remain the generic (scalar) versions.
     * Most of these can be implemented using only MMX and 64-bit registers,
     * but they end up a bit slower than using the equally-ubiquitous SSE2.
    */
    png_debug(1, "in png_init_filter_functions_sse2");
-   if (bpp == 3)
+
+   if (bpp == 1)
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub1_sse2;
+
+   else if (bpp == 2)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub2_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg2_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_read_filter_row_paeth2_sse2;
+   }
+   else if (bpp == 3)
    {
       pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub3_sse2;
       pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg3_sse2;
@@ -42,11 +155,266 @@ png_init_filter_functions_sse2(png_structp pp, unsigned int bpp)
       pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
           png_read_filter_row_paeth4_sse2;
    }
+   else if (bpp == 6)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub6_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg6_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_read_filter_row_paeth6_sse2;
+   }
+   else if (bpp == 8)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub8_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg8_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_read_filter_row_paeth8_sse2;
+   }
+
+   /* SSE2 has no PNG_FILTER_VALUE_UP function; the compiler should
+    * autovectorize the C version.
+    */
+
+#if PNG_INTEL_AVX2_OPT > 0
+   if (png_have_avx2() == 0)
+      return;
+
+   /* Where the CPU supports AVX2 replace the SSE2 functions with AVX2 ones.  Up
+    * and Sub are computed for many pixels at once; Avg gains nothing from AVX2
+    * so the SSE2 versions are retained.
+    */
+   pp->read_filter[PNG_FILTER_VALUE_UP-1] = png_read_filter_row_up_avx2;
+
+   if (bpp == 1)
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub1_avx2;
+
+   else if (bpp == 2)
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub2_avx2;
+
+   else if (bpp == 3)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub3_avx2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         png_read_filter_row_paeth3_avx2;
+   }
+   else if (bpp == 4)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub4_avx2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         png_read_filter_row_paeth4_avx2;
+   }
+   else if (bpp == 6)
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         png_read_filter_row_paeth6_avx2;
+
+   else if (bpp == 8)
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         png_read_filter_row_paeth8_avx2;
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+}
+#endif /* READ */
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+void
+png_init_write_filter_functions_sse2(png_structp pp, unsigned int bpp)
+{
+   /* When writing all four filters are computed from the unfiltered rows, so
+    * the same functions handle every pixel size, 16 (or, with AVX2, 32) bytes
+    * at a time.
+    */
+   png_debug(1, "in png_init_write_filter_functions_sse2");
+
+#if PNG_INTEL_AVX2_OPT > 0
+   if (png_have_avx2() != 0)
+   {
+      pp->write_filter[PNG_FILTER_VALUE_SUB-1] = png_write_filter_row_sub_avx2;
+      pp->write_filter[PNG_FILTER_VALUE_UP-1] = png_write_filter_row_up_avx2;
+      pp->write_filter[PNG_FILTER_VALUE_AVG-1] = png_write_filter_row_avg_avx2;
+      pp->write_filter[PNG_FILTER_VALUE_PAETH-1] =
+          png_write_filter_row_paeth_avx2;
+      pp->write_filter_sums = png_write_filter_sums_avx2;
+      return;
+   }
+#endif
+
+   pp->write_filter[PNG_FILTER_VALUE_SUB-1] = png_write_filter_row_sub_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_UP-1] = png_write_filter_row_up_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_AVG-1] = png_write_filter_row_avg_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_PAETH-1] =
+       png_write_filter_row_paeth_sse2;
+   pp->write_filter_sums = png_write_filter_sums_sse2;
+
+   PNG_UNUSED(bpp)
+}
+#endif /* WRITE_FILTER */
+
+#if PNG_INTEL_PCLMUL_OPT > 0
+/* PCLMULQDQ only needs the XMM registers, which SSE2 already requires the OS
+ * to support, so the CPUID feature bit is sufficient.
+ */
+static int
+png_check_pclmul(void)
+{
+#ifdef _MSC_VER
+   int info[4];
+
+   /* PCLMULQDQ (bit 1) */
+   __cpuid(info, 1);
+   return (info[2] & 0x2) != 0;
+#else
+   unsigned int eax, ebx, ecx, edx;
+
+   if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+      return 0;
+
+   return (ecx & 0x2U) != 0;
+#endif
+}
+
+void
+png_init_crc_functions_sse2(png_structp pp)
+{
+   static volatile int have_pclmul = -1; /* not checked */
+
+   png_debug(1, "in png_init_crc_functions_sse2");
+
+   if (have_pclmul < 0)
+      have_pclmul = png_check_pclmul();
+
+   if (have_pclmul != 0)
+      pp->crc_fn = png_crc32_pclmul;
+}
+#endif /* PNG_INTEL_PCLMUL_OPT > 0 */
+
+#ifdef PNG_READ_EXPAND_SUPPORTED
+void
+png_init_palette_functions_sse2(png_structp pp)
+{
+   /* Both expansion functions look up an RGBA palette with the tRNS values,
+    * or 255, as alpha.  Entries beyond the end of the palette are black, as
+    * they are in png_ptr->palette.
+    */
+   png_bytep rp = pp->riffled_palette;
+   int num_palette = pp->num_palette;
+   int i;
+
+   png_debug(1, "in png_init_palette_functions_sse2");
+
+   for (i = 0; i < 256; ++i, rp += 4)
+   {
+      if (i < num_palette)
+      {
+         rp[0] = pp->palette[i].red;
+         rp[1] = pp->palette[i].green;
+         rp[2] = pp->palette[i].blue;
+      }
+
+      else
+         rp[0] = rp[1] = rp[2] = 0;
+
+      rp[3] = (png_byte)(i < pp->num_trans ? pp->trans_alpha[i] : 0xff);
+   }
+
+   pp->expand_palette = png_do_expand_palette_sse2;
+
+#if PNG_INTEL_AVX2_OPT > 0
+   if (png_have_avx2() != 0)
+      pp->expand_palette = png_do_expand_palette_avx2;
+#endif
+}
+#endif /* READ_EXPAND */
+
+#ifdef PNG_READ_INTERLACING_SUPPORTED
+void
+png_init_interlace_functions_sse2(png_structp pp)
+{
+   /* SSE2 unpacks replicate 1, 2, 4 and 8 byte pixels; the SSSE3 version adds
+    * a byte shuffle for 3 and 6 byte (RGB) pixels.
+    */
+   png_debug(1, "in png_init_interlace_functions_sse2");
+
+   pp->read_interlace = png_read_interlace_sse2;
+   pp->combine_row = png_combine_row_sse2;
+
+#if PNG_INTEL_SSSE3_OPT > 0
+   if (png_have_ssse3() != 0)
+      pp->read_interlace = png_read_interlace_ssse3;
+#endif
+}
+#endif /* READ_INTERLACING */
 
-   /* No need optimize PNG_FILTER_VALUE_UP.  The compiler should
-    * autovectorize.
+#ifdef PNG_READ_GAMMA_SUPPORTED
+void
+png_init_gamma_functions_sse2(png_structp pp)
+{
+   /* The 8-bit table lookup needs the AVX2 gathers to be quicker than the C
+    * code.  The 16-bit values are only calculated when the application has
+    * asked for this with PNG_APPROXIMATE_GAMMA_16.  SSE2 compositing handles
+    * the rows without gamma correction, AVX2 also those with it.  Conversion
+    * to gray needs the AVX2 32-bit multiplies and byte shuffles.
     */
+   png_debug(1, "in png_init_gamma_functions_sse2");
+
+#if PNG_INTEL_AVX2_OPT > 0
+   if (pp->gamma_table != NULL && png_have_avx2() != 0)
+      pp->do_gamma = png_do_gamma_avx2;
+#endif
+
+#ifdef PNG_READ_16BIT_SUPPORTED
+   if (pp->gamma_16_exponent != 0)
+   {
+      pp->do_gamma = png_do_gamma_16_sse2;
+
+#  if PNG_INTEL_AVX2_OPT > 0
+      if (png_have_avx2() != 0)
+         pp->do_gamma = png_do_gamma_16_avx2;
+#  endif
+   }
+#endif
+
+#if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+   defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+   pp->do_compose = png_do_compose_sse2;
+
+#  if PNG_INTEL_AVX2_OPT > 0
+   if (png_have_avx2() != 0)
+      pp->do_compose = png_do_compose_avx2;
+#  endif
+#endif
+
+#if defined(PNG_READ_RGB_TO_GRAY_SUPPORTED) && PNG_INTEL_AVX2_OPT > 0
+   if (png_have_avx2() != 0)
+      pp->do_rgb_to_gray = png_do_rgb_to_gray_avx2;
+#endif
+}
+#endif /* READ_GAMMA */
+
+#if PNG_INTEL_SSSE3_OPT > 0
+void
+png_init_shuffle_functions_sse2(png_structp pp)
+{
+   /* The pixels are rearranged, 16 bytes at a time, by one SSSE3 byte shuffle
+    * with the table png_init_fused built, the sub-byte pixels of packswap by
+    * two 16 entry lookups.
+    */
+   png_debug(1, "in png_init_shuffle_functions_sse2");
+
+   if (png_have_ssse3() == 0)
+      return;
+
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+   defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+   /* Not if the 8-bit gamma lookup is fused too. */
+   if (pp->do_fused != NULL && pp->fused_gamma == NULL)
+      pp->do_fused = png_do_fused_ssse3;
+#endif
+
+#if defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+   defined(PNG_WRITE_PACKSWAP_SUPPORTED)
+   if ((pp->transformations & PNG_PACKSWAP) != 0)
+      pp->do_packswap = png_do_packswap_ssse3;
+#endif
 }
+#endif /* PNG_INTEL_SSSE3_OPT > 0 */
 
 #endif /* PNG_INTEL_SSE_IMPLEMENTATION > 0 */
-#endif /* PNG_READ_SUPPORTED */
+#endif /* READ || WRITE */
@@ -0,0 +1,300 @@
+/* interlace_sse2_intrinsics.c - SSE2 and SSSE3 Adam7 row expansion
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_INTERLACING_SUPPORTED
+
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0
+
+#include <emmintrin.h>
+
+#if PNG_INTEL_SSSE3_OPT > 0
+#  include <tmmintrin.h>
+
+/* The shuffle based expansion is compiled for SSSE3 regardless of the flags
+ * used for the rest of libpng.  It is only installed after
+ * png_init_interlace_functions_sse2 has checked the CPU.
+ */
+#  if PNG_INTEL_SSE_IMPLEMENTATION < 2 && (defined(__GNUC__) ||\
+      defined(__clang__))
+#     define PNG_SSSE3_TARGET __attribute__((target("ssse3")))
+#  else
+#     define PNG_SSSE3_TARGET
+#  endif
+#endif
+
+/* Adam7 column increment for each of the passes png_do_read_interlace
+ * expands (pass 6 is already full width.)
+ */
+static const unsigned int png_pass_inc[6] = {8, 8, 4, 4, 2, 2};
+
+/* Replicate each element in the low or high half of 'v' to two adjacent
+ * elements; 'size' is the element size in bytes.
+ */
+static __m128i
+png_dup_lo(__m128i v, unsigned int size)
+{
+   switch (size)
+   {
+      case 1:  return _mm_unpacklo_epi8(v, v);
+      case 2:  return _mm_unpacklo_epi16(v, v);
+      case 4:  return _mm_unpacklo_epi32(v, v);
+      default: return _mm_unpacklo_epi64(v, v);
+   }
+}
+
+static __m128i
+png_dup_hi(__m128i v, unsigned int size)
+{
+   switch (size)
+   {
+      case 1:  return _mm_unpackhi_epi8(v, v);
+      case 2:  return _mm_unpackhi_epi16(v, v);
+      case 4:  return _mm_unpackhi_epi32(v, v);
+      default: return _mm_unpackhi_epi64(v, v);
+   }
+}
+
+/* Store 'v' with each element repeated 'inc' times, 16*inc bytes in all. */
+static void
+png_store_replicated(png_bytep dp, __m128i v, unsigned int size,
+    unsigned int inc)
+{
+   __m128i lo = png_dup_lo(v, size);
+   __m128i hi = png_dup_hi(v, size);
+
+   if (inc == 2)
+   {
+      _mm_storeu_si128((__m128i*)dp, lo);
+      _mm_storeu_si128((__m128i*)(dp + 16), hi);
+   }
+
+   else
+   {
+      __m128i a = png_dup_lo(lo, size);
+      __m128i b = png_dup_hi(lo, size);
+      __m128i c = png_dup_lo(hi, size);
+      __m128i d = png_dup_hi(hi, size);
+
+      if (inc == 4)
+      {
+         _mm_storeu_si128((__m128i*)dp, a);
+         _mm_storeu_si128((__m128i*)(dp + 16), b);
+         _mm_storeu_si128((__m128i*)(dp + 32), c);
+         _mm_storeu_si128((__m128i*)(dp + 48), d);
+      }
+
+      else /* inc == 8 */
+      {
+         _mm_storeu_si128((__m128i*)dp, png_dup_lo(a, size));
+         _mm_storeu_si128((__m128i*)(dp + 16), png_dup_hi(a, size));
+         _mm_storeu_si128((__m128i*)(dp + 32), png_dup_lo(b, size));
+         _mm_storeu_si128((__m128i*)(dp + 48), png_dup_hi(b, size));
+         _mm_storeu_si128((__m128i*)(dp + 64), png_dup_lo(c, size));
+         _mm_storeu_si128((__m128i*)(dp + 80), png_dup_hi(c, size));
+         _mm_storeu_si128((__m128i*)(dp + 96), png_dup_lo(d, size));
+         _mm_storeu_si128((__m128i*)(dp + 112), png_dup_hi(d, size));
+      }
+   }
+}
+
+/* Expand the pixels from 'first' to the end of the row with the C algorithm;
+ * the pixels at the end of a row that do not fill a vector.
+ */
+static void
+png_expand_tail(png_bytep row, png_uint_32 first, png_uint_32 width,
+    unsigned int pixel_bytes, unsigned int inc)
+{
+   png_bytep sp = row + (size_t)width * pixel_bytes;
+   png_bytep dp = row + (size_t)width * inc * pixel_bytes;
+
+   while (width > first)
+   {
+      unsigned int j;
+
+      sp -= pixel_bytes;
+      --width;
+
+      for (j = 0; j < inc; ++j)
+      {
+         dp -= pixel_bytes;
+         memmove(dp, sp, pixel_bytes);
+      }
+   }
+}
+
+/* The rows are expanded in place from the end, so the output of each vector
+ * of pixels lands beyond the pixels still to be read; only the first vector
+ * overlaps its own output, and it is loaded before anything is stored.
+ */
+int
+png_read_interlace_sse2(png_row_infop row_info, png_bytep row, int pass)
+{
+   unsigned int pixel_bytes = row_info->pixel_depth >> 3;
+   unsigned int inc = png_pass_inc[pass];
+   png_uint_32 width = row_info->width;
+   size_t n;
+
+   if (pixel_bytes != 1 && pixel_bytes != 2 && pixel_bytes != 4 &&
+       pixel_bytes != 8)
+      return 0;
+
+   if ((row_info->pixel_depth & 7) != 0)
+      return 0;
+
+   /* The number of whole vectors of input. */
+   n = ((size_t)width * pixel_bytes) >> 4;
+   png_expand_tail(row, (png_uint_32)((n << 4) / pixel_bytes), width,
+       pixel_bytes, inc);
+
+   while (n > 0)
+   {
+      --n;
+      png_store_replicated(row + (n << 4) * inc,
+          _mm_loadu_si128((const __m128i*)(row + (n << 4))), pixel_bytes, inc);
+   }
+
+   row_info->width = width * inc;
+   row_info->rowbytes = PNG_ROWBYTES(row_info->pixel_depth, row_info->width);
+   return 1;
+}
+
+#if PNG_INTEL_SSSE3_OPT > 0
+/* RGB and 16-bit RGB pixels do not fit the unpack instructions, so these use a
+ * byte shuffle on 12 bytes (four or two pixels) of input at a time.  The
+ * output, 12*inc bytes, is a whole number of vectors except for pass 5 (inc 2)
+ * where it ends with half a vector.
+ */
+int PNG_SSSE3_TARGET
+png_read_interlace_ssse3(png_row_infop row_info, png_bytep row, int pass)
+{
+   unsigned int pixel_bytes = row_info->pixel_depth >> 3;
+   unsigned int inc = png_pass_inc[pass];
+   unsigned int out_bytes = 12 * inc;
+   png_uint_32 width = row_info->width;
+   __m128i shuffle[6];
+   png_byte index[16*6];
+   unsigned int i;
+   size_t n;
+
+   if ((pixel_bytes != 3 && pixel_bytes != 6) ||
+       (row_info->pixel_depth & 7) != 0)
+      return png_read_interlace_sse2(row_info, row, pass);
+
+   /* Output byte i comes from input pixel i/(pixel_bytes*inc); the entries
+    * past the end of the output for pass 5 are never stored.
+    */
+   for (i = 0; i < (sizeof index); ++i)
+      index[i] = (png_byte)(((i / (pixel_bytes*inc)) * pixel_bytes +
+          i % pixel_bytes) & 0x0f);
+
+   for (i = 0; i < 6; ++i)
+      shuffle[i] = _mm_loadu_si128((const __m128i*)(index + 16*i));
+
+   n = ((size_t)width * pixel_bytes) / 12;
+   png_expand_tail(row, (png_uint_32)(n * 12 / pixel_bytes), width,
+       pixel_bytes, inc);
+
+   while (n > 0)
+   {
+      png_bytep dp;
+      __m128i v;
+      int tmp;
+
+      --n;
+      dp = row + n * out_bytes;
+
+      memcpy(&tmp, row + n*12 + 8, sizeof tmp);
+      v = _mm_unpacklo_epi64(
+          _mm_loadl_epi64((const __m128i*)(row + n*12)),
+          _mm_cvtsi32_si128(tmp));
+
+      if (inc == 2)
+      {
+         _mm_storeu_si128((__m128i*)dp, _mm_shuffle_epi8(v, shuffle[0]));
+         _mm_storel_epi64((__m128i*)(dp + 16), _mm_shuffle_epi8(v,
+             shuffle[1]));
+      }
+
+      else
+      {
+         for (i = 0; i < out_bytes >> 4; ++i)
+            _mm_storeu_si128((__m128i*)(dp + 16*i),
+                _mm_shuffle_epi8(v, shuffle[i]));
+      }
+   }
+
+   row_info->width = width * inc;
+   row_info->rowbytes = PNG_ROWBYTES(row_info->pixel_depth, row_info->width);
+   return 1;
+}
+#endif /* PNG_INTEL_SSSE3_OPT > 0 */
+
+/* Copy the first 'copy' bytes of every 'jump' from sp to dp.  Because the row
+ * in sp has already been expanded the unwanted bytes can be read as well, so
+ * this is a masked blend; the mask repeats every lcm(jump, 16) bytes, which
+ * must be at most four vectors.
+ */
+int
+png_combine_row_sse2(png_bytep dp, png_const_bytep sp, size_t length,
+    unsigned int copy, unsigned int jump)
+{
+   png_byte bytes[64];
+   __m128i mask[4];
+   unsigned int period, vectors, v, i;
+
+   /* Sparse copies (one pixel in eight of the first passes) are quicker done
+    * pixel by pixel.
+    */
+   if (jump > 4 * copy)
+      return 0;
+
+   period = jump;
+   while ((period & 15) != 0)
+      period += jump;
+
+   if (period > sizeof bytes)
+      return 0;
+
+   vectors = period >> 4;
+
+   for (i = 0; i < period; ++i)
+      bytes[i] = (png_byte)(i % jump < copy ? 0xff : 0);
+
+   for (v = 0; v < vectors; ++v)
+      mask[v] = _mm_loadu_si128((const __m128i*)(bytes + 16*v));
+
+   v = 0;
+   while (length >= 16)
+   {
+      __m128i s = _mm_loadu_si128((const __m128i*)sp);
+      __m128i d = _mm_loadu_si128((const __m128i*)dp);
+
+      d = _mm_or_si128(_mm_and_si128(mask[v], s),
+          _mm_andnot_si128(mask[v], d));
+      _mm_storeu_si128((__m128i*)dp, d);
+
+      if (++v == vectors)
+         v = 0;
+
+      sp += 16;
+      dp += 16;
+      length -= 16;
+   }
+
+   for (i = 0; i < length; ++i)
+      if (bytes[16*v + i] != 0)
+         dp[i] = sp[i];
+
+   return 1;
+}
+
+#endif /* PNG_INTEL_SSE_IMPLEMENTATION > 0 */
+#endif /* READ_INTERLACING */
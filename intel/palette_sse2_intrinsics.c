@@ -0,0 +1,231 @@
+/* palette_sse2_intrinsics.c - SSE2 and AVX2 palette expansion
+ *
+ * Copyright (c) 2026 agent
+ * Derived from arm/palette_neon_intrinsics.c
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_EXPAND_SUPPORTED
+
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0
+
+#include <immintrin.h>
+
+/* The AVX2 functions are compiled for AVX2 regardless of the flags used for
+ * the rest of libpng; png_init_palette_functions_sse2 only installs them after
+ * checking the CPU.
+ */
+#if PNG_INTEL_AVX2_OPT > 0
+#  if defined(__GNUC__) || defined(__clang__)
+#     define PNG_AVX2_TARGET __attribute__((target("avx2")))
+#  else
+#     define PNG_AVX2_TARGET
+#  endif
+#endif
+
+/* Both versions work from png_ptr->riffled_palette, 256 RGBA entries with the
+ * tRNS alpha values (or 255) in the fourth byte, and expand the row in place
+ * from the end.  Each group of eight (AVX2) or four (SSE2) pixels is loaded
+ * before its output is stored, and the output of every other group lies beyond
+ * the indices still to be read.  The pixels at the end of the row that do not
+ * fill a group are done first, one at a time.
+ */
+
+/* Return the palette index of pixel 'i' in a row of 'bit_depth' indices. */
+static unsigned int
+png_palette_index(png_const_bytep row, png_uint_32 i, unsigned int bit_depth)
+{
+   if (bit_depth == 8)
+      return row[i];
+
+   else
+   {
+      png_uint_32 bit = i * bit_depth;
+      unsigned int shift = 8 - bit_depth - (unsigned int)(bit & 7);
+
+      return (row[bit >> 3] >> shift) & ((1U << bit_depth) - 1);
+   }
+}
+
+static void
+png_expand_palette_tail(png_const_bytep riffled_palette, png_bytep row,
+    png_uint_32 first, png_uint_32 width, unsigned int bit_depth,
+    unsigned int channels)
+{
+   while (width > first)
+   {
+      unsigned int index = png_palette_index(row, --width, bit_depth);
+
+      memcpy(row + (size_t)width * channels, riffled_palette + 4*index,
+          channels);
+   }
+}
+
+static void
+png_expand_palette_done(png_row_infop row_info, unsigned int channels)
+{
+   row_info->bit_depth = 8;
+   row_info->pixel_depth = (png_byte)(8 * channels);
+   row_info->rowbytes = (size_t)row_info->width * channels;
+   row_info->color_type = (png_byte)(channels == 4 ? PNG_COLOR_TYPE_RGBA :
+       PNG_COLOR_TYPE_RGB);
+   row_info->channels = (png_byte)channels;
+}
+
+/* Expand to RGBA: each pixel is a single 32-bit load from the riffled palette
+ * and four pixels are stored together.  Without AVX2 RGB output is left to the
+ * C code.
+ */
+int
+png_do_expand_palette_sse2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   const png_uint_32 *palette = png_aligncastconst(const png_uint_32 *,
+       png_ptr->riffled_palette);
+   unsigned int bit_depth = row_info->bit_depth;
+   png_uint_32 width = row_info->width;
+   png_uint_32 n = width & ~(png_uint_32)3;
+
+   if (png_ptr->num_trans == 0)
+      return 0;
+
+   png_expand_palette_tail(png_ptr->riffled_palette, row, n, width, bit_depth,
+       4);
+
+   while (n > 0)
+   {
+      __m128i v;
+
+      n -= 4;
+      v = _mm_set_epi32(
+          (int)palette[png_palette_index(row, n + 3, bit_depth)],
+          (int)palette[png_palette_index(row, n + 2, bit_depth)],
+          (int)palette[png_palette_index(row, n + 1, bit_depth)],
+          (int)palette[png_palette_index(row, n, bit_depth)]);
+      _mm_storeu_si128((__m128i*)(row + 4*(size_t)n), v);
+   }
+
+   png_expand_palette_done(row_info, 4);
+   return 1;
+}
+
+#if PNG_INTEL_AVX2_OPT > 0
+/* The indices of eight pixels occupy 'bit_depth' bytes.  These are unpacked by
+ * a byte shuffle that puts the byte holding each pixel in a separate 32-bit
+ * lane, followed by a variable shift and a mask, then the palette entries are
+ * gathered.  For RGB a second shuffle drops the alpha bytes.
+ *
+ * The table gives the byte for each of the first four pixels, for 1 and 2, 4
+ * and 8 bit indices; the next four pixels start bit_depth/2 bytes further on.
+ */
+static const png_byte png_index_shuffle[3][16] =
+{
+   { 0, 0x80, 0x80, 0x80, 0, 0x80, 0x80, 0x80,
+     0, 0x80, 0x80, 0x80, 0, 0x80, 0x80, 0x80 },
+   { 0, 0x80, 0x80, 0x80, 0, 0x80, 0x80, 0x80,
+     1, 0x80, 0x80, 0x80, 1, 0x80, 0x80, 0x80 },
+   { 0, 0x80, 0x80, 0x80, 1, 0x80, 0x80, 0x80,
+     2, 0x80, 0x80, 0x80, 3, 0x80, 0x80, 0x80 }
+};
+
+int PNG_AVX2_TARGET
+png_do_expand_palette_avx2(png_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
+{
+   const int *palette = png_aligncastconst(const int *,
+       png_ptr->riffled_palette);
+   unsigned int bit_depth = row_info->bit_depth;
+   unsigned int channels = png_ptr->num_trans > 0 ? 4 : 3;
+   png_uint_32 width = row_info->width;
+   png_uint_32 n = width & ~(png_uint_32)7;
+   __m128i lo;
+   __m256i shuffle, shift, mask, rgb;
+
+   switch (bit_depth)
+   {
+      case 1:
+         lo = _mm_loadu_si128((const __m128i*)png_index_shuffle[0]);
+         shift = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+         break;
+
+      case 2:
+         lo = _mm_loadu_si128((const __m128i*)png_index_shuffle[0]);
+         shift = _mm256_setr_epi32(6, 4, 2, 0, 6, 4, 2, 0);
+         break;
+
+      case 4:
+         lo = _mm_loadu_si128((const __m128i*)png_index_shuffle[1]);
+         shift = _mm256_setr_epi32(4, 0, 4, 0, 4, 0, 4, 0);
+         break;
+
+      case 8:
+         lo = _mm_loadu_si128((const __m128i*)png_index_shuffle[2]);
+         shift = _mm256_setzero_si256();
+         break;
+
+      default:
+         return 0;
+   }
+
+   shuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(lo),
+       _mm_add_epi8(lo, _mm_set1_epi32((int)(bit_depth >> 1))), 1);
+   mask = _mm256_set1_epi32((1 << bit_depth) - 1);
+   rgb = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+       -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+   png_expand_palette_tail(png_ptr->riffled_palette, row, n, width, bit_depth,
+       channels);
+
+   while (n > 0)
+   {
+      png_const_bytep sp;
+      png_bytep dp;
+      __m128i in;
+      __m256i index, v;
+
+      n -= 8;
+      sp = row + ((n * bit_depth) >> 3);
+      dp = row + (size_t)n * channels;
+
+      /* The load may include bytes beyond the group; the shuffle ignores
+       * them and they are inside the row buffer, which is large enough for
+       * the expanded row.
+       */
+      in = _mm_loadl_epi64((const __m128i*)sp);
+      index = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(in), shuffle);
+      index = _mm256_and_si256(_mm256_srlv_epi32(index, shift), mask);
+      v = _mm256_i32gather_epi32(palette, index, 4);
+
+      if (channels == 4)
+         _mm256_storeu_si256((__m256i*)dp, v);
+
+      else
+      {
+         __m128i hi;
+         int tmp;
+
+         v = _mm256_shuffle_epi8(v, rgb);
+         hi = _mm256_extracti128_si256(v, 1);
+
+         /* The low half has four unused bytes at the end, which the high
+          * half then overwrites.
+          */
+         _mm_storeu_si128((__m128i*)dp, _mm256_castsi256_si128(v));
+         _mm_storel_epi64((__m128i*)(dp + 12), hi);
+         tmp = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+         memcpy(dp + 20, &tmp, sizeof tmp);
+      }
+   }
+
+   png_expand_palette_done(row_info, channels);
+   return 1;
+}
+#endif /* PNG_INTEL_AVX2_OPT > 0 */
+
+#endif /* PNG_INTEL_SSE_IMPLEMENTATION > 0 */
+#endif /* READ_EXPAND */
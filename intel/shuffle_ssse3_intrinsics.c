@@ -0,0 +1,183 @@
+/* shuffle_ssse3_intrinsics.c - SSSE3 byte shuffles for the transformations
+ *                              that only move bytes
+ *
+ * Copyright (c) 2026 agent
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if defined(PNG_READ_SUPPORTED) || defined(PNG_WRITE_SUPPORTED)
+
+#if PNG_INTEL_SSSE3_OPT > 0
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+/* Like the interlace code this is compiled for SSSE3 regardless of the flags
+ * used for the rest of libpng and only installed after
+ * png_init_shuffle_functions_sse2 has checked the CPU.
+ */
+#if PNG_INTEL_SSE_IMPLEMENTATION < 2 && (defined(__GNUC__) ||\
+    defined(__clang__))
+#  define PNG_SSSE3_TARGET __attribute__((target("ssse3")))
+#else
+#  define PNG_SSSE3_TARGET
+#endif
+
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+    defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+/* Convert the row with png_ptr->fused_shuffle and fused_xor, a block of
+ * png_ptr->fused_block pixels at a time; see png_init_fused.  The row is done
+ * in place, so each 16 byte store may overwrite input that has not been used
+ * yet.  The next block is always loaded before the store, which is enough for
+ * the rest of the row except for the pixels that do not fill a whole load,
+ * at the start of the row if the pixels get bigger and at the end otherwise.
+ * These are saved first then converted by png_do_fused.
+ */
+void PNG_SSSE3_TARGET
+png_do_fused_ssse3(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   unsigned int in = png_ptr->fused_in_bytes;
+   unsigned int out = png_ptr->fused_out_bytes;
+   size_t in_step = png_ptr->fused_block * in;
+   size_t out_step = png_ptr->fused_block * out;
+   size_t row_in = (size_t)width * in;
+   const __m128i shuffle =
+       _mm_loadu_si128((const __m128i*)png_ptr->fused_shuffle);
+   const __m128i invert = _mm_loadu_si128((const __m128i*)png_ptr->fused_xor);
+   png_byte save[16];
+   png_uint_32 rest;
+   size_t blocks;
+   __m128i v, next;
+
+   if (row_in < 16)
+   {
+      png_do_fused(png_ptr, row, width);
+      return;
+   }
+
+   /* Every load is of 16 bytes within the input row. */
+   blocks = (row_in - 16) / in_step + 1;
+   rest = width - (png_uint_32)(blocks * png_ptr->fused_block);
+
+   if (out > in)
+   {
+      png_const_bytep sp = row + row_in;
+      png_bytep dp = row + (size_t)width * out;
+
+      memcpy(save, row, rest * in);
+      v = _mm_loadu_si128((const __m128i*)(sp - 16));
+
+      while (--blocks > 0)
+      {
+         sp -= in_step;
+         next = _mm_loadu_si128((const __m128i*)(sp - 16));
+         _mm_storeu_si128((__m128i*)(dp - 16),
+             _mm_xor_si128(_mm_shuffle_epi8(v, shuffle), invert));
+         dp -= out_step;
+         v = next;
+      }
+
+      _mm_storeu_si128((__m128i*)(dp - 16),
+          _mm_xor_si128(_mm_shuffle_epi8(v, shuffle), invert));
+
+      memcpy(row, save, rest * in);
+      png_do_fused(png_ptr, row, rest);
+   }
+
+   else
+   {
+      png_const_bytep sp = row;
+      png_bytep dp = row;
+
+      memcpy(save, row + blocks * in_step, rest * in);
+      v = _mm_loadu_si128((const __m128i*)sp);
+
+      while (--blocks > 0)
+      {
+         sp += in_step;
+         next = _mm_loadu_si128((const __m128i*)sp);
+         _mm_storeu_si128((__m128i*)dp,
+             _mm_xor_si128(_mm_shuffle_epi8(v, shuffle), invert));
+         dp += out_step;
+         v = next;
+      }
+
+      _mm_storeu_si128((__m128i*)dp,
+          _mm_xor_si128(_mm_shuffle_epi8(v, shuffle), invert));
+      dp += out_step;
+
+      memcpy(dp, save, rest * in);
+      png_do_fused(png_ptr, dp, rest);
+   }
+}
+#endif /* READ_TRANSFORMS || WRITE_TRANSFORMS */
+
+#if defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+    defined(PNG_WRITE_PACKSWAP_SUPPORTED)
+/* Reversing the order of the pixels in a byte is the same as swapping the
+ * two halves and reversing the pixels in each half, so each of the tables in
+ * pngtrans.c is two 16 entry lookups, one for each half.  These are the
+ * lookups for the high halves; the results for the low halves are the same
+ * shifted up by 4 bits.
+ */
+static const png_byte png_packswap_half[3][16] =
+{
+   { /* 1 bit */
+      0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+      0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+   },
+   { /* 2 bits */
+      0x0, 0x4, 0x8, 0xC, 0x1, 0x5, 0x9, 0xD,
+      0x2, 0x6, 0xA, 0xE, 0x3, 0x7, 0xB, 0xF
+   },
+   { /* 4 bits */
+      0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7,
+      0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF
+   }
+};
+
+int PNG_SSSE3_TARGET
+png_do_packswap_ssse3(png_row_infop row_info, png_bytep row)
+{
+   const __m128i low_bits = _mm_set1_epi8(0x0f);
+   png_const_bytep half;
+   png_bytep end = row + row_info->rowbytes;
+   __m128i high, low;
+
+   switch (row_info->bit_depth)
+   {
+      case 1: half = png_packswap_half[0]; break;
+      case 2: half = png_packswap_half[1]; break;
+      case 4: half = png_packswap_half[2]; break;
+      default: return 0;
+   }
+
+   high = _mm_loadu_si128((const __m128i*)half);
+   low = _mm_slli_epi16(high, 4);
+
+   for (; end - row >= 16; row += 16)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)row);
+
+      v = _mm_or_si128(
+          _mm_shuffle_epi8(low, _mm_and_si128(v, low_bits)),
+          _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(v, 4),
+          low_bits)));
+      _mm_storeu_si128((__m128i*)row, v);
+   }
+
+   for (; row < end; ++row)
+      *row = (png_byte)((half[*row & 0xf] << 4) | half[*row >> 4]);
+
+   return 1;
+}
+#endif /* READ_PACKSWAP || WRITE_PACKSWAP */
+
+#endif /* PNG_INTEL_SSSE3_OPT > 0 */
+#endif /* READ || WRITE */
@@ -2969,6 +2969,28 @@ typedef struct
     * because that call initializes the 'flags' field.
     */
 
+#define PNG_IMAGE_FLAG_TRUSTED_INPUT 0x08
+   /* On read neither calculate nor check the CRC of the chunks or the ADLER32
+    * of the compressed data read by png_image_finish_read.  Only use this
+    * flag for PNG data that is known to be intact, for example because it has
+    * already been checked by some other means; damaged data will produce an
+    * incorrect image rather than an error.  The flag has no effect on write.
+    *
+    * NOTE: like PNG_IMAGE_FLAG_16BIT_sRGB the flag can only be set after the
+    * png_image_begin_read_ call, so the chunks before the image data are
+    * always checked.
+    */
+
+#define PNG_IMAGE_FLAG_RESTART_POINTS 0x10
+   /* On write split the image data of a non-interlaced image into groups of
+    * rows that can be decompressed independently of each other and record the
+    * start of each group in a private 'riDX' chunk after the IDAT chunks.
+    * This makes the file slightly larger; other decoders ignore the chunk.  A
+    * libpng built with PNG_READ_PARALLEL_SUPPORTED uses it to decode the
+    * groups on several threads when the whole PNG is in memory (see
+    * png_image_begin_read_from_memory.)  The flag has no effect on read.
+    */
+
 #ifdef PNG_SIMPLIFIED_READ_SUPPORTED
 /* READ APIs
  * ---------
@@ -3211,7 +3233,9 @@ PNG_EXPORT(245, int, png_image_write_to_memory, (png_imagep image, void *memory,
 #ifdef PNG_POWERPC_VSX_API_SUPPORTED
 #  define PNG_POWERPC_VSX   10 /* HARDWARE: PowerPC VSX SIMD instructions supported */
 #endif
-#define PNG_OPTION_NEXT  12 /* Next option - numbers must be even */
+#define PNG_SKIP_CHECKSUMS 12 /* SOFTWARE: don't calculate CRC or ADLER32 */
+#define PNG_APPROXIMATE_GAMMA_16 14 /* SOFTWARE: calculate 16-bit gamma */
+#define PNG_OPTION_NEXT  16 /* Next option - numbers must be even */
 
 /* Return values: NOTE: there are four values and 'off' is *not* zero */
 #define PNG_OPTION_UNSET   0 /* Unset - defaults to off */
@@ -3227,6 +3251,196 @@ PNG_EXPORT(244, int, png_set_option, (png_structrp png_ptr, int option,
  *  END OF HARDWARE AND SOFTWARE OPTIONS
  ******************************************************************************/
 
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+/* Compress the IDAT data using up to 'num_threads' threads.  The filtered
+ * image data is split into independent groups that are deflated concurrently
+ * and joined into a single zlib stream, so the result is an ordinary PNG file.
+ * The compressed data is not identical to (and is usually very slightly larger
+ * than) the data produced by a single thread, but it does not depend on the
+ * number of threads.  Values less than 2 select the normal serial compressor,
+ * which is also used for small images.
+ */
+PNG_EXPORT(250, void, png_set_compression_threads, (png_structrp png_ptr,
+    int num_threads));
+#endif
+
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+/* Replace the zlib functions used to compress and decompress IDAT and the
+ * other compressed chunks, for example with zlib-ng, libdeflate or Intel ISA-L.
+ * Each function receives a pointer to the zlib z_stream owned by libpng and
+ * must behave as the zlib function it replaces, including the handling of
+ * next_in, avail_in, next_out, avail_out and msg.  The zalloc, zfree and opaque
+ * members of the z_stream are set by libpng and may be used to allocate memory.
+ * Members that are NULL use the zlib function; the compression and the
+ * decompression functions should each be replaced as a set.  A NULL 'backend'
+ * restores zlib.  This cannot be called while a chunk is being compressed or
+ * decompressed.
+ *
+ * With png_set_compression_threads or PNG_READ_PARALLEL_SUPPORTED the IDAT
+ * functions are called at the same time from several threads, each with its
+ * own z_stream, so the backend must then be thread safe.  Those z_streams have
+ * zalloc, zfree and opaque set to Z_NULL, so their memory is allocated with the
+ * zlib (or backend) default allocator and not the png_set_mem_fn functions.
+ *
+ * The two optional whole-buffer functions are used when all the data is in
+ * memory at once: inflate_buffer for the IDAT data of a PNG read with
+ * png_image_begin_read_from_memory (or a mapped file) and deflate_buffer for
+ * the compressed text and iCCP chunks.  They behave as zlib uncompress and
+ * compress2: a complete zlib stream is decompressed from, or compressed to,
+ * dst, *dst_len is the size of dst on entry and the number of bytes written on
+ * return, and a zlib return code is returned, Z_OK on success.  On failure
+ * libpng uses the stream functions instead, so the functions need not handle
+ * every case; NULL members are not used.
+ */
+typedef struct png_zlib_backend
+{
+   int (PNGCBAPI *deflate_init2)(png_voidp zstream, int level, int method,
+       int window_bits, int mem_level, int strategy);
+   int (PNGCBAPI *deflate_reset)(png_voidp zstream);
+   int (PNGCBAPI *deflate_set_dictionary)(png_voidp zstream,
+       png_const_bytep dictionary, unsigned int length);
+   unsigned long (PNGCBAPI *deflate_bound)(png_voidp zstream,
+       unsigned long source_len);
+   int (PNGCBAPI *deflate_data)(png_voidp zstream, int flush);
+   int (PNGCBAPI *deflate_end)(png_voidp zstream);
+
+   int (PNGCBAPI *inflate_init2)(png_voidp zstream, int window_bits);
+   int (PNGCBAPI *inflate_reset)(png_voidp zstream);
+   int (PNGCBAPI *inflate_reset2)(png_voidp zstream, int window_bits);
+   int (PNGCBAPI *inflate_validate)(png_voidp zstream, int check);
+   int (PNGCBAPI *inflate_data)(png_voidp zstream, int flush);
+   int (PNGCBAPI *inflate_end)(png_voidp zstream);
+
+   int (PNGCBAPI *deflate_buffer)(png_bytep dst, size_t *dst_len,
+       png_const_bytep src, size_t src_len, int level);
+   int (PNGCBAPI *inflate_buffer)(png_bytep dst, size_t *dst_len,
+       png_const_bytep src, size_t src_len);
+} png_zlib_backend;
+typedef const png_zlib_backend * png_const_zlib_backendp;
+
+PNG_EXPORT(251, void, png_set_zlib_backend, (png_structrp png_ptr,
+    png_const_zlib_backendp backend));
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+PNG_EXPORT(260, int, png_image_set_zlib_backend, (png_imagep image,
+    png_const_zlib_backendp backend));
+   /* Call between png_image_begin_read_ and png_image_finish_read to use the
+    * given functions, as png_set_zlib_backend, to decompress the image.
+    * Returns 0 (and frees the image) if the image is not being read.
+    */
+#endif
+#endif
+
+#if defined(PNG_SIMPLIFIED_READ_SUPPORTED) && defined(PNG_STDIO_SUPPORTED)
+PNG_EXPORT(252, int, png_image_begin_read_from_mapped_file, (png_imagep image,
+   const char *file_name));
+   /* As png_image_begin_read_from_file but, where the system supports it, the
+    * named file is mapped into memory and read as if by
+    * png_image_begin_read_from_memory, avoiding the copy through stdio.  The
+    * mapping is released by png_image_free (png_image_finish_read calls it.)
+    * If the file cannot be mapped it is read with stdio instead.  The file
+    * must not be truncated while it is mapped; on most systems that raises a
+    * signal (SIGBUS) rather than a png error.
+    */
+#endif
+
+#ifdef PNG_READ_BORROW_SUPPORTED
+/* An optional companion to the read function for input that is already in
+ * memory (a buffer or a mapped file.)  The function returns a pointer to the
+ * next 'length' bytes of the input and advances past them, exactly as if
+ * read_data_fn had copied them.  The data must remain valid and unchanged
+ * until the png_struct is destroyed.  The function may return NULL, without
+ * consuming any input, in which case libpng reads the data with read_data_fn.
+ * When the function is available libpng decompresses IDAT, iCCP and zTXt and
+ * stores eXIf directly from the input rather than copying it first.
+ *
+ * png_set_read_fn removes any borrow function, so call png_set_read_borrow_fn
+ * after it.  The function is not used by the progressive reader.
+ */
+typedef PNG_CALLBACK(png_const_bytep, *png_borrow_ptr, (png_structp, size_t));
+
+PNG_EXPORT(253, void, png_set_read_borrow_fn, (png_structrp png_ptr,
+    png_borrow_ptr borrow_data_fn));
+#endif
+
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+/* Make every 'nrows'th row of a non-interlaced image a restart point, or turn
+ * restart points off with 0.  At a restart point the compressor is fully
+ * flushed (Z_FULL_FLUSH) and the row is filtered with a filter that does not
+ * use the previous row, so the IDAT data can be decompressed from there on
+ * without the data before it.  The restart points are listed in a private
+ * 'riDX' chunk after the IDAT chunks.  Call this before writing the image
+ * data.
+ */
+PNG_EXPORT(254, void, png_set_restart_points, (png_structrp png_ptr,
+    png_uint_32 nrows));
+
+/* Returns the number of restart points written so far and sets *points to
+ * an array of that many pairs of values: the row number and the offset of the
+ * row in the zlib stream formed by the concatenated IDAT chunk data.  The
+ * array remains valid until the png_struct is destroyed.
+ */
+PNG_EXPORT(255, png_uint_32, png_get_restart_points,
+    (png_const_structrp png_ptr, png_const_uint_32p *points));
+#endif
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+PNG_EXPORT(256, int, png_image_set_crop, (png_imagep image, png_uint_32 x,
+   png_uint_32 y, png_uint_32 width, png_uint_32 height));
+   /* Call between png_image_begin_read_ and png_image_finish_read to read only
+    * the given rectangle of the image; image->width and image->height are set
+    * to the size of the rectangle, so the PNG_IMAGE_ macros and the row_stride
+    * of png_image_finish_read apply to the rectangle.  For a non-interlaced
+    * image the rows above the rectangle are only decompressed, the columns
+    * outside it are not transformed and no data after its last row is read.
+    * An interlaced image is decoded in full, into a temporary buffer, and the
+    * rectangle copied from it.  Returns 0 (and frees the image) if the
+    * rectangle is not inside the image.
+    */
+#endif
+
+#ifdef PNG_SEQUENTIAL_READ_SUPPORTED
+PNG_EXPORT(257, void, png_set_read_stop_row, (png_structrp png_ptr,
+   png_uint_32 nrows));
+   /* Stop reading the image data of a non-interlaced image after the first
+    * nrows rows: the inflate stream is released and the rest of the IDAT data
+    * is skipped without decompressing it or checking its CRC.  png_read_end
+    * may still be called to read the chunks after IDAT.  If nrows rows have
+    * already been read the image data is abandoned at once.  nrows 0 (the
+    * default) reads the whole image.
+    */
+#endif
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+PNG_EXPORT(258, int, png_image_set_reduction, (png_imagep image,
+   unsigned int factor));
+   /* Call between png_image_begin_read_ and png_image_finish_read to reduce
+    * the image, or the png_image_set_crop rectangle, by 2, 4 or 8 in each
+    * direction (1 cancels the reduction); image->width and image->height are
+    * set to the reduced size, rounded up.  For a non-interlaced image each
+    * block of pixels is averaged as the rows are read, so the conversion to
+    * the output format is only done on the reduced image.  Interlaced images
+    * are decoded in full and each block averaged after the conversion, which
+    * gives the same result unless the conversion changes the sample values.
+    * Palette images, those with less than 8 bits per sample and those with a
+    * tRNS chunk are point sampled.
+    * Returns 0 (and frees the image) if the factor is not supported.
+    */
+#endif
+
+#ifdef PNG_SEQUENTIAL_READ_SUPPORTED
+PNG_EXPORT(259, void, png_set_read_last_pass, (png_structrp png_ptr,
+   int pass));
+   /* Stop reading the image data of an interlaced image at the end of the
+    * given Adam7 pass (0 to 6): the inflate stream is released and the rest
+    * of the IDAT data is skipped, as by png_set_read_stop_row.  Call it before
+    * png_set_interlace_handling, which then returns pass+1.  Without
+    * png_set_interlace_handling the rows of each pass are returned as they
+    * are stored, so pass 0 alone is an image 1/8 of the width and height of
+    * the full image; with it each row is expanded to the full width.
+    */
+#endif
+
 /* Maintainer: Put new public prototypes here ^, in libpng.3, in project
  * defs, and in scripts/symbols.def.
  */
@@ -3235,7 +3449,7 @@ PNG_EXPORT(244, int, png_set_option, (png_structrp png_ptr, int option,
  * one to use is one more than this.)
  */
 #ifdef PNG_EXPORT_LAST_ORDINAL
-  PNG_EXPORT_LAST_ORDINAL(249);
+  PNG_EXPORT_LAST_ORDINAL(260);
 #endif
 
 #ifdef __cplusplus
@@ -1233,6 +1233,18 @@ png_get_io_chunk_type (png_const_structrp png_ptr)
 }
 #endif /* IO_STATE */
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+png_uint_32 PNGAPI
+png_get_restart_points(png_const_structrp png_ptr, png_const_uint_32p *points)
+{
+   if (png_ptr == NULL || points == NULL)
+      return 0;
+
+   *points = png_ptr->restart_points;
+   return png_ptr->num_restart_points;
+}
+#endif
+
 #ifdef PNG_CHECK_FOR_INVALID_INDEX_SUPPORTED
 #  ifdef PNG_GET_PALETTE_MAX_SUPPORTED
 int PNGAPI
@@ -786,7 +786,9 @@ png_push_process_row(png_structrp png_ptr)
    if (png_ptr->interlaced != 0 &&
        (png_ptr->transformations & PNG_INTERLACE) != 0)
    {
-      if (png_ptr->pass < 6)
+      if (png_ptr->pass < 6 && (png_ptr->read_interlace == NULL ||
+          png_ptr->read_interlace(&row_info, png_ptr->row_buf + 1,
+          png_ptr->pass) == 0))
          png_do_read_interlace(&row_info, png_ptr->row_buf + 1, png_ptr->pass,
              png_ptr->transformations);
 
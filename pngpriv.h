@@ -185,6 +185,12 @@
       /* Use the intrinsics code by default. */
 #     define PNG_ARM_NEON_IMPLEMENTATION 1
 #  endif
+
+#  if PNG_ARM_NEON_IMPLEMENTATION == 1
+      /* There is no assembler version of the write filters. */
+#     define PNG_WRITE_FILTER_OPTIMIZATIONS\
+         png_init_write_filter_functions_neon
+#  endif
 #endif /* PNG_ARM_NEON_OPT > 0 */
 
 #ifndef PNG_MIPS_MSA_OPT
@@ -240,11 +246,104 @@
 
 #   if PNG_INTEL_SSE_IMPLEMENTATION > 0
 #      define PNG_FILTER_OPTIMIZATIONS png_init_filter_functions_sse2
+#      define PNG_WRITE_FILTER_OPTIMIZATIONS\
+          png_init_write_filter_functions_sse2
 #   endif
 #else
 #   define PNG_INTEL_SSE_IMPLEMENTATION 0
 #endif
 
+#ifndef PNG_INTEL_AVX2_OPT
+   /* The AVX2 code in intel/filter_avx2_intrinsics.c is compiled with a
+    * function-level target attribute, so it does not need -mavx2 in CFLAGS;
+    * png_init_filter_functions_sse2 only installs it after checking the CPU at
+    * run time.  This requires a compiler that supports the attribute (or, with
+    * MSVC, accepts AVX2 intrinsics unconditionally.)  To disable the AVX2 code
+    * put -DPNG_INTEL_AVX2_OPT=0 in CPPFLAGS.
+    */
+#  if PNG_INTEL_SSE_IMPLEMENTATION > 0 && (defined(__clang__) ||\
+      (defined(__GNUC__) && (__GNUC__ > 4 ||\
+         (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) ||\
+      (defined(_MSC_VER) && _MSC_VER >= 1800))
+#     define PNG_INTEL_AVX2_OPT 1
+#  else
+#     define PNG_INTEL_AVX2_OPT 0
+#  endif
+#endif
+
+#ifndef PNG_INTEL_PCLMUL_OPT
+   /* The CRC-32 code in intel/crc32_pclmul_intrinsics.c uses the carry-less
+    * multiply instruction, PCLMULQDQ.  Like the AVX2 code it is compiled with
+    * a target attribute and only used after a run-time check of the CPU.  To
+    * disable it put -DPNG_INTEL_PCLMUL_OPT=0 in CPPFLAGS.
+    */
+#  if PNG_INTEL_SSE_IMPLEMENTATION > 0 && (defined(__clang__) ||\
+      (defined(__GNUC__) && (__GNUC__ > 4 ||\
+         (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) ||\
+      (defined(_MSC_VER) && _MSC_VER >= 1800))
+#     define PNG_INTEL_PCLMUL_OPT 1
+#  else
+#     define PNG_INTEL_PCLMUL_OPT 0
+#  endif
+#endif
+
+#if PNG_INTEL_PCLMUL_OPT > 0
+#  define PNG_CRC_OPTIMIZATIONS png_init_crc_functions_sse2
+#endif
+
+#ifndef PNG_INTEL_SSSE3_OPT
+   /* The byte shuffle used to expand interlaced RGB rows needs SSSE3; it is
+    * built in whenever the compiler can target it, either because SSSE3 is
+    * enabled for the whole build or, like the AVX2 code, with a target
+    * attribute and a run-time check.
+    */
+#  if PNG_INTEL_SSE_IMPLEMENTATION >= 2 || PNG_INTEL_AVX2_OPT > 0
+#     define PNG_INTEL_SSSE3_OPT 1
+#  else
+#     define PNG_INTEL_SSSE3_OPT 0
+#  endif
+#endif
+
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0
+#  define PNG_INTERLACE_OPTIMIZATIONS png_init_interlace_functions_sse2
+#  define PNG_PALETTE_OPTIMIZATIONS png_init_palette_functions_sse2
+#  define PNG_GAMMA_OPTIMIZATIONS png_init_gamma_functions_sse2
+#endif
+
+#if PNG_INTEL_SSSE3_OPT > 0
+#  define PNG_SHUFFLE_OPTIMIZATIONS png_init_shuffle_functions_sse2
+#endif
+
+#ifndef PNG_ARM_PMULL_OPT
+   /* The CRC-32 code in arm/crc32_neon_intrinsics.c uses the 64-bit polynomial
+    * multiply (PMULL) from the ARMv8 cryptography extension.  Unlike NEON this
+    * is optional in ARMv8, so it is only used if the compiler has been told
+    * that the target has it (for example with -march=armv8-a+crypto.)
+    */
+#  if PNG_ARM_NEON_IMPLEMENTATION == 1 && defined(__aarch64__) &&\
+      (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#     define PNG_ARM_PMULL_OPT 1
+#  else
+#     define PNG_ARM_PMULL_OPT 0
+#  endif
+#endif
+
+#if PNG_ARM_PMULL_OPT > 0
+#  define PNG_CRC_OPTIMIZATIONS png_init_crc_functions_neon
+#endif
+
+/* The NEON gamma correction uses the AArch64 four register table lookup. */
+#if PNG_ARM_NEON_IMPLEMENTATION == 1 && (defined(__aarch64__) ||\
+    defined(_M_ARM64))
+#  define PNG_ARM_NEON_GAMMA 1
+#  define PNG_GAMMA_OPTIMIZATIONS png_init_gamma_functions_neon
+#endif
+
+/* The byte shuffles use TBL (VTBL on 32-bit ARM) */
+#if PNG_ARM_NEON_IMPLEMENTATION == 1
+#  define PNG_SHUFFLE_OPTIMIZATIONS png_init_shuffle_functions_neon
+#endif
+
 #if PNG_MIPS_MSA_OPT > 0
 #  define PNG_FILTER_OPTIMIZATIONS png_init_filter_functions_msa
 #  ifndef PNG_MIPS_MSA_IMPLEMENTATION
@@ -446,6 +545,38 @@
 #  define PNG_ZBUF_SIZE 65536L
 #endif
 
+/* Multi-threaded IDAT compression: the amount of filtered data compressed by
+ * one thread in one step and the maximum number of threads.  The group size
+ * must be at least the 32768 byte deflate window.
+ */
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+#  ifndef PNG_ZPARALLEL_GROUP_SIZE
+#    define PNG_ZPARALLEL_GROUP_SIZE 262144
+#  endif
+#  ifndef PNG_ZPARALLEL_MAX_THREADS
+#    define PNG_ZPARALLEL_MAX_THREADS 64
+#  endif
+#endif
+
+/* Restart points: the amount of filtered data in each group of rows written by
+ * the simplified API with PNG_IMAGE_FLAG_RESTART_POINTS and the limits on the
+ * number of threads used to decode the groups; the minimum is there so that
+ * the threaded code can be tested on a single processor.
+ */
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+#  ifndef PNG_RESTART_GROUP_SIZE
+#    define PNG_RESTART_GROUP_SIZE 1048576
+#  endif
+#endif
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+#  ifndef PNG_READ_PARALLEL_MIN_THREADS
+#    define PNG_READ_PARALLEL_MIN_THREADS 1
+#  endif
+#  ifndef PNG_READ_PARALLEL_MAX_THREADS
+#    define PNG_READ_PARALLEL_MAX_THREADS 64
+#  endif
+#endif
+
 /* If warnings or errors are turned off the code is disabled or redirected here.
  * From 1.5.4 functions have been added to allow very limited formatting of
  * error and warning messages - this code will also be disabled here.
@@ -678,7 +809,7 @@
 /* Flags for the png_ptr->flags rather than declaring a byte for each one */
 #define PNG_FLAG_ZLIB_CUSTOM_STRATEGY     0x0001U
 #define PNG_FLAG_ZSTREAM_INITIALIZED      0x0002U /* Added to libpng-1.6.0 */
-                                  /*      0x0004U    unused */
+#define PNG_FLAG_IDAT_ABANDONED           0x0004U /* Added to libpng-1.6.38 */
 #define PNG_FLAG_ZSTREAM_ENDED            0x0008U /* Added to libpng-1.6.0 */
                                   /*      0x0010U    unused */
                                   /*      0x0020U    unused */
@@ -863,6 +994,7 @@
 #define png_oFFs PNG_U32(111,  70,  70, 115)
 #define png_pCAL PNG_U32(112,  67,  65,  76)
 #define png_pHYs PNG_U32(112,  72,  89, 115)
+#define png_riDX PNG_U32(114, 105,  68,  88) /* private, restart points */
 #define png_sBIT PNG_U32(115,  66,  73,  84)
 #define png_sCAL PNG_U32(115,  67,  65,  76)
 #define png_sPLT PNG_U32(115,  80,  76,  84)
@@ -1049,6 +1181,47 @@ PNG_INTERNAL_FUNCTION(voidpf,png_zalloc,(voidpf png_ptr, uInt items, uInt size),
 /* Function to free memory for zlib.  PNGAPI is disallowed. */
 PNG_INTERNAL_FUNCTION(void,png_zfree,(voidpf png_ptr, voidpf ptr),PNG_EMPTY);
 
+/* The zlib functions used by default for png_ptr->zstream; the 'zstream'
+ * argument is a z_streamp.  These are the png_zlib_backend functions if the
+ * application can replace them, in which case PNG_ZLIB(png_ptr, name) is the
+ * function currently in use, otherwise PNG_ZLIB calls these directly.
+ */
+#ifdef PNG_WRITE_SUPPORTED
+PNG_INTERNAL_CALLBACK(int,png_zlib_deflate_init2,(png_voidp zstream, int level,
+   int method, int window_bits, int mem_level, int strategy),PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_deflate_reset,(png_voidp zstream),
+   PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_deflate_set_dictionary,(png_voidp zstream,
+   png_const_bytep dictionary, unsigned int length),PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(unsigned long,png_zlib_deflate_bound,(png_voidp zstream,
+   unsigned long source_len),PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_deflate_data,(png_voidp zstream, int flush),
+   PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_deflate_end,(png_voidp zstream),PNG_EMPTY);
+#endif /* WRITE */
+
+#ifdef PNG_READ_SUPPORTED
+PNG_INTERNAL_CALLBACK(int,png_zlib_inflate_init2,(png_voidp zstream,
+   int window_bits),PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_inflate_reset,(png_voidp zstream),
+   PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_inflate_reset2,(png_voidp zstream,
+   int window_bits),PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_inflate_validate,(png_voidp zstream,
+   int check),PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_inflate_data,(png_voidp zstream, int flush),
+   PNG_EMPTY);
+PNG_INTERNAL_CALLBACK(int,png_zlib_inflate_end,(png_voidp zstream),PNG_EMPTY);
+#endif /* READ */
+
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+PNG_INTERNAL_FUNCTION(void,png_init_zlib_backend,(png_structrp png_ptr,
+   png_const_zlib_backendp backend),PNG_EMPTY);
+#  define PNG_ZLIB(pp, name) (*(pp)->zlib_backend.name)
+#else
+#  define PNG_ZLIB(pp, name) png_zlib_##name
+#endif
+
 /* Next four functions are used internally as callbacks.  PNGCBAPI is required
  * but not PNG_EXPORT.  PNGAPI added at libpng version 1.2.3, changed to
  * PNGCBAPI at 1.5.0
@@ -1109,6 +1282,22 @@ PNG_INTERNAL_FUNCTION(int,png_crc_error,(png_structrp png_ptr),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_calculate_crc,(png_structrp png_ptr,
    png_const_bytep ptr, size_t length),PNG_EMPTY);
 
+/* CRC-32 functions with the semantics of zlib's crc32(); the portable version
+ * and the hardware specific ones that png_calculate_crc may use instead.
+ */
+PNG_INTERNAL_FUNCTION(png_uint_32,png_crc32_slice8,(png_uint_32 crc,
+   png_const_bytep ptr, size_t length),PNG_EMPTY);
+
+#if PNG_INTEL_PCLMUL_OPT > 0
+PNG_INTERNAL_FUNCTION(png_uint_32,png_crc32_pclmul,(png_uint_32 crc,
+   png_const_bytep ptr, size_t length),PNG_EMPTY);
+#endif
+
+#if PNG_ARM_PMULL_OPT > 0
+PNG_INTERNAL_FUNCTION(png_uint_32,png_crc32_pmull,(png_uint_32 crc,
+   png_const_bytep ptr, size_t length),PNG_EMPTY);
+#endif
+
 #ifdef PNG_WRITE_FLUSH_SUPPORTED
 PNG_INTERNAL_FUNCTION(void,png_flush,(png_structrp png_ptr),PNG_EMPTY);
 #endif
@@ -1129,6 +1318,23 @@ PNG_INTERNAL_FUNCTION(void,png_compress_IDAT,(png_structrp png_ptr,
    png_const_bytep row_data, png_alloc_size_t row_data_length, int flush),
    PNG_EMPTY);
 
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+PNG_INTERNAL_FUNCTION(void,png_free_parallel_deflate,(png_structrp png_ptr),
+   PNG_EMPTY);
+   /* Release the threaded IDAT compressor state, if any. */
+#endif
+
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+PNG_INTERNAL_FUNCTION(int,png_write_restart_point,(png_structrp png_ptr),
+   PNG_EMPTY);
+   /* Called for each row before it is filtered; if the row starts a group
+    * flush the compressor and record the restart point.  Returns non-zero if
+    * the row must not be filtered using the previous row.
+    */
+
+PNG_INTERNAL_FUNCTION(void,png_write_riDX,(png_structrp png_ptr),PNG_EMPTY);
+#endif
+
 PNG_INTERNAL_FUNCTION(void,png_write_IEND,(png_structrp png_ptr),PNG_EMPTY);
 
 #ifdef PNG_WRITE_gAMA_SUPPORTED
@@ -1282,6 +1488,24 @@ PNG_INTERNAL_FUNCTION(void,png_combine_row,(png_const_structrp png_ptr,
  */
 PNG_INTERNAL_FUNCTION(void,png_do_read_interlace,(png_row_infop row_info,
     png_bytep row, int pass, png_uint_32 transformations),PNG_EMPTY);
+
+/* Hardware specific versions of the above for whole byte pixels, installed
+ * by PNG_INTERLACE_OPTIMIZATIONS.  They return 0, having done nothing, for
+ * the cases they do not handle.  The png_combine_row one copies the first
+ * 'copy' bytes of every 'jump' bytes from sp to dp.
+ */
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0
+PNG_INTERNAL_FUNCTION(int,png_read_interlace_sse2,(png_row_infop row_info,
+    png_bytep row, int pass),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(int,png_combine_row_sse2,(png_bytep dp,
+    png_const_bytep sp, size_t length, unsigned int copy, unsigned int jump),
+    PNG_EMPTY);
+#endif
+
+#if PNG_INTEL_SSSE3_OPT > 0
+PNG_INTERNAL_FUNCTION(int,png_read_interlace_ssse3,(png_row_infop row_info,
+    png_bytep row, int pass),PNG_EMPTY);
+#endif
 #endif
 
 /* GRR TO DO (2.0 or whenever):  simplify other internal calling interfaces */
@@ -1301,6 +1525,14 @@ PNG_INTERNAL_FUNCTION(void,png_read_filter_row,(png_structrp pp, png_row_infop
 #if PNG_ARM_NEON_OPT > 0
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_up_neon,(png_row_infop row_info,
     png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub1_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub2_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg2_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth2_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub3_neon,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub4_neon,(png_row_infop
@@ -1313,6 +1545,18 @@ PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_neon,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_neon,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub6_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub8_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg6_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg8_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth6_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth8_neon,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 #endif
 
 #if PNG_MIPS_MSA_OPT > 0
@@ -1350,6 +1594,14 @@ PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_vsx,(png_row_infop
 #endif
 
 #if PNG_INTEL_SSE_IMPLEMENTATION > 0
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub1_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub2_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg2_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth2_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub3_sse2,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub4_sse2,(png_row_infop
@@ -1362,12 +1614,108 @@ PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_sse2,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_sse2,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub6_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub8_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg6_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg8_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth6_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth8_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+#endif
+
+#if PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_up_avx2,(png_row_infop row_info,
+    png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub1_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub2_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub3_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub4_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth6_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth8_avx2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 #endif
 
 /* Choose the best filter to use and filter the row data */
 PNG_INTERNAL_FUNCTION(void,png_write_find_filter,(png_structrp png_ptr,
     png_row_infop row_info),PNG_EMPTY);
 
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* Filter a row for writing: these store the filtered bytes of 'row' in
+ * 'filtered_row' and return the sum of their absolute values (as signed bytes)
+ * but may stop early, returning a partial sum, once it exceeds lmins.  None of
+ * the pointers include the filter byte.  The png_write_filter_sums functions
+ * compute the full sums for all five filters, indexed by PNG_FILTER_VALUE_,
+ * in a single pass without storing any filtered bytes.
+ */
+#if PNG_ARM_NEON_IMPLEMENTATION == 1
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_sub_neon,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_up_neon,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_avg_neon,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_paeth_neon,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_filter_sums_neon,(png_const_bytep row,
+    png_const_bytep prev_row, size_t row_bytes, unsigned int bpp,
+    size_t *sums),PNG_EMPTY);
+#endif
+
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_sub_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_up_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_avg_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_paeth_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_filter_sums_sse2,(png_const_bytep row,
+    png_const_bytep prev_row, size_t row_bytes, unsigned int bpp,
+    size_t *sums),PNG_EMPTY);
+#endif
+
+#if PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_sub_avx2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_up_avx2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_avg_avx2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(size_t,png_write_filter_row_paeth_avx2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep filtered_row,
+    size_t row_bytes, unsigned int bpp, size_t lmins),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_write_filter_sums_avx2,(png_const_bytep row,
+    png_const_bytep prev_row, size_t row_bytes, unsigned int bpp,
+    size_t *sums),PNG_EMPTY);
+#endif
+#endif /* WRITE_FILTER */
+
 #ifdef PNG_SEQUENTIAL_READ_SUPPORTED
 PNG_INTERNAL_FUNCTION(void,png_read_IDAT_data,(png_structrp png_ptr,
    png_bytep output, png_alloc_size_t avail_out),PNG_EMPTY);
@@ -1381,6 +1729,17 @@ PNG_INTERNAL_FUNCTION(void,png_read_finish_IDAT,(png_structrp png_ptr),
    /* This cleans up when the IDAT LZ stream does not end when the last image
     * byte is read; there is still some pending input.
     */
+PNG_INTERNAL_FUNCTION(void,png_read_stop_IDAT,(png_structrp png_ptr),
+   PNG_EMPTY);
+   /* Abandon the rest of the IDAT stream at png_ptr->read_stop_row or after
+    * png_ptr->read_passes: release the inflate stream and skip the remaining
+    * IDAT data unchecked.
+    */
+PNG_INTERNAL_FUNCTION(void,png_skip_chunk_data,(png_structrp png_ptr,
+   png_uint_32 length),PNG_EMPTY);
+   /* Discard 'length' bytes of chunk data and the chunk CRC without
+    * calculating or checking the CRC.
+    */
 
 PNG_INTERNAL_FUNCTION(void,png_read_finish_row,(png_structrp png_ptr),
    PNG_EMPTY);
@@ -1395,7 +1754,8 @@ PNG_INTERNAL_FUNCTION(int,png_zlib_inflate,(png_structrp png_ptr, int flush),
       PNG_EMPTY);
 #  define PNG_INFLATE(pp, flush) png_zlib_inflate(pp, flush)
 #else /* Zlib < 1.2.4 */
-#  define PNG_INFLATE(pp, flush) inflate(&(pp)->zstream, flush)
+#  define PNG_INFLATE(pp, flush)\
+      PNG_ZLIB(pp, inflate_data)(&(pp)->zstream, flush)
 #endif /* Zlib < 1.2.4 */
 
 #ifdef PNG_READ_TRANSFORMS_SUPPORTED
@@ -1420,8 +1780,8 @@ PNG_INTERNAL_FUNCTION(void,png_do_swap,(png_row_infop row_info,
 
 #if defined(PNG_READ_PACKSWAP_SUPPORTED) || \
     defined(PNG_WRITE_PACKSWAP_SUPPORTED)
-PNG_INTERNAL_FUNCTION(void,png_do_packswap,(png_row_infop row_info,
-    png_bytep row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_do_packswap,(png_const_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
 #endif
 
 #if defined(PNG_READ_INVERT_SUPPORTED) || defined(PNG_WRITE_INVERT_SUPPORTED)
@@ -1434,6 +1794,49 @@ PNG_INTERNAL_FUNCTION(void,png_do_bgr,(png_row_infop row_info,
     png_bytep row),PNG_EMPTY);
 #endif
 
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) || \
+    defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+/* The transformations that only move, drop, insert or invert whole bytes of
+ * each pixel are worked out once per image by following a single pixel
+ * through them; see png_init_read_fused in pngrtran.c and
+ * png_init_write_fused in pngwtran.c.  Each output byte is source[i] of the
+ * input pixel XORed with value[i]; a source of 8 selects a zero byte, so the
+ * output is value[i].  Pixels have at most 8 bytes at every step.  On read
+ * the gamma correction of 8-bit samples is also included: if gamma is not NULL
+ * the first gamma_bytes bytes of the input pixel, the color samples, are
+ * looked up in it before they are moved.
+ */
+typedef struct
+{
+   png_byte color_type;
+   png_byte bit_depth;
+   png_byte channels;
+   png_byte bytes;
+   png_byte source[8];
+   png_byte value[8];
+   png_const_bytep gamma;
+   png_byte gamma_bytes;
+} png_fused_pixel;
+
+/* Replace the pixel with the 'n' bytes at the positions in 'pick'. */
+PNG_INTERNAL_FUNCTION(void,png_fused_pick,(png_fused_pixel *pixel,
+    png_const_bytep pick, unsigned int n),PNG_EMPTY);
+
+/* Invert 'n' bytes of the pixel starting at 'first'. */
+PNG_INTERNAL_FUNCTION(void,png_fused_invert,(png_fused_pixel *pixel,
+    unsigned int first, unsigned int n),PNG_EMPTY);
+
+/* Set png_ptr->do_fused to convert pixels of 'in' bytes to 'pixel', or to
+ * NULL if that only leaves the pixels unchanged or gamma corrected.
+ */
+PNG_INTERNAL_FUNCTION(void,png_init_fused,(png_structrp png_ptr,
+    const png_fused_pixel *pixel, unsigned int in),PNG_EMPTY);
+
+/* The C version of png_ptr->do_fused, for any pixel sizes. */
+PNG_INTERNAL_FUNCTION(void,png_do_fused,(png_const_structrp png_ptr,
+    png_bytep row, png_uint_32 width),PNG_EMPTY);
+#endif
+
 /* The following decodes the appropriate chunks, and does error correction,
  * then calls the appropriate callback for the chunk if it is valid.
  */
@@ -1567,6 +1970,8 @@ PNG_INTERNAL_FUNCTION(void,png_do_read_transformations,(png_structrp png_ptr,
 #ifdef PNG_WRITE_TRANSFORMS_SUPPORTED
 PNG_INTERNAL_FUNCTION(void,png_do_write_transformations,(png_structrp png_ptr,
    png_row_infop row_info),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_init_write_transformations,
+   (png_structrp png_ptr),PNG_EMPTY);
 #endif
 
 #ifdef PNG_READ_TRANSFORMS_SUPPORTED
@@ -2031,6 +2436,16 @@ PNG_INTERNAL_FUNCTION(void,png_build_gamma_table,(png_structrp png_ptr,
 /* SIMPLIFIED READ/WRITE SUPPORT */
 #if defined(PNG_SIMPLIFIED_READ_SUPPORTED) ||\
    defined(PNG_SIMPLIFIED_WRITE_SUPPORTED)
+/* png_image_begin_read_from_mapped_file maps the file into memory on systems
+ * where this is known to be possible; elsewhere it falls back to stdio.
+ * Define PNG_NO_MMAP to always use stdio.
+ */
+#if defined(PNG_SIMPLIFIED_READ_SUPPORTED) && defined(PNG_STDIO_SUPPORTED) &&\
+   !defined(PNG_NO_MMAP) && (defined(_WIN32) || defined(__unix__) ||\
+   (defined(__APPLE__) && defined(__MACH__)))
+#  define PNG_MMAP_FILE
+#endif
+
 /* The internal structure that png_image::opaque points to. */
 typedef struct png_control
 {
@@ -2041,10 +2456,20 @@ typedef struct png_control
    png_const_bytep memory;          /* Memory buffer. */
    size_t          size;            /* Size of the memory buffer. */
 
+#ifdef PNG_MMAP_FILE
+   png_voidp       mapped;          /* Base of a mapped file, else NULL */
+   size_t          mapped_size;     /* Size of the mapping */
+#endif
+
    unsigned int for_write       :1; /* Otherwise it is a read structure */
    unsigned int owned_file      :1; /* We own the file in io_ptr */
 } png_control;
 
+#ifdef PNG_MMAP_FILE
+/* Release the file mapping made by png_image_begin_read_from_mapped_file. */
+PNG_INTERNAL_FUNCTION(void,png_image_unmap_file,(png_controlp cp),PNG_EMPTY);
+#endif
+
 /* Return the pointer to the jmp_buf from a png_control: necessary because C
  * does not reveal the type of the elements of jmp_buf.
  */
@@ -2114,6 +2539,65 @@ PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_sse2,
 #  endif
 #endif
 
+/* The same for the filters used when writing, selected with the macro
+ * PNG_WRITE_FILTER_OPTIMIZATIONS.
+ */
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+PNG_INTERNAL_FUNCTION(void, PNG_WRITE_FILTER_OPTIMIZATIONS,
+   (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+#else
+#  if PNG_ARM_NEON_IMPLEMENTATION == 1
+PNG_INTERNAL_FUNCTION(void, png_init_write_filter_functions_neon,
+   (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+#  endif
+
+#  if PNG_INTEL_SSE_IMPLEMENTATION > 0
+PNG_INTERNAL_FUNCTION(void, png_init_write_filter_functions_sse2,
+   (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+#  endif
+#endif
+
+/* And for the expansion of interlaced rows, PNG_INTERLACE_OPTIMIZATIONS. */
+#if defined(PNG_INTERLACE_OPTIMIZATIONS) &&\
+    defined(PNG_READ_INTERLACING_SUPPORTED)
+PNG_INTERNAL_FUNCTION(void, PNG_INTERLACE_OPTIMIZATIONS, (png_structp png_ptr),
+   PNG_EMPTY);
+#endif
+
+/* And for palette expansion, PNG_PALETTE_OPTIMIZATIONS; this fills in
+ * png_ptr->riffled_palette, which the caller has allocated, and sets
+ * png_ptr->expand_palette.
+ */
+#if defined(PNG_PALETTE_OPTIMIZATIONS) && defined(PNG_READ_EXPAND_SUPPORTED)
+PNG_INTERNAL_FUNCTION(void, PNG_PALETTE_OPTIMIZATIONS, (png_structp png_ptr),
+   PNG_EMPTY);
+#endif
+
+/* And for gamma correction, alpha compositing and conversion to gray,
+ * PNG_GAMMA_OPTIMIZATIONS; this is called after the gamma tables have been
+ * built and sets png_ptr->do_gamma, png_ptr->do_compose and
+ * png_ptr->do_rgb_to_gray.
+ */
+#if defined(PNG_GAMMA_OPTIMIZATIONS) && defined(PNG_READ_GAMMA_SUPPORTED)
+PNG_INTERNAL_FUNCTION(void, PNG_GAMMA_OPTIMIZATIONS, (png_structp png_ptr),
+   PNG_EMPTY);
+#endif
+
+/* And for the byte shuffles, PNG_SHUFFLE_OPTIMIZATIONS; this is called once
+ * the transformations are known, after png_init_fused, and may replace
+ * png_ptr->do_fused and set png_ptr->do_packswap.
+ */
+#ifdef PNG_SHUFFLE_OPTIMIZATIONS
+PNG_INTERNAL_FUNCTION(void, PNG_SHUFFLE_OPTIMIZATIONS, (png_structp png_ptr),
+   PNG_EMPTY);
+#endif
+
+/* And for the CRC-32 calculation, PNG_CRC_OPTIMIZATIONS. */
+#ifdef PNG_CRC_OPTIMIZATIONS
+PNG_INTERNAL_FUNCTION(void, PNG_CRC_OPTIMIZATIONS, (png_structp png_ptr),
+   PNG_EMPTY);
+#endif
+
 PNG_INTERNAL_FUNCTION(png_uint_32, png_check_keyword, (png_structrp png_ptr,
    png_const_charp key, png_bytep new_key), PNG_EMPTY);
 
@@ -2140,6 +2624,91 @@ PNG_INTERNAL_FUNCTION(int,
                       PNG_EMPTY);
 #endif
 
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0 && defined(PNG_READ_EXPAND_SUPPORTED)
+PNG_INTERNAL_FUNCTION(int,png_do_expand_palette_sse2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#  if PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(int,png_do_expand_palette_avx2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#  endif
+#endif
+
+/* Hardware gamma correction and compositing, installed by
+ * PNG_GAMMA_OPTIMIZATIONS; these return 0, having done nothing, for the rows
+ * png_do_gamma or png_do_compose must handle.
+ */
+#if PNG_INTEL_SSE_IMPLEMENTATION > 0 && defined(PNG_READ_GAMMA_SUPPORTED)
+#  if PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(int,png_do_gamma_avx2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#  endif
+#  ifdef PNG_READ_16BIT_SUPPORTED
+PNG_INTERNAL_FUNCTION(int,png_do_gamma_16_sse2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#     if PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(int,png_do_gamma_16_avx2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#     endif
+#  endif
+#  if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+      defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+PNG_INTERNAL_FUNCTION(int,png_do_compose_sse2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#     if PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(int,png_do_compose_avx2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#     endif
+#  endif
+#  if defined(PNG_READ_RGB_TO_GRAY_SUPPORTED) && PNG_INTEL_AVX2_OPT > 0
+PNG_INTERNAL_FUNCTION(int,png_do_rgb_to_gray_avx2,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row, int *rgb_error),PNG_EMPTY);
+#  endif
+#endif
+
+#if defined(PNG_ARM_NEON_GAMMA) && defined(PNG_READ_GAMMA_SUPPORTED)
+PNG_INTERNAL_FUNCTION(int,png_do_gamma_neon,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#  if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+      defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+PNG_INTERNAL_FUNCTION(int,png_do_compose_neon,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row),PNG_EMPTY);
+#  endif
+#  ifdef PNG_READ_RGB_TO_GRAY_SUPPORTED
+PNG_INTERNAL_FUNCTION(int,png_do_rgb_to_gray_neon,(png_structrp png_ptr,
+    png_row_infop row_info, png_bytep row, int *rgb_error),PNG_EMPTY);
+#  endif
+#endif
+
+/* Hardware byte shuffles, installed by PNG_SHUFFLE_OPTIMIZATIONS.  The
+ * packswap ones return 0, having done nothing, for the rows png_do_packswap
+ * must handle.
+ */
+#if PNG_INTEL_SSSE3_OPT > 0
+#  if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+      defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+PNG_INTERNAL_FUNCTION(void,png_do_fused_ssse3,(png_const_structrp png_ptr,
+    png_bytep row, png_uint_32 width),PNG_EMPTY);
+#  endif
+#  if defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+      defined(PNG_WRITE_PACKSWAP_SUPPORTED)
+PNG_INTERNAL_FUNCTION(int,png_do_packswap_ssse3,(png_row_infop row_info,
+    png_bytep row),PNG_EMPTY);
+#  endif
+#endif
+
+#if PNG_ARM_NEON_IMPLEMENTATION == 1
+#  if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+      defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+PNG_INTERNAL_FUNCTION(void,png_do_fused_neon,(png_const_structrp png_ptr,
+    png_bytep row, png_uint_32 width),PNG_EMPTY);
+#  endif
+#  if defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+      defined(PNG_WRITE_PACKSWAP_SUPPORTED)
+PNG_INTERNAL_FUNCTION(int,png_do_packswap_neon,(png_row_infop row_info,
+    png_bytep row),PNG_EMPTY);
+#  endif
+#endif
+
 /* Maintainer: Put new private prototypes here ^ */
 
 #include "pngdebug.h"
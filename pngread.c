@@ -18,6 +18,17 @@
 #if defined(PNG_SIMPLIFIED_READ_SUPPORTED) && defined(PNG_STDIO_SUPPORTED)
 #  include <errno.h>
 #endif
+#ifdef PNG_MMAP_FILE
+#  ifdef _WIN32
+#     include <windows.h>
+#  else
+#     include <fcntl.h>
+#     include <unistd.h>
+#     include <sys/types.h>
+#     include <sys/stat.h>
+#     include <sys/mman.h>
+#  endif
+#endif
 
 #ifdef PNG_READ_SUPPORTED
 
@@ -379,10 +390,238 @@ png_do_read_intrapixel(png_row_infop row_info, png_bytep row)
 }
 #endif /* MNG_FEATURES */
 
+/* Read the next row of IDAT data into png_ptr->row_buf, undo the filter and
+ * save the result as the previous row.
+ */
+static void
+png_read_filtered_row(png_structrp png_ptr, png_row_infop row_info)
+{
+   png_ptr->row_buf[0]=255; /* to force error if no data was found */
+   png_read_IDAT_data(png_ptr, png_ptr->row_buf, row_info->rowbytes + 1);
+
+   if (png_ptr->row_buf[0] > PNG_FILTER_VALUE_NONE)
+   {
+      if (png_ptr->row_buf[0] < PNG_FILTER_VALUE_LAST)
+         png_read_filter_row(png_ptr, row_info, png_ptr->row_buf + 1,
+             png_ptr->prev_row + 1, png_ptr->row_buf[0]);
+      else
+         png_error(png_ptr, "bad adaptive filter value");
+   }
+
+   /* libpng 1.5.6: the following line was copying png_ptr->rowbytes before
+    * 1.5.6, while the buffer really is this big in current versions of libpng
+    * it may not be in the future, so this was changed just to copy the
+    * interlaced count:
+    */
+   memcpy(png_ptr->prev_row, png_ptr->row_buf, row_info->rowbytes + 1);
+}
+
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+/* Only the columns in the crop window are transformed: move them to the start
+ * of the row.  Packed pixels are moved from the start of the byte that
+ * contains the first one and the number of 'lead' pixels before it is
+ * returned; these are dropped after the transforms, which always unpack them
+ * for the simplified API.
+ */
+static png_uint_32
+png_read_crop_row(png_structrp png_ptr, png_row_infop row_info)
+{
+   png_uint_32 x = png_ptr->crop_x;
+   png_uint_32 lead = row_info->pixel_depth < 8 ?
+       x & ((8U / row_info->pixel_depth) - 1) : 0;
+
+   x -= lead;
+   row_info->width = png_ptr->crop_width + lead;
+   row_info->rowbytes = PNG_ROWBYTES(row_info->pixel_depth, row_info->width);
+
+   if (x > 0)
+      memmove(png_ptr->row_buf + 1,
+          png_ptr->row_buf + 1 + PNG_ROWBYTES(row_info->pixel_depth, x),
+          row_info->rowbytes);
+
+   return lead;
+}
+
+/* Add the samples of the cropped row in png_ptr->row_buf to the sums for each
+ * block of 2^shift columns.
+ */
+static void
+png_read_sum_row(png_structrp png_ptr, png_row_infop row_info,
+    png_uint_32 out_width)
+{
+   unsigned int shift = png_ptr->scale_shift;
+   unsigned int channels = row_info->channels;
+   unsigned int bytes = row_info->bit_depth >> 3;
+   png_const_bytep sp = png_ptr->row_buf + 1;
+   png_uint_32p sum = png_ptr->scale_sum;
+   png_uint_32 width = png_ptr->crop_width;
+   png_uint_32 x;
+
+   for (x = 0; x < out_width; ++x)
+   {
+      png_uint_32 cols = width - (x << shift);
+      png_uint_32 i;
+
+      if (cols > (1U << shift))
+         cols = 1U << shift;
+
+      if (bytes == 1)
+         for (i = 0; i < cols; ++i)
+         {
+            unsigned int c = 0;
+
+            do
+               sum[c] += *sp++;
+            while (++c < channels);
+         }
+
+      else
+         for (i = 0; i < cols; ++i)
+         {
+            unsigned int c = 0;
+
+            do
+            {
+               sum[c] += ((png_uint_32)sp[0] << 8) + sp[1];
+               sp += 2;
+            }
+            while (++c < channels);
+         }
+
+      sum += channels;
+   }
+}
+
+/* Reduce the cropped row in png_ptr->row_buf by the png_image_set_reduction
+ * factor.  Samples of eight or more bits without a tRNS chunk are averaged
+ * over each block of rows and columns, reading the remaining rows of the block
+ * here; palette indices, packed pixels and images with a transparent color
+ * are point sampled from the top-left pixel of each block and the remaining
+ * rows are skipped by the next png_read_row.  'full' describes the
+ * uncropped row.  Returns the new number of lead pixels, which is always 0.
+ */
+static png_uint_32
+png_read_reduce_row(png_structrp png_ptr, png_row_infop row_info,
+    png_row_infop full, png_uint_32 lead)
+{
+   unsigned int shift = png_ptr->scale_shift;
+   unsigned int depth = row_info->pixel_depth;
+   png_uint_32 out_width = (png_ptr->crop_width + (1U << shift) - 1) >> shift;
+   png_bytep sp = png_ptr->row_buf + 1;
+   png_uint_32 x;
+
+   if (row_info->bit_depth < 8 || png_ptr->num_trans > 0 ||
+       row_info->color_type == PNG_COLOR_TYPE_PALETTE)
+   {
+      if (depth < 8)
+      {
+         unsigned int mask = (1U << depth) - 1;
+
+         /* Each pixel is written no later in the row than the one it is
+          * read from, so this can be done in place.
+          */
+         for (x = 0; x < out_width; ++x)
+         {
+            size_t s = ((size_t)lead + ((size_t)x << shift)) * depth;
+            size_t d = (size_t)x * depth;
+            unsigned int v = (sp[s >> 3] >> (8 - depth - (s & 7))) & mask;
+            unsigned int dshift = (unsigned int)(8 - depth - (d & 7));
+
+            sp[d >> 3] = (png_byte)((sp[d >> 3] & ~(mask << dshift)) |
+                (v << dshift));
+         }
+      }
+
+      else
+      {
+         size_t bytes = depth >> 3;
+
+         for (x = 1; x < out_width; ++x)
+            memcpy(sp + x * bytes, sp + ((size_t)x << shift) * bytes, bytes);
+      }
+   }
+
+   else
+   {
+      unsigned int channels = row_info->channels;
+      unsigned int bytes = row_info->bit_depth >> 3;
+      png_uint_32 rows = png_ptr->crop_y + png_ptr->crop_height -
+          png_ptr->row_number;
+      png_uint_32 y;
+      png_uint_32p sum;
+
+      if (rows > (1U << shift))
+         rows = 1U << shift;
+
+      if (png_ptr->scale_sum == NULL)
+      {
+         if (out_width > PNG_SIZE_MAX / (channels * (sizeof *sum)))
+            png_error(png_ptr, "image too wide to reduce");
+
+         png_ptr->scale_sum = png_voidcast(png_uint_32p, png_malloc(png_ptr,
+             out_width * channels * (sizeof *sum)));
+      }
+
+      sum = png_ptr->scale_sum;
+      memset(sum, 0, out_width * channels * (sizeof *sum));
+
+      for (y = 1;; ++y)
+      {
+         png_read_sum_row(png_ptr, row_info, out_width);
+
+         if (y == rows)
+            break;
+
+         /* Read the next row of the block; its lead is 0 too. */
+         png_read_finish_row(png_ptr);
+         png_read_filtered_row(png_ptr, full);
+         *row_info = *full;
+         (void)png_read_crop_row(png_ptr, row_info);
+      }
+
+      /* Store the rounded averages; the sums for each block of 16-bit samples
+       * can be no more than 65535*64, so they cannot overflow.
+       */
+      for (x = 0; x < out_width; ++x)
+      {
+         png_uint_32 cols = png_ptr->crop_width - (x << shift);
+         png_uint_32 count;
+         unsigned int c;
+
+         if (cols > (1U << shift))
+            cols = 1U << shift;
+
+         count = cols * rows;
+
+         for (c = 0; c < channels; ++c, sp += bytes)
+         {
+            png_uint_32 v = (*sum++ + (count >> 1)) / count;
+
+            if (bytes == 2)
+            {
+               sp[0] = (png_byte)(v >> 8);
+               sp[1] = (png_byte)v;
+            }
+
+            else
+               *sp = (png_byte)v;
+         }
+      }
+   }
+
+   row_info->width = out_width;
+   row_info->rowbytes = PNG_ROWBYTES(depth, out_width);
+   return 0;
+}
+#endif /* SIMPLIFIED_READ */
+
 void PNGAPI
 png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
 {
    png_row_info row_info;
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   png_uint_32 crop_lead = 0;
+#endif
 
    if (png_ptr == NULL)
       return;
@@ -390,6 +629,9 @@ png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
    png_debug2(1, "in png_read_row (row %lu, pass %d)",
        (unsigned long)png_ptr->row_number, png_ptr->pass);
 
+   if ((png_ptr->flags & PNG_FLAG_IDAT_ABANDONED) != 0)
+      png_error(png_ptr, "Read past the last requested row");
+
    /* png_read_start_row sets the information (in particular iwidth) for this
     * interlace pass.
     */
@@ -538,25 +780,23 @@ png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
    if ((png_ptr->mode & PNG_HAVE_IDAT) == 0)
       png_error(png_ptr, "Invalid attempt to read row data");
 
-   /* Fill the row with IDAT data: */
-   png_ptr->row_buf[0]=255; /* to force error if no data was found */
-   png_read_IDAT_data(png_ptr, png_ptr->row_buf, row_info.rowbytes + 1);
-
-   if (png_ptr->row_buf[0] > PNG_FILTER_VALUE_NONE)
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   /* The rows above the crop window of a non-interlaced image (see
+    * png_image_set_crop), and those that are not sampled when the image is
+    * reduced, are decompressed and unfiltered, because the next row may
+    * depend on them, but not transformed.
+    */
+   while (png_ptr->row_number < png_ptr->crop_y ||
+       ((png_ptr->row_number - png_ptr->crop_y) &
+       ((1U << png_ptr->scale_shift) - 1)) != 0)
    {
-      if (png_ptr->row_buf[0] < PNG_FILTER_VALUE_LAST)
-         png_read_filter_row(png_ptr, &row_info, png_ptr->row_buf + 1,
-             png_ptr->prev_row + 1, png_ptr->row_buf[0]);
-      else
-         png_error(png_ptr, "bad adaptive filter value");
+      png_read_filtered_row(png_ptr, &row_info);
+      png_read_finish_row(png_ptr);
    }
+#endif
 
-   /* libpng 1.5.6: the following line was copying png_ptr->rowbytes before
-    * 1.5.6, while the buffer really is this big in current versions of libpng
-    * it may not be in the future, so this was changed just to copy the
-    * interlaced count:
-    */
-   memcpy(png_ptr->prev_row, png_ptr->row_buf, row_info.rowbytes + 1);
+   /* Fill the row with IDAT data: */
+   png_read_filtered_row(png_ptr, &row_info);
 
 #ifdef PNG_MNG_FEATURES_SUPPORTED
    if ((png_ptr->mng_features_permitted & PNG_FLAG_MNG_FILTER_64) != 0 &&
@@ -567,6 +807,20 @@ png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
    }
 #endif
 
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   /* The transforms are done on the crop window, reduced if required. */
+   if (png_ptr->crop_width > 0)
+   {
+      png_row_info full = row_info;
+
+      crop_lead = png_read_crop_row(png_ptr, &row_info);
+
+      if (png_ptr->scale_shift > 0)
+         crop_lead = png_read_reduce_row(png_ptr, &row_info, &full,
+             crop_lead);
+   }
+#endif
+
 #ifdef PNG_READ_TRANSFORMS_SUPPORTED
    if (png_ptr->transformations)
       png_do_read_transformations(png_ptr, &row_info);
@@ -588,7 +842,9 @@ png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
    if (png_ptr->interlaced != 0 &&
       (png_ptr->transformations & PNG_INTERLACE) != 0)
    {
-      if (png_ptr->pass < 6)
+      if (png_ptr->pass < 6 && (png_ptr->read_interlace == NULL ||
+          png_ptr->read_interlace(&row_info, png_ptr->row_buf + 1,
+          png_ptr->pass) == 0))
          png_do_read_interlace(&row_info, png_ptr->row_buf + 1, png_ptr->pass,
              png_ptr->transformations);
 
@@ -601,6 +857,25 @@ png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
 
    else
 #endif
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   if (png_ptr->crop_width > 0)
+   {
+      unsigned int pixel_bytes = row_info.pixel_depth >> 3;
+      size_t bytes = (row_info.width - crop_lead) * (size_t)pixel_bytes;
+
+      if ((row_info.pixel_depth & 7) != 0)
+         png_error(png_ptr, "crop window of packed pixels");
+
+      if (row != NULL)
+         memcpy(row, png_ptr->row_buf + 1 + crop_lead * pixel_bytes, bytes);
+
+      if (dsp_row != NULL)
+         memcpy(dsp_row, png_ptr->row_buf + 1 + crop_lead * pixel_bytes,
+             bytes);
+   }
+
+   else
+#endif
    {
       if (row != NULL)
          png_combine_row(png_ptr, row, -1/*ignored*/);
@@ -614,6 +889,48 @@ png_read_row(png_structrp png_ptr, png_bytep row, png_bytep dsp_row)
       (*(png_ptr->read_row_fn))(png_ptr, png_ptr->row_number, png_ptr->pass);
 
 }
+
+void PNGAPI
+png_set_read_stop_row(png_structrp png_ptr, png_uint_32 nrows)
+{
+   png_debug(1, "in png_set_read_stop_row");
+
+   if (png_ptr == NULL || (png_ptr->mode & PNG_IS_READ_STRUCT) == 0)
+      return;
+
+   png_ptr->read_stop_row = nrows;
+
+   /* If the rows have already been read stop now; otherwise
+    * png_read_finish_row stops after row nrows-1.
+    */
+   if (nrows > 0 && png_ptr->interlaced == 0 &&
+       png_ptr->zowner == png_IDAT && png_ptr->row_number >= nrows)
+      png_read_stop_IDAT(png_ptr);
+}
+
+void PNGAPI
+png_set_read_last_pass(png_structrp png_ptr, int pass)
+{
+   png_debug(1, "in png_set_read_last_pass");
+
+   if (png_ptr == NULL || (png_ptr->mode & PNG_IS_READ_STRUCT) == 0)
+      return;
+
+   if (pass < 0 || pass > 6)
+   {
+      png_app_error(png_ptr, "png_set_read_last_pass: invalid pass");
+      return;
+   }
+
+   png_ptr->read_passes = (png_byte)(pass + 1);
+
+   /* If the pass has already been read stop now; otherwise
+    * png_read_finish_row stops at the end of the pass.
+    */
+   if (png_ptr->interlaced != 0 && png_ptr->zowner == png_IDAT &&
+       png_ptr->pass > pass)
+      png_read_stop_IDAT(png_ptr);
+}
 #endif /* SEQUENTIAL_READ */
 
 #ifdef PNG_SEQUENTIAL_READ_SUPPORTED
@@ -745,6 +1062,11 @@ png_read_image(png_structrp png_ptr, png_bytepp image)
 
    image_height=png_ptr->height;
 
+   /* Only the rows before the stop row of a non-interlaced image are read. */
+   if (png_ptr->read_stop_row > 0 && png_ptr->read_stop_row < image_height &&
+       png_ptr->interlaced == 0)
+      image_height = png_ptr->read_stop_row;
+
    for (j = 0; j < pass; j++)
    {
       rp = image;
@@ -833,7 +1155,14 @@ png_read_end(png_structrp png_ptr, png_inforp info_ptr)
              || (png_ptr->mode & PNG_HAVE_CHUNK_AFTER_IDAT) != 0)
             png_benign_error(png_ptr, "..Too many IDATs found");
 
-         png_crc_finish(png_ptr, length);
+         /* The rest of an image abandoned by png_set_read_stop_row or
+          * png_set_read_last_pass is not checked.
+          */
+         if ((png_ptr->flags & PNG_FLAG_IDAT_ABANDONED) != 0)
+            png_skip_chunk_data(png_ptr, length);
+
+         else
+            png_crc_finish(png_ptr, length);
       }
       else if (chunk_name == png_PLTE)
          png_handle_PLTE(png_ptr, info_ptr, length);
@@ -951,6 +1280,16 @@ png_read_destroy(png_structrp png_ptr)
    png_ptr->big_prev_row = NULL;
    png_free(png_ptr, png_ptr->read_buffer);
    png_ptr->read_buffer = NULL;
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   png_free(png_ptr, png_ptr->idat_image);
+   png_ptr->idat_image = NULL;
+   png_free(png_ptr, png_ptr->scale_sum);
+   png_ptr->scale_sum = NULL;
+#endif
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+   png_free(png_ptr, png_ptr->idat_restart);
+   png_ptr->idat_restart = NULL;
+#endif
 
 #ifdef PNG_READ_QUANTIZE_SUPPORTED
    png_free(png_ptr, png_ptr->palette_lookup);
@@ -976,7 +1315,8 @@ png_read_destroy(png_structrp png_ptr)
    png_ptr->free_me &= ~PNG_FREE_TRNS;
 #endif
 
-   inflateEnd(&png_ptr->zstream);
+   if ((png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED) != 0)
+      PNG_ZLIB(png_ptr, inflate_end)(&png_ptr->zstream);
 
 #ifdef PNG_PROGRESSIVE_READ_SUPPORTED
    png_free(png_ptr, png_ptr->save_buffer);
@@ -995,7 +1335,7 @@ png_read_destroy(png_structrp png_ptr)
 #endif
 
 #if defined(PNG_READ_EXPAND_SUPPORTED) && \
-    defined(PNG_ARM_NEON_IMPLEMENTATION)
+    (defined(PNG_ARM_NEON_IMPLEMENTATION) || defined(PNG_PALETTE_OPTIMIZATIONS))
    png_free(png_ptr, png_ptr->riffled_palette);
    png_ptr->riffled_palette = NULL;
 #endif
@@ -1399,6 +1739,119 @@ png_gamma_not_sRGB(png_fixed_point g)
    return 1;
 }
 
+#if defined(PNG_READ_PARALLEL_SUPPORTED) || defined(PNG_ZLIB_BACKEND_SUPPORTED)
+/* Called when the whole PNG is in memory and png_read_info has just read the
+ * header of the first IDAT chunk: find the total length of the IDAT data, so
+ * that png_read_IDAT_image can read it in one piece, and, for a non-interlaced
+ * image, look for an riDX chunk (see png_write_restart_point) between the last
+ * IDAT and IEND.  If a valid one is found the restart points are stored for
+ * png_read_IDAT_image, otherwise the chunk is ignored; it is not an error
+ * because the chunk is private and only serves to speed up the read.
+ */
+static void
+png_image_read_IDAT_length(png_structrp png_ptr, png_const_bytep memory,
+    size_t size)
+{
+   png_alloc_size_t length = 0;
+   png_uint_32 chunk_length = png_ptr->idat_size;
+   png_uint_32 chunk_name = png_IDAT;
+   int in_idat = 1;
+
+   /* The data is not checked here, so nothing must be trusted beyond what is
+    * needed to find the chunks.
+    */
+   for (;;)
+   {
+      if (chunk_name == png_IDAT)
+      {
+         /* The IDAT chunks must be consecutive. */
+         if (in_idat == 0)
+            return;
+
+         length += chunk_length;
+      }
+
+      else
+      {
+         if (in_idat != 0)
+         {
+            png_ptr->idat_length = length;
+            in_idat = 0;
+
+            /* Restart points are only used in non-interlaced images. */
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+            if (png_ptr->interlaced != 0)
+               return;
+#else
+            return;
+#endif
+         }
+
+         if (chunk_name == png_IEND)
+            return;
+
+         else if (chunk_name == png_riDX)
+            break;
+      }
+
+      /* Skip the chunk data and CRC and read the next chunk header. */
+      if (chunk_length > PNG_UINT_31_MAX ||
+          size < (png_alloc_size_t)chunk_length + 12)
+         return;
+
+      memory += chunk_length + 4; /* CRC */
+      size -= chunk_length + 4;
+      chunk_length = png_get_uint_32(memory);
+      chunk_name = PNG_CHUNK_FROM_STRING(memory + 4);
+      memory += 8;
+      size -= 8;
+   }
+
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+   {
+      png_uint_32 height = png_ptr->height;
+      png_uint_32 n = chunk_length / 8;
+      png_uint_32 i;
+      png_uint_32p points;
+
+      if (n == 0 || chunk_length % 8 != 0 || length <= 6 ||
+          chunk_length > PNG_UINT_31_MAX ||
+          size < (png_alloc_size_t)chunk_length + 4 ||
+          length > ZLIB_IO_MAX ||
+          png_crc32_slice8(0, memory - 4, chunk_length + 4) !=
+          png_get_uint_32(memory + chunk_length))
+         return;
+
+      for (i = 0; i < n; ++i)
+      {
+         png_uint_32 row = png_get_uint_32(memory + 8 * i);
+         png_uint_32 offset = png_get_uint_32(memory + 8 * i + 4);
+
+         /* Each group must have at least one row, the first group starts after
+          * the zlib header and the last ends before the Adler-32.
+          */
+         if (row == 0 || row >= height || offset <= 2 || offset >= length - 4 ||
+             (i > 0 && (row <= png_get_uint_32(memory + 8 * i - 8) ||
+             offset <= png_get_uint_32(memory + 8 * i - 4))))
+            return;
+      }
+
+      points = png_voidcast(png_uint_32p, png_malloc_base(png_ptr,
+          (png_alloc_size_t)n * 2 * (sizeof (png_uint_32))));
+
+      if (points == NULL)
+         return;
+
+      for (i = 0; i < 2 * n; ++i)
+         points[i] = png_get_uint_32(memory + 4 * i);
+
+      png_ptr->idat_restart = points;
+      png_ptr->idat_restarts = n;
+   }
+#endif /* READ_PARALLEL */
+}
+#endif /* READ_PARALLEL || ZLIB_BACKEND */
+
 /* Do the main body of a 'png_image_begin_read' function; read the PNG file
  * header and fill in all the information.  This is executed in a safe context,
  * unlike the init routine above.
@@ -1415,6 +1868,12 @@ png_image_read_header(png_voidp argument)
 #endif
    png_read_info(png_ptr, info_ptr);
 
+#if defined(PNG_READ_PARALLEL_SUPPORTED) || defined(PNG_ZLIB_BACKEND_SUPPORTED)
+   if (png_ptr->read_whole_idat != 0 && image->opaque->memory != NULL)
+      png_image_read_IDAT_length(png_ptr, image->opaque->memory,
+          image->opaque->size);
+#endif
+
    /* Do this the fast way; just read directly out of png_struct. */
    image->width = png_ptr->width;
    image->height = png_ptr->height;
@@ -1567,6 +2026,38 @@ png_image_memory_read(png_structp png_ptr, png_bytep out, size_t need)
    }
 }
 
+#ifdef PNG_READ_BORROW_SUPPORTED
+/* The borrow function for the same memory: the data is returned in place.
+ * NULL makes libpng fall back to png_image_memory_read, which reports the
+ * error.
+ */
+static png_const_bytep PNGCBAPI
+png_image_memory_borrow(png_structp png_ptr, size_t need)
+{
+   if (png_ptr != NULL)
+   {
+      png_imagep image = png_voidcast(png_imagep, png_ptr->io_ptr);
+      if (image != NULL)
+      {
+         png_controlp cp = image->opaque;
+         if (cp != NULL)
+         {
+            png_const_bytep memory = cp->memory;
+
+            if (memory != NULL && cp->size >= need)
+            {
+               cp->memory = memory + need;
+               cp->size -= need;
+               return memory;
+            }
+         }
+      }
+   }
+
+   return NULL;
+}
+#endif
+
 int PNGAPI png_image_begin_read_from_memory(png_imagep image,
     png_const_voidp memory, size_t size)
 {
@@ -1584,6 +2075,15 @@ int PNGAPI png_image_begin_read_from_memory(png_imagep image,
             image->opaque->size = size;
             image->opaque->png_ptr->io_ptr = image;
             image->opaque->png_ptr->read_data_fn = png_image_memory_read;
+#           ifdef PNG_READ_BORROW_SUPPORTED
+               image->opaque->png_ptr->borrow_data_fn =
+                   png_image_memory_borrow;
+#           endif
+
+            /* All the compressed data is available so the rows can be
+             * decompressed in one go.
+             */
+            image->opaque->png_ptr->read_whole_idat = 1;
 
             return png_safe_execute(image, png_image_read_header, image);
          }
@@ -1601,6 +2101,297 @@ int PNGAPI png_image_begin_read_from_memory(png_imagep image,
    return 0;
 }
 
+#ifdef PNG_STDIO_SUPPORTED
+#ifdef PNG_MMAP_FILE
+/* Map the whole of the named file read-only.  Returns NULL, without setting
+ * *size, if the file cannot be mapped; this includes empty files and anything
+ * that is not a regular file.
+ */
+static png_voidp
+png_image_map_file(const char *file_name, size_t *size)
+{
+   png_voidp mapped = NULL;
+#  ifdef _WIN32
+   HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL,
+       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+   if (file != INVALID_HANDLE_VALUE)
+   {
+      LARGE_INTEGER file_size;
+
+      if (GetFileSizeEx(file, &file_size) != 0 && file_size.QuadPart > 0 &&
+          (ULONGLONG)file_size.QuadPart <= (size_t)-1)
+      {
+         HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+             NULL);
+
+         if (mapping != NULL)
+         {
+            /* The view keeps the mapping object alive. */
+            mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+            if (mapped != NULL)
+               *size = (size_t)file_size.QuadPart;
+
+            (void)CloseHandle(mapping);
+         }
+      }
+
+      (void)CloseHandle(file);
+   }
+#  else
+   int fd = open(file_name, O_RDONLY);
+
+   if (fd >= 0)
+   {
+      struct stat st;
+
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+          (off_t)(size_t)st.st_size == st.st_size)
+      {
+         void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+             0);
+
+         if (p != MAP_FAILED)
+         {
+#           ifdef POSIX_MADV_SEQUENTIAL
+               (void)posix_madvise(p, (size_t)st.st_size,
+                   POSIX_MADV_SEQUENTIAL);
+#           endif
+            mapped = p;
+            *size = (size_t)st.st_size;
+         }
+      }
+
+      /* The mapping remains valid after the descriptor is closed. */
+      (void)close(fd);
+   }
+#  endif
+
+   return mapped;
+}
+
+static void
+png_image_unmap(png_voidp mapped, size_t size)
+{
+#  ifdef _WIN32
+   (void)UnmapViewOfFile(mapped);
+   PNG_UNUSED(size)
+#  else
+   (void)munmap(mapped, size);
+#  endif
+}
+
+void /* PRIVATE */
+png_image_unmap_file(png_controlp cp)
+{
+   png_voidp mapped = cp->mapped;
+
+   cp->mapped = NULL;
+   cp->memory = NULL;
+   cp->size = 0;
+
+   if (mapped != NULL)
+      png_image_unmap(mapped, cp->mapped_size);
+}
+#endif /* MMAP_FILE */
+
+int PNGAPI
+png_image_begin_read_from_mapped_file(png_imagep image, const char *file_name)
+{
+   if (image != NULL && image->version == PNG_IMAGE_VERSION)
+   {
+      if (file_name != NULL)
+      {
+#        ifdef PNG_MMAP_FILE
+            size_t size = 0;
+            png_voidp mapped = png_image_map_file(file_name, &size);
+
+            if (mapped != NULL)
+            {
+               if (png_image_read_init(image) != 0)
+               {
+                  png_controlp cp = image->opaque;
+
+                  /* The mapping is read exactly as a memory buffer would be,
+                   * so the whole of IDAT is available at once.
+                   */
+                  cp->mapped = mapped;
+                  cp->mapped_size = size;
+                  cp->memory = png_voidcast(png_const_bytep, mapped);
+                  cp->size = size;
+                  cp->png_ptr->io_ptr = image;
+                  cp->png_ptr->read_data_fn = png_image_memory_read;
+#                 ifdef PNG_READ_BORROW_SUPPORTED
+                     cp->png_ptr->borrow_data_fn = png_image_memory_borrow;
+#                 endif
+                  cp->png_ptr->read_whole_idat = 1;
+
+                  return png_safe_execute(image, png_image_read_header, image);
+               }
+
+               /* png_image_read_init has already recorded the error. */
+               png_image_unmap(mapped, size);
+               return 0;
+            }
+#        endif
+
+         /* The file cannot be mapped, or mapping is not supported on this
+          * system, so read it with stdio.
+          */
+         return png_image_begin_read_from_file(image, file_name);
+      }
+
+      else
+         return png_image_error(image,
+             "png_image_begin_read_from_mapped_file: invalid argument");
+   }
+
+   else if (image != NULL)
+      return png_image_error(image,
+          "png_image_begin_read_from_mapped_file: incorrect PNG_IMAGE_VERSION");
+
+   return 0;
+}
+#endif /* STDIO */
+
+/* Set the size of the image returned by png_image_finish_read from the crop
+ * window and the reduction factor.
+ */
+static void
+png_image_set_window(png_imagep image)
+{
+   png_structrp png_ptr = image->opaque->png_ptr;
+   unsigned int shift = png_ptr->scale_shift;
+   png_uint_32 y = png_ptr->crop_y + png_ptr->crop_height;
+
+   image->width = (png_ptr->crop_width + (1U << shift) - 1) >> shift;
+   image->height = (png_ptr->crop_height + (1U << shift) - 1) >> shift;
+
+   /* Rows below the window are never needed, so do not decompress the whole
+    * of IDAT in advance unless the window reaches the last row.  The setting
+    * is recomputed each time, because a later call may widen the window
+    * again; it is only ever set when the compressed data is already in memory
+    * (png_image_begin_read_from_memory or a mapped file.)
+    */
+   if (y < png_ptr->height)
+   {
+      png_ptr->read_whole_idat = 0;
+      png_ptr->read_stop_row = y;
+   }
+
+   else
+   {
+      png_ptr->read_whole_idat = image->opaque->memory != NULL;
+      png_ptr->read_stop_row = 0;
+   }
+}
+
+int PNGAPI
+png_image_set_crop(png_imagep image, png_uint_32 x, png_uint_32 y,
+    png_uint_32 width, png_uint_32 height)
+{
+   if (image != NULL && image->version == PNG_IMAGE_VERSION)
+   {
+      png_controlp cp = image->opaque;
+
+      if (cp != NULL && cp->for_write == 0 && width > 0 && height > 0 &&
+          x < cp->png_ptr->width && width <= cp->png_ptr->width - x &&
+          y < cp->png_ptr->height && height <= cp->png_ptr->height - y)
+      {
+         png_structrp png_ptr = cp->png_ptr;
+
+         png_ptr->crop_x = x;
+         png_ptr->crop_y = y;
+         png_ptr->crop_width = width;
+         png_ptr->crop_height = height;
+         png_image_set_window(image);
+
+         return 1;
+      }
+
+      else
+         return png_image_error(image, "png_image_set_crop: invalid argument");
+   }
+
+   else if (image != NULL)
+      return png_image_error(image,
+          "png_image_set_crop: damaged PNG_IMAGE_VERSION");
+
+   return 0;
+}
+
+int PNGAPI
+png_image_set_reduction(png_imagep image, unsigned int factor)
+{
+   if (image != NULL && image->version == PNG_IMAGE_VERSION)
+   {
+      png_controlp cp = image->opaque;
+
+      if (cp != NULL && cp->for_write == 0 &&
+          (factor == 1 || factor == 2 || factor == 4 || factor == 8))
+      {
+         png_structrp png_ptr = cp->png_ptr;
+
+         png_ptr->scale_shift = (png_byte)(factor == 8 ? 3 :
+             factor == 4 ? 2 : factor == 2 ? 1 : 0);
+
+         /* Without png_image_set_crop the whole image is reduced. */
+         if (png_ptr->crop_width == 0 && factor > 1)
+         {
+            png_ptr->crop_width = png_ptr->width;
+            png_ptr->crop_height = png_ptr->height;
+         }
+
+         if (png_ptr->crop_width > 0)
+            png_image_set_window(image);
+
+         return 1;
+      }
+
+      else
+         return png_image_error(image,
+             "png_image_set_reduction: invalid argument");
+   }
+
+   else if (image != NULL)
+      return png_image_error(image,
+          "png_image_set_reduction: damaged PNG_IMAGE_VERSION");
+
+   return 0;
+}
+
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+int PNGAPI
+png_image_set_zlib_backend(png_imagep image, png_const_zlib_backendp backend)
+{
+   if (image != NULL && image->version == PNG_IMAGE_VERSION)
+   {
+      png_controlp cp = image->opaque;
+
+      /* png_set_zlib_backend only fails if the stream is in use, which it
+       * never is between png_image_begin_read_ and png_image_finish_read;
+       * check anyway because png_app_error is not safe here.
+       */
+      if (cp != NULL && cp->for_write == 0 && cp->png_ptr->zowner == 0)
+      {
+         png_set_zlib_backend(cp->png_ptr, backend);
+         return 1;
+      }
+
+      else
+         return png_image_error(image,
+             "png_image_set_zlib_backend: invalid argument");
+   }
+
+   else if (image != NULL)
+      return png_image_error(image,
+          "png_image_set_zlib_backend: damaged PNG_IMAGE_VERSION");
+
+   return 0;
+}
+#endif /* ZLIB_BACKEND */
+
 /* Utility function to skip chunks that are not used by the simplified image
  * read functions and an appropriate macro to call it.
  */
@@ -2960,7 +3751,8 @@ png_image_read_and_map(png_voidp argument)
          break;
 
       case PNG_INTERLACE_ADAM7:
-         passes = PNG_INTERLACE_ADAM7_PASSES;
+         passes = png_ptr->read_passes > 0 ? png_ptr->read_passes :
+             PNG_INTERLACE_ADAM7_PASSES;
          break;
 
       default:
@@ -3277,7 +4069,8 @@ png_image_read_composite(png_voidp argument)
          break;
 
       case PNG_INTERLACE_ADAM7:
-         passes = PNG_INTERLACE_ADAM7_PASSES;
+         passes = png_ptr->read_passes > 0 ? png_ptr->read_passes :
+             PNG_INTERLACE_ADAM7_PASSES;
          break;
 
       default:
@@ -3426,7 +4219,8 @@ png_image_read_background(png_voidp argument)
          break;
 
       case PNG_INTERLACE_ADAM7:
-         passes = PNG_INTERLACE_ADAM7_PASSES;
+         passes = png_ptr->read_passes > 0 ? png_ptr->read_passes :
+             PNG_INTERLACE_ADAM7_PASSES;
          break;
 
       default:
@@ -4104,6 +4898,224 @@ png_image_read_direct(png_voidp argument)
    }
 }
 
+/* Choose the correct 'end' routine; for the color-map case all the setup has
+ * already been done.
+ */
+static int
+png_image_read_rows(png_image_read_control *display)
+{
+   png_imagep image = display->image;
+
+   if ((image->format & PNG_FORMAT_FLAG_COLORMAP) != 0)
+      return png_safe_execute(image, png_image_read_colormap, display) &&
+          png_safe_execute(image, png_image_read_colormapped, display);
+
+   else
+      return png_safe_execute(image, png_image_read_direct, display);
+}
+
+/* Store the rounded average of each block of 2^shift columns and 'rows' rows
+ * of the 'width' pixels at 'in', which are in the output format, in 'out'.
+ * This is the averaging png_read_reduce_row does on the rows of a
+ * non-interlaced image before they are transformed.
+ */
+static void
+png_image_reduce_row(png_bytep out, png_const_bytep in, size_t row_bytes,
+    png_uint_32 width, png_uint_32 rows, unsigned int shift,
+    unsigned int channels, unsigned int component_size)
+{
+   size_t pixel_size = channels * (size_t)component_size;
+   png_uint_32 x;
+
+   for (x = 0; (x << shift) < width; ++x, in += pixel_size << shift)
+   {
+      png_uint_32 cols = width - (x << shift);
+      unsigned int c;
+
+      if (cols > (1U << shift))
+         cols = 1U << shift;
+
+      for (c = 0; c < channels; ++c, out += component_size)
+      {
+         png_uint_32 count = cols * rows;
+         png_uint_32 sum = 0;
+         png_uint_32 i, j;
+
+         for (j = 0; j < rows; ++j)
+         {
+            png_const_bytep sp = in + j * row_bytes + c * component_size;
+
+            for (i = 0; i < cols; ++i, sp += pixel_size)
+            {
+               if (component_size == 2)
+               {
+                  png_const_voidp vp = sp;
+                  png_const_uint_16p sp16 = png_voidcast(png_const_uint_16p,
+                      vp);
+
+                  sum += *sp16;
+               }
+
+               else
+                  sum += *sp;
+            }
+         }
+
+         sum = (sum + (count >> 1)) / count;
+
+         if (component_size == 2)
+         {
+            png_voidp vp = out;
+            png_uint_16p out16 = png_voidcast(png_uint_16p, vp);
+
+            *out16 = (png_uint_16)sum;
+         }
+
+         else
+            *out = (png_byte)sum;
+      }
+   }
+}
+
+/* Read the whole of an interlaced image into a temporary buffer then copy the
+ * crop window to the application buffer; a png_safe_execute callback.  If the
+ * image is reduced each block is averaged, or point sampled from its top-left
+ * pixel in the cases where png_read_reduce_row does that.  When point sampled
+ * blocks start on a block boundary the pixels taken are all in the first
+ * Adam7 passes (pass 0 alone has every eighth pixel of every eighth row) so
+ * the later passes are not read.
+ */
+static int
+png_image_read_window(png_voidp argument)
+{
+   png_image_read_control *display = png_voidcast(png_image_read_control*,
+       argument);
+   png_imagep image = display->image;
+   png_structrp png_ptr = image->opaque->png_ptr;
+   png_uint_32 x = png_ptr->crop_x;
+   png_uint_32 y = png_ptr->crop_y;
+   png_uint_32 crop_width = png_ptr->crop_width;
+   png_uint_32 crop_height = png_ptr->crop_height;
+   unsigned int shift = png_ptr->scale_shift;
+   png_uint_32 width = image->width;
+   png_uint_32 height = image->height;
+   unsigned int pixel_size = PNG_IMAGE_PIXEL_SIZE(image->format);
+   png_voidp buffer = display->buffer;
+   png_int_32 row_stride = display->row_stride;
+   ptrdiff_t out_bytes = (ptrdiff_t)row_stride *
+       (ptrdiff_t)PNG_IMAGE_PIXEL_COMPONENT_SIZE(image->format);
+   png_bytep first_out = png_voidcast(png_bytep, buffer);
+   int point_sample = png_ptr->bit_depth < 8 || png_ptr->num_trans > 0 ||
+       png_ptr->color_type == PNG_COLOR_TYPE_PALETTE ||
+       (image->format & PNG_FORMAT_FLAG_COLORMAP) != 0;
+   png_alloc_size_t row_bytes;
+   png_bytep whole;
+   int result;
+
+   if (png_ptr->width > PNG_SIZE_MAX/pixel_size ||
+       png_ptr->height > PNG_SIZE_MAX/(png_ptr->width * pixel_size))
+      png_error(png_ptr, "image too large to crop");
+
+   row_bytes = png_ptr->width * (png_alloc_size_t)pixel_size;
+   whole = png_voidcast(png_bytep, png_malloc(png_ptr,
+       row_bytes * png_ptr->height));
+
+   /* A negative stride means that the first row is at the end. */
+   if (out_bytes < 0)
+      first_out += (height-1) * (-out_bytes);
+
+   /* Without a background color alpha is removed by compositing onto the
+    * existing contents of the buffer, so copy those to the window in 'whole',
+    * each pixel of a reduced image to its whole block.
+    */
+   if ((image->format & (PNG_FORMAT_FLAG_COLORMAP | PNG_FORMAT_FLAG_ALPHA |
+       PNG_FORMAT_FLAG_LINEAR)) == 0 && display->background == NULL &&
+       ((png_ptr->color_type & PNG_COLOR_MASK_ALPHA) != 0 ||
+       png_ptr->num_trans > 0))
+   {
+      png_uint_32 j;
+
+      for (j = 0; j < crop_height; ++j)
+      {
+         png_bytep out = whole + (y + j) * row_bytes + x * (size_t)pixel_size;
+         png_const_bytep in = first_out + (ptrdiff_t)(j >> shift) * out_bytes;
+
+         if (shift == 0)
+            memcpy(out, in, crop_width * (size_t)pixel_size);
+
+         else
+         {
+            png_uint_32 i;
+
+            for (i = 0; i < crop_width; ++i)
+               memcpy(out + i * (size_t)pixel_size,
+                   in + (i >> shift) * (size_t)pixel_size, pixel_size);
+         }
+      }
+   }
+
+   /* The image is read as if no window was set; row_stride is in components,
+    * not bytes.
+    */
+   if (shift > 0 && point_sample != 0 && ((x | y) & ((1U << shift) - 1)) == 0)
+      png_ptr->read_passes = (png_byte)(7 - 2 * shift);
+
+   png_ptr->crop_x = png_ptr->crop_y = png_ptr->crop_width = 0;
+   png_ptr->scale_shift = 0;
+   image->width = png_ptr->width;
+   image->height = png_ptr->height;
+   display->buffer = whole;
+   display->row_stride = (png_int_32)/*SAFE*/
+       (png_ptr->width * PNG_IMAGE_PIXEL_CHANNELS(image->format));
+
+   result = png_image_read_rows(display);
+
+   image->width = width;
+   image->height = height;
+   display->buffer = buffer;
+   display->row_stride = row_stride;
+
+   if (result != 0)
+   {
+      png_bytep out = first_out;
+      png_const_bytep in = whole + y * row_bytes + x * (size_t)pixel_size;
+      png_uint_32 row;
+
+      for (row = 0; row < height; ++row)
+      {
+         if (shift == 0)
+            memcpy(out, in, width * (size_t)pixel_size);
+
+         else if (point_sample == 0)
+         {
+            png_uint_32 rows = crop_height - (row << shift);
+
+            if (rows > (1U << shift))
+               rows = 1U << shift;
+
+            png_image_reduce_row(out, in, row_bytes, crop_width, rows, shift,
+                PNG_IMAGE_PIXEL_CHANNELS(image->format),
+                PNG_IMAGE_PIXEL_COMPONENT_SIZE(image->format));
+         }
+
+         else
+         {
+            png_uint_32 i;
+
+            for (i = 0; i < width; ++i)
+               memcpy(out + i * (size_t)pixel_size,
+                   in + ((size_t)i << shift) * pixel_size, pixel_size);
+         }
+
+         in += row_bytes << shift;
+         out += out_bytes;
+      }
+   }
+
+   png_free(png_ptr, whole);
+   return result;
+}
+
 int PNGAPI
 png_image_finish_read(png_imagep image, png_const_colorp background,
     void *buffer, png_int_32 row_stride, void *colormap)
@@ -4175,20 +5187,22 @@ png_image_finish_read(png_imagep image, png_const_colorp background,
                   display.background = background;
                   display.local_row = NULL;
 
-                  /* Choose the correct 'end' routine; for the color-map case
-                   * all the setup has already been done.
+#if defined(PNG_SET_OPTION_SUPPORTED) && defined(PNG_SKIP_CHECKSUMS)
+                  if ((image->flags & PNG_IMAGE_FLAG_TRUSTED_INPUT) != 0)
+                     png_set_option(image->opaque->png_ptr,
+                         PNG_SKIP_CHECKSUMS, PNG_OPTION_ON);
+#endif
+
+                  /* The crop window of an interlaced image is copied from
+                   * the whole image.
                    */
-                  if ((image->format & PNG_FORMAT_FLAG_COLORMAP) != 0)
-                     result =
-                         png_safe_execute(image,
-                             png_image_read_colormap, &display) &&
-                             png_safe_execute(image,
-                             png_image_read_colormapped, &display);
+                  if (image->opaque->png_ptr->crop_width > 0 &&
+                      image->opaque->png_ptr->interlaced != PNG_INTERLACE_NONE)
+                     result = png_safe_execute(image, png_image_read_window,
+                         &display);
 
                   else
-                     result =
-                        png_safe_execute(image,
-                            png_image_read_direct, &display);
+                     result = png_image_read_rows(&display);
 
                   png_image_free(image);
                   return result;
@@ -102,6 +102,11 @@ png_set_read_fn(png_structrp png_ptr, png_voidp io_ptr,
    png_ptr->read_data_fn = read_data_fn;
 #endif
 
+#ifdef PNG_READ_BORROW_SUPPORTED
+   /* A borrow function belongs to the previous input. */
+   png_ptr->borrow_data_fn = NULL;
+#endif
+
 #ifdef PNG_WRITE_SUPPORTED
    /* It is an error to write to a read device */
    if (png_ptr->write_data_fn != NULL)
@@ -117,4 +122,19 @@ png_set_read_fn(png_structrp png_ptr, png_voidp io_ptr,
    png_ptr->output_flush_fn = NULL;
 #endif
 }
+
+#ifdef PNG_READ_BORROW_SUPPORTED
+/* This function allows an application whose input is already in memory to
+ * supply a function that returns the input in place; see png.h.  It must be
+ * called after png_set_read_fn.  Pass NULL to remove the function.
+ */
+void PNGAPI
+png_set_read_borrow_fn(png_structrp png_ptr, png_borrow_ptr borrow_data_fn)
+{
+   if (png_ptr == NULL)
+      return;
+
+   png_ptr->borrow_data_fn = borrow_data_fn;
+}
+#endif
 #endif /* READ */
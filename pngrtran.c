@@ -1287,6 +1287,288 @@ png_init_rgb_transformations(png_structrp png_ptr)
 #endif /* READ_EXPAND && READ_BACKGROUND */
 }
 
+/* The transformations between the expansion of the image data and the user
+ * transform that only move, duplicate, drop, insert or invert whole bytes
+ * of each pixel can all be done in one pass over the row.  When the
+ * transformations requested are all of this kind png_init_read_fused works
+ * out, once per image, where each output byte of a pixel comes from and the
+ * rows are then converted by png_ptr->do_fused instead of a pass for each
+ * transformation.  The gamma correction of 8-bit samples is a table lookup
+ * for each color byte, so it is done in the same pass; this covers the usual
+ * expand, gamma, strip alpha or filler to RGB or RGBA read.  The kernels are
+ * in pngtrans.c, shared with the writer.
+ *
+ * The other transformations that do arithmetic on the samples are still done
+ * one by one: alpha composition (PNG_COMPOSE), conversion to gray, alpha
+ * encoding, scaling 16-bit samples to 8 bits, PNG_SHIFT, quantizing and the
+ * gamma correction of 16-bit samples.
+ */
+
+/* G to RGB or GA to RGBA for 8 and 16-bit samples; the alpha bytes follow
+ * the gray ones.
+ */
+static const png_byte png_fused_gray_to_rgb[2][8] =
+{
+   { 0, 0, 0, 1, 0, 0, 0, 0 },
+   { 0, 1, 0, 1, 0, 1, 2, 3 }
+};
+
+/* Simulate the part of png_do_read_transformations after the expansion on a
+ * single pixel, in the same order and with the same tests on the row format.
+ * If every step that would change the row only moves bytes, or is the gamma
+ * correction of 8-bit samples, this sets png_ptr->do_fused, otherwise it is
+ * left NULL and the steps are done one by one.
+ */
+static void
+png_init_read_fused(png_structrp png_ptr)
+{
+   png_uint_32 transformations = png_ptr->transformations;
+   png_fused_pixel pixel;
+   unsigned int in, b, i;
+
+   png_ptr->do_fused = NULL;
+
+   /* The format after the expansion, as png_do_expand_palette and png_do_expand
+    * produce it.
+    */
+   pixel.color_type = png_ptr->color_type;
+   pixel.bit_depth = png_ptr->bit_depth;
+
+#ifdef PNG_READ_EXPAND_SUPPORTED
+   if ((transformations & PNG_EXPAND) != 0)
+   {
+      if (pixel.color_type == PNG_COLOR_TYPE_PALETTE)
+      {
+         pixel.color_type = (png_byte)(png_ptr->num_trans > 0 ?
+             PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB);
+         pixel.bit_depth = 8;
+      }
+
+      else
+      {
+         int trans = png_ptr->num_trans != 0 &&
+             (transformations & PNG_EXPAND_tRNS) != 0;
+
+         if (pixel.color_type == PNG_COLOR_TYPE_GRAY)
+         {
+            if (pixel.bit_depth < 8)
+               pixel.bit_depth = 8;
+
+            if (trans != 0)
+               pixel.color_type = PNG_COLOR_TYPE_GRAY_ALPHA;
+         }
+
+         else if (pixel.color_type == PNG_COLOR_TYPE_RGB && trans != 0)
+            pixel.color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+      }
+   }
+#endif
+
+   /* Palette and packed rows are left to the separate steps. */
+   if (pixel.color_type == PNG_COLOR_TYPE_PALETTE || pixel.bit_depth < 8)
+      return;
+
+   /* So are the other steps that do arithmetic on the samples. */
+   if ((transformations & (PNG_RGB_TO_GRAY | PNG_COMPOSE | PNG_QUANTIZE |
+       PNG_SHIFT)) != 0)
+      return;
+
+#ifdef PNG_READ_ALPHA_MODE_SUPPORTED
+   if ((transformations & PNG_ENCODE_ALPHA) != 0)
+      return;
+#endif
+
+   pixel.channels = (png_byte)(1 +
+       ((pixel.color_type & PNG_COLOR_MASK_COLOR) != 0 ? 2 : 0) +
+       ((pixel.color_type & PNG_COLOR_MASK_ALPHA) != 0 ? 1 : 0));
+   pixel.bytes = (png_byte)(pixel.channels * (pixel.bit_depth >> 3));
+   in = pixel.bytes;
+
+   for (i = 0; i < 8; ++i)
+   {
+      pixel.source[i] = (png_byte)(i < pixel.bytes ? i : 8);
+      pixel.value[i] = 0;
+   }
+
+   pixel.gamma = NULL;
+   pixel.gamma_bytes = 0;
+
+#ifdef PNG_READ_GAMMA_SUPPORTED
+   /* The test in png_do_read_transformations without the parts that depend on
+    * RGB_TO_GRAY and COMPOSE.  png_do_gamma looks up the color samples of an
+    * 8-bit row in gamma_table and leaves the alpha samples alone.  It runs
+    * after the steps before it, which only move whole samples, so the lookup
+    * can be done on the input pixel.
+    */
+   if ((transformations & PNG_GAMMA) != 0 &&
+       png_ptr->color_type != PNG_COLOR_TYPE_PALETTE)
+   {
+      if (pixel.bit_depth != 8)
+         return;
+
+      pixel.gamma = png_ptr->gamma_table;
+
+      if (pixel.gamma != NULL)
+         pixel.gamma_bytes = (png_byte)(pixel.channels -
+             ((pixel.color_type & PNG_COLOR_MASK_ALPHA) != 0 ? 1 : 0));
+   }
+#endif
+
+   /* 'b' is the number of bytes in each sample; it is updated when the bit
+    * depth changes.
+    */
+   b = pixel.bit_depth >> 3;
+
+#ifdef PNG_READ_STRIP_ALPHA_SUPPORTED
+   if ((transformations & PNG_STRIP_ALPHA) != 0 &&
+       (pixel.color_type == PNG_COLOR_TYPE_RGB_ALPHA ||
+       pixel.color_type == PNG_COLOR_TYPE_GRAY_ALPHA))
+   {
+      /* png_do_strip_channel with at_start == 0 keeps the leading channels. */
+      pixel.bytes = (png_byte)(pixel.bytes - b);
+      pixel.channels--;
+      pixel.color_type =
+          (png_byte)(pixel.color_type & ~PNG_COLOR_MASK_ALPHA);
+   }
+#endif
+
+#ifdef PNG_READ_GRAY_TO_RGB_SUPPORTED
+   if ((transformations & PNG_GRAY_TO_RGB) != 0 &&
+       (png_ptr->mode & PNG_BACKGROUND_IS_GRAY) == 0 &&
+       (pixel.color_type & PNG_COLOR_MASK_COLOR) == 0)
+   {
+      png_fused_pick(&pixel, png_fused_gray_to_rgb[b-1], 3*b + pixel.bytes - b);
+      pixel.channels = (png_byte)(pixel.channels + 2);
+      pixel.color_type = (png_byte)(pixel.color_type | PNG_COLOR_MASK_COLOR);
+   }
+#endif
+
+#ifdef PNG_READ_SCALE_16_TO_8_SUPPORTED
+   /* This does arithmetic but only on 16-bit rows. */
+   if ((transformations & PNG_SCALE_16_TO_8) != 0 && pixel.bit_depth == 16)
+      return;
+#endif
+
+#ifdef PNG_READ_STRIP_16_TO_8_SUPPORTED
+   if ((transformations & PNG_16_TO_8) != 0 && pixel.bit_depth == 16)
+   {
+      static const png_byte chop[4] = { 0, 2, 4, 6 };
+
+      png_fused_pick(&pixel, chop, pixel.bytes >> 1);
+      pixel.bit_depth = 8;
+      b = 1;
+   }
+#endif
+
+#ifdef PNG_READ_EXPAND_16_SUPPORTED
+   if ((transformations & PNG_EXPAND_16) != 0 && pixel.bit_depth == 8)
+   {
+      static const png_byte expand_16[8] = { 0, 0, 1, 1, 2, 2, 3, 3 };
+
+      png_fused_pick(&pixel, expand_16, 2*pixel.bytes);
+      pixel.bit_depth = 16;
+      b = 2;
+   }
+#endif
+
+#ifdef PNG_READ_GRAY_TO_RGB_SUPPORTED
+   if ((transformations & PNG_GRAY_TO_RGB) != 0 &&
+       (png_ptr->mode & PNG_BACKGROUND_IS_GRAY) != 0 &&
+       (pixel.color_type & PNG_COLOR_MASK_COLOR) == 0)
+   {
+      png_fused_pick(&pixel, png_fused_gray_to_rgb[b-1], 3*b + pixel.bytes - b);
+      pixel.channels = (png_byte)(pixel.channels + 2);
+      pixel.color_type = (png_byte)(pixel.color_type | PNG_COLOR_MASK_COLOR);
+   }
+#endif
+
+#ifdef PNG_READ_INVERT_SUPPORTED
+   /* png_do_invert inverts all of a gray row but only the gray channel of a
+    * gray-alpha row.
+    */
+   if ((transformations & PNG_INVERT_MONO) != 0)
+   {
+      if (pixel.color_type == PNG_COLOR_TYPE_GRAY)
+         png_fused_invert(&pixel, 0, pixel.bytes);
+
+      else if (pixel.color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+         png_fused_invert(&pixel, 0, b);
+   }
+#endif
+
+#ifdef PNG_READ_INVERT_ALPHA_SUPPORTED
+   if ((transformations & PNG_INVERT_ALPHA) != 0 &&
+       (pixel.color_type & PNG_COLOR_MASK_ALPHA) != 0)
+      png_fused_invert(&pixel, pixel.bytes - b, b);
+#endif
+
+   /* PNG_PACK and PNG_PACKSWAP only affect rows of less than 8 bits. */
+
+#ifdef PNG_READ_BGR_SUPPORTED
+   if ((transformations & PNG_BGR) != 0 &&
+       (pixel.color_type & PNG_COLOR_MASK_COLOR) != 0)
+   {
+      static const png_byte bgr[2][8] =
+      {
+         { 2, 1, 0, 3, 0, 0, 0, 0 },
+         { 4, 5, 2, 3, 0, 1, 6, 7 }
+      };
+
+      png_fused_pick(&pixel, bgr[b-1], pixel.bytes);
+   }
+#endif
+
+#ifdef PNG_READ_FILLER_SUPPORTED
+   if ((transformations & PNG_FILLER) != 0 &&
+       (pixel.color_type == PNG_COLOR_TYPE_GRAY ||
+       pixel.color_type == PNG_COLOR_TYPE_RGB))
+   {
+      /* The filler bytes are inserted before or after the pixel; the color
+       * type does not change.
+       */
+      unsigned int at = (png_ptr->flags & PNG_FLAG_FILLER_AFTER) != 0 ?
+          pixel.bytes : 0;
+
+      memmove(pixel.source + at + b, pixel.source + at, pixel.bytes - at);
+      memmove(pixel.value + at + b, pixel.value + at, pixel.bytes - at);
+      pixel.source[at] = pixel.source[at + b - 1] = 8;
+      pixel.value[at + b - 1] = (png_byte)png_ptr->filler;
+      if (b == 2)
+         pixel.value[at] = (png_byte)(png_ptr->filler >> 8);
+
+      pixel.bytes = (png_byte)(pixel.bytes + b);
+      pixel.channels++;
+   }
+#endif
+
+#ifdef PNG_READ_SWAP_ALPHA_SUPPORTED
+   if ((transformations & PNG_SWAP_ALPHA) != 0 &&
+       (pixel.color_type & PNG_COLOR_MASK_ALPHA) != 0)
+   {
+      /* Move the alpha bytes to the front. */
+      png_byte pick[8];
+
+      for (i = 0; i < pixel.bytes; ++i)
+         pick[i] = (png_byte)((i + pixel.bytes - b) % pixel.bytes);
+
+      png_fused_pick(&pixel, pick, pixel.bytes);
+   }
+#endif
+
+#ifdef PNG_READ_16BIT_SUPPORTED
+#ifdef PNG_READ_SWAP_SUPPORTED
+   if ((transformations & PNG_SWAP_BYTES) != 0 && pixel.bit_depth == 16)
+   {
+      static const png_byte swap[8] = { 1, 0, 3, 2, 5, 4, 7, 6 };
+
+      png_fused_pick(&pixel, swap, pixel.bytes);
+   }
+#endif
+#endif
+
+   png_init_fused(png_ptr, &pixel, in);
+}
+
 void /* PRIVATE */
 png_init_read_transformations(png_structrp png_ptr)
 {
@@ -1930,6 +2212,52 @@ png_init_read_transformations(png_structrp png_ptr)
          }
    }
 #endif /* READ_SHIFT */
+
+#if defined(PNG_GAMMA_OPTIMIZATIONS) && defined(PNG_READ_GAMMA_SUPPORTED)
+   /* Install any hardware specific gamma correction, compositing and
+    * conversion to gray now the tables exist.
+    */
+   png_ptr->do_gamma = NULL;
+   png_ptr->gamma_16_exponent = 0;
+#  if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+      defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+   png_ptr->do_compose = NULL;
+#  endif
+#  ifdef PNG_READ_RGB_TO_GRAY_SUPPORTED
+   png_ptr->do_rgb_to_gray = NULL;
+#  endif
+
+#  if defined(PNG_APPROXIMATE_GAMMA_16) && defined(PNG_READ_16BIT_SUPPORTED)
+   /* The 16-bit values may be calculated instead of looked up, but only those
+    * of the table made by png_build_16bit_table.
+    */
+   if ((png_ptr->transformations & PNG_GAMMA) != 0 &&
+       ((png_ptr->options >> PNG_APPROXIMATE_GAMMA_16) & 3) ==
+       PNG_OPTION_ON && png_ptr->gamma_16_table != NULL &&
+       (png_ptr->transformations & (PNG_16_TO_8 | PNG_SCALE_16_TO_8)) == 0)
+   {
+      png_fixed_point gamma_val = png_ptr->screen_gamma > 0 ?
+          png_reciprocal2(png_ptr->colorspace.gamma,
+          png_ptr->screen_gamma) : PNG_FP_1;
+
+      if (png_gamma_significant(gamma_val) != 0)
+         png_ptr->gamma_16_exponent = gamma_val;
+   }
+#  endif
+
+   if ((png_ptr->transformations &
+       (PNG_GAMMA | PNG_COMPOSE | PNG_RGB_TO_GRAY)) != 0)
+      PNG_GAMMA_OPTIMIZATIONS(png_ptr);
+#endif
+
+   /* Finally, with the transformations settled, see if the row conversions can
+    * be done in one pass.
+    */
+   png_init_read_fused(png_ptr);
+
+#ifdef PNG_SHUFFLE_OPTIMIZATIONS
+   PNG_SHUFFLE_OPTIMIZATIONS(png_ptr);
+#endif
 }
 
 /* Modify the info structure to reflect the transformations.  The
@@ -4732,74 +5060,12 @@ png_do_quantize(png_row_infop row_info, png_bytep row,
 }
 #endif /* READ_QUANTIZE */
 
-/* Transform the row.  The order of transformations is significant,
- * and is very touchy.  If you add a transformation, take care to
- * decide how it fits in with the other transformations here.
+/* The transformations after the expansion and before the user transform, done
+ * one at a time.  png_init_read_fused must be kept in step with this.
  */
-void /* PRIVATE */
-png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
+static void
+png_do_read_row_transformations(png_structrp png_ptr, png_row_infop row_info)
 {
-   png_debug(1, "in png_do_read_transformations");
-
-   if (png_ptr->row_buf == NULL)
-   {
-      /* Prior to 1.5.4 this output row/pass where the NULL pointer is, but this
-       * error is incredibly rare and incredibly easy to debug without this
-       * information.
-       */
-      png_error(png_ptr, "NULL row buffer");
-   }
-
-   /* The following is debugging; prior to 1.5.4 the code was never compiled in;
-    * in 1.5.4 PNG_FLAG_DETECT_UNINITIALIZED was added and the macro
-    * PNG_WARN_UNINITIALIZED_ROW removed.  In 1.6 the new flag is set only for
-    * all transformations, however in practice the ROW_INIT always gets done on
-    * demand, if necessary.
-    */
-   if ((png_ptr->flags & PNG_FLAG_DETECT_UNINITIALIZED) != 0 &&
-       (png_ptr->flags & PNG_FLAG_ROW_INIT) == 0)
-   {
-      /* Application has failed to call either png_read_start_image() or
-       * png_read_update_info() after setting transforms that expand pixels.
-       * This check added to libpng-1.2.19 (but not enabled until 1.5.4).
-       */
-      png_error(png_ptr, "Uninitialized row");
-   }
-
-#ifdef PNG_READ_EXPAND_SUPPORTED
-   if ((png_ptr->transformations & PNG_EXPAND) != 0)
-   {
-      if (row_info->color_type == PNG_COLOR_TYPE_PALETTE)
-      {
-#ifdef PNG_ARM_NEON_INTRINSICS_AVAILABLE
-         if ((png_ptr->num_trans > 0) && (png_ptr->bit_depth == 8))
-         {
-            if (png_ptr->riffled_palette == NULL)
-            {
-               /* Initialize the accelerated palette expansion. */
-               png_ptr->riffled_palette =
-                   (png_bytep)png_malloc(png_ptr, 256 * 4);
-               png_riffle_palette_neon(png_ptr);
-            }
-         }
-#endif
-         png_do_expand_palette(png_ptr, row_info, png_ptr->row_buf + 1,
-             png_ptr->palette, png_ptr->trans_alpha, png_ptr->num_trans);
-      }
-
-      else
-      {
-         if (png_ptr->num_trans != 0 &&
-             (png_ptr->transformations & PNG_EXPAND_tRNS) != 0)
-            png_do_expand(row_info, png_ptr->row_buf + 1,
-                &(png_ptr->trans_color));
-
-         else
-            png_do_expand(row_info, png_ptr->row_buf + 1, NULL);
-      }
-   }
-#endif
-
 #ifdef PNG_READ_STRIP_ALPHA_SUPPORTED
    if ((png_ptr->transformations & PNG_STRIP_ALPHA) != 0 &&
        (png_ptr->transformations & PNG_COMPOSE) == 0 &&
@@ -4812,9 +5078,15 @@ png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
 #ifdef PNG_READ_RGB_TO_GRAY_SUPPORTED
    if ((png_ptr->transformations & PNG_RGB_TO_GRAY) != 0)
    {
-      int rgb_error =
-          png_do_rgb_to_gray(png_ptr, row_info,
-              png_ptr->row_buf + 1);
+      int rgb_error;
+
+#ifdef PNG_GAMMA_OPTIMIZATIONS
+      if (png_ptr->do_rgb_to_gray == NULL ||
+          png_ptr->do_rgb_to_gray(png_ptr, row_info, png_ptr->row_buf + 1,
+          &rgb_error) == 0)
+#endif
+         rgb_error = png_do_rgb_to_gray(png_ptr, row_info,
+             png_ptr->row_buf + 1);
 
       if (rgb_error != 0)
       {
@@ -4873,7 +5145,13 @@ png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
 #if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
    defined(PNG_READ_ALPHA_MODE_SUPPORTED)
    if ((png_ptr->transformations & PNG_COMPOSE) != 0)
-      png_do_compose(row_info, png_ptr->row_buf + 1, png_ptr);
+   {
+#ifdef PNG_GAMMA_OPTIMIZATIONS
+      if (png_ptr->do_compose == NULL ||
+          png_ptr->do_compose(png_ptr, row_info, png_ptr->row_buf + 1) == 0)
+#endif
+         png_do_compose(row_info, png_ptr->row_buf + 1, png_ptr);
+   }
 #endif
 
 #ifdef PNG_READ_GAMMA_SUPPORTED
@@ -4895,7 +5173,13 @@ png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
        * RGB_TO_GRAY will do the transform.
        */
        (png_ptr->color_type != PNG_COLOR_TYPE_PALETTE))
-      png_do_gamma(row_info, png_ptr->row_buf + 1, png_ptr);
+   {
+#ifdef PNG_GAMMA_OPTIMIZATIONS
+      if (png_ptr->do_gamma == NULL ||
+          png_ptr->do_gamma(png_ptr, row_info, png_ptr->row_buf + 1) == 0)
+#endif
+         png_do_gamma(row_info, png_ptr->row_buf + 1, png_ptr);
+   }
 #endif
 
 #ifdef PNG_READ_STRIP_ALPHA_SUPPORTED
@@ -4990,7 +5274,7 @@ png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
 
 #ifdef PNG_READ_PACKSWAP_SUPPORTED
    if ((png_ptr->transformations & PNG_PACKSWAP) != 0)
-      png_do_packswap(row_info, png_ptr->row_buf + 1);
+      png_do_packswap(png_ptr, row_info, png_ptr->row_buf + 1);
 #endif
 
 #ifdef PNG_READ_FILLER_SUPPORTED
@@ -5010,6 +5294,100 @@ png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
       png_do_swap(row_info, png_ptr->row_buf + 1);
 #endif
 #endif
+}
+
+/* Transform the row.  The order of transformations is significant,
+ * and is very touchy.  If you add a transformation, take care to
+ * decide how it fits in with the other transformations here.
+ */
+void /* PRIVATE */
+png_do_read_transformations(png_structrp png_ptr, png_row_infop row_info)
+{
+   png_debug(1, "in png_do_read_transformations");
+
+   if (png_ptr->row_buf == NULL)
+   {
+      /* Prior to 1.5.4 this output row/pass where the NULL pointer is, but this
+       * error is incredibly rare and incredibly easy to debug without this
+       * information.
+       */
+      png_error(png_ptr, "NULL row buffer");
+   }
+
+   /* The following is debugging; prior to 1.5.4 the code was never compiled in;
+    * in 1.5.4 PNG_FLAG_DETECT_UNINITIALIZED was added and the macro
+    * PNG_WARN_UNINITIALIZED_ROW removed.  In 1.6 the new flag is set only for
+    * all transformations, however in practice the ROW_INIT always gets done on
+    * demand, if necessary.
+    */
+   if ((png_ptr->flags & PNG_FLAG_DETECT_UNINITIALIZED) != 0 &&
+       (png_ptr->flags & PNG_FLAG_ROW_INIT) == 0)
+   {
+      /* Application has failed to call either png_read_start_image() or
+       * png_read_update_info() after setting transforms that expand pixels.
+       * This check added to libpng-1.2.19 (but not enabled until 1.5.4).
+       */
+      png_error(png_ptr, "Uninitialized row");
+   }
+
+#ifdef PNG_READ_EXPAND_SUPPORTED
+   if ((png_ptr->transformations & PNG_EXPAND) != 0)
+   {
+      if (row_info->color_type == PNG_COLOR_TYPE_PALETTE)
+      {
+#ifdef PNG_ARM_NEON_INTRINSICS_AVAILABLE
+         if ((png_ptr->num_trans > 0) && (png_ptr->bit_depth == 8))
+         {
+            if (png_ptr->riffled_palette == NULL)
+            {
+               /* Initialize the accelerated palette expansion. */
+               png_ptr->riffled_palette =
+                   (png_bytep)png_malloc(png_ptr, 256 * 4);
+               png_riffle_palette_neon(png_ptr);
+            }
+         }
+#endif
+#ifdef PNG_PALETTE_OPTIMIZATIONS
+         if (png_ptr->riffled_palette == NULL)
+         {
+            /* Initialize the hardware specific palette expansion. */
+            png_ptr->riffled_palette = (png_bytep)png_malloc(png_ptr, 256 * 4);
+            PNG_PALETTE_OPTIMIZATIONS(png_ptr);
+         }
+
+         if (png_ptr->expand_palette(png_ptr, row_info,
+             png_ptr->row_buf + 1) == 0)
+#endif
+         png_do_expand_palette(png_ptr, row_info, png_ptr->row_buf + 1,
+             png_ptr->palette, png_ptr->trans_alpha, png_ptr->num_trans);
+      }
+
+      else
+      {
+         if (png_ptr->num_trans != 0 &&
+             (png_ptr->transformations & PNG_EXPAND_tRNS) != 0)
+            png_do_expand(row_info, png_ptr->row_buf + 1,
+                &(png_ptr->trans_color));
+
+         else
+            png_do_expand(row_info, png_ptr->row_buf + 1, NULL);
+      }
+   }
+#endif
+
+   if (png_ptr->do_fused != NULL)
+   {
+      /* All the transformations can be done in one pass. */
+      png_ptr->do_fused(png_ptr, png_ptr->row_buf + 1, row_info->width);
+      row_info->color_type = png_ptr->fused_color_type;
+      row_info->bit_depth = png_ptr->fused_bit_depth;
+      row_info->channels = png_ptr->fused_channels;
+      row_info->pixel_depth = (png_byte)(8 * png_ptr->fused_out_bytes);
+      row_info->rowbytes = (size_t)row_info->width * png_ptr->fused_out_bytes;
+   }
+
+   else
+      png_do_read_row_transformations(png_ptr, row_info);
 
 #ifdef PNG_READ_USER_TRANSFORM_SUPPORTED
    if ((png_ptr->transformations & PNG_USER_TRANSFORM) != 0)
@@ -18,6 +18,15 @@
 
 #ifdef PNG_READ_SUPPORTED
 
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+#  ifdef _WIN32
+#    include <windows.h>
+#  else
+#    include <pthread.h>
+#    include <unistd.h>
+#  endif
+#endif
+
 png_uint_32 PNGAPI
 png_get_uint_31(png_const_structrp png_ptr, png_const_bytep buf)
 {
@@ -202,6 +211,29 @@ png_crc_read(png_structrp png_ptr, png_bytep buf, png_uint_32 length)
    png_calculate_crc(png_ptr, buf, length);
 }
 
+#ifdef PNG_READ_BORROW_SUPPORTED
+/* Return a pointer to the next 'length' bytes of chunk data in the
+ * application's own input, after running them through the CRC.  Returns NULL,
+ * having read nothing, if the input cannot be used in place; the caller must
+ * then use png_crc_read.
+ */
+static png_const_bytep
+png_crc_borrow(png_structrp png_ptr, png_uint_32 length)
+{
+   png_const_bytep data;
+
+   if (png_ptr->borrow_data_fn == NULL || length == 0)
+      return NULL;
+
+   data = (*(png_ptr->borrow_data_fn))(png_ptr, length);
+
+   if (data != NULL)
+      png_calculate_crc(png_ptr, data, length);
+
+   return data;
+}
+#endif
+
 /* Optionally skip data and then check the CRC.  Depending on whether we
  * are reading an ancillary or critical chunk, and how the program has set
  * things up, we may calculate the CRC on the data and print a message.
@@ -218,6 +250,11 @@ png_crc_finish(png_structrp png_ptr, png_uint_32 skip)
       png_uint_32 len;
       png_byte tmpbuf[PNG_INFLATE_BUF_SIZE];
 
+#ifdef PNG_READ_BORROW_SUPPORTED
+      if (png_crc_borrow(png_ptr, skip) != NULL)
+         break;
+#endif
+
       len = (sizeof tmpbuf);
       if (len > skip)
          len = skip;
@@ -267,6 +304,11 @@ png_crc_error(png_structrp png_ptr)
          need_crc = 0;
    }
 
+#if defined(PNG_SET_OPTION_SUPPORTED) && defined(PNG_SKIP_CHECKSUMS)
+   if (((png_ptr->options >> PNG_SKIP_CHECKSUMS) & 3) == PNG_OPTION_ON)
+      need_crc = 0;
+#endif
+
 #ifdef PNG_IO_STATE_SUPPORTED
    png_ptr->io_state = PNG_IO_READING | PNG_IO_CHUNK_CRC;
 #endif
@@ -391,6 +433,8 @@ png_inflate_claim(png_structrp png_ptr, png_uint_32 owner)
       }
 # endif
 
+#else
+#  define window_bits 15 /* inflateInit always uses the maximum */
 #endif /* ZLIB_VERNUM >= 0x1240 */
 
       /* Set this for safety, just in case the previous owner left pointers to
@@ -403,30 +447,31 @@ png_inflate_claim(png_structrp png_ptr, png_uint_32 owner)
 
       if ((png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED) != 0)
       {
-#if ZLIB_VERNUM >= 0x1240
-         ret = inflateReset2(&png_ptr->zstream, window_bits);
-#else
-         ret = inflateReset(&png_ptr->zstream);
-#endif
+         ret = PNG_ZLIB(png_ptr, inflate_reset2)(&png_ptr->zstream,
+             window_bits);
       }
 
       else
       {
-#if ZLIB_VERNUM >= 0x1240
-         ret = inflateInit2(&png_ptr->zstream, window_bits);
-#else
-         ret = inflateInit(&png_ptr->zstream);
-#endif
+         ret = PNG_ZLIB(png_ptr, inflate_init2)(&png_ptr->zstream,
+             window_bits);
 
          if (ret == Z_OK)
             png_ptr->flags |= PNG_FLAG_ZSTREAM_INITIALIZED;
       }
 
-#if ZLIB_VERNUM >= 0x1290 && \
-   defined(PNG_SET_OPTION_SUPPORTED) && defined(PNG_IGNORE_ADLER32)
+#if ZLIB_VERNUM >= 0x1290 && defined(PNG_SET_OPTION_SUPPORTED)
+# ifdef PNG_IGNORE_ADLER32
       if (((png_ptr->options >> PNG_IGNORE_ADLER32) & 3) == PNG_OPTION_ON)
          /* Turn off validation of the ADLER32 checksum in IDAT chunks */
-         ret = inflateValidate(&png_ptr->zstream, 0);
+         ret = PNG_ZLIB(png_ptr, inflate_validate)(&png_ptr->zstream, 0);
+# endif
+# ifdef PNG_SKIP_CHECKSUMS
+      /* This also stops zlib calculating the checksum in the first place. */
+      if (ret == Z_OK &&
+          ((png_ptr->options >> PNG_SKIP_CHECKSUMS) & 3) == PNG_OPTION_ON)
+         ret = PNG_ZLIB(png_ptr, inflate_validate)(&png_ptr->zstream, 0);
+# endif
 #endif
 
       if (ret == Z_OK)
@@ -464,7 +509,7 @@ png_zlib_inflate(png_structrp png_ptr, int flush)
       png_ptr->zstream_start = 0;
    }
 
-   return inflate(&png_ptr->zstream, flush);
+   return PNG_ZLIB(png_ptr, inflate_data)(&png_ptr->zstream, flush);
 }
 #endif /* Zlib >= 1.2.4 */
 
@@ -600,14 +645,15 @@ png_inflate(png_structrp png_ptr, png_uint_32 owner, int finish,
 }
 
 /*
- * Decompress trailing data in a chunk.  The assumption is that read_buffer
- * points at an allocated area holding the contents of a chunk with a
- * trailing compressed part.  What we get back is an allocated area
- * holding the original prefix part and an uncompressed version of the
- * trailing part (the malloc area passed in is freed).
+ * Decompress trailing data in a chunk.  The assumption is that 'chunk' points
+ * at the contents of a chunk with a trailing compressed part; this is either
+ * read_buffer or the application's own input.  What we get back, in
+ * read_buffer, is an allocated area holding the original prefix part and an
+ * uncompressed version of the trailing part (the previous read_buffer is
+ * freed).
  */
 static int
-png_decompress_chunk(png_structrp png_ptr,
+png_decompress_chunk(png_structrp png_ptr, png_const_bytep chunk,
     png_uint_32 chunklength, png_uint_32 prefix_size,
     png_alloc_size_t *newlength /* must be initialized to the maximum! */,
     int terminate /*add a '\0' to the end of the uncompressed data*/)
@@ -647,7 +693,7 @@ png_decompress_chunk(png_structrp png_ptr,
          png_uint_32 lzsize = chunklength - prefix_size;
 
          ret = png_inflate(png_ptr, png_ptr->chunk_name, 1/*finish*/,
-             /* input: */ png_ptr->read_buffer + prefix_size, &lzsize,
+             /* input: */ chunk + prefix_size, &lzsize,
              /* output: */ NULL, newlength);
 
          if (ret == Z_STREAM_END)
@@ -659,7 +705,7 @@ png_decompress_chunk(png_structrp png_ptr,
              * with Z_FINISH in almost all cases, so the window will not be
              * maintained.
              */
-            if (inflateReset(&png_ptr->zstream) == Z_OK)
+            if (PNG_ZLIB(png_ptr, inflate_reset)(&png_ptr->zstream) == Z_OK)
             {
                /* Because of the limit checks above we know that the new,
                 * expanded, size will fit in a size_t (let alone an
@@ -677,7 +723,7 @@ png_decompress_chunk(png_structrp png_ptr,
                   memset(text, 0, buffer_size);
 
                   ret = png_inflate(png_ptr, png_ptr->chunk_name, 1/*finish*/,
-                      png_ptr->read_buffer + prefix_size, &lzsize,
+                      chunk + prefix_size, &lzsize,
                       text + prefix_size, newlength);
 
                   if (ret == Z_STREAM_END)
@@ -688,7 +734,7 @@ png_decompress_chunk(png_structrp png_ptr,
                            text[prefix_size + *newlength] = 0;
 
                         if (prefix_size > 0)
-                           memcpy(text, png_ptr->read_buffer, prefix_size);
+                           memcpy(text, chunk, prefix_size);
 
                         {
                            png_bytep old_ptr = png_ptr->read_buffer;
@@ -787,15 +833,33 @@ png_inflate_read(png_structrp png_ptr, png_bytep read_buffer, uInt read_size,
       {
          if (png_ptr->zstream.avail_in == 0)
          {
-            if (read_size > *chunk_bytes)
-               read_size = (uInt)*chunk_bytes;
-            *chunk_bytes -= read_size;
+            png_const_bytep next_in = NULL;
+            uInt avail_in;
+
+#ifdef PNG_READ_BORROW_SUPPORTED
+            /* Borrowed input does not need to fit in read_buffer. */
+            avail_in = ZLIB_IO_MAX;
+            if (avail_in > *chunk_bytes)
+               avail_in = (uInt)*chunk_bytes;
+
+            next_in = png_crc_borrow(png_ptr, avail_in);
 
-            if (read_size > 0)
-               png_crc_read(png_ptr, read_buffer, read_size);
+            if (next_in == NULL)
+#endif
+            {
+               avail_in = read_size;
+               if (avail_in > *chunk_bytes)
+                  avail_in = (uInt)*chunk_bytes;
+
+               if (avail_in > 0)
+                  png_crc_read(png_ptr, read_buffer, avail_in);
+
+               next_in = read_buffer;
+            }
 
-            png_ptr->zstream.next_in = read_buffer;
-            png_ptr->zstream.avail_in = read_size;
+            *chunk_bytes -= avail_in;
+            png_ptr->zstream.next_in = PNGZ_INPUT_CAST(next_in);
+            png_ptr->zstream.avail_in = avail_in;
          }
 
          if (png_ptr->zstream.avail_out == 0)
@@ -2039,6 +2103,9 @@ void /* PRIVATE */
 png_handle_eXIf(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
 {
    unsigned int i;
+#ifdef PNG_READ_BORROW_SUPPORTED
+   png_const_bytep data;
+#endif
 
    png_debug(1, "in png_handle_eXIf");
 
@@ -2059,6 +2126,28 @@ png_handle_eXIf(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
       return;
    }
 
+#ifdef PNG_READ_BORROW_SUPPORTED
+   /* The data can be stored straight from the input; png_set_eXIf_1 makes its
+    * own copy.
+    */
+   data = png_crc_borrow(png_ptr, length);
+
+   if (data != NULL)
+   {
+      if (data[1] != 'M' && data[1] != 'I' && data[0] != data[1])
+      {
+         png_crc_finish(png_ptr, 0);
+         png_chunk_benign_error(png_ptr, "incorrect byte-order specifier");
+      }
+
+      else if (png_crc_finish(png_ptr, 0) == 0)
+         png_set_eXIf_1(png_ptr, info_ptr, length,
+             png_constcast(png_bytep, data));
+
+      return;
+   }
+#endif
+
    info_ptr->free_me |= PNG_FREE_EXIF;
 
    info_ptr->eXIf_buf = png_voidcast(png_bytep,
@@ -2594,7 +2683,7 @@ void /* PRIVATE */
 png_handle_zTXt(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
 {
    png_const_charp errmsg = NULL;
-   png_bytep       buffer;
+   png_const_bytep buffer = NULL;
    png_uint_32     keyword_length;
 
    png_debug(1, "in png_handle_zTXt");
@@ -2623,19 +2712,28 @@ png_handle_zTXt(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
    if ((png_ptr->mode & PNG_HAVE_IDAT) != 0)
       png_ptr->mode |= PNG_AFTER_IDAT;
 
-   /* Note, "length" is sufficient here; we won't be adding
-    * a null terminator later.
-    */
-   buffer = png_read_buffer(png_ptr, length, 2/*silent*/);
+#ifdef PNG_READ_BORROW_SUPPORTED
+   /* The compressed text can be inflated straight from the input. */
+   buffer = png_crc_borrow(png_ptr, length);
 
    if (buffer == NULL)
+#endif
    {
-      png_crc_finish(png_ptr, length);
-      png_chunk_benign_error(png_ptr, "out of memory");
-      return;
-   }
+      /* Note, "length" is sufficient here; we won't be adding
+       * a null terminator later.
+       */
+      png_bytep copy = png_read_buffer(png_ptr, length, 2/*silent*/);
 
-   png_crc_read(png_ptr, buffer, length);
+      if (copy == NULL)
+      {
+         png_crc_finish(png_ptr, length);
+         png_chunk_benign_error(png_ptr, "out of memory");
+         return;
+      }
+
+      png_crc_read(png_ptr, copy, length);
+      buffer = copy;
+   }
 
    if (png_crc_finish(png_ptr, 0) != 0)
       return;
@@ -2667,7 +2765,7 @@ png_handle_zTXt(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
        * level memory limit, this should be split to different values for iCCP
        * and text chunks.
        */
-      if (png_decompress_chunk(png_ptr, length, keyword_length+2,
+      if (png_decompress_chunk(png_ptr, buffer, length, keyword_length+2,
           &uncompressed_length, 1/*terminate*/) == Z_STREAM_END)
       {
          png_text text;
@@ -2680,12 +2778,13 @@ png_handle_zTXt(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
              * except for the extra compression type byte and the fact that
              * it isn't necessarily '\0' terminated.
              */
-            buffer = png_ptr->read_buffer;
-            buffer[uncompressed_length+(keyword_length+2)] = 0;
+            png_bytep text_buffer = png_ptr->read_buffer;
+
+            text_buffer[uncompressed_length+(keyword_length+2)] = 0;
 
             text.compression = PNG_TEXT_COMPRESSION_zTXt;
-            text.key = (png_charp)buffer;
-            text.text = (png_charp)(buffer + keyword_length+2);
+            text.key = (png_charp)text_buffer;
+            text.text = (png_charp)(text_buffer + keyword_length+2);
             text.text_length = uncompressed_length;
             text.itxt_length = 0;
             text.lang = NULL;
@@ -2812,7 +2911,7 @@ png_handle_iTXt(png_structrp png_ptr, png_inforp info_ptr, png_uint_32 length)
           * level memory limit, this should be split to different values for
           * iCCP and text chunks.
           */
-         if (png_decompress_chunk(png_ptr, length, prefix_length,
+         if (png_decompress_chunk(png_ptr, buffer, length, prefix_length,
              &uncompressed_length, 1/*terminate*/) == Z_STREAM_END)
             buffer = png_ptr->read_buffer;
 
@@ -3483,6 +3582,12 @@ png_combine_row(png_const_structrp png_ptr, png_bytep dp, int display)
          /* In Adam7 there is a constant offset between where the pixels go. */
          bytes_to_jump = PNG_PASS_COL_OFFSET(pass) * pixel_depth;
 
+         /* A hardware specific version may do the whole copy. */
+         if (png_ptr->combine_row != NULL &&
+             png_ptr->combine_row(dp, sp, row_width, bytes_to_copy,
+             bytes_to_jump) != 0)
+            return;
+
          /* And simply copy these bytes.  Some optimization is possible here,
           * depending on the value of 'bytes_to_copy'.  Special case the low
           * byte counts, which we know to be frequent.
@@ -4143,10 +4248,684 @@ png_read_filter_row(png_structrp pp, png_row_infop row_info, png_bytep row,
 }
 
 #ifdef PNG_SEQUENTIAL_READ_SUPPORTED
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+/* Undo the filters of 'rows' rows stored back to back at 'output', each of
+ * row_info->rowbytes bytes after the filter byte.  The filter functions may
+ * read and write a little beyond the end of a row, which here is the next row,
+ * so each row is unfiltered in 'row_buf' and copied back.  'row_buf' and
+ * 'prev_row' must have the padding of png_ptr->row_buf; 'prev_row' holds the
+ * row before the first one.  The filter functions must have been initialized
+ * and this must not png_error, as it is also run by the READ_PARALLEL worker
+ * threads; a bad filter value just returns 0.
+ */
+static int
+png_unfilter_rows(png_const_structrp png_ptr, png_row_infop row_info,
+    png_bytep output, png_uint_32 rows, png_bytep row_buf, png_bytep prev_row)
+{
+   size_t row_bytes = row_info->rowbytes;
+
+   for (; rows > 0; --rows, output += row_bytes + 1)
+   {
+      unsigned int filter = output[0];
+
+      if (filter > PNG_FILTER_VALUE_NONE)
+      {
+         png_bytep temp = prev_row;
+
+         if (filter >= PNG_FILTER_VALUE_LAST)
+            return 0;
+
+         memcpy(row_buf + 1, output + 1, row_bytes);
+         png_ptr->read_filter[filter-1](row_info, row_buf + 1, prev_row + 1);
+         memcpy(output + 1, row_buf + 1, row_bytes);
+         output[0] = PNG_FILTER_VALUE_NONE;
+
+         prev_row = row_buf;
+         row_buf = temp;
+      }
+
+      else
+         memcpy(prev_row + 1, output + 1, row_bytes);
+   }
+
+   return 1;
+}
+
+#if defined(PNG_READ_PARALLEL_SUPPORTED) || defined(PNG_ZLIB_BACKEND_SUPPORTED)
+/* Read all png_ptr->idat_length bytes of the IDAT data into 'buffer'; the
+ * length was found by png_image_read_IDAT_length, so this is just like the
+ * reads in png_read_IDAT_data.
+ */
+static void
+png_read_IDAT_all(png_structrp png_ptr, png_bytep buffer)
+{
+   png_alloc_size_t length = png_ptr->idat_length;
+   png_alloc_size_t pos;
+
+   for (pos = 0; pos < length;)
+   {
+      uInt avail_in = ZLIB_IO_MAX;
+
+      while (png_ptr->idat_size == 0)
+      {
+         png_crc_finish(png_ptr, 0);
+
+         png_ptr->idat_size = png_read_chunk_header(png_ptr);
+
+         if (png_ptr->chunk_name != png_IDAT)
+            png_error(png_ptr, "Not enough image data");
+      }
+
+      if (avail_in > png_ptr->idat_size)
+         avail_in = (uInt)png_ptr->idat_size;
+
+      if (avail_in > length - pos)
+         avail_in = (uInt)(length - pos);
+
+      png_crc_read(png_ptr, buffer + pos, avail_in);
+      png_ptr->idat_size -= avail_in;
+      pos += avail_in;
+   }
+}
+#endif /* READ_PARALLEL || ZLIB_BACKEND */
+
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+/* Decoding of the groups of rows between the restart points read from an riDX
+ * chunk.  Each thread inflates and unfilters every num_jobs'th group with its
+ * own raw inflate stream; there is no dictionary because the writer did a full
+ * flush at each restart point.  The worker threads must not png_error, so any
+ * problem is just recorded and the whole image is then decoded serially, which
+ * reports the error in the normal way.
+ */
+typedef struct
+{
+   png_const_bytep  input;      /* compressed data of the group */
+   png_alloc_size_t input_len;
+   png_bytep        output;     /* filtered rows of the group */
+   png_alloc_size_t output_len;
+   png_uint_32      rows;
+   uLong            adler;      /* Adler-32 of the filtered rows */
+   int              last;       /* the group ends the zlib stream */
+   int              unfiltered; /* set once the rows have been unfiltered */
+} png_idat_group, *png_idat_groupp;
+
+typedef struct
+{
+   png_structrp     png_ptr;
+   z_stream         zs;
+   png_idat_groupp  groups;
+   png_uint_32      num_groups;
+   png_uint_32      first;      /* first group of this job */
+   unsigned int     step;       /* number of jobs */
+   png_bytep        buffer;     /* padded row_buf and prev_row */
+   int              check_adler;
+   int              ok;         /* set if every group was decoded */
+   int              started;    /* set if 'thread' must be joined */
+#ifdef _WIN32
+   HANDLE           thread;
+#else
+   pthread_t        thread;
+#endif
+} png_idat_job, *png_idat_jobp;
+
+static uLong
+png_idat_adler(uLong adler, png_const_bytep data, png_alloc_size_t length)
+{
+   while (length > 0)
+   {
+      uInt avail = ZLIB_IO_MAX;
+
+      if (avail > length)
+         avail = (uInt)length;
+
+      adler = adler32(adler, data, avail);
+      data += avail;
+      length -= avail;
+   }
+
+   return adler;
+}
+
+/* The job's row_buf and prev_row, each laid out like the png_struct ones with
+ * 31 bytes before the filter byte and at least 32 after the row.
+ */
+#define PNG_IDAT_JOB_ROW(row_bytes) ((row_bytes) + 64)
+
+/* Decode one group, the first of the image if 'first' is set; returns 0 on any
+ * error.
+ */
+static int
+png_idat_group_run(png_idat_jobp job, png_idat_groupp group, int first)
+{
+   png_structrp png_ptr = job->png_ptr;
+   png_bytep output = group->output;
+   png_alloc_size_t avail_out = group->output_len;
+   png_byte extra;
+   png_alloc_size_t row_bytes;
+   png_row_info row_info;
+   png_uint_32 rows;
+   int ret = PNG_ZLIB(png_ptr, inflate_reset)(&job->zs);
+
+   /* The compressed data is known to be at most ZLIB_IO_MAX bytes. */
+   job->zs.next_in = PNGZ_INPUT_CAST(group->input);
+   job->zs.avail_in = (uInt)group->input_len;
+
+   while (ret == Z_OK && avail_out > 0)
+   {
+      uInt out = ZLIB_IO_MAX;
+
+      if (out > avail_out)
+         out = (uInt)avail_out;
+
+      job->zs.next_out = output;
+      job->zs.avail_out = out;
+      ret = PNG_ZLIB(png_ptr, inflate_data)(&job->zs, Z_NO_FLUSH);
+      output += out - job->zs.avail_out;
+      avail_out -= out - job->zs.avail_out;
+   }
+
+   /* There must be no more output: a group before a restart point simply runs
+    * out of input, the last group must also reach the end of the stream.
+    */
+   job->zs.next_out = &extra;
+   job->zs.avail_out = 1;
+
+   while (ret == Z_OK && job->zs.avail_out == 1 && job->zs.avail_in > 0)
+      ret = PNG_ZLIB(png_ptr, inflate_data)(&job->zs, Z_NO_FLUSH);
+
+   if (avail_out > 0 || job->zs.avail_out == 0 || job->zs.avail_in > 0)
+      return 0;
+
+   if (group->last != 0 ? ret != Z_STREAM_END :
+       ret != Z_OK && ret != Z_BUF_ERROR)
+      return 0;
+
+   if (job->check_adler != 0)
+      group->adler = png_idat_adler(adler32(0L, Z_NULL, 0), group->output,
+          group->output_len);
+
+   /* A group that starts with a filter that uses the previous row is left for
+    * the main thread, which unfilters the groups in order.
+    */
+   output = group->output;
+   row_bytes = group->output_len / group->rows;
+
+   if (first == 0 && output[0] != PNG_FILTER_VALUE_NONE &&
+       output[0] != PNG_FILTER_VALUE_SUB)
+   {
+      for (rows = group->rows; rows > 0; --rows, output += row_bytes)
+      {
+         if (output[0] >= PNG_FILTER_VALUE_LAST)
+            return 0;
+      }
+
+      return 1;
+   }
+
+   row_info.width = png_ptr->width;
+   row_info.color_type = png_ptr->color_type;
+   row_info.bit_depth = png_ptr->bit_depth;
+   row_info.channels = png_ptr->channels;
+   row_info.pixel_depth = png_ptr->pixel_depth;
+   row_info.rowbytes = row_bytes - 1;
+
+   /* The row before the group is zero for the first group and not used by the
+    * first filter of the others.
+    */
+   memset(job->buffer + PNG_IDAT_JOB_ROW(row_bytes) + 31, 0, row_bytes);
+
+   if (png_unfilter_rows(png_ptr, &row_info, output, group->rows,
+       job->buffer + 31, job->buffer + PNG_IDAT_JOB_ROW(row_bytes) + 31) == 0)
+      return 0;
+
+   group->unfiltered = 1;
+   return 1;
+}
+
+static void
+png_idat_job_run(png_idat_jobp job)
+{
+   png_uint_32 i;
+
+   for (i = job->first; i < job->num_groups; i += job->step)
+   {
+      if (png_idat_group_run(job, job->groups + i, i == 0) == 0)
+         return;
+   }
+
+   job->ok = 1;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+png_idat_job_thread(LPVOID arg)
+{
+   png_idat_job_run(png_voidcast(png_idat_jobp, arg));
+   return 0;
+}
+#else
+static void *
+png_idat_job_thread(void *arg)
+{
+   png_idat_job_run(png_voidcast(png_idat_jobp, arg));
+   return NULL;
+}
+#endif
+
+static unsigned int
+png_idat_threads(void)
+{
+   long count;
+
+#ifdef _WIN32
+   SYSTEM_INFO info;
+
+   GetSystemInfo(&info);
+   count = (long)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   count = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+   count = 1;
+#endif
+
+   if (count < PNG_READ_PARALLEL_MIN_THREADS)
+      count = PNG_READ_PARALLEL_MIN_THREADS;
+
+   if (count > PNG_READ_PARALLEL_MAX_THREADS)
+      count = PNG_READ_PARALLEL_MAX_THREADS;
+
+   return (unsigned int)count;
+}
+
+/* Decode the groups of rows described by png_ptr->idat_restart into
+ * png_ptr->idat_image, which holds 'size' bytes.  Returns 1 on success.  If
+ * the threaded decode fails after the IDAT data has been read the data is left
+ * in png_ptr->zstream for the serial code; 0 is returned in either case.
+ */
+static int
+png_read_IDAT_parallel(png_structrp png_ptr, png_alloc_size_t size)
+{
+   png_uint_32p points = png_ptr->idat_restart;
+   png_uint_32 num_groups = png_ptr->idat_restarts + 1;
+   png_alloc_size_t length = png_ptr->idat_length;
+   png_alloc_size_t row_bytes = size / png_ptr->height;
+   unsigned int num_jobs = png_idat_threads();
+   unsigned int jobs_init = 0;
+   int check_adler = 1;
+   int ok = 1;
+   png_idat_groupp groups;
+   png_idat_jobp jobs;
+   png_bytep buffer;
+   png_uint_32 i;
+
+   if (num_jobs > num_groups)
+      num_jobs = num_groups;
+
+   buffer = num_jobs > 1 ? png_read_buffer(png_ptr, length, 2/*silent*/) :
+       NULL;
+
+   if (buffer == NULL)
+      return 0;
+
+   /* png_ptr still owns the restart points in case of an error here. */
+   png_read_IDAT_all(png_ptr, buffer);
+
+   png_ptr->idat_restart = NULL;
+   png_ptr->idat_restarts = 0;
+
+#ifdef PNG_SET_OPTION_SUPPORTED
+#  ifdef PNG_SKIP_CHECKSUMS
+   if (((png_ptr->options >> PNG_SKIP_CHECKSUMS) & 3) == PNG_OPTION_ON)
+      check_adler = 0;
+#  endif
+#  ifdef PNG_IGNORE_ADLER32
+   if (((png_ptr->options >> PNG_IGNORE_ADLER32) & 3) == PNG_OPTION_ON)
+      check_adler = 0;
+#  endif
+#endif
+
+   groups = png_voidcast(png_idat_groupp, png_malloc_base(png_ptr,
+       num_groups * (sizeof *groups)));
+   jobs = png_voidcast(png_idat_jobp, png_malloc_base(png_ptr,
+       num_jobs * (sizeof *jobs)));
+
+   /* The zlib header: deflate, a valid window size and no preset dictionary. */
+   if (groups == NULL || jobs == NULL || (buffer[0] & 0x0f) != 8 ||
+       (buffer[0] >> 4) > 7 || (buffer[1] & 0x20) != 0 ||
+       ((buffer[0] << 8) + buffer[1]) % 31 != 0)
+      ok = 0;
+
+   for (i = 0; ok != 0 && i < num_groups; ++i)
+   {
+      png_idat_groupp group = groups + i;
+      png_uint_32 row = i > 0 ? points[2*i-2] : 0;
+      png_uint_32 end_row = i < num_groups-1 ? points[2*i] : png_ptr->height;
+      png_alloc_size_t start = i > 0 ? points[2*i-1] : 2;
+      png_alloc_size_t end = i < num_groups-1 ? points[2*i+1] : length-4;
+
+      group->input = buffer + start;
+      group->input_len = end - start;
+      group->output = png_ptr->idat_image + row * row_bytes;
+      group->output_len = (end_row - row) * row_bytes;
+      group->rows = end_row - row;
+      group->adler = 1;
+      group->last = i == num_groups-1;
+      group->unfiltered = 0;
+   }
+
+   png_free(png_ptr, points);
+
+   /* The workers call the filter functions directly. */
+   if (png_ptr->read_filter[0] == NULL)
+      png_init_filter_functions(png_ptr);
+
+   /* The streams are initialized here, where it is safe to allocate memory. */
+   for (i = 0; ok != 0 && i < num_jobs; ++i)
+   {
+      png_idat_jobp job = jobs + i;
+
+      memset(job, 0, (sizeof *job));
+      job->png_ptr = png_ptr;
+      job->groups = groups;
+      job->num_groups = num_groups;
+      job->first = i;
+      job->step = num_jobs;
+      job->check_adler = check_adler;
+      /* zlib allocates the window on the worker thread, where the
+       * application's memory functions (which may not be thread safe) and
+       * png_error must not be used, so the streams use the zlib allocator.
+       */
+      job->zs.zalloc = Z_NULL;
+      job->zs.zfree = Z_NULL;
+      job->zs.opaque = Z_NULL;
+      job->buffer = png_voidcast(png_bytep, png_malloc_base(png_ptr,
+          2 * PNG_IDAT_JOB_ROW(row_bytes)));
+
+      if (job->buffer == NULL)
+         ok = 0;
+
+      else if (PNG_ZLIB(png_ptr, inflate_init2)(&job->zs, -15) != Z_OK)
+      {
+         png_free(png_ptr, job->buffer);
+         ok = 0;
+      }
+
+      else
+         jobs_init = i + 1;
+   }
+
+   /* If a thread cannot be created the job is just run here. */
+   if (ok != 0)
+   {
+      for (i = 1; i < num_jobs; ++i)
+      {
+         png_idat_jobp job = jobs + i;
+
+#ifdef _WIN32
+         job->thread = CreateThread(NULL, 0, png_idat_job_thread, job, 0,
+             NULL);
+         job->started = job->thread != NULL;
+#else
+         job->started =
+             pthread_create(&job->thread, NULL, png_idat_job_thread, job) == 0;
+#endif
+
+         if (job->started == 0)
+            png_idat_job_run(job);
+      }
+
+      png_idat_job_run(jobs);
+
+      for (i = 1; i < num_jobs; ++i)
+      {
+         png_idat_jobp job = jobs + i;
+
+         if (job->started != 0)
+         {
+#ifdef _WIN32
+            WaitForSingleObject(job->thread, INFINITE);
+            CloseHandle(job->thread);
+#else
+            pthread_join(job->thread, NULL);
+#endif
+         }
+      }
+   }
+
+   for (i = 0; i < jobs_init; ++i)
+   {
+      if (jobs[i].ok == 0)
+         ok = 0;
+
+      PNG_ZLIB(png_ptr, inflate_end)(&jobs[i].zs);
+      png_free(png_ptr, jobs[i].buffer);
+   }
+
+   png_free(png_ptr, jobs);
+
+   if (ok != 0 && check_adler != 0)
+   {
+      uLong adler = adler32(0L, Z_NULL, 0);
+
+      for (i = 0; i < num_groups; ++i)
+         adler = adler32_combine(adler, groups[i].adler,
+             (z_off_t)groups[i].output_len);
+
+      if (adler != png_get_uint_32(buffer + length - 4))
+         ok = 0;
+   }
+
+   if (ok == 0)
+   {
+      png_free(png_ptr, groups);
+
+      /* Decompress the data that has been read in the normal way. */
+      png_ptr->zstream.next_in = PNGZ_INPUT_CAST(buffer);
+      png_ptr->zstream.avail_in = (uInt)length;
+      return 0;
+   }
+
+   /* Undo the filters of the groups left by the workers, in order, using the
+    * unfiltered last row of the group before; the filter values have already
+    * been checked.
+    */
+   for (i = 1; i < num_groups; ++i)
+   {
+      if (groups[i].unfiltered == 0)
+      {
+         png_row_info row_info;
+
+         row_info.width = png_ptr->width;
+         row_info.color_type = png_ptr->color_type;
+         row_info.bit_depth = png_ptr->bit_depth;
+         row_info.channels = png_ptr->channels;
+         row_info.pixel_depth = png_ptr->pixel_depth;
+         row_info.rowbytes = row_bytes - 1;
+
+         memcpy(png_ptr->prev_row, groups[i].output - row_bytes, row_bytes);
+         (void)png_unfilter_rows(png_ptr, &row_info, groups[i].output,
+             groups[i].rows, png_ptr->row_buf, png_ptr->prev_row);
+      }
+   }
+
+   png_free(png_ptr, groups);
+   memset(png_ptr->prev_row, 0, row_bytes);
+
+   png_ptr->mode |= PNG_AFTER_IDAT;
+   png_ptr->flags |= PNG_FLAG_ZSTREAM_ENDED;
+   return 1;
+}
+#endif /* READ_PARALLEL */
+
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+/* Decompress all the IDAT data into png_ptr->idat_image, which holds 'size'
+ * bytes, with one call to the zlib backend inflate_buffer function.  Returns 1
+ * on success.  If the function fails after the IDAT data has been read the
+ * data is left in png_ptr->zstream for the serial code, which reports any
+ * error; 0 is returned in either case.
+ */
+static int
+png_read_IDAT_buffer(png_structrp png_ptr, png_alloc_size_t size)
+{
+   png_alloc_size_t length = png_ptr->idat_length;
+   size_t out_len = size;
+   png_bytep buffer;
+
+   if (length > ZLIB_IO_MAX)
+      return 0;
+
+   buffer = png_read_buffer(png_ptr, length, 2/*silent*/);
+
+   if (buffer == NULL)
+      return 0;
+
+   png_read_IDAT_all(png_ptr, buffer);
+
+   if (png_ptr->zlib_backend.inflate_buffer(png_ptr->idat_image, &out_len,
+       buffer, length) != Z_OK || out_len != size)
+   {
+      png_ptr->zstream.next_in = PNGZ_INPUT_CAST(buffer);
+      png_ptr->zstream.avail_in = (uInt)length;
+      return 0;
+   }
+
+   png_ptr->mode |= PNG_AFTER_IDAT;
+   png_ptr->flags |= PNG_FLAG_ZSTREAM_ENDED;
+   return 1;
+}
+#endif /* ZLIB_BACKEND */
+
+/* Used by the simplified API when the whole PNG is in memory: inflate all the
+ * IDAT data into one buffer, with one inflate call per IDAT chunk rather than
+ * one or more per row (or a single call to the zlib backend inflate_buffer
+ * function), then undo the row filters.  png_read_IDAT_data then just copies
+ * each (unfiltered) row out of the buffer.  Returns 0 if the buffer cannot be
+ * allocated, in which case the rows are read normally.
+ */
+static int
+png_read_IDAT_image(png_structrp png_ptr)
+{
+   png_uint_32 width = png_ptr->width;
+   png_uint_32 height = png_ptr->height;
+   unsigned int pixel_depth = png_ptr->pixel_depth;
+   int last_pass = png_ptr->interlaced != 0 ? 6 : 0;
+   png_alloc_size_t size = 0;
+   png_bytep row;
+   uInt read_size;
+   int pass;
+
+   for (pass = 0; pass <= last_pass; ++pass)
+   {
+      png_uint_32 pw = last_pass != 0 ? PNG_PASS_COLS(width, pass) : width;
+      png_uint_32 ph = last_pass != 0 ? PNG_PASS_ROWS(height, pass) : height;
+      png_alloc_size_t row_bytes;
+
+      if (pw == 0 || ph == 0)
+         continue;
+
+      row_bytes = PNG_ROWBYTES(pixel_depth, pw) + 1;
+
+      if (ph > (PNG_SIZE_MAX - size) / row_bytes)
+         return 0;
+
+      size += row_bytes * ph;
+   }
+
+   png_ptr->idat_image = png_voidcast(png_bytep, png_malloc_base(png_ptr,
+       size));
+
+   if (png_ptr->idat_image == NULL)
+      return 0;
+
+   if (png_ptr->read_filter[0] == NULL)
+      png_init_filter_functions(png_ptr);
+
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+   if (png_ptr->idat_restarts > 0 && last_pass == 0 &&
+       png_read_IDAT_parallel(png_ptr, size) != 0)
+   {
+      png_ptr->idat_image_size = size;
+      png_ptr->idat_image_pos = 0;
+      return 1;
+   }
+#endif
+
+   /* Otherwise read each IDAT chunk in one piece; the PNG is already in memory
+    * so the extra copy of a chunk is not a significant cost.  If the parallel
+    * decode read the data but failed it is already in the z_stream.
+    */
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+   if (png_ptr->zlib_backend.inflate_buffer == NULL ||
+       png_ptr->idat_length == 0 || png_ptr->zstream.avail_in > 0 ||
+       png_read_IDAT_buffer(png_ptr, size) == 0)
+#endif
+   {
+      read_size = png_ptr->IDAT_read_size;
+      png_ptr->IDAT_read_size = ZLIB_IO_MAX;
+      png_read_IDAT_data(png_ptr, png_ptr->idat_image, size);
+      png_ptr->IDAT_read_size = read_size;
+   }
+
+   /* Undo the filters in png_ptr->row_buf and prev_row, which are not in use
+    * yet; the row before the first row of each pass is zero.
+    */
+   row = png_ptr->idat_image;
+
+   for (pass = 0; pass <= last_pass; ++pass)
+   {
+      png_uint_32 pw = last_pass != 0 ? PNG_PASS_COLS(width, pass) : width;
+      png_uint_32 ph = last_pass != 0 ? PNG_PASS_ROWS(height, pass) : height;
+      png_row_info row_info;
+
+      if (pw == 0 || ph == 0)
+         continue;
+
+      row_info.width = pw;
+      row_info.color_type = png_ptr->color_type;
+      row_info.bit_depth = png_ptr->bit_depth;
+      row_info.channels = png_ptr->channels;
+      row_info.pixel_depth = (png_byte)pixel_depth;
+      row_info.rowbytes = PNG_ROWBYTES(pixel_depth, pw);
+
+      memset(png_ptr->prev_row, 0, row_info.rowbytes + 1);
+
+      if (png_unfilter_rows(png_ptr, &row_info, row, ph, png_ptr->row_buf,
+          png_ptr->prev_row) == 0)
+         png_error(png_ptr, "bad adaptive filter value");
+
+      row += (row_info.rowbytes + 1) * ph;
+   }
+
+   memset(png_ptr->prev_row, 0, png_ptr->rowbytes + 1);
+
+   png_ptr->idat_image_size = size;
+   png_ptr->idat_image_pos = 0;
+   return 1;
+}
+#endif /* SIMPLIFIED_READ */
+
 void /* PRIVATE */
 png_read_IDAT_data(png_structrp png_ptr, png_bytep output,
     png_alloc_size_t avail_out)
 {
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   if (output != NULL && png_ptr->read_whole_idat != 0)
+   {
+      png_ptr->read_whole_idat = 0; /* also stops the recursion */
+      (void)png_read_IDAT_image(png_ptr);
+   }
+
+   if (output != NULL && png_ptr->idat_image_size != 0)
+   {
+      if (avail_out > png_ptr->idat_image_size - png_ptr->idat_image_pos)
+         png_error(png_ptr, "Not enough image data");
+
+      memcpy(output, png_ptr->idat_image + png_ptr->idat_image_pos, avail_out);
+      png_ptr->idat_image_pos += avail_out;
+      return;
+   }
+#endif
+
    /* Loop reading IDATs and decompressing the result into output[avail_out] */
    png_ptr->zstream.next_out = output;
    png_ptr->zstream.avail_out = 0; /* safety: set below */
@@ -4162,7 +4941,7 @@ png_read_IDAT_data(png_structrp png_ptr, png_bytep output,
       if (png_ptr->zstream.avail_in == 0)
       {
          uInt avail_in;
-         png_bytep buffer;
+         png_const_bytep buffer = NULL;
 
          while (png_ptr->idat_size == 0)
          {
@@ -4176,22 +4955,41 @@ png_read_IDAT_data(png_structrp png_ptr, png_bytep output,
                png_error(png_ptr, "Not enough image data");
          }
 
-         avail_in = png_ptr->IDAT_read_size;
+#ifdef PNG_READ_BORROW_SUPPORTED
+         /* Input that can be used in place is not limited by IDAT_read_size
+          * because no buffer is required.
+          */
+         avail_in = ZLIB_IO_MAX;
 
          if (avail_in > png_ptr->idat_size)
             avail_in = (uInt)png_ptr->idat_size;
 
-         /* A PNG with a gradually increasing IDAT size will defeat this attempt
-          * to minimize memory usage by causing lots of re-allocs, but
-          * realistically doing IDAT_read_size re-allocs is not likely to be a
-          * big problem.
-          */
-         buffer = png_read_buffer(png_ptr, avail_in, 0/*error*/);
+         buffer = png_crc_borrow(png_ptr, avail_in);
+
+         if (buffer == NULL)
+#endif
+         {
+            png_bytep copy;
+
+            avail_in = png_ptr->IDAT_read_size;
+
+            if (avail_in > png_ptr->idat_size)
+               avail_in = (uInt)png_ptr->idat_size;
+
+            /* A PNG with a gradually increasing IDAT size will defeat this
+             * attempt to minimize memory usage by causing lots of re-allocs,
+             * but realistically doing IDAT_read_size re-allocs is not likely
+             * to be a big problem.
+             */
+            copy = png_read_buffer(png_ptr, avail_in, 0/*error*/);
+
+            png_crc_read(png_ptr, copy, avail_in);
+            buffer = copy;
+         }
 
-         png_crc_read(png_ptr, buffer, avail_in);
          png_ptr->idat_size -= avail_in;
 
-         png_ptr->zstream.next_in = buffer;
+         png_ptr->zstream.next_in = PNGZ_INPUT_CAST(buffer);
          png_ptr->zstream.avail_in = avail_in;
       }
 
@@ -4275,6 +5073,12 @@ png_read_IDAT_data(png_structrp png_ptr, png_bytep output,
 void /* PRIVATE */
 png_read_finish_IDAT(png_structrp png_ptr)
 {
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   png_free(png_ptr, png_ptr->idat_image);
+   png_ptr->idat_image = NULL;
+   png_ptr->idat_image_size = 0;
+#endif
+
    /* We don't need any more data and the stream should have ended, however the
     * LZ end code may actually not have been processed.  In this case we must
     * read it otherwise stray unread IDAT data or, more likely, an IDAT chunk
@@ -4320,6 +5124,70 @@ png_read_finish_IDAT(png_structrp png_ptr)
    }
 }
 
+void /* PRIVATE */
+png_skip_chunk_data(png_structrp png_ptr, png_uint_32 length)
+{
+   png_byte tmpbuf[PNG_INFLATE_BUF_SIZE];
+
+#ifdef PNG_READ_BORROW_SUPPORTED
+   if (length > 0 && png_ptr->borrow_data_fn != NULL &&
+       (*(png_ptr->borrow_data_fn))(png_ptr, length) != NULL)
+      length = 0;
+#endif
+
+   while (length > 0)
+   {
+      png_uint_32 len = (sizeof tmpbuf);
+
+      if (len > length)
+         len = length;
+
+      png_read_data(png_ptr, tmpbuf, len);
+      length -= len;
+   }
+
+#ifdef PNG_IO_STATE_SUPPORTED
+   png_ptr->io_state = PNG_IO_READING | PNG_IO_CHUNK_CRC;
+#endif
+
+   /* The CRC is read, as it always is, in a single I/O call. */
+   png_read_data(png_ptr, tmpbuf, 4);
+}
+
+void /* PRIVATE */
+png_read_stop_IDAT(png_structrp png_ptr)
+{
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+   png_free(png_ptr, png_ptr->idat_image);
+   png_ptr->idat_image = NULL;
+   png_ptr->idat_image_size = 0;
+#endif
+
+   /* The rest of the image is never going to be decompressed, so the memory
+    * used by inflate is released now; it is allocated again if a later chunk
+    * is compressed.
+    */
+   png_ptr->zstream.next_in = NULL;
+   png_ptr->zstream.avail_in = 0;
+   png_ptr->zstream.next_out = NULL;
+
+   if ((png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED) != 0)
+   {
+      (void)PNG_ZLIB(png_ptr, inflate_end)(&png_ptr->zstream);
+      png_ptr->flags &= ~PNG_FLAG_ZSTREAM_INITIALIZED;
+   }
+
+   png_ptr->zowner = 0;
+   png_ptr->mode |= PNG_AFTER_IDAT;
+   png_ptr->flags |= PNG_FLAG_ZSTREAM_ENDED | PNG_FLAG_IDAT_ABANDONED;
+
+   /* The read is always in, or at the end of, an IDAT chunk; png_read_end
+    * skips any further IDAT chunks in the same way.
+    */
+   png_skip_chunk_data(png_ptr, png_ptr->idat_size);
+   png_ptr->idat_size = 0;
+}
+
 void /* PRIVATE */
 png_read_finish_row(png_structrp png_ptr)
 {
@@ -4340,7 +5208,14 @@ png_read_finish_row(png_structrp png_ptr)
    png_debug(1, "in png_read_finish_row");
    png_ptr->row_number++;
    if (png_ptr->row_number < png_ptr->num_rows)
+   {
+      /* The rows after png_ptr->read_stop_row are not wanted. */
+      if (png_ptr->row_number == png_ptr->read_stop_row &&
+          png_ptr->interlaced == 0)
+         png_read_stop_IDAT(png_ptr);
+
       return;
+   }
 
    if (png_ptr->interlaced != 0)
    {
@@ -4377,7 +5252,14 @@ png_read_finish_row(png_structrp png_ptr)
       } while (png_ptr->num_rows == 0 || png_ptr->iwidth == 0);
 
       if (png_ptr->pass < 7)
+      {
+         /* The passes after png_set_read_last_pass are not wanted. */
+         if (png_ptr->pass >= png_ptr->read_passes &&
+             png_ptr->read_passes > 0)
+            png_read_stop_IDAT(png_ptr);
+
          return;
+      }
    }
 
    /* Here after at the end of the last row of the last pass. */
@@ -4409,6 +5291,15 @@ png_read_start_row(png_structrp png_ptr)
 
 #ifdef PNG_READ_TRANSFORMS_SUPPORTED
    png_init_read_transformations(png_ptr);
+#endif
+#if defined(PNG_INTERLACE_OPTIMIZATIONS) &&\
+    defined(PNG_READ_INTERLACING_SUPPORTED)
+   /* As with PNG_FILTER_OPTIMIZATIONS this installs hardware specific versions
+    * of the functions that expand interlaced rows.
+    */
+   if (png_ptr->interlaced != 0 &&
+       (png_ptr->transformations & PNG_INTERLACE) != 0)
+      PNG_INTERLACE_OPTIMIZATIONS(png_ptr);
 #endif
    if (png_ptr->interlaced != 0)
    {
@@ -66,6 +66,11 @@ typedef struct png_compression_buffer
 
 #define PNG_COMPRESSION_BUFFER_SIZE(pp)\
    (offsetof(png_compression_buffer, output) + (pp)->zbuffer_size)
+
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+/* State of the multi-threaded IDAT compressor; private to pngwutil.c */
+typedef struct png_zparallel png_zparallel, *png_zparallelp;
+#endif
 #endif
 
 /* Colorspace support; structures used in png_struct, png_info and in internal
@@ -156,6 +161,9 @@ struct png_struct_def
    png_rw_ptr write_data_fn;  /* function for writing output data */
    png_rw_ptr read_data_fn;   /* function for reading input data */
    png_voidp io_ptr;          /* ptr to application struct for I/O functions */
+#ifdef PNG_READ_BORROW_SUPPORTED
+   png_borrow_ptr borrow_data_fn; /* optional in-place read function */
+#endif
 
 #ifdef PNG_READ_USER_TRANSFORM_SUPPORTED
    png_user_transform_ptr read_user_transform_fn; /* user read transform */
@@ -181,6 +189,9 @@ struct png_struct_def
 
    png_uint_32 zowner;        /* ID (chunk type) of zstream owner, 0 if none */
    z_stream    zstream;       /* decompression structure */
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+   png_zlib_backend zlib_backend; /* functions used with zstream */
+#endif
 
 #ifdef PNG_WRITE_SUPPORTED
    png_compression_bufferp zbuffer_list; /* Created on demand during write */
@@ -191,6 +202,10 @@ struct png_struct_def
    int zlib_window_bits;      /* holds zlib compression window bits */
    int zlib_mem_level;        /* holds zlib compression memory level */
    int zlib_strategy;         /* holds zlib compression strategy */
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+   int zlib_threads;          /* threads to use for IDAT compression */
+   png_zparallelp zparallel;  /* IDAT compressor state when threads > 1 */
+#endif
 #endif
 /* Added at libpng 1.5.4 */
 #ifdef PNG_WRITE_CUSTOMIZE_ZTXT_COMPRESSION_SUPPORTED
@@ -236,6 +251,8 @@ struct png_struct_def
 
    png_uint_32 idat_size;     /* current IDAT size for read */
    png_uint_32 crc;           /* current chunk CRC value */
+   png_uint_32 (*crc_fn)(png_uint_32 crc, png_const_bytep ptr,
+      size_t length);         /* CRC-32 function, chosen on first use */
    png_colorp palette;        /* palette from the input file */
    png_uint_16 num_palette;   /* number of color entries in palette */
 
@@ -286,6 +303,12 @@ struct png_struct_def
    png_uint_32 flush_rows;    /* number of rows written since last flush */
 #endif
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+   png_uint_32 restart_rows;    /* rows in each group, 0 - no restart points */
+   png_uint_32p restart_points; /* row and IDAT offset of each restart point */
+   png_uint_32 num_restart_points;
+#endif
+
 #ifdef PNG_READ_GAMMA_SUPPORTED
    int gamma_shift;      /* number of "insignificant" bits in 16-bit gamma */
    png_fixed_point screen_gamma; /* screen gamma value (display_exponent) */
@@ -394,10 +417,59 @@ struct png_struct_def
 
 /* New member added in libpng-1.6.36 */
 #if defined(PNG_READ_EXPAND_SUPPORTED) && \
-    defined(PNG_ARM_NEON_IMPLEMENTATION)
+    (defined(PNG_ARM_NEON_IMPLEMENTATION) || defined(PNG_PALETTE_OPTIMIZATIONS))
    png_bytep riffled_palette; /* buffer for accelerated palette expansion */
 #endif
 
+/* New member added in libpng-1.6.38 */
+#if defined(PNG_READ_EXPAND_SUPPORTED) && defined(PNG_PALETTE_OPTIMIZATIONS)
+   int (*expand_palette)(png_structrp png_ptr, png_row_infop row_info,
+      png_bytep row);         /* hardware palette expansion, 0 if not done */
+#endif
+
+/* New members added in libpng-1.6.38 */
+#if defined(PNG_READ_GAMMA_SUPPORTED) && defined(PNG_GAMMA_OPTIMIZATIONS)
+   int (*do_gamma)(png_structrp png_ptr, png_row_infop row_info,
+      png_bytep row);         /* hardware gamma correction, 0 if not done */
+   png_fixed_point gamma_16_exponent; /* for PNG_APPROXIMATE_GAMMA_16, or 0 */
+#  if defined(PNG_READ_BACKGROUND_SUPPORTED) ||\
+      defined(PNG_READ_ALPHA_MODE_SUPPORTED)
+   int (*do_compose)(png_structrp png_ptr, png_row_infop row_info,
+      png_bytep row);         /* hardware alpha compositing, 0 if not done */
+#  endif
+#  ifdef PNG_READ_RGB_TO_GRAY_SUPPORTED
+   int (*do_rgb_to_gray)(png_structrp png_ptr, png_row_infop row_info,
+      png_bytep row, int *rgb_error); /* hardware rgb_to_gray, 0 if not done */
+#  endif
+#endif
+
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) ||\
+    defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+   void (*do_fused)(png_const_structrp png_ptr, png_bytep row,
+      png_uint_32 width);     /* single pass row conversion, NULL if unused */
+   png_byte fused_in_bytes;   /* bytes per pixel before do_fused */
+   png_byte fused_out_bytes;  /* bytes per pixel after do_fused */
+   png_byte fused_color_type; /* format of the row after do_fused */
+   png_byte fused_bit_depth;
+   png_byte fused_channels;
+   png_byte fused_source[8];  /* input byte of each output byte, 8 for zero */
+   png_byte fused_value[8];   /* XORed with each output byte */
+   png_const_bytep fused_gamma; /* 8-bit gamma table, NULL if not used */
+   png_byte fused_gamma_bytes; /* input bytes looked up in fused_gamma */
+#  ifdef PNG_SHUFFLE_OPTIMIZATIONS
+   png_byte fused_block;      /* whole pixels in 16 bytes */
+   png_byte fused_shuffle[16]; /* the same for a block, 0x80 for zero */
+   png_byte fused_xor[16];
+#  endif
+#endif
+
+#if (defined(PNG_READ_PACKSWAP_SUPPORTED) ||\
+    defined(PNG_WRITE_PACKSWAP_SUPPORTED)) &&\
+    defined(PNG_SHUFFLE_OPTIMIZATIONS)
+   int (*do_packswap)(png_row_infop row_info,
+      png_bytep row);         /* hardware packswap, 0 if not done */
+#endif
+
 /* New member added in libpng-1.0.4 (renamed in 1.0.9) */
 #if defined(PNG_MNG_FEATURES_SUPPORTED)
 /* Changed from png_byte to png_uint_32 at version 1.2.0 */
@@ -466,6 +538,25 @@ struct png_struct_def
 #endif
 #ifdef PNG_SEQUENTIAL_READ_SUPPORTED
   uInt             IDAT_read_size;   /* limit on read buffer size for IDAT */
+  png_uint_32      read_stop_row;    /* abandon IDAT after this row, or 0 */
+  png_byte         read_passes;      /* abandon IDAT after this many passes */
+#endif
+#ifdef PNG_SIMPLIFIED_READ_SUPPORTED
+  png_bytep        idat_image;       /* all the unfiltered IDAT rows */
+  png_alloc_size_t idat_image_size;  /* size of idat_image, 0 until read */
+  png_alloc_size_t idat_image_pos;   /* offset of the next row */
+  int              read_whole_idat;  /* read idat_image at the first row */
+  png_uint_32      crop_x;           /* png_image_set_crop window, */
+  png_uint_32      crop_y;           /* crop_width is 0 if there is no */
+  png_uint_32      crop_width;       /* window */
+  png_uint_32      crop_height;
+  png_uint_32p     scale_sum;        /* png_image_set_reduction sums */
+  png_byte         scale_shift;      /* log2 of the reduction factor */
+  png_alloc_size_t idat_length;      /* total length of the IDAT data, or 0 */
+#endif
+#ifdef PNG_READ_PARALLEL_SUPPORTED
+  png_uint_32p     idat_restart;     /* row, offset pairs from riDX */
+  png_uint_32      idat_restarts;    /* number of pairs */
 #endif
 
 #ifdef PNG_IO_STATE_SUPPORTED
@@ -480,6 +571,24 @@ struct png_struct_def
    void (*read_filter[PNG_FILTER_VALUE_LAST-1])(png_row_infop row_info,
       png_bytep row, png_const_bytep prev_row);
 
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* Hardware specific write filters; a NULL entry means the C code is used. */
+   size_t (*write_filter[PNG_FILTER_VALUE_LAST-1])(png_const_bytep row,
+      png_const_bytep prev_row, png_bytep filtered_row, size_t row_bytes,
+      unsigned int bpp, size_t lmins);
+   void (*write_filter_sums)(png_const_bytep row, png_const_bytep prev_row,
+      size_t row_bytes, unsigned int bpp, size_t *sums);
+#endif
+
+#ifdef PNG_READ_INTERLACING_SUPPORTED
+/* Hardware specific versions of png_do_read_interlace and the copy in
+ * png_combine_row; NULL, or a return of 0, means the C code is used.
+ */
+   int (*read_interlace)(png_row_infop row_info, png_bytep row, int pass);
+   int (*combine_row)(png_bytep dp, png_const_bytep sp, size_t length,
+      unsigned int copy, unsigned int jump);
+#endif
+
 #ifdef PNG_READ_SUPPORTED
 #if defined(PNG_COLORSPACE_SUPPORTED) || defined(PNG_GAMMA_SUPPORTED)
    png_colorspace   colorspace;
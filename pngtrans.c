@@ -103,6 +103,14 @@ png_set_interlace_handling(png_structrp png_ptr)
    if (png_ptr != 0 && png_ptr->interlaced != 0)
    {
       png_ptr->transformations |= PNG_INTERLACE;
+
+#ifdef PNG_SEQUENTIAL_READ_SUPPORTED
+      /* Only the passes before png_set_read_last_pass are read. */
+      if ((png_ptr->mode & PNG_IS_READ_STRUCT) != 0 &&
+          png_ptr->read_passes > 0)
+         return (png_ptr->read_passes);
+#endif
+
       return (7);
    }
 
@@ -452,7 +460,8 @@ static const png_byte fourbppswaptable[256] = {
 
 /* Swaps pixel packing order within bytes */
 void /* PRIVATE */
-png_do_packswap(png_row_infop row_info, png_bytep row)
+png_do_packswap(png_const_structrp png_ptr, png_row_infop row_info,
+    png_bytep row)
 {
    png_debug(1, "in png_do_packswap");
 
@@ -461,6 +470,14 @@ png_do_packswap(png_row_infop row_info, png_bytep row)
       png_bytep rp;
       png_const_bytep end, table;
 
+#ifdef PNG_SHUFFLE_OPTIMIZATIONS
+      if (png_ptr->do_packswap != NULL &&
+          png_ptr->do_packswap(row_info, row) != 0)
+         return;
+#else
+      PNG_UNUSED(png_ptr)
+#endif
+
       end = row + row_info->rowbytes;
 
       if (row_info->bit_depth == 1)
@@ -692,6 +709,409 @@ png_do_bgr(png_row_infop row_info, png_bytep row)
 }
 #endif /* READ_BGR || WRITE_BGR */
 
+#if defined(PNG_READ_TRANSFORMS_SUPPORTED) || \
+    defined(PNG_WRITE_TRANSFORMS_SUPPORTED)
+/* Following a pixel through the transformations, see png_fused_pixel in
+ * pngpriv.h.
+ */
+void /* PRIVATE */
+png_fused_pick(png_fused_pixel *pixel, png_const_bytep pick, unsigned int n)
+{
+   png_byte source[8], value[8];
+   unsigned int i;
+
+   for (i = 0; i < n; ++i)
+   {
+      source[i] = pixel->source[pick[i]];
+      value[i] = pixel->value[pick[i]];
+   }
+
+   memcpy(pixel->source, source, n);
+   memcpy(pixel->value, value, n);
+   pixel->bytes = (png_byte)n;
+}
+
+void /* PRIVATE */
+png_fused_invert(png_fused_pixel *pixel, unsigned int first, unsigned int n)
+{
+   while (n-- > 0)
+      pixel->value[first++] ^= 0xff;
+}
+
+/* Convert 'width' pixels of 'in' bytes to 'out' bytes, looking up the first
+ * 'gamma' bytes of each input pixel in png_ptr->fused_gamma.  The row is done
+ * in place, from the end if the pixels get bigger; each pixel is copied before
+ * any of its output is stored.  The specialized versions below call this with
+ * constant sizes so that the compiler can unroll the inner loops.
+ */
+static void
+png_fused_pixels(png_const_structrp png_ptr, png_bytep row, png_uint_32 width,
+    unsigned int in, unsigned int out, unsigned int gamma)
+{
+   png_const_bytep table = png_ptr->fused_gamma;
+   png_byte source[8], value[8], pixel[9];
+   unsigned int i;
+
+   memcpy(source, png_ptr->fused_source, sizeof source);
+   memcpy(value, png_ptr->fused_value, sizeof value);
+   pixel[8] = 0;
+
+   if (out > in)
+   {
+      png_const_bytep sp = row + (size_t)width * in;
+      png_bytep dp = row + (size_t)width * out;
+
+      while (width-- > 0)
+      {
+         sp -= in;
+         dp -= out;
+         memcpy(pixel, sp, in);
+
+         for (i = 0; i < gamma; ++i)
+            pixel[i] = table[pixel[i]];
+
+         for (i = 0; i < out; ++i)
+            dp[i] = (png_byte)(pixel[source[i]] ^ value[i]);
+      }
+   }
+
+   else
+   {
+      png_const_bytep sp = row;
+      png_bytep dp = row;
+
+      while (width-- > 0)
+      {
+         memcpy(pixel, sp, in);
+
+         for (i = 0; i < gamma; ++i)
+            pixel[i] = table[pixel[i]];
+
+         for (i = 0; i < out; ++i)
+            dp[i] = (png_byte)(pixel[source[i]] ^ value[i]);
+
+         sp += in;
+         dp += out;
+      }
+   }
+}
+
+void /* PRIVATE */
+png_do_fused(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, png_ptr->fused_in_bytes,
+       png_ptr->fused_out_bytes, png_ptr->fused_gamma_bytes);
+}
+
+/* G to RGB, G to RGBX or XRGB */
+static void
+png_fused_1_3(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 1, 3, 0);
+}
+
+static void
+png_fused_1_4(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 1, 4, 0);
+}
+
+/* GA to RGBA or ARGB */
+static void
+png_fused_2_4(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 2, 4, 0);
+}
+
+/* RGB to BGR */
+static void
+png_fused_3_3(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 3, 3, 0);
+}
+
+/* RGB to RGBX, BGRX, XRGB or XBGR */
+static void
+png_fused_3_4(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 3, 4, 0);
+}
+
+/* RGBA or RGBX without the last channel, possibly as BGR */
+static void
+png_fused_4_3(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 4, 3, 0);
+}
+
+/* RGBA to BGRA, ARGB, ABGR, with or without inverting the alpha */
+static void
+png_fused_4_4(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 4, 4, 0);
+}
+
+/* The same for 16-bit RGB and RGBA, including the byte swap */
+static void
+png_fused_6_6(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 6, 6, 0);
+}
+
+static void
+png_fused_8_8(png_const_structrp png_ptr, png_bytep row, png_uint_32 width)
+{
+   png_fused_pixels(png_ptr, row, width, 8, 8, 0);
+}
+
+#ifdef PNG_READ_GAMMA_SUPPORTED
+/* The usual 8-bit reads to RGB or RGBA with gamma correction, without the
+ * pixel copy and byte map of png_fused_pixels.  The color samples are looked
+ * up in png_ptr->fused_gamma, the alpha samples are copied and the filler is
+ * png_ptr->fused_value[3].
+ */
+static void
+png_fused_gamma_g_rgb(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   png_const_bytep gamma = png_ptr->fused_gamma;
+   png_const_bytep sp = row + width;
+   png_bytep dp = row + 3 * (size_t)width;
+
+   while (width-- > 0)
+   {
+      png_byte g = gamma[*--sp];
+
+      dp -= 3;
+      dp[0] = dp[1] = dp[2] = g;
+   }
+}
+
+static void
+png_fused_gamma_g_rgbx(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   png_const_bytep gamma = png_ptr->fused_gamma;
+   png_byte filler = png_ptr->fused_value[3];
+   png_const_bytep sp = row + width;
+   png_bytep dp = row + 4 * (size_t)width;
+
+   while (width-- > 0)
+   {
+      png_byte g = gamma[*--sp];
+
+      dp -= 4;
+      dp[0] = dp[1] = dp[2] = g;
+      dp[3] = filler;
+   }
+}
+
+static void
+png_fused_gamma_ga_rgba(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   png_const_bytep gamma = png_ptr->fused_gamma;
+   png_const_bytep sp = row + 2 * (size_t)width;
+   png_bytep dp = row + 4 * (size_t)width;
+
+   while (width-- > 0)
+   {
+      png_byte g, a;
+
+      sp -= 2;
+      g = gamma[sp[0]];
+      a = sp[1];
+      dp -= 4;
+      dp[0] = dp[1] = dp[2] = g;
+      dp[3] = a;
+   }
+}
+
+static void
+png_fused_gamma_rgb_rgbx(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   png_const_bytep gamma = png_ptr->fused_gamma;
+   png_byte filler = png_ptr->fused_value[3];
+   png_const_bytep sp = row + 3 * (size_t)width;
+   png_bytep dp = row + 4 * (size_t)width;
+
+   while (width-- > 0)
+   {
+      png_byte r, g, b;
+
+      sp -= 3;
+      r = gamma[sp[0]];
+      g = gamma[sp[1]];
+      b = gamma[sp[2]];
+      dp -= 4;
+      dp[0] = r;
+      dp[1] = g;
+      dp[2] = b;
+      dp[3] = filler;
+   }
+}
+
+static void
+png_fused_gamma_rgba_rgb(png_const_structrp png_ptr, png_bytep row,
+    png_uint_32 width)
+{
+   png_const_bytep gamma = png_ptr->fused_gamma;
+   png_const_bytep sp = row;
+   png_bytep dp = row;
+
+   while (width-- > 0)
+   {
+      png_byte r = gamma[sp[0]];
+      png_byte g = gamma[sp[1]];
+      png_byte b = gamma[sp[2]];
+
+      dp[0] = r;
+      dp[1] = g;
+      dp[2] = b;
+      sp += 4;
+      dp += 3;
+   }
+}
+
+/* Return 1 if the 8-bit pixel has the 'out' bytes of 'source' and none of them
+ * inverted; the value of a filler byte, source 8, is not checked.
+ */
+static int
+png_fused_is(const png_fused_pixel *pixel, png_const_bytep source,
+    unsigned int out)
+{
+   unsigned int i;
+
+   if (pixel->bit_depth != 8 || pixel->bytes != out)
+      return 0;
+
+   for (i = 0; i < out; ++i)
+      if (pixel->source[i] != source[i] ||
+          (source[i] < 8 && pixel->value[i] != 0))
+         return 0;
+
+   return 1;
+}
+#endif /* READ_GAMMA */
+
+void /* PRIVATE */
+png_init_fused(png_structrp png_ptr, const png_fused_pixel *pixel,
+    unsigned int in)
+{
+   unsigned int out = pixel->bytes;
+   unsigned int i;
+
+   png_ptr->do_fused = NULL;
+
+   /* Nothing to do if the pixel is unchanged; every step that changes the
+    * format also changes the number of bytes.  Gamma correction on its own is
+    * left to png_do_gamma, which may have a hardware version.
+    */
+   if (out == in)
+   {
+      for (i = 0; i < in; ++i)
+         if (pixel->source[i] != i || pixel->value[i] != 0)
+            break;
+
+      if (i == in)
+         return;
+   }
+
+   png_ptr->fused_in_bytes = (png_byte)in;
+   png_ptr->fused_out_bytes = (png_byte)out;
+   png_ptr->fused_color_type = pixel->color_type;
+   png_ptr->fused_bit_depth = pixel->bit_depth;
+   png_ptr->fused_channels = pixel->channels;
+
+   for (i = 0; i < 8; ++i)
+   {
+      png_ptr->fused_source[i] = (png_byte)(i < out ? pixel->source[i] : 8);
+      png_ptr->fused_value[i] = (png_byte)(i < out ? pixel->value[i] : 0);
+   }
+
+   png_ptr->fused_gamma = pixel->gamma;
+   png_ptr->fused_gamma_bytes =
+       (png_byte)(pixel->gamma != NULL ? pixel->gamma_bytes : 0);
+
+#ifdef PNG_READ_GAMMA_SUPPORTED
+   if (pixel->gamma != NULL)
+   {
+      static const png_byte g_rgb[4] = { 0, 0, 0, 8 };
+      static const png_byte ga_rgba[4] = { 0, 0, 0, 1 };
+      static const png_byte rgb_rgbx[4] = { 0, 1, 2, 8 };
+
+      if (in == 1 && png_fused_is(pixel, g_rgb, 3))
+         png_ptr->do_fused = png_fused_gamma_g_rgb;
+
+      else if (in == 1 && png_fused_is(pixel, g_rgb, 4))
+         png_ptr->do_fused = png_fused_gamma_g_rgbx;
+
+      else if (in == 2 && png_fused_is(pixel, ga_rgba, 4))
+         png_ptr->do_fused = png_fused_gamma_ga_rgba;
+
+      else if (in == 3 && png_fused_is(pixel, rgb_rgbx, 4))
+         png_ptr->do_fused = png_fused_gamma_rgb_rgbx;
+
+      else if (in == 4 && png_fused_is(pixel, rgb_rgbx, 3))
+         png_ptr->do_fused = png_fused_gamma_rgba_rgb;
+
+      else
+         png_ptr->do_fused = png_do_fused;
+
+      /* The hardware byte shuffles cannot do the lookup. */
+      return;
+   }
+#endif
+
+   switch (in * 16 + out)
+   {
+      case 0x13: png_ptr->do_fused = png_fused_1_3; break;
+      case 0x14: png_ptr->do_fused = png_fused_1_4; break;
+      case 0x24: png_ptr->do_fused = png_fused_2_4; break;
+      case 0x33: png_ptr->do_fused = png_fused_3_3; break;
+      case 0x34: png_ptr->do_fused = png_fused_3_4; break;
+      case 0x43: png_ptr->do_fused = png_fused_4_3; break;
+      case 0x44: png_ptr->do_fused = png_fused_4_4; break;
+      case 0x66: png_ptr->do_fused = png_fused_6_6; break;
+      case 0x88: png_ptr->do_fused = png_fused_8_8; break;
+      default:   png_ptr->do_fused = png_do_fused; break;
+   }
+
+#ifdef PNG_SHUFFLE_OPTIMIZATIONS
+   /* The hardware versions convert a block of as many whole pixels as fit in
+    * 16 bytes with one byte shuffle and an XOR.  Rows where the pixels get
+    * bigger are done from the end, so then the block is at the end of the 16
+    * bytes, both before and after the shuffle.
+    */
+   {
+      unsigned int n = 16 / (out > in ? out : in);
+      unsigned int in_at = out > in ? 16 - n * in : 0;
+      unsigned int out_at = out > in ? 16 - n * out : 0;
+
+      for (i = 0; i < 16; ++i)
+      {
+         png_ptr->fused_shuffle[i] = 0x80;
+         png_ptr->fused_xor[i] = 0;
+      }
+
+      for (i = 0; i < n * out; ++i)
+      {
+         unsigned int source = pixel->source[i % out];
+
+         if (source < 8)
+            png_ptr->fused_shuffle[out_at + i] =
+                (png_byte)(in_at + (i / out) * in + source);
+
+         png_ptr->fused_xor[out_at + i] = pixel->value[i % out];
+      }
+
+      png_ptr->fused_block = (png_byte)n;
+   }
+#endif
+}
+#endif /* READ_TRANSFORMS || WRITE_TRANSFORMS */
+
 #if defined(PNG_READ_CHECK_FOR_INVALID_INDEX_SUPPORTED) || \
     defined(PNG_WRITE_CHECK_FOR_INVALID_INDEX_SUPPORTED)
 /* Added at libpng-1.5.10 */
@@ -370,6 +370,11 @@ png_write_end(png_structrp png_ptr, png_inforp info_ptr)
       png_benign_error(png_ptr, "Wrote palette index exceeding num_palette");
 #endif
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+   if (png_ptr->num_restart_points > 0)
+      png_write_riDX(png_ptr);
+#endif
+
    /* See if user wants us to write information chunks */
    if (info_ptr != NULL)
    {
@@ -934,6 +939,30 @@ png_write_flush(png_structrp png_ptr)
 }
 #endif /* WRITE_FLUSH */
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+/* Set the number of rows between restart points or 0 to turn them off */
+void PNGAPI
+png_set_restart_points(png_structrp png_ptr, png_uint_32 nrows)
+{
+   png_debug(1, "in png_set_restart_points");
+
+   if (png_ptr == NULL)
+      return;
+
+   /* The array of restart points is allocated, for the number of rows between
+    * them, at the first one.
+    */
+   if (png_ptr->restart_points != NULL)
+   {
+      png_app_error(png_ptr,
+          "png_set_restart_points: image data already written");
+      return;
+   }
+
+   png_ptr->restart_rows = nrows;
+}
+#endif /* WRITE_RESTART_POINTS */
+
 /* Free any memory used in png_ptr struct without freeing the struct itself. */
 static void
 png_write_destroy(png_structrp png_ptr)
@@ -942,7 +971,11 @@ png_write_destroy(png_structrp png_ptr)
 
    /* Free any memory zlib uses */
    if ((png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED) != 0)
-      deflateEnd(&png_ptr->zstream);
+      PNG_ZLIB(png_ptr, deflate_end)(&png_ptr->zstream);
+
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+   png_free_parallel_deflate(png_ptr);
+#endif
 
    /* Free our memory.  png_free checks NULL for us. */
    png_free_buffer_list(png_ptr, &png_ptr->zbuffer_list);
@@ -957,6 +990,11 @@ png_write_destroy(png_structrp png_ptr)
    png_ptr->tst_row = NULL;
 #endif
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+   png_free(png_ptr, png_ptr->restart_points);
+   png_ptr->restart_points = NULL;
+#endif
+
 #ifdef PNG_SET_UNKNOWN_CHUNKS_SUPPORTED
    png_free(png_ptr, png_ptr->chunk_list);
    png_ptr->chunk_list = NULL;
@@ -1238,6 +1276,28 @@ png_set_compression_method(png_structrp png_ptr, int method)
 }
 #endif /* WRITE_CUSTOMIZE_COMPRESSION */
 
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+void PNGAPI
+png_set_compression_threads(png_structrp png_ptr, int num_threads)
+{
+   png_debug(1, "in png_set_compression_threads");
+
+   if (png_ptr == NULL)
+      return;
+
+   /* Each thread compresses PNG_ZPARALLEL_GROUP_SIZE bytes at a time and
+    * buffers both the input and the output, so limit the memory used.
+    */
+   if (num_threads > PNG_ZPARALLEL_MAX_THREADS)
+      num_threads = PNG_ZPARALLEL_MAX_THREADS;
+
+   else if (num_threads < 1)
+      num_threads = 1;
+
+   png_ptr->zlib_threads = num_threads;
+}
+#endif /* WRITE_PARALLEL */
+
 /* The following were added to libpng-1.5.4 */
 #ifdef PNG_WRITE_CUSTOMIZE_ZTXT_COMPRESSION_SUPPORTED
 void PNGAPI
@@ -2115,6 +2175,19 @@ png_image_write_main(png_voidp argument)
 #   endif
    }
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+   /* Split the image data into groups of about PNG_RESTART_GROUP_SIZE bytes
+    * that a reader can decode independently.
+    */
+   if ((image->flags & PNG_IMAGE_FLAG_RESTART_POINTS) != 0)
+   {
+      size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr) + 1;
+
+      png_set_restart_points(png_ptr, rowbytes < PNG_RESTART_GROUP_SIZE ?
+          (png_uint_32)(PNG_RESTART_GROUP_SIZE / rowbytes) : 1);
+   }
+#endif
+
    /* Check for the cases that currently require a pre-transform on the row
     * before it is written.  This only applies when the input is 16-bit and
     * either there is an alpha channel or it is converted to 8-bit.
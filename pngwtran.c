@@ -494,6 +494,140 @@ png_do_write_invert_alpha(png_row_infop row_info, png_bytep row)
 }
 #endif
 
+/* Follow a single pixel through png_do_write_transformations, in the same
+ * order and with the same tests on the row format.  As on read (see
+ * png_init_read_fused) this sets png_ptr->do_fused if every step that would
+ * change the row only moves or inverts bytes.
+ */
+static void
+png_init_write_fused(png_structrp png_ptr)
+{
+   png_uint_32 transformations = png_ptr->transformations;
+   png_fused_pixel pixel;
+   unsigned int in, b, i;
+
+   png_ptr->do_fused = NULL;
+
+   /* Palette and packed rows are left to the separate steps, so are the
+    * shifts and the user transform, which may change the row format.
+    */
+   if (png_ptr->color_type == PNG_COLOR_TYPE_PALETTE ||
+       png_ptr->bit_depth < 8 ||
+       (transformations & (PNG_USER_TRANSFORM | PNG_SHIFT)) != 0)
+      return;
+
+   pixel.color_type = png_ptr->color_type;
+   pixel.bit_depth = png_ptr->usr_bit_depth;
+   pixel.channels = png_ptr->usr_channels;
+   b = pixel.bit_depth >> 3;
+   pixel.bytes = (png_byte)(pixel.channels * b);
+   in = pixel.bytes;
+
+   for (i = 0; i < 8; ++i)
+   {
+      pixel.source[i] = (png_byte)(i < pixel.bytes ? i : 8);
+      pixel.value[i] = 0;
+   }
+
+   pixel.gamma = NULL;
+   pixel.gamma_bytes = 0;
+
+#ifdef PNG_WRITE_FILLER_SUPPORTED
+   if ((transformations & PNG_FILLER) != 0 &&
+       (pixel.channels == 2 || pixel.channels == 4))
+   {
+      /* png_do_strip_channel removes the first channel if the filler is
+       * before the pixel, otherwise the last.
+       */
+      static const png_byte keep[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+      png_fused_pick(&pixel, (png_ptr->flags & PNG_FLAG_FILLER_AFTER) != 0 ?
+          keep : keep + b, pixel.bytes - b);
+      pixel.channels--;
+      pixel.color_type =
+          (png_byte)(pixel.color_type & ~PNG_COLOR_MASK_ALPHA);
+   }
+#endif
+
+   /* PNG_PACKSWAP and PNG_PACK only affect rows of less than 8 bits. */
+
+#ifdef PNG_WRITE_SWAP_SUPPORTED
+#  ifdef PNG_16BIT_SUPPORTED
+   if ((transformations & PNG_SWAP_BYTES) != 0 && pixel.bit_depth == 16)
+   {
+      static const png_byte swap[8] = { 1, 0, 3, 2, 5, 4, 7, 6 };
+
+      png_fused_pick(&pixel, swap, pixel.bytes);
+   }
+#  endif
+#endif
+
+#ifdef PNG_WRITE_SWAP_ALPHA_SUPPORTED
+   if ((transformations & PNG_SWAP_ALPHA) != 0 &&
+       (pixel.color_type == PNG_COLOR_TYPE_RGB_ALPHA ||
+       pixel.color_type == PNG_COLOR_TYPE_GRAY_ALPHA))
+   {
+      /* Move the alpha bytes from the front to the end. */
+      png_byte pick[8];
+
+      for (i = 0; i < pixel.bytes; ++i)
+         pick[i] = (png_byte)((i + b) % pixel.bytes);
+
+      png_fused_pick(&pixel, pick, pixel.bytes);
+   }
+#endif
+
+#ifdef PNG_WRITE_INVERT_ALPHA_SUPPORTED
+   if ((transformations & PNG_INVERT_ALPHA) != 0 &&
+       (pixel.color_type == PNG_COLOR_TYPE_RGB_ALPHA ||
+       pixel.color_type == PNG_COLOR_TYPE_GRAY_ALPHA))
+      png_fused_invert(&pixel, pixel.bytes - b, b);
+#endif
+
+#ifdef PNG_WRITE_BGR_SUPPORTED
+   if ((transformations & PNG_BGR) != 0 &&
+       (pixel.color_type == PNG_COLOR_TYPE_RGB ||
+       pixel.color_type == PNG_COLOR_TYPE_RGB_ALPHA))
+   {
+      static const png_byte bgr[2][8] =
+      {
+         { 2, 1, 0, 3, 0, 0, 0, 0 },
+         { 4, 5, 2, 3, 0, 1, 6, 7 }
+      };
+
+      png_fused_pick(&pixel, bgr[b-1], pixel.bytes);
+   }
+#endif
+
+#ifdef PNG_WRITE_INVERT_SUPPORTED
+   /* png_do_invert inverts all of a gray row but only the gray channel of a
+    * gray-alpha row.
+    */
+   if ((transformations & PNG_INVERT_MONO) != 0)
+   {
+      if (pixel.color_type == PNG_COLOR_TYPE_GRAY)
+         png_fused_invert(&pixel, 0, pixel.bytes);
+
+      else if (pixel.color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+         png_fused_invert(&pixel, 0, b);
+   }
+#endif
+
+   png_init_fused(png_ptr, &pixel, in);
+}
+
+void /* PRIVATE */
+png_init_write_transformations(png_structrp png_ptr)
+{
+   png_debug(1, "in png_init_write_transformations");
+
+   png_init_write_fused(png_ptr);
+
+#ifdef PNG_SHUFFLE_OPTIMIZATIONS
+   PNG_SHUFFLE_OPTIMIZATIONS(png_ptr);
+#endif
+}
+
 /* Transform the data according to the user's wishes.  The order of
  * transformations is significant.
  */
@@ -521,6 +655,18 @@ png_do_write_transformations(png_structrp png_ptr, png_row_infop row_info)
              png_ptr->row_buf + 1);      /* start of pixel data for row */
 #endif
 
+   if (png_ptr->do_fused != NULL)
+   {
+      /* All the transformations can be done in one pass. */
+      png_ptr->do_fused(png_ptr, png_ptr->row_buf + 1, row_info->width);
+      row_info->color_type = png_ptr->fused_color_type;
+      row_info->bit_depth = png_ptr->fused_bit_depth;
+      row_info->channels = png_ptr->fused_channels;
+      row_info->pixel_depth = (png_byte)(8 * png_ptr->fused_out_bytes);
+      row_info->rowbytes = (size_t)row_info->width * png_ptr->fused_out_bytes;
+      return;
+   }
+
 #ifdef PNG_WRITE_FILLER_SUPPORTED
    if ((png_ptr->transformations & PNG_FILLER) != 0)
       png_do_strip_channel(row_info, png_ptr->row_buf + 1,
@@ -529,7 +675,7 @@ png_do_write_transformations(png_structrp png_ptr, png_row_infop row_info)
 
 #ifdef PNG_WRITE_PACKSWAP_SUPPORTED
    if ((png_ptr->transformations & PNG_PACKSWAP) != 0)
-      png_do_packswap(row_info, png_ptr->row_buf + 1);
+      png_do_packswap(png_ptr, row_info, png_ptr->row_buf + 1);
 #endif
 
 #ifdef PNG_WRITE_PACK_SUPPORTED
@@ -15,6 +15,14 @@
 
 #ifdef PNG_WRITE_SUPPORTED
 
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+#  ifdef _WIN32
+#    include <windows.h>
+#  else
+#    include <pthread.h>
+#  endif
+#endif
+
 #ifdef PNG_WRITE_INT_FUNCTIONS_SUPPORTED
 /* Place a 32-bit number into a buffer in PNG byte order.  We work
  * with unsigned numbers for convenience, although one supported
@@ -392,7 +400,7 @@ png_deflate_claim(png_structrp png_ptr, png_uint_32 owner,
          png_ptr->zlib_set_mem_level != memLevel ||
          png_ptr->zlib_set_strategy != strategy))
       {
-         if (deflateEnd(&png_ptr->zstream) != Z_OK)
+         if (PNG_ZLIB(png_ptr, deflate_end)(&png_ptr->zstream) != Z_OK)
             png_warning(png_ptr, "deflateEnd failed (ignored)");
 
          png_ptr->flags &= ~PNG_FLAG_ZSTREAM_INITIALIZED;
@@ -410,12 +418,12 @@ png_deflate_claim(png_structrp png_ptr, png_uint_32 owner,
        * do a simple reset to the previous parameters.
        */
       if ((png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED) != 0)
-         ret = deflateReset(&png_ptr->zstream);
+         ret = PNG_ZLIB(png_ptr, deflate_reset)(&png_ptr->zstream);
 
       else
       {
-         ret = deflateInit2(&png_ptr->zstream, level, method, windowBits,
-             memLevel, strategy);
+         ret = PNG_ZLIB(png_ptr, deflate_init2)(&png_ptr->zstream, level,
+             method, windowBits, memLevel, strategy);
 
          if (ret == Z_OK)
             png_ptr->flags |= PNG_FLAG_ZSTREAM_INITIALIZED;
@@ -483,6 +491,90 @@ png_text_compress_init(compression_state *comp, png_const_bytep input,
    comp->output_len = 0;
 }
 
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+/* Compress the input with one call to the zlib backend deflate_buffer function
+ * and copy the result to comp->output and the png_ptr->zbuffer_list buffers,
+ * where png_text_compress would have left it.  Returns 0 if this fails; the
+ * input is then compressed with the stream functions.
+ */
+static int
+png_text_compress_buffer(png_structrp png_ptr, compression_state *comp,
+    png_uint_32 prefix_len)
+{
+   png_alloc_size_t input_len = comp->input_len;
+   png_compression_bufferp *end = &png_ptr->zbuffer_list;
+   size_t bound, output_len, pos, avail;
+   png_bytep buffer;
+   int level, ok;
+
+   if (input_len > PNG_UINT_31_MAX)
+      return 0;
+
+   /* The zlib compressBound limit, enough for stored blocks. */
+   bound = input_len + (input_len >> 12) + (input_len >> 14) +
+       (input_len >> 25) + 13;
+   output_len = bound;
+
+#ifdef PNG_WRITE_CUSTOMIZE_ZTXT_COMPRESSION_SUPPORTED
+   level = png_ptr->zlib_text_level;
+#else
+   level = png_ptr->zlib_level;
+#endif
+
+   buffer = png_voidcast(png_bytep, png_malloc_base(png_ptr, bound));
+
+   if (buffer == NULL)
+      return 0;
+
+   ok = png_ptr->zlib_backend.deflate_buffer(buffer, &output_len, comp->input,
+       input_len, level) == Z_OK && output_len > 2 && output_len <= bound &&
+       output_len + prefix_len < PNG_UINT_31_MAX;
+
+   avail = (sizeof comp->output);
+
+   if (ok != 0 && avail > output_len)
+      avail = output_len;
+
+   if (ok != 0)
+      memcpy(comp->output, buffer, avail);
+
+   for (pos = avail; ok != 0 && pos < output_len; pos += avail)
+   {
+      png_compression_bufferp next = *end;
+
+      if (next == NULL)
+      {
+         next = png_voidcast(png_compression_bufferp, png_malloc_base(png_ptr,
+             PNG_COMPRESSION_BUFFER_SIZE(png_ptr)));
+
+         if (next == NULL)
+         {
+            ok = 0;
+            break;
+         }
+
+         next->next = NULL;
+         *end = next;
+      }
+
+      avail = png_ptr->zbuffer_size;
+
+      if (avail > output_len - pos)
+         avail = output_len - pos;
+
+      memcpy(next->output, buffer + pos, avail);
+      end = &next->next;
+   }
+
+   png_free(png_ptr, buffer);
+
+   if (ok != 0)
+      comp->output_len = (png_uint_32)output_len;
+
+   return ok;
+}
+#endif /* ZLIB_BACKEND */
+
 /* Compress the data in the compression state input */
 static int
 png_text_compress(png_structrp png_ptr, png_uint_32 chunk_name,
@@ -490,6 +582,17 @@ png_text_compress(png_structrp png_ptr, png_uint_32 chunk_name,
 {
    int ret;
 
+#ifdef PNG_ZLIB_BACKEND_SUPPORTED
+   if (png_ptr->zlib_backend.deflate_buffer != NULL &&
+       png_text_compress_buffer(png_ptr, comp, prefix_len) != 0)
+   {
+#  ifdef PNG_WRITE_OPTIMIZE_CMF_SUPPORTED
+      optimize_cmf(comp->output, comp->input_len);
+#  endif
+      return Z_OK;
+   }
+#endif
+
    /* To find the length of the output it is necessary to first compress the
     * input. The result is buffered rather than using the two-pass algorithm
     * that is used on the inflate side; deflate is assumed to be slower and a
@@ -577,7 +680,7 @@ png_text_compress(png_structrp png_ptr, png_uint_32 chunk_name,
          }
 
          /* Compress the data */
-         ret = deflate(&png_ptr->zstream,
+         ret = PNG_ZLIB(png_ptr, deflate_data)(&png_ptr->zstream,
              input_len > 0 ? Z_NO_FLUSH : Z_FINISH);
 
          /* Claw back input data that was not consumed (because avail_in is
@@ -910,6 +1013,441 @@ png_write_PLTE(png_structrp png_ptr, png_const_colorp palette,
    png_ptr->mode |= PNG_HAVE_PLTE;
 }
 
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+/* Multi-threaded IDAT compression.  The filtered image data is collected into
+ * a batch of up to zlib_threads groups of PNG_ZPARALLEL_GROUP_SIZE bytes.  Each
+ * group is compressed to raw deflate data on its own thread, using the 32768
+ * bytes that precede it as a preset dictionary, and is terminated with a
+ * Z_SYNC_FLUSH (the last group of the image with Z_FINISH) so the results can
+ * simply be concatenated.  The zlib header and the Adler-32 trailer, which is
+ * combined from the checksums of the individual groups, are added here.
+ */
+#define PNG_ZPARALLEL_WINDOW 32768
+
+#if PNG_ZPARALLEL_GROUP_SIZE < PNG_ZPARALLEL_WINDOW
+#  error PNG_ZPARALLEL_GROUP_SIZE must be at least 32768
+#endif
+
+typedef struct png_zjob
+{
+   png_const_structrp png_ptr; /* for PNG_ZLIB */
+   z_stream  zs;
+   png_bytep input;        /* group data, preceded by the dictionary */
+   uInt      input_len;
+   uInt      dict_len;
+   png_bytep output;
+   uInt      output_size;
+   uInt      output_len;
+   uLong     adler;        /* Adler-32 of the group data */
+   int       flush;        /* Z_SYNC_FLUSH or Z_FINISH */
+   int       ret;          /* zlib return code, Z_OK on success */
+   int       started;      /* set if 'thread' must be joined */
+#ifdef _WIN32
+   HANDLE    thread;
+#else
+   pthread_t thread;
+#endif
+} png_zjob, *png_zjobp;
+
+struct png_zparallel
+{
+   png_zjobp        jobs;
+   unsigned int     num_jobs;
+   unsigned int     jobs_init;  /* jobs with an initialized z_stream */
+   png_bytep        input;      /* window followed by num_jobs groups */
+   png_alloc_size_t input_len;  /* bytes of the batch after the window */
+   uInt             window_len; /* bytes of preceding data in the window */
+   uInt             output_pos; /* bytes in the zbuffer_list output buffer */
+   uLong            adler;      /* Adler-32 of the data compressed so far */
+   png_alloc_size_t total_out;  /* bytes of the zlib stream output so far */
+};
+
+void /* PRIVATE */
+png_free_parallel_deflate(png_structrp png_ptr)
+{
+   png_zparallelp zp = png_ptr->zparallel;
+
+   if (zp != NULL)
+   {
+      png_ptr->zparallel = NULL;
+
+      if (zp->jobs != NULL)
+      {
+         unsigned int i;
+
+         for (i = 0; i < zp->num_jobs; ++i)
+         {
+            if (i < zp->jobs_init)
+               PNG_ZLIB(png_ptr, deflate_end)(&zp->jobs[i].zs);
+
+            png_free(png_ptr, zp->jobs[i].output);
+         }
+
+         png_free(png_ptr, zp->jobs);
+      }
+
+      png_free(png_ptr, zp->input);
+      png_free(png_ptr, zp);
+   }
+}
+
+/* Append compressed data to the IDAT output buffer, writing an IDAT chunk each
+ * time the buffer fills.
+ */
+static void
+png_parallel_output(png_structrp png_ptr, png_const_bytep data,
+    png_alloc_size_t size)
+{
+   png_zparallelp zp = png_ptr->zparallel;
+   png_bytep buffer = png_ptr->zbuffer_list->output;
+
+   zp->total_out += size;
+
+   while (size > 0)
+   {
+      uInt avail = png_ptr->zbuffer_size - zp->output_pos;
+
+      if (avail > size)
+         avail = (uInt)size;
+
+      memcpy(buffer + zp->output_pos, data, avail);
+      zp->output_pos += avail;
+      data += avail;
+      size -= avail;
+
+      if (zp->output_pos == png_ptr->zbuffer_size)
+      {
+         png_write_complete_chunk(png_ptr, png_IDAT, buffer, zp->output_pos);
+         png_ptr->mode |= PNG_HAVE_IDAT;
+         zp->output_pos = 0;
+      }
+   }
+}
+
+/* Compress one group.  This runs on a worker thread so it must not call
+ * anything that can png_error or allocate memory; errors are returned in
+ * job->ret.
+ */
+static void
+png_zjob_run(png_zjobp job)
+{
+   int ret = PNG_ZLIB(job->png_ptr, deflate_reset)(&job->zs);
+
+   if (ret == Z_OK && job->dict_len > 0)
+      ret = PNG_ZLIB(job->png_ptr, deflate_set_dictionary)(&job->zs,
+          job->input - job->dict_len, job->dict_len);
+
+   if (ret == Z_OK)
+   {
+      job->zs.next_in = job->input;
+      job->zs.avail_in = job->input_len;
+      job->zs.next_out = job->output;
+      job->zs.avail_out = job->output_size;
+
+      ret = PNG_ZLIB(job->png_ptr, deflate_data)(&job->zs, job->flush);
+
+      /* The output buffer is large enough for all of the output, so anything
+       * other than complete success is an error.
+       */
+      if (job->flush == Z_FINISH)
+      {
+         if (ret == Z_STREAM_END)
+            ret = Z_OK;
+
+         else if (ret == Z_OK)
+            ret = Z_BUF_ERROR;
+      }
+
+      else if (ret == Z_OK && job->zs.avail_out == 0)
+         ret = Z_BUF_ERROR;
+
+      job->output_len = job->output_size - job->zs.avail_out;
+   }
+
+   job->adler = adler32(adler32(0L, Z_NULL, 0), job->input, job->input_len);
+   job->ret = ret;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+png_zjob_thread(LPVOID arg)
+{
+   png_zjob_run(png_voidcast(png_zjobp, arg));
+   return 0;
+}
+#else
+static void *
+png_zjob_thread(void *arg)
+{
+   png_zjob_run(png_voidcast(png_zjobp, arg));
+   return NULL;
+}
+#endif
+
+/* Compress the current batch, one group per thread, and output the results in
+ * order.  'flush' is Z_FINISH for the last batch of the image, in which case
+ * there may be no data at all.
+ */
+static void
+png_parallel_batch(png_structrp png_ptr, int flush)
+{
+   png_zparallelp zp = png_ptr->zparallel;
+   png_alloc_size_t len = zp->input_len;
+   png_alloc_size_t pos = 0;
+   unsigned int num_jobs = 0;
+   unsigned int i;
+
+   do
+   {
+      png_zjobp job = zp->jobs + num_jobs++;
+      png_alloc_size_t dict_len = zp->window_len + pos;
+      png_alloc_size_t size = len - pos;
+
+      if (size > PNG_ZPARALLEL_GROUP_SIZE)
+         size = PNG_ZPARALLEL_GROUP_SIZE;
+
+      if (dict_len > PNG_ZPARALLEL_WINDOW)
+         dict_len = PNG_ZPARALLEL_WINDOW;
+
+      job->input = zp->input + PNG_ZPARALLEL_WINDOW + pos;
+      job->input_len = (uInt)size;
+      job->dict_len = (uInt)dict_len;
+      pos += size;
+      job->flush = pos == len && flush == Z_FINISH ? Z_FINISH : Z_SYNC_FLUSH;
+   }
+   while (pos < len);
+
+   /* If a thread cannot be created the group is just compressed here. */
+   for (i = 1; i < num_jobs; ++i)
+   {
+      png_zjobp job = zp->jobs + i;
+
+#ifdef _WIN32
+      job->thread = CreateThread(NULL, 0, png_zjob_thread, job, 0, NULL);
+      job->started = job->thread != NULL;
+#else
+      job->started =
+          pthread_create(&job->thread, NULL, png_zjob_thread, job) == 0;
+#endif
+
+      if (job->started == 0)
+         png_zjob_run(job);
+   }
+
+   png_zjob_run(zp->jobs);
+
+   for (i = 1; i < num_jobs; ++i)
+   {
+      png_zjobp job = zp->jobs + i;
+
+      if (job->started != 0)
+      {
+#ifdef _WIN32
+         WaitForSingleObject(job->thread, INFINITE);
+         CloseHandle(job->thread);
+#else
+         pthread_join(job->thread, NULL);
+#endif
+         job->started = 0;
+      }
+   }
+
+   /* All the threads have finished, so it is now safe to png_error. */
+   for (i = 0; i < num_jobs; ++i)
+   {
+      png_zjobp job = zp->jobs + i;
+
+      if (job->ret != Z_OK)
+      {
+         png_ptr->zstream.msg = job->zs.msg;
+         png_zstream_error(png_ptr, job->ret);
+         png_error(png_ptr, png_ptr->zstream.msg);
+      }
+
+      zp->adler = adler32_combine(zp->adler, job->adler,
+          (z_off_t)job->input_len);
+      png_parallel_output(png_ptr, job->output, job->output_len);
+   }
+
+   /* Keep the end of the data as the dictionary for the next batch. */
+   if (len > 0)
+   {
+      png_alloc_size_t keep = zp->window_len + len;
+
+      if (keep > PNG_ZPARALLEL_WINDOW)
+         keep = PNG_ZPARALLEL_WINDOW;
+
+      memmove(zp->input + PNG_ZPARALLEL_WINDOW - keep,
+          zp->input + PNG_ZPARALLEL_WINDOW + len - keep, keep);
+      zp->window_len = (uInt)keep;
+      zp->input_len = 0;
+   }
+}
+
+/* Allocate the compressor state and initialize one raw deflate stream per
+ * thread with the IDAT compression parameters, then output the zlib header
+ * that those parameters would have produced.
+ */
+static void
+png_init_parallel_deflate(png_structrp png_ptr)
+{
+   png_zparallelp zp;
+   unsigned int num_jobs = (unsigned int)png_ptr->zlib_threads;
+   int level = png_ptr->zlib_level;
+   int windowBits = png_ptr->zlib_window_bits;
+   int strategy;
+   unsigned int i;
+
+   if ((png_ptr->flags & PNG_FLAG_ZLIB_CUSTOM_STRATEGY) != 0)
+      strategy = png_ptr->zlib_strategy;
+
+   else if (png_ptr->do_filter != PNG_FILTER_NONE)
+      strategy = PNG_Z_DEFAULT_STRATEGY;
+
+   else
+      strategy = PNG_Z_DEFAULT_NOFILTER_STRATEGY;
+
+   /* zlib does not support a 256 byte window for raw deflate data. */
+   if (windowBits < 9)
+      windowBits = 9;
+
+   zp = png_voidcast(png_zparallelp, png_malloc(png_ptr, (sizeof *zp)));
+   memset(zp, 0, (sizeof *zp));
+   png_ptr->zparallel = zp; /* so that it gets freed on error */
+
+   zp->jobs = png_voidcast(png_zjobp, png_malloc(png_ptr,
+       num_jobs * (sizeof *zp->jobs)));
+   memset(zp->jobs, 0, num_jobs * (sizeof *zp->jobs));
+   zp->num_jobs = num_jobs;
+
+   zp->input = png_voidcast(png_bytep, png_malloc(png_ptr,
+       PNG_ZPARALLEL_WINDOW + (png_alloc_size_t)num_jobs *
+       PNG_ZPARALLEL_GROUP_SIZE));
+   zp->adler = adler32(0L, Z_NULL, 0);
+
+   for (i = 0; i < num_jobs; ++i)
+   {
+      png_zjobp job = zp->jobs + i;
+      int ret;
+
+      /* The streams are used on the worker threads, so they use the zlib
+       * allocator rather than the application's memory functions.
+       */
+      job->png_ptr = png_ptr;
+      job->zs.zalloc = Z_NULL;
+      job->zs.zfree = Z_NULL;
+      job->zs.opaque = Z_NULL;
+
+      ret = PNG_ZLIB(png_ptr, deflate_init2)(&job->zs, level,
+          png_ptr->zlib_method, -windowBits, png_ptr->zlib_mem_level,
+          strategy);
+
+      if (ret != Z_OK)
+      {
+         png_ptr->zstream.msg = job->zs.msg;
+         png_zstream_error(png_ptr, ret);
+         png_error(png_ptr, png_ptr->zstream.msg);
+      }
+
+      zp->jobs_init = i + 1;
+
+      /* Allow for the empty stored block written by Z_SYNC_FLUSH. */
+      job->output_size =
+          (uInt)PNG_ZLIB(png_ptr, deflate_bound)(&job->zs,
+          PNG_ZPARALLEL_GROUP_SIZE) + 16;
+      job->output = png_voidcast(png_bytep, png_malloc(png_ptr,
+          job->output_size));
+   }
+
+   /* The zlib header, as written by deflate; see RFC 1950. */
+   {
+      png_byte header[2];
+      unsigned int cmf_flg, level_flags;
+
+      if (level == Z_DEFAULT_COMPRESSION)
+         level = 6;
+
+      if (strategy >= Z_HUFFMAN_ONLY || level < 2)
+         level_flags = 0;
+
+      else if (level < 6)
+         level_flags = 1;
+
+      else if (level == 6)
+         level_flags = 2;
+
+      else
+         level_flags = 3;
+
+      cmf_flg = ((Z_DEFLATED + ((unsigned int)(windowBits - 8) << 4)) << 8) |
+          (level_flags << 6);
+      cmf_flg += 31 - cmf_flg % 31;
+
+      header[0] = (png_byte)(cmf_flg >> 8);
+      header[1] = (png_byte)(cmf_flg & 0xff);
+      png_parallel_output(png_ptr, header, 2);
+   }
+}
+
+/* The threaded equivalent of the deflate loop in png_compress_IDAT. */
+static void
+png_parallel_deflate(png_structrp png_ptr, png_const_bytep input,
+    png_alloc_size_t input_len, int flush)
+{
+   png_zparallelp zp = png_ptr->zparallel;
+   png_alloc_size_t batch_size =
+       (png_alloc_size_t)zp->num_jobs * PNG_ZPARALLEL_GROUP_SIZE;
+
+   while (input_len > 0)
+   {
+      png_alloc_size_t avail;
+
+      /* A full batch is only compressed once more data arrives; this ensures
+       * that the Z_FINISH is applied to the final group.
+       */
+      if (zp->input_len == batch_size)
+         png_parallel_batch(png_ptr, Z_NO_FLUSH);
+
+      avail = batch_size - zp->input_len;
+
+      if (avail > input_len)
+         avail = input_len;
+
+      memcpy(zp->input + PNG_ZPARALLEL_WINDOW + zp->input_len, input, avail);
+      zp->input_len += avail;
+      input += avail;
+      input_len -= avail;
+   }
+
+   if ((flush == Z_SYNC_FLUSH || flush == Z_FULL_FLUSH) && zp->input_len > 0)
+      png_parallel_batch(png_ptr, Z_SYNC_FLUSH);
+
+   /* Every group ends with a Z_SYNC_FLUSH; for a Z_FULL_FLUSH the data before
+    * this point must also not be used as the dictionary of the next group.
+    */
+   if (flush == Z_FULL_FLUSH)
+      zp->window_len = 0;
+
+   else if (flush == Z_FINISH)
+   {
+      png_byte adler[4];
+
+      png_parallel_batch(png_ptr, Z_FINISH);
+
+      png_save_uint_32(adler, (png_uint_32)zp->adler);
+      png_parallel_output(png_ptr, adler, 4);
+
+      if (zp->output_pos > 0)
+         png_write_complete_chunk(png_ptr, png_IDAT,
+             png_ptr->zbuffer_list->output, zp->output_pos);
+
+      png_ptr->mode |= PNG_HAVE_IDAT | PNG_AFTER_IDAT;
+      png_ptr->zowner = 0; /* Release the stream */
+      png_free_parallel_deflate(png_ptr);
+   }
+}
+#endif /* WRITE_PARALLEL */
+
 /* This is similar to png_text_compress, above, except that it does not require
  * all of the data at once and, instead of buffering the compressed result,
  * writes it as IDAT chunks.  Unlike png_text_compress it *can* png_error out
@@ -921,6 +1459,7 @@ png_write_PLTE(png_structrp png_ptr, png_const_colorp palette,
  *
  * Z_NO_FLUSH: normal incremental output of compressed data
  * Z_SYNC_FLUSH: do a SYNC_FLUSH, used by png_write_flush
+ * Z_FULL_FLUSH: do a FULL_FLUSH, used for restart points
  * Z_FINISH: this is the end of the input, do a Z_FINISH and clean up
  *
  * The routine manages the acquire and release of the png_ptr->zstream by
@@ -948,17 +1487,39 @@ png_compress_IDAT(png_structrp png_ptr, png_const_bytep input,
       else
          png_free_buffer_list(png_ptr, &png_ptr->zbuffer_list->next);
 
-      /* It is a terminal error if we can't claim the zstream. */
-      if (png_deflate_claim(png_ptr, png_IDAT, png_image_size(png_ptr)) != Z_OK)
-         png_error(png_ptr, png_ptr->zstream.msg);
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+      /* Threads are only worth using if there are at least two groups. */
+      if (png_ptr->zlib_threads > 1 && png_ptr->zowner == 0 &&
+          png_image_size(png_ptr) >= 2 * PNG_ZPARALLEL_GROUP_SIZE)
+      {
+         png_init_parallel_deflate(png_ptr);
+         png_ptr->zowner = png_IDAT;
+      }
 
-      /* The output state is maintained in png_ptr->zstream, so it must be
-       * initialized here after the claim.
-       */
-      png_ptr->zstream.next_out = png_ptr->zbuffer_list->output;
-      png_ptr->zstream.avail_out = png_ptr->zbuffer_size;
+      else
+#endif
+      {
+         /* It is a terminal error if we can't claim the zstream. */
+         if (png_deflate_claim(png_ptr, png_IDAT, png_image_size(png_ptr)) !=
+             Z_OK)
+            png_error(png_ptr, png_ptr->zstream.msg);
+
+         /* The output state is maintained in png_ptr->zstream, so it must be
+          * initialized here after the claim.
+          */
+         png_ptr->zstream.next_out = png_ptr->zbuffer_list->output;
+         png_ptr->zstream.avail_out = png_ptr->zbuffer_size;
+      }
    }
 
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+   if (png_ptr->zparallel != NULL)
+   {
+      png_parallel_deflate(png_ptr, input, input_len, flush);
+      return;
+   }
+#endif
+
    /* Now loop reading and writing until all the input is consumed or an error
     * terminates the operation.  The _out values are maintained across calls to
     * this function, but the input must be reset each time.
@@ -978,7 +1539,8 @@ png_compress_IDAT(png_structrp png_ptr, png_const_bytep input,
       png_ptr->zstream.avail_in = avail;
       input_len -= avail;
 
-      ret = deflate(&png_ptr->zstream, input_len > 0 ? Z_NO_FLUSH : flush);
+      ret = PNG_ZLIB(png_ptr, deflate_data)(&png_ptr->zstream,
+          input_len > 0 ? Z_NO_FLUSH : flush);
 
       /* Include as-yet unconsumed input */
       input_len += png_ptr->zstream.avail_in;
@@ -1068,6 +1630,90 @@ png_compress_IDAT(png_structrp png_ptr, png_const_bytep input,
    }
 }
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+/* A restart point is a row that starts at a byte offset of the zlib stream in
+ * the IDAT chunks where the compressor has been fully flushed and which is not
+ * filtered with reference to the previous row, so a decoder can decompress and
+ * unfilter the rows from that point on without the rows before it.  The riDX
+ * chunk, written after the IDAT chunks, lists them as pairs of 4-byte unsigned
+ * integers: the row number and the offset, counted from the start of the zlib
+ * stream (i.e. including its two byte header.)
+ */
+int /* PRIVATE */
+png_write_restart_point(png_structrp png_ptr)
+{
+   png_uint_32 row = png_ptr->row_number;
+   png_uint_32 max_points;
+   png_alloc_size_t offset;
+
+   /* The rows of an interlaced image are spread over all the passes, so a
+    * group of rows can't be decoded on its own.
+    */
+   if (png_ptr->restart_rows == 0 || png_ptr->interlaced != 0 || row == 0 ||
+       row % png_ptr->restart_rows != 0)
+      return 0;
+
+   /* The riDX chunk length must fit in 31 bits. */
+   max_points = (png_ptr->height - 1) / png_ptr->restart_rows;
+
+   if (max_points > PNG_UINT_31_MAX / 8)
+      max_points = PNG_UINT_31_MAX / 8;
+
+   if (png_ptr->num_restart_points >= max_points)
+      return 0;
+
+   if (png_ptr->restart_points == NULL)
+      png_ptr->restart_points = png_voidcast(png_uint_32p, png_malloc(png_ptr,
+          (png_alloc_size_t)max_points * 2 * (sizeof (png_uint_32))));
+
+   png_compress_IDAT(png_ptr, NULL, 0, Z_FULL_FLUSH);
+
+#ifdef PNG_WRITE_PARALLEL_SUPPORTED
+   if (png_ptr->zparallel != NULL)
+      offset = png_ptr->zparallel->total_out;
+
+   else
+#endif
+      offset = png_ptr->zstream.total_out;
+
+   /* Stop if the offset no longer fits; the rows are just written normally. */
+   if (offset > PNG_UINT_31_MAX)
+   {
+      png_ptr->restart_rows = 0;
+      return 0;
+   }
+
+   png_ptr->restart_points[2 * png_ptr->num_restart_points] = row;
+   png_ptr->restart_points[2 * png_ptr->num_restart_points + 1] =
+       (png_uint_32)offset;
+   png_ptr->num_restart_points++;
+
+   return 1;
+}
+
+/* Write the riDX chunk; this must follow the last IDAT chunk. */
+void /* PRIVATE */
+png_write_riDX(png_structrp png_ptr)
+{
+   png_uint_32 i;
+
+   png_debug(1, "in png_write_riDX");
+
+   png_write_chunk_header(png_ptr, png_riDX, 8 * png_ptr->num_restart_points);
+
+   for (i = 0; i < png_ptr->num_restart_points; ++i)
+   {
+      png_byte buf[8];
+
+      png_save_uint_32(buf, png_ptr->restart_points[2 * i]);
+      png_save_uint_32(buf + 4, png_ptr->restart_points[2 * i + 1]);
+      png_write_chunk_data(png_ptr, buf, 8);
+   }
+
+   png_write_chunk_end(png_ptr);
+}
+#endif /* WRITE_RESTART_POINTS */
+
 /* Write an IEND chunk */
 void /* PRIVATE */
 png_write_IEND(png_structrp png_ptr)
@@ -1926,6 +2572,10 @@ png_write_start_row(png_structrp png_ptr)
 
    png_ptr->row_buf[0] = PNG_FILTER_VALUE_NONE;
 
+#ifdef PNG_WRITE_TRANSFORMS_SUPPORTED
+   png_init_write_transformations(png_ptr);
+#endif
+
 #ifdef PNG_WRITE_FILTER_SUPPORTED
    filters = png_ptr->do_filter;
 
@@ -1970,6 +2620,15 @@ png_write_start_row(png_structrp png_ptr)
    if ((filters & (PNG_FILTER_AVG | PNG_FILTER_UP | PNG_FILTER_PAETH)) != 0)
       png_ptr->prev_row = png_voidcast(png_bytep,
           png_calloc(png_ptr, buf_size));
+
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   /* Install any hardware specific filter functions; those left NULL use the
+    * C code below.
+    */
+   if ((filters & (PNG_FILTER_SUB | PNG_FILTER_UP | PNG_FILTER_AVG |
+       PNG_FILTER_PAETH)) != 0)
+      PNG_WRITE_FILTER_OPTIMIZATIONS(png_ptr, (png_ptr->pixel_depth + 7) >> 3);
+#endif
 #endif /* WRITE_FILTER */
 
 #ifdef PNG_WRITE_INTERLACING_SUPPORTED
@@ -2286,6 +2945,13 @@ png_setup_sub_row(png_structrp png_ptr, png_uint_32 bpp,
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_SUB;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_SUB-1] != NULL)
+      return png_ptr->write_filter[PNG_FILTER_VALUE_SUB-1](
+          png_ptr->row_buf + 1, NULL, png_ptr->try_row + 1, row_bytes,
+          bpp, lmins);
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1; i < bpp;
         i++, rp++, dp++)
    {
@@ -2323,6 +2989,16 @@ png_setup_sub_row_only(png_structrp png_ptr, png_uint_32 bpp,
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_SUB;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_SUB-1] != NULL)
+   {
+      (void)png_ptr->write_filter[PNG_FILTER_VALUE_SUB-1](
+          png_ptr->row_buf + 1, NULL, png_ptr->try_row + 1, row_bytes,
+          bpp, PNG_SIZE_MAX);
+      return;
+   }
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1; i < bpp;
         i++, rp++, dp++)
    {
@@ -2346,6 +3022,13 @@ png_setup_up_row(png_structrp png_ptr, size_t row_bytes, size_t lmins)
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_UP;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_UP-1] != NULL)
+      return png_ptr->write_filter[PNG_FILTER_VALUE_UP-1](
+          png_ptr->row_buf + 1, png_ptr->prev_row + 1, png_ptr->try_row + 1,
+          row_bytes, 1, lmins);
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1,
        pp = png_ptr->prev_row + 1; i < row_bytes;
        i++, rp++, pp++, dp++)
@@ -2371,6 +3054,16 @@ png_setup_up_row_only(png_structrp png_ptr, size_t row_bytes)
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_UP;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_UP-1] != NULL)
+   {
+      (void)png_ptr->write_filter[PNG_FILTER_VALUE_UP-1](
+          png_ptr->row_buf + 1, png_ptr->prev_row + 1, png_ptr->try_row + 1,
+          row_bytes, 1, PNG_SIZE_MAX);
+      return;
+   }
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1,
        pp = png_ptr->prev_row + 1; i < row_bytes;
        i++, rp++, pp++, dp++)
@@ -2390,6 +3083,13 @@ png_setup_avg_row(png_structrp png_ptr, png_uint_32 bpp,
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_AVG;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_AVG-1] != NULL)
+      return png_ptr->write_filter[PNG_FILTER_VALUE_AVG-1](
+          png_ptr->row_buf + 1, png_ptr->prev_row + 1, png_ptr->try_row + 1,
+          row_bytes, bpp, lmins);
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1,
        pp = png_ptr->prev_row + 1; i < bpp; i++)
    {
@@ -2428,6 +3128,16 @@ png_setup_avg_row_only(png_structrp png_ptr, png_uint_32 bpp,
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_AVG;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_AVG-1] != NULL)
+   {
+      (void)png_ptr->write_filter[PNG_FILTER_VALUE_AVG-1](
+          png_ptr->row_buf + 1, png_ptr->prev_row + 1, png_ptr->try_row + 1,
+          row_bytes, bpp, PNG_SIZE_MAX);
+      return;
+   }
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1,
        pp = png_ptr->prev_row + 1; i < bpp; i++)
    {
@@ -2452,6 +3162,13 @@ png_setup_paeth_row(png_structrp png_ptr, png_uint_32 bpp,
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_PAETH;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_PAETH-1] != NULL)
+      return png_ptr->write_filter[PNG_FILTER_VALUE_PAETH-1](
+          png_ptr->row_buf + 1, png_ptr->prev_row + 1, png_ptr->try_row + 1,
+          row_bytes, bpp, lmins);
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1,
        pp = png_ptr->prev_row + 1; i < bpp; i++)
    {
@@ -2511,6 +3228,16 @@ png_setup_paeth_row_only(png_structrp png_ptr, png_uint_32 bpp,
 
    png_ptr->try_row[0] = PNG_FILTER_VALUE_PAETH;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_PAETH-1] != NULL)
+   {
+      (void)png_ptr->write_filter[PNG_FILTER_VALUE_PAETH-1](
+          png_ptr->row_buf + 1, png_ptr->prev_row + 1, png_ptr->try_row + 1,
+          row_bytes, bpp, PNG_SIZE_MAX);
+      return;
+   }
+#endif
+
    for (i = 0, rp = png_ptr->row_buf + 1, dp = png_ptr->try_row + 1,
        pp = png_ptr->prev_row + 1; i < bpp; i++)
    {
@@ -2550,6 +3277,9 @@ void /* PRIVATE */
 png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
 {
 #ifndef PNG_WRITE_FILTER_SUPPORTED
+#  ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+   (void)png_write_restart_point(png_ptr);
+#  endif
    png_write_filtered_row(png_ptr, png_ptr->row_buf, row_info->rowbytes+1);
 #else
    unsigned int filter_to_do = png_ptr->do_filter;
@@ -2561,6 +3291,17 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
 
    png_debug(1, "in png_write_find_filter");
 
+#ifdef PNG_WRITE_RESTART_POINTS_SUPPORTED
+   /* The first row of a group must not depend on the previous row. */
+   if (png_write_restart_point(png_ptr) != 0)
+   {
+      filter_to_do &= PNG_FILTER_NONE | PNG_FILTER_SUB;
+
+      if (filter_to_do == 0)
+         filter_to_do = PNG_FILTER_NONE;
+   }
+#endif
+
    /* Find out how many bytes offset each pixel is */
    bpp = (row_info->pixel_depth + 7) >> 3;
 
@@ -2605,6 +3346,38 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
        */
       filter_to_do &= 0U-filter_to_do;
    }
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   else if (png_ptr->write_filter_sums != NULL &&
+         (filter_to_do & (filter_to_do - 1)) != 0 &&
+         png_ptr->prev_row != NULL)
+   {
+      /* Several filters, including at least one that uses the previous row,
+       * and a hardware specific function to sum all five in one pass: reduce
+       * the list to the filter with the smallest sum (the first, in the order
+       * below, if there is a tie) so that the row is only filtered once.  The
+       * C code does not do this because, unlike the loops below, it can't
+       * stop early on a filter that is already worse.
+       */
+      size_t sums[PNG_FILTER_VALUE_LAST];
+      int filter, best = PNG_FILTER_VALUE_NONE;
+
+      png_ptr->write_filter_sums(row_buf + 1, png_ptr->prev_row + 1,
+          row_bytes, bpp, sums);
+
+      for (filter = PNG_FILTER_VALUE_NONE; filter < PNG_FILTER_VALUE_LAST;
+           filter++)
+      {
+         if ((filter_to_do & (PNG_FILTER_NONE << filter)) != 0 &&
+             sums[filter] < mins)
+         {
+            mins = sums[filter];
+            best = filter;
+         }
+      }
+
+      filter_to_do = PNG_FILTER_NONE << best;
+   }
+#endif
    else if ((filter_to_do & PNG_FILTER_NONE) != 0 &&
          filter_to_do != PNG_FILTER_NONE)
    {
@@ -43,6 +43,7 @@
 #define PNG_INCH_CONVERSIONS_SUPPORTED
 #define PNG_READ_16_TO_8_ACCURATE_SCALE_SUPPORTED
 #define PNG_SET_OPTION_SUPPORTED
+#define PNG_WRITE_PARALLEL_SUPPORTED
 
 #undef PNG_H
 #include "../png.h"